@@ -11,8 +11,25 @@ RETURN_CODE_SUCCESS=0
 RETURN_CODE_ERROR=1
 
 SRC_FILES_COMMON=(
+    "src/charger_queue.cpp"
+    "src/charger_site.cpp"
+    "src/checkpoint.cpp"
+    "src/config.cpp"
+    "src/fleet_catalog.cpp"
+    "src/fleet_soa.cpp"
+    "src/instrumentation.cpp"
+    "src/monte_carlo.cpp"
+    "src/network.cpp"
+    "src/results_writer.cpp"
+    "src/scenario.cpp"
     "src/simulation.cpp"
+    "src/statistics.cpp"
+    "src/sweep.cpp"
+    "src/thread_pool.cpp"
+    "src/trace.cpp"
+    "src/trace_analysis.cpp"
     "src/vehicle.cpp"
+    "src/what_if.cpp"
 )
 
 
@@ -25,6 +42,9 @@ build_and_run_program()
     CUSTOM_DEFINES=(
         # uncomment to turn debug prints ON throughout the whole program (see "utils.h")
         "-DDEBUG"
+        # uncomment to count and time the hot paths, and print a summary at exit (see
+        # "instrumentation.h")
+        # "-DINSTRUMENTATION"
     )
     EXECUTABLE_NAME="evtol_simulation"
 
@@ -35,7 +55,7 @@ build_and_run_program()
     mkdir -p bin
 
     echo "Building..."
-    time ccache g++ -Wall -Wextra -Werror -O3 -std=gnu++17 "${CUSTOM_DEFINES[@]}" \
+    time ccache g++ -Wall -Wextra -Werror -O3 -std=gnu++17 -pthread "${CUSTOM_DEFINES[@]}" \
         "${SRC_FILES[@]}" -I"src" -o "bin/$EXECUTABLE_NAME"
 
     return_code="$?"
@@ -57,6 +77,8 @@ build_and_run_unit_tests()
     CUSTOM_DEFINES=(
         # uncomment to turn debug prints ON throughout the whole program (see "utils.h")
         # "-DDEBUG"
+        # uncomment to count and time the hot paths (see "instrumentation.h")
+        # "-DINSTRUMENTATION"
     )
     EXECUTABLE_NAME="evtol_simulation_unittest"
 
@@ -81,6 +103,67 @@ build_and_run_unit_tests()
     fi
 }
 
+build_and_run_benchmarks()
+{
+    SRC_FILES=(
+        "src/main_benchmark.cpp"
+        "${SRC_FILES_COMMON[@]}"
+    )
+    CUSTOM_DEFINES=(
+        # uncomment to turn debug prints ON throughout the whole program (see "utils.h")
+        # "-DDEBUG"
+        # uncomment to count and time the hot paths (see "instrumentation.h")
+        # "-DINSTRUMENTATION"
+    )
+    EXECUTABLE_NAME="evtol_simulation_benchmark"
+
+
+    echo "================================================="
+    echo "Building and running $EXECUTABLE_NAME."
+    echo "================================================="
+    cd "$SCRIPT_DIRECTORY"
+    mkdir -p bin
+
+    echo "Building..."
+    time ccache g++ -Wall -Wextra -Werror -O3 -std=gnu++17 -pthread "${CUSTOM_DEFINES[@]}" \
+        "${SRC_FILES[@]}" -lbenchmark_main -lbenchmark -o "bin/$EXECUTABLE_NAME"
+
+    return_code="$?"
+    if [ "$return_code" -eq 0 ]; then
+        echo -e "\nRunning..."
+        # pass any extra arguments, such as `--benchmark_filter=<regex>`, on to the benchmarks
+        "bin/$EXECUTABLE_NAME" "$@"
+    else
+        echo "Failed to build."
+        exit "$RETURN_CODE_ERROR"
+    fi
+}
+
+build_trace_reader()
+{
+    SRC_FILES=(
+        "src/trace_reader_main.cpp"
+        "${SRC_FILES_COMMON[@]}"
+    )
+    EXECUTABLE_NAME="evtol_trace_reader"
+
+    echo "================================================="
+    echo "Building $EXECUTABLE_NAME."
+    echo "================================================="
+    cd "$SCRIPT_DIRECTORY"
+    mkdir -p bin
+
+    echo "Building..."
+    time ccache g++ -Wall -Wextra -Werror -O3 -std=gnu++17 -pthread \
+        "${SRC_FILES[@]}" -o "bin/$EXECUTABLE_NAME"
+
+    return_code="$?"
+    if [ "$return_code" -ne 0 ]; then
+        echo "Failed to build."
+        exit "$RETURN_CODE_ERROR"
+    fi
+}
+
 main() {
     if [ "$#" -eq 0 ]; then
         # if no args, build and run both
@@ -95,6 +178,15 @@ main() {
         # build and run the main program only
         echo "Building and running the main program only."
         build_and_run_program
+    elif [ "$1" = "trace_reader" ]; then
+        # build the trace reader tool only; run it yourself on a trace file
+        echo "Building the trace reader tool only."
+        build_trace_reader
+    elif [ "$1" = "benchmark" ]; then
+        # build and run the benchmarks only, passing any remaining args on to them
+        echo "Building and running benchmarks only."
+        shift
+        build_and_run_benchmarks "$@"
     fi
 }
 
@@ -0,0 +1,132 @@
+#include "charger_queue.h"
+
+// local includes
+#include "checkpoint.h"
+
+// C++ includes
+#include <algorithm>
+#include <functional>
+
+Charger_queue::Charger_queue(Charger_queue_policy policy) : _policy{policy}
+{
+}
+
+void Charger_queue::push(uint32_t i_vehicle, double priority_key)
+{
+    if (_policy != Charger_queue_policy::FIFO)
+    {
+        _heap.push_back({priority_key, _next_sequence_num, i_vehicle});
+        _next_sequence_num++;
+        std::push_heap(_heap.begin(), _heap.end(), std::greater<Heap_entry>());
+        return;
+    }
+
+    if (_ring_size == _ring.size())
+    {
+        // Full: double the capacity, unwrapping the contents to start at index 0
+        std::vector<uint32_t> new_ring(std::max<size_t>(16, 2 * _ring.size()));
+        for (size_t i = 0; i < _ring_size; i++)
+        {
+            new_ring[i] = _ring[(_ring_head + i) & (_ring.size() - 1)];
+        }
+        _ring.swap(new_ring);
+        _ring_head = 0;
+    }
+
+    _ring[(_ring_head + _ring_size) & (_ring.size() - 1)] = i_vehicle;
+    _ring_size++;
+}
+
+bool Charger_queue::pop(uint32_t* i_vehicle)
+{
+    if (_policy != Charger_queue_policy::FIFO)
+    {
+        if (_heap.empty())
+        {
+            return false;
+        }
+        std::pop_heap(_heap.begin(), _heap.end(), std::greater<Heap_entry>());
+        *i_vehicle = _heap.back().i_vehicle;
+        _heap.pop_back();
+        return true;
+    }
+
+    if (_ring_size == 0)
+    {
+        return false;
+    }
+    *i_vehicle = _ring[_ring_head];
+    _ring_head = (_ring_head + 1) & (_ring.size() - 1);
+    _ring_size--;
+    return true;
+}
+
+size_t Charger_queue::size() const
+{
+    return _policy == Charger_queue_policy::FIFO ? _ring_size : _heap.size();
+}
+
+void Charger_queue::clear()
+{
+    _ring_head = 0;
+    _ring_size = 0;
+    _heap.clear();
+}
+
+void Charger_queue::save(Checkpoint_writer* writer) const
+{
+    writer->write(_policy);
+
+    // Note: write the ring in line order, so that loading it doesn't depend on its capacity
+    std::vector<uint32_t> ring;
+    ring.reserve(_ring_size);
+    for (size_t i = 0; i < _ring_size; i++)
+    {
+        ring.push_back(_ring[(_ring_head + i) & (_ring.size() - 1)]);
+    }
+    writer->write_vector(ring);
+
+    writer->write_vector(_heap);
+    writer->write(_next_sequence_num);
+}
+
+bool Charger_queue::load(Checkpoint_reader* reader, uint32_t num_vehicles)
+{
+    Charger_queue_policy policy;
+    std::vector<uint32_t> ring;
+    std::vector<Heap_entry> heap;
+    uint64_t next_sequence_num = 0;
+    if (!reader->read(&policy) || policy != _policy || !reader->read_vector(&ring)
+        || !reader->read_vector(&heap) || !reader->read(&next_sequence_num))
+    {
+        return false;
+    }
+
+    for (uint32_t i_vehicle : ring)
+    {
+        if (i_vehicle >= num_vehicles)
+        {
+            return false;
+        }
+    }
+    for (const Heap_entry& entry : heap)
+    {
+        if (entry.i_vehicle >= num_vehicles || entry.sequence_num >= next_sequence_num)
+        {
+            return false;
+        }
+    }
+    if (!std::is_heap(heap.begin(), heap.end(), std::greater<Heap_entry>()))
+    {
+        return false;
+    }
+
+    clear();
+    for (uint32_t i_vehicle : ring)
+    {
+        push(i_vehicle);
+    }
+    _heap = std::move(heap);
+    _next_sequence_num = next_sequence_num;
+    return true;
+}
@@ -0,0 +1,101 @@
+/*
+Charger queue module: the line of vehicles waiting for a charger.
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Checkpoint_reader;
+class Checkpoint_writer;
+
+/// The order in which waiting vehicles get the next free charger
+enum class Charger_queue_policy
+{
+    /// First come, first served
+    FIFO = 0,
+    /// Vehicles whose type has the lowest max range go first, since they will need a charger
+    /// again the soonest; FIFO among equals
+    LOWEST_RANGE_FIRST,
+    /// Vehicles whose type has the shortest time to charge go first, which minimizes the average
+    /// wait (the "shortest job first" rule); FIFO among equals
+    SHORTEST_CHARGE_FIRST,
+};
+
+/// The line of vehicles waiting for a charger. Vehicles get in line once, and are then handed a
+/// charger directly, in policy order, as soon as one is released, so waiting vehicles cost
+/// nothing per time step. Push and pop are O(1) for `Charger_queue_policy::FIFO`, and O(log n)
+/// for the priority policies.
+class Charger_queue
+{
+public:
+    explicit Charger_queue(Charger_queue_policy policy = Charger_queue_policy::FIFO);
+
+    /// Get vehicle `i_vehicle` in line. For priority policies, vehicles with the lowest
+    /// `priority_key` are served first; FIFO ignores it.
+    void push(uint32_t i_vehicle, double priority_key = 0);
+
+    /// Take the next vehicle out of line. Returns false if the line is empty.
+    bool pop(uint32_t* i_vehicle);
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t size() const;
+
+    Charger_queue_policy policy() const
+    {
+        return _policy;
+    }
+
+    /// Remove every vehicle from the line
+    void clear();
+
+    /// Write the line, in order, to a checkpoint
+    void save(Checkpoint_writer* writer) const;
+    /// Replace the line with the one in a checkpoint. Returns false if the checkpoint is
+    /// malformed, or holds a different policy or any vehicle index >= `num_vehicles`.
+    bool load(Checkpoint_reader* reader, uint32_t num_vehicles);
+
+private:
+    Charger_queue_policy _policy;
+
+    // For `Charger_queue_policy::FIFO`: a ring buffer, whose capacity is always a power of 2
+
+    std::vector<uint32_t> _ring;
+    size_t _ring_head = 0;
+    size_t _ring_size = 0;
+
+    // For the priority policies: a binary min-heap
+
+    struct Heap_entry
+    {
+        double priority_key;
+        /// Order of arrival, to keep the line FIFO among vehicles with equal keys
+        uint64_t sequence_num;
+        uint32_t i_vehicle;
+
+        bool operator>(const Heap_entry& other) const
+        {
+            if (priority_key != other.priority_key)
+            {
+                return priority_key > other.priority_key;
+            }
+            return sequence_num > other.sequence_num;
+        }
+    };
+
+    std::vector<Heap_entry> _heap;
+    uint64_t _next_sequence_num = 0;
+};
@@ -0,0 +1,271 @@
+#include "charger_site.h"
+
+// local includes
+#include "vehicle.h"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+bool Charger_site_config::is_valid() const
+{
+    bool valid = true;
+
+    for (double power_kw : charger_power_kw)
+    {
+        if (!(power_kw > 0 && std::isfinite(power_kw)))
+        {
+            printf("Error: every charger_power_kw must be > 0, but got %f.\n", power_kw);
+            valid = false;
+        }
+    }
+
+    if (!(site_power_cap_kw >= 0))
+    {
+        printf("Error: site_power_cap_kw must be >= 0, but is %f.\n", site_power_cap_kw);
+        valid = false;
+    }
+    for (const Site_power_cap_change& change : power_cap_changes)
+    {
+        if (!(change.start_hrs >= 0 && change.cap_kw >= 0))
+        {
+            printf("Error: a site_power_cap_change needs a start time and a cap >= 0, but got %f "
+                   "hrs and %f kW.\n",
+                   change.start_hrs,
+                   change.cap_kw);
+            valid = false;
+        }
+    }
+
+    for (const Charger_outage& outage : outages)
+    {
+        if (outage.i_charger >= charger_power_kw.size())
+        {
+            printf("Error: a charger_outage is for charger %u, but there are only %lu chargers.\n",
+                   outage.i_charger,
+                   charger_power_kw.size());
+            valid = false;
+        }
+        if (!(outage.start_hrs >= 0 && outage.end_hrs >= outage.start_hrs))
+        {
+            printf("Error: a charger_outage must start at >= 0 hrs and end no earlier, but is from "
+                   "%f to %f hrs.\n",
+                   outage.start_hrs,
+                   outage.end_hrs);
+            valid = false;
+        }
+    }
+
+    if (!enabled() && (!power_cap_changes.empty() || !outages.empty()
+                       || site_power_cap_kw != std::numeric_limits<double>::infinity()))
+    {
+        printf("Error: site power caps and charger outages require charger_power_kw.\n");
+        valid = false;
+    }
+
+    return valid;
+}
+
+void Charger_site::init(const Charger_site_config& config, double step_size_hrs)
+{
+    _chargers.clear();
+    for (double power_kw : config.charger_power_kw)
+    {
+        Charger charger;
+        charger.max_power_kw = power_kw;
+        _chargers.push_back(charger);
+    }
+
+    _schedule.clear();
+    for (const Charger_outage& outage : config.outages)
+    {
+        _schedule.push_back({num_steps_to_complete(outage.start_hrs, step_size_hrs),
+                             Site_change::Type::OUTAGE_START,
+                             outage.i_charger,
+                             0});
+        _schedule.push_back({num_steps_to_complete(outage.end_hrs, step_size_hrs),
+                             Site_change::Type::OUTAGE_END,
+                             outage.i_charger,
+                             0});
+    }
+    for (const Site_power_cap_change& change : config.power_cap_changes)
+    {
+        _schedule.push_back({num_steps_to_complete(change.start_hrs, step_size_hrs),
+                             Site_change::Type::POWER_CAP,
+                             0,
+                             change.cap_kw});
+    }
+    // keep changes at the same time step in the order given, so an outage starts before it ends
+    std::stable_sort(
+        _schedule.begin(), _schedule.end(), [](const Site_change& a, const Site_change& b) {
+            return a.step < b.step;
+        });
+
+    _power_cap_kw = config.site_power_cap_kw;
+    _load_shedding_policy = config.load_shedding_policy;
+    _time_hrs = 0;
+    _next_session_sequence_num = 0;
+}
+
+void Charger_site::advance(double time_hrs)
+{
+    double elapsed_hrs = time_hrs - _time_hrs;
+    for (Charger& charger : _chargers)
+    {
+        if (charger.in_use())
+        {
+            charger.energy_remaining_kwh =
+                std::max(charger.energy_remaining_kwh - charger.power_kw * elapsed_hrs, 0.0);
+        }
+    }
+    _time_hrs = time_hrs;
+}
+
+bool Charger_site::start_session(uint32_t i_vehicle,
+                                 double vehicle_power_kw,
+                                 double energy_kwh,
+                                 uint32_t* i_charger)
+{
+    uint32_t i_best = Charger::NO_VEHICLE;
+    for (uint32_t i = 0; i < _chargers.size(); i++)
+    {
+        const Charger& charger = _chargers[i];
+        if (!charger.in_use() && charger.in_service()
+            && (i_best == Charger::NO_VEHICLE
+                || charger.max_power_kw > _chargers[i_best].max_power_kw))
+        {
+            i_best = i;
+        }
+    }
+    if (i_best == Charger::NO_VEHICLE)
+    {
+        return false;
+    }
+
+    Charger& charger = _chargers[i_best];
+    charger.i_vehicle = i_vehicle;
+    charger.demand_kw = std::min(charger.max_power_kw, vehicle_power_kw);
+    charger.power_kw = 0;
+    charger.energy_remaining_kwh = energy_kwh;
+    charger.session_sequence_num = _next_session_sequence_num;
+    _next_session_sequence_num++;
+
+    *i_charger = i_best;
+    return true;
+}
+
+void Charger_site::end_session(uint32_t i_charger)
+{
+    Charger& charger = _chargers[i_charger];
+    charger.i_vehicle = Charger::NO_VEHICLE;
+    charger.demand_kw = 0;
+    charger.power_kw = 0;
+    charger.energy_remaining_kwh = 0;
+}
+
+bool Charger_site::apply(const Site_change& change,
+                         uint32_t* i_vehicle,
+                         double* energy_remaining_kwh)
+{
+    switch (change.type)
+    {
+    case Site_change::Type::OUTAGE_START:
+    {
+        Charger& charger = _chargers[change.i_charger];
+        (charger.num_outages)++;
+        if (charger.in_use())
+        {
+            *i_vehicle = charger.i_vehicle;
+            *energy_remaining_kwh = charger.energy_remaining_kwh;
+            end_session(change.i_charger);
+            return true;
+        }
+        break;
+    }
+    case Site_change::Type::OUTAGE_END:
+        (_chargers[change.i_charger].num_outages)--;
+        break;
+    case Site_change::Type::POWER_CAP:
+        _power_cap_kw = change.cap_kw;
+        break;
+    }
+
+    return false;
+}
+
+bool Charger_site::has_free_charger() const
+{
+    for (const Charger& charger : _chargers)
+    {
+        if (!charger.in_use() && charger.in_service())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Charger_site::allocate_power(std::vector<uint32_t>* changed)
+{
+    auto set_power = [&](uint32_t i_charger, double power_kw) {
+        Charger& charger = _chargers[i_charger];
+        if (charger.power_kw != power_kw)
+        {
+            charger.power_kw = power_kw;
+            changed->push_back(i_charger);
+        }
+    };
+
+    _sessions_in_order.clear();
+    double total_demand_kw = 0;
+    for (uint32_t i_charger = 0; i_charger < _chargers.size(); i_charger++)
+    {
+        if (_chargers[i_charger].in_use())
+        {
+            _sessions_in_order.push_back(i_charger);
+            total_demand_kw += _chargers[i_charger].demand_kw;
+        }
+    }
+
+    // Note: a new session starts out with 0 power, so always counts as changed, unless it's given
+    // no power at all
+    if (total_demand_kw <= _power_cap_kw)
+    {
+        for (uint32_t i_charger : _sessions_in_order)
+        {
+            set_power(i_charger, _chargers[i_charger].demand_kw);
+        }
+        return;
+    }
+
+    switch (_load_shedding_policy)
+    {
+    case Load_shedding_policy::PROPORTIONAL:
+    {
+        double fraction = _power_cap_kw / total_demand_kw;
+        for (uint32_t i_charger : _sessions_in_order)
+        {
+            set_power(i_charger, _chargers[i_charger].demand_kw * fraction);
+        }
+        break;
+    }
+    case Load_shedding_policy::FIRST_COME_FIRST_SERVED:
+    {
+        std::sort(_sessions_in_order.begin(),
+                  _sessions_in_order.end(),
+                  [&](uint32_t a, uint32_t b) {
+                      return _chargers[a].session_sequence_num
+                             < _chargers[b].session_sequence_num;
+                  });
+        double power_left_kw = _power_cap_kw;
+        for (uint32_t i_charger : _sessions_in_order)
+        {
+            double power_kw = std::min(_chargers[i_charger].demand_kw, power_left_kw);
+            set_power(i_charger, power_kw);
+            power_left_kw -= power_kw;
+        }
+        break;
+    }
+    }
+}
@@ -0,0 +1,187 @@
+/*
+Charger site module: the chargers at a vertiport as individual objects, each with its own power
+limit and its own scheduled outages, all sharing the site's grid power, which may be capped, and
+which is shed by a `Load_shedding_policy` when the vehicles charging at once want more than the
+cap allows.
+
+A vehicle's charge then takes as long as its battery's missing energy takes to deliver at the
+power it's given, which changes whenever a session starts or ends, a charger goes out or comes back
+into service, or the cap changes. The `Engine::EVENT_DRIVEN` engine only recomputes each session's
+power, and reschedules its end, at those events, never per time step.
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/// How a site's capped power is shared among the sessions charging at once, when they want more
+/// than the cap
+enum class Load_shedding_policy
+{
+    /// Throttle every session by the same fraction
+    PROPORTIONAL = 0,
+    /// Sessions which started first get all the power they can take, in order; later ones get
+    /// whatever is left, if any, and wait on their chargers until power frees up
+    FIRST_COME_FIRST_SERVED,
+};
+
+/// Charger `i_charger` is out of service from `start_hrs` until `end_hrs`. A vehicle charging on
+/// it when it goes out gets back in line, keeping the charge it has so far.
+struct Charger_outage
+{
+    uint32_t i_charger;
+    double start_hrs;
+    double end_hrs;
+};
+
+/// The site power cap changes to `cap_kw` at `start_hrs`
+struct Site_power_cap_change
+{
+    double start_hrs;
+    double cap_kw;
+};
+
+/// The chargers at a site, and their limits
+struct Charger_site_config
+{
+    /// The max power of each charger, in kW; one per charger. Empty means chargers are modeled as
+    /// just a number of identical chargers, each charging every vehicle at its type's full
+    /// charge power, and never going out of service.
+    std::vector<double> charger_power_kw;
+    /// The total power all chargers may draw at once, at the start of the simulation
+    double site_power_cap_kw = std::numeric_limits<double>::infinity();
+    /// Changes to the site power cap over time, ex: to follow grid demand response windows
+    std::vector<Site_power_cap_change> power_cap_changes;
+    std::vector<Charger_outage> outages;
+    Load_shedding_policy load_shedding_policy = Load_shedding_policy::PROPORTIONAL;
+
+    bool enabled() const
+    {
+        return !charger_power_kw.empty();
+    }
+
+    /// Returns true if every value is physically meaningful, and otherwise prints why not and
+    /// returns false
+    bool is_valid() const;
+};
+
+/// A scheduled change to a site: a charger going out of service or coming back, or a new cap
+struct Site_change
+{
+    enum class Type : uint8_t
+    {
+        OUTAGE_START = 0,
+        OUTAGE_END,
+        POWER_CAP,
+    };
+
+    /// The time step at which the change is made
+    uint64_t step;
+    Type type;
+    /// For outages
+    uint32_t i_charger;
+    /// For `Type::POWER_CAP`
+    double cap_kw;
+};
+
+/// One charger, and the session charging on it, if any
+struct Charger
+{
+    static constexpr uint32_t NO_VEHICLE = std::numeric_limits<uint32_t>::max();
+
+    double max_power_kw = 0;
+    /// The vehicle charging here, or `NO_VEHICLE`
+    uint32_t i_vehicle = NO_VEHICLE;
+    /// Overlapping outages in effect; the charger is in service only if this is 0
+    uint32_t num_outages = 0;
+
+    // The current session
+
+    /// The most power the session can take: the lesser of the charger's and the vehicle's
+    double demand_kw = 0;
+    /// The power the session is given, after load shedding
+    double power_kw = 0;
+    /// Energy still to deliver to fully charge the vehicle
+    double energy_remaining_kwh = 0;
+    /// Order in which sessions started, for `Load_shedding_policy::FIRST_COME_FIRST_SERVED`
+    uint64_t session_sequence_num = 0;
+
+    bool in_use() const
+    {
+        return i_vehicle != NO_VEHICLE;
+    }
+
+    bool in_service() const
+    {
+        return num_outages == 0;
+    }
+};
+
+/// The chargers of a site, while running a simulation
+class Charger_site
+{
+public:
+    /// Set up the chargers of `config`, all free, in service, and capped at the starting cap, and
+    /// its schedule of changes, in time steps of `step_size_hrs`. Keeps the memory already
+    /// allocated, so it can be reused for the next simulation.
+    void init(const Charger_site_config& config, double step_size_hrs);
+
+    /// Every scheduled outage start and end and cap change, in time step order
+    const std::vector<Site_change>& schedule() const
+    {
+        return _schedule;
+    }
+
+    const Charger& charger(uint32_t i_charger) const
+    {
+        return _chargers[i_charger];
+    }
+
+    /// Deliver energy to every session, at its current power, up to simulation time `time_hrs`.
+    /// Call this before any change at `time_hrs`.
+    void advance(double time_hrs);
+
+    /// Start charging vehicle `i_vehicle`, which can take up to `vehicle_power_kw` and needs
+    /// `energy_kwh`, on the most powerful free charger in service (the lowest-numbered among
+    /// equals). Returns false if there's no free charger in service. Call `allocate_power()`
+    /// afterwards to give the session its power.
+    bool start_session(uint32_t i_vehicle,
+                       double vehicle_power_kw,
+                       double energy_kwh,
+                       uint32_t* i_charger);
+
+    /// End the session on charger `i_charger`, freeing it
+    void end_session(uint32_t i_charger);
+
+    /// Make a scheduled change. If it takes a charger out of service while in use, ends its
+    /// session, and returns true and sets `i_vehicle` and `energy_remaining_kwh` to the vehicle
+    /// which must get back in line, and the energy it still needs.
+    bool apply(const Site_change& change, uint32_t* i_vehicle, double* energy_remaining_kwh);
+
+    /// Whether any charger is free and in service
+    bool has_free_charger() const;
+
+    /// Share the site's power among the sessions per the load shedding policy, and append to
+    /// `changed` every charger whose session's power changed, including new sessions
+    void allocate_power(std::vector<uint32_t>* changed);
+
+private:
+    std::vector<Charger> _chargers;
+    std::vector<Site_change> _schedule;
+    double _power_cap_kw = 0;
+    Load_shedding_policy _load_shedding_policy = Load_shedding_policy::PROPORTIONAL;
+    /// The time up to which energy has been delivered
+    double _time_hrs = 0;
+    uint64_t _next_session_sequence_num = 0;
+    /// Scratch space for `allocate_power()`, to not allocate every time
+    std::vector<uint32_t> _sessions_in_order;
+};
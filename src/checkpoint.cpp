@@ -0,0 +1,90 @@
+#include "checkpoint.h"
+
+// C++ includes
+#include <cerrno>
+#include <cstdio>
+
+void Checkpoint_writer::write_string(const std::string& str)
+{
+    write((uint64_t)str.size());
+    _data.insert(_data.end(), str.begin(), str.end());
+}
+
+bool Checkpoint_writer::write_file(const std::string& path) const
+{
+    // Write to a temporary file first, and rename it into place only once complete, so that
+    // being interrupted mid-write never leaves a truncated checkpoint in place of the last good
+    // one
+    std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        printf("Error: failed to create checkpoint file \"%s\": %s.\n",
+               temp_path.c_str(),
+               strerror(errno));
+        return false;
+    }
+
+    bool written = fwrite(_data.data(), 1, _data.size(), file) == _data.size();
+    // Note: close even if the write failed, so as not to leak the file
+    bool closed = fclose(file) == 0;
+    if (!written || !closed)
+    {
+        printf("Error: failed to write checkpoint file \"%s\".\n", temp_path.c_str());
+        remove(temp_path.c_str());
+        return false;
+    }
+
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        printf("Error: failed to rename \"%s\" to \"%s\": %s.\n",
+               temp_path.c_str(),
+               path.c_str(),
+               strerror(errno));
+        remove(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool Checkpoint_reader::read_file(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        printf(
+            "Error: failed to open checkpoint file \"%s\": %s.\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::vector<char> data;
+    char block[1 << 16];
+    size_t num_read;
+    while ((num_read = fread(block, 1, sizeof(block), file)) > 0)
+    {
+        data.insert(data.end(), block, block + num_read);
+    }
+    bool read_failed = ferror(file);
+    fclose(file);
+    if (read_failed)
+    {
+        printf("Error: failed to read checkpoint file \"%s\".\n", path.c_str());
+        return false;
+    }
+
+    *this = Checkpoint_reader{std::move(data)};
+    return true;
+}
+
+bool Checkpoint_reader::read_string(std::string* str)
+{
+    uint64_t size = 0;
+    if (!read(&size) || !has_bytes_left(size))
+    {
+        return false;
+    }
+    str->assign(_data.data() + _offset, size);
+    _offset += size;
+    return true;
+}
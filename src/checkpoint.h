@@ -0,0 +1,159 @@
+/*
+Checkpoint module: compact binary snapshots of in-progress state, so that long runs can be resumed
+after being interrupted, or forked into many "what-if" branches from one shared, warmed-up state.
+
+A checkpoint is built in memory by a `Checkpoint_writer`, and parsed by a `Checkpoint_reader`;
+either one may come from, or go to, a file. Values are written in native byte order, with no
+padding between them: trivially-copyable values as raw bytes, and vectors and strings as a
+`uint64_t` element count followed by their elements. Each type which can be checkpointed writes and
+reads its own fields, in the same order, with `save()` and `load()` members.
+
+`Simulation` checkpoint file layout; see `Simulation::save_checkpoint()`:
+1. one `Checkpoint_file_header`
+1. the simulation's parameters and `Simulation_options`
+1. the vehicle types, with their distributions so far
+1. the vehicles, with their stats and random number streams
+1. the chargers, the charger line, the current time step and the simulation's random number
+   stream
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+constexpr char CHECKPOINT_FILE_MAGIC[8] = {'E', 'V', 'T', 'O', 'L', 'C', 'K', 'P'};
+constexpr uint32_t CHECKPOINT_FILE_VERSION = 3;
+
+struct Checkpoint_file_header
+{
+    char magic[8];
+    uint32_t version;
+    /// `sizeof(Vehicle_stats)`, as written, to catch checkpoints from incompatible builds
+    uint32_t vehicle_stats_size;
+};
+static_assert(sizeof(Checkpoint_file_header) == 16, "Checkpoint_file_header must be packed");
+
+/// Builds a checkpoint in memory
+class Checkpoint_writer
+{
+public:
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "use a `save()` member instead");
+        const char* bytes = (const char*)&value;
+        _data.insert(_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void write_vector(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "use a `save()` member instead");
+        write((uint64_t)values.size());
+        const char* bytes = (const char*)values.data();
+        _data.insert(_data.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void write_string(const std::string& str);
+
+    /// Everything written so far
+    const std::vector<char>& data() const
+    {
+        return _data;
+    }
+
+    /// Write everything written so far to a new file at `path`, replacing it if it exists.
+    /// Returns false, after printing why, on any error.
+    bool write_file(const std::string& path) const;
+
+private:
+    std::vector<char> _data;
+};
+
+/// Parses a checkpoint. Any read past the end of the checkpoint fails, and leaves the reader
+/// failed from then on, so that a whole series of reads can be checked once, at the end, with
+/// `ok()`.
+class Checkpoint_reader
+{
+public:
+    explicit Checkpoint_reader(std::vector<char> data = {}) : _data{std::move(data)}
+    {
+    }
+
+    /// Read the whole checkpoint file at `path`. Returns false, after printing why, on any error.
+    bool read_file(const std::string& path);
+
+    /// Returns false, and leaves `value` unchanged, if there aren't enough bytes left
+    template <typename T>
+    bool read(T* value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "use a `load()` member instead");
+        if (!has_bytes_left(sizeof(T)))
+        {
+            return false;
+        }
+        memcpy((void*)value, _data.data() + _offset, sizeof(T));
+        _offset += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool read_vector(std::vector<T>* values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "use a `load()` member instead");
+        uint64_t size = 0;
+        // Note: check the size against the bytes left before allocating anything, so that a
+        // corrupt size can't exhaust memory
+        if (!read(&size) || size > (_data.size() - _offset) / sizeof(T)
+            || !has_bytes_left(size * sizeof(T)))
+        {
+            return false;
+        }
+        values->resize(size);
+        memcpy((void*)values->data(), _data.data() + _offset, size * sizeof(T));
+        _offset += size * sizeof(T);
+        return true;
+    }
+
+    bool read_string(std::string* str);
+
+    /// Returns false if any read so far has failed
+    bool ok() const
+    {
+        return !_failed;
+    }
+
+    /// Returns true if every byte has been read
+    bool at_end() const
+    {
+        return _offset == _data.size();
+    }
+
+private:
+    bool has_bytes_left(size_t size)
+    {
+        if (_failed || size > _data.size() - _offset)
+        {
+            _failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<char> _data;
+    size_t _offset = 0;
+    bool _failed = false;
+};
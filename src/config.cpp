@@ -0,0 +1,895 @@
+#include "config.h"
+
+// local includes
+#include "utils.h"
+
+// C++ includes
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+/// Remove leading and trailing whitespace
+static std::string trim(const std::string& str)
+{
+    const char* whitespace = " \t\r\n";
+    size_t i_begin = str.find_first_not_of(whitespace);
+    if (i_begin == std::string::npos)
+    {
+        return "";
+    }
+    size_t i_end = str.find_last_not_of(whitespace);
+    return str.substr(i_begin, i_end - i_begin + 1);
+}
+
+static bool parse_double(const std::string& value, double* result)
+{
+    char* end = nullptr;
+    errno = 0;
+    *result = strtod(value.c_str(), &end);
+    return !value.empty() && *end == '\0' && errno == 0;
+}
+
+static bool parse_uint64(const std::string& value, uint64_t* result)
+{
+    // `strtoull()` silently accepts negative numbers, so reject them explicitly
+    if (value.empty() || value[0] == '-')
+    {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    *result = strtoull(value.c_str(), &end, 0);
+    return *end == '\0' && errno == 0;
+}
+
+static bool parse_uint32(const std::string& value, uint32_t* result)
+{
+    uint64_t result_u64;
+    if (!parse_uint64(value, &result_u64) || result_u64 > std::numeric_limits<uint32_t>::max())
+    {
+        return false;
+    }
+    *result = (uint32_t)result_u64;
+    return true;
+}
+
+static bool parse_bool(const std::string& value, bool* result)
+{
+    if (value == "true" || value == "1")
+    {
+        *result = true;
+        return true;
+    }
+    if (value == "false" || value == "0")
+    {
+        *result = false;
+        return true;
+    }
+    return false;
+}
+
+/// Parse a whitespace-separated list of numbers, such as fleet mix weights
+static bool parse_double_list(const std::string& value, std::vector<double>* result)
+{
+    std::istringstream stream{value};
+    std::string element;
+    std::vector<double> values;
+    while (stream >> element)
+    {
+        double element_value;
+        if (!parse_double(element, &element_value))
+        {
+            return false;
+        }
+        values.push_back(element_value);
+    }
+
+    *result = values;
+    return !values.empty();
+}
+
+/// Parse sweep values given either as a comma-separated list, ex: "1,2,5", or as an inclusive
+/// range in the form "first:last" or "first:last:increment", ex: "2:10:2" for 2, 4, 6, 8, 10
+template<typename T>
+static bool parse_sweep_values(
+    const std::string& value, bool (*parse_value)(const std::string&, T*), std::vector<T>* result)
+{
+    std::vector<T> values;
+
+    if (value.find(':') != std::string::npos)
+    {
+        std::vector<std::string> fields;
+        std::istringstream stream{value};
+        std::string field;
+        while (std::getline(stream, field, ':'))
+        {
+            fields.push_back(trim(field));
+        }
+
+        T first;
+        T last;
+        T increment = 1;
+        if ((fields.size() != 2 && fields.size() != 3) || !parse_value(fields[0], &first)
+            || !parse_value(fields[1], &last)
+            || (fields.size() == 3 && !parse_value(fields[2], &increment)) || !(increment > 0)
+            || last < first)
+        {
+            return false;
+        }
+
+        // count the values first, to stay robust to floating point error in `increment`
+        uint64_t num_values = (uint64_t)((last - first) / increment + 1e-9) + 1;
+        for (uint64_t i = 0; i < num_values; i++)
+        {
+            values.push_back((T)(first + i * increment));
+        }
+    }
+    else
+    {
+        std::istringstream stream{value};
+        std::string field;
+        while (std::getline(stream, field, ','))
+        {
+            T field_value;
+            if (!parse_value(trim(field), &field_value))
+            {
+                return false;
+            }
+            values.push_back(field_value);
+        }
+    }
+
+    *result = values;
+    return !values.empty();
+}
+
+/// Parse a vehicle type in the form
+/// `name cruise_speed_mph battery_capacity_kwh time_to_charge_hrs energy_used_kwh_per_mile
+/// passengers_per_vehicle prob_fault_per_hr`
+static bool parse_vehicle_type(const std::string& value, Program_config* config)
+{
+    std::istringstream stream{value};
+    std::string name;
+    std::string fields[6];
+    stream >> name;
+    for (std::string& field : fields)
+    {
+        stream >> field;
+    }
+    std::string extra;
+    stream >> extra;
+
+    double cruise_speed_mph;
+    double battery_capacity_kwh;
+    double time_to_charge_hrs;
+    double energy_used_kwh_per_mile;
+    uint32_t passengers_per_vehicle;
+    double prob_fault_per_hr;
+    if (name.empty() || !extra.empty() || !parse_double(fields[0], &cruise_speed_mph)
+        || !parse_double(fields[1], &battery_capacity_kwh)
+        || !parse_double(fields[2], &time_to_charge_hrs)
+        || !parse_double(fields[3], &energy_used_kwh_per_mile)
+        || !parse_uint32(fields[4], &passengers_per_vehicle)
+        || !parse_double(fields[5], &prob_fault_per_hr))
+    {
+        printf(
+            "Error: vehicle_type must be \"name cruise_speed_mph battery_capacity_kwh "
+            "time_to_charge_hrs energy_used_kwh_per_mile passengers_per_vehicle "
+            "prob_fault_per_hr\", but is \"%s\".\n",
+            value.c_str());
+        return false;
+    }
+
+    Vehicle_type vehicle_type{
+        name,
+        cruise_speed_mph,
+        battery_capacity_kwh,
+        time_to_charge_hrs,
+        energy_used_kwh_per_mile,
+        passengers_per_vehicle,
+        prob_fault_per_hr};
+    if (!vehicle_type.is_valid())
+    {
+        return false;
+    }
+
+    config->scenario.vehicle_types.push_back(vehicle_type);
+    return true;
+}
+
+/// `i_charger start_hrs end_hrs`
+static bool parse_charger_outage(const std::string& value, Charger_outage* outage)
+{
+    std::istringstream stream{value};
+    std::string fields[3];
+    for (std::string& field : fields)
+    {
+        stream >> field;
+    }
+    std::string extra;
+    stream >> extra;
+
+    return extra.empty() && parse_uint32(fields[0], &outage->i_charger)
+           && parse_double(fields[1], &outage->start_hrs)
+           && parse_double(fields[2], &outage->end_hrs);
+}
+
+/// `start_hrs cap_kw`
+static bool parse_site_power_cap_change(const std::string& value, Site_power_cap_change* change)
+{
+    std::vector<double> values;
+    if (!parse_double_list(value, &values) || values.size() != 2)
+    {
+        return false;
+    }
+    change->start_hrs = values[0];
+    change->cap_kw = values[1];
+    return true;
+}
+
+/// `name num_chargers [route_weight...]`, with one route weight per vertiport, if any
+static bool parse_vertiport(const std::string& value, Vertiport_config* vertiport)
+{
+    std::istringstream stream{value};
+    std::string num_chargers;
+    stream >> vertiport->name >> num_chargers;
+    if (vertiport->name.empty() || !parse_uint32(num_chargers, &vertiport->num_chargers))
+    {
+        return false;
+    }
+
+    std::string route_weights;
+    std::getline(stream, route_weights);
+    vertiport->route_weights.clear();
+    return route_weights.find_first_not_of(" \t") == std::string::npos
+           || parse_double_list(route_weights, &vertiport->route_weights);
+}
+
+/// `from to distance_miles`, with the names of the vertiports at either end
+static bool parse_route(const std::string& value, Route_config* route)
+{
+    std::istringstream stream{value};
+    std::string distance_miles;
+    std::string rest;
+    stream >> route->from >> route->to >> distance_miles;
+    return !route->to.empty() && parse_double(distance_miles, &route->distance_miles)
+           && !(stream >> rest);
+}
+
+bool apply_setting(const std::string& key, const std::string& value, Program_config* config)
+{
+    Scenario& scenario = config->scenario;
+    bool parsed = false;
+
+    if (key == "num_chargers")
+    {
+        parsed = parse_uint32(value, &scenario.num_chargers);
+    }
+    else if (key == "num_vehicles")
+    {
+        parsed = parse_uint32(value, &scenario.num_vehicles);
+    }
+    else if (key == "simulation_duration_hrs")
+    {
+        parsed = parse_double(value, &scenario.simulation_duration_hrs);
+    }
+    else if (key == "simulation_step_size_hrs")
+    {
+        parsed = parse_double(value, &scenario.simulation_step_size_hrs);
+    }
+    else if (key == "simulation_step_size_sec")
+    {
+        double step_size_sec = 0;
+        parsed = parse_double(value, &step_size_sec);
+        if (parsed)
+        {
+            scenario.simulation_step_size_hrs = step_size_sec / SECONDS_PER_HR;
+        }
+    }
+    else if (key == "engine")
+    {
+        parsed = parse_engine(value, &scenario.options.engine);
+    }
+    else if (key == "fault_model")
+    {
+        parsed = parse_fault_model(value, &scenario.options.fault_model);
+    }
+    else if (key == "simulation_num_threads")
+    {
+        parsed = parse_uint32(value, &scenario.options.num_threads);
+    }
+    else if (key == "specialized_kernels")
+    {
+        parsed = parse_bool(value, &scenario.options.specialized_kernels);
+    }
+    else if (key == "charger_queue_policy")
+    {
+        parsed = parse_charger_queue_policy(value, &scenario.options.charger_queue_policy);
+    }
+    else if (key == "charger_power_kw")
+    {
+        parsed = parse_double_list(value, &scenario.options.charger_site.charger_power_kw);
+        if (parsed)
+        {
+            scenario.num_chargers = scenario.options.charger_site.charger_power_kw.size();
+        }
+    }
+    else if (key == "site_power_cap_kw")
+    {
+        parsed = parse_double(value, &scenario.options.charger_site.site_power_cap_kw);
+    }
+    else if (key == "site_power_cap_change")
+    {
+        Site_power_cap_change change;
+        parsed = parse_site_power_cap_change(value, &change);
+        if (parsed)
+        {
+            scenario.options.charger_site.power_cap_changes.push_back(change);
+        }
+    }
+    else if (key == "charger_outage")
+    {
+        Charger_outage outage;
+        parsed = parse_charger_outage(value, &outage);
+        if (parsed)
+        {
+            scenario.options.charger_site.outages.push_back(outage);
+        }
+    }
+    else if (key == "load_shedding_policy")
+    {
+        parsed = parse_load_shedding_policy(
+            value, &scenario.options.charger_site.load_shedding_policy);
+    }
+    else if (key == "vertiport")
+    {
+        Vertiport_config vertiport;
+        parsed = parse_vertiport(value, &vertiport);
+        if (parsed)
+        {
+            scenario.options.network.vertiports.push_back(vertiport);
+            scenario.num_chargers = scenario.options.network.num_chargers();
+        }
+    }
+    else if (key == "route")
+    {
+        Route_config route;
+        parsed = parse_route(value, &route);
+        if (parsed)
+        {
+            scenario.options.network.routes.push_back(route);
+        }
+    }
+    else if (key == "trace_path")
+    {
+        scenario.options.trace_path = value;
+        parsed = !value.empty();
+    }
+    else if (key == "fleet_sampling")
+    {
+        parsed = parse_fleet_sampling(value, &scenario.options.fleet_sampling);
+    }
+    else if (key == "record_fault_times")
+    {
+        parsed = parse_bool(value, &scenario.options.record_fault_times);
+    }
+    else if (key == "seed")
+    {
+        uint64_t seed = 0;
+        parsed = parse_uint64(value, &seed);
+        if (parsed)
+        {
+            // one seed makes both the single run and the whole Monte Carlo batch reproducible
+            scenario.options.seed = seed;
+            config->monte_carlo.base_seed = seed;
+        }
+    }
+    else if (key == "num_replications")
+    {
+        parsed = parse_uint32(value, &config->monte_carlo.num_replications);
+    }
+    else if (key == "num_threads")
+    {
+        parsed = parse_uint32(value, &config->monte_carlo.num_threads);
+    }
+    else if (key == "antithetic")
+    {
+        parsed = parse_bool(value, &config->monte_carlo.antithetic);
+    }
+    else if (key == "common_random_numbers")
+    {
+        parsed = parse_bool(value, &config->monte_carlo.common_random_numbers);
+    }
+    else if (key == "batch_size")
+    {
+        parsed = parse_uint32(value, &config->monte_carlo.batch_size);
+    }
+    else if (key == "target_relative_ci_passenger_miles")
+    {
+        parsed = parse_double(value,
+                              &config->monte_carlo.precision_targets.total_num_passenger_miles);
+    }
+    else if (key == "target_relative_ci_faults")
+    {
+        parsed = parse_double(value, &config->monte_carlo.precision_targets.total_num_faults);
+    }
+    else if (key == "target_relative_ci_wait_time")
+    {
+        parsed = parse_double(value, &config->monte_carlo.precision_targets.total_wait_time_hrs);
+    }
+    else if (key == "min_replications")
+    {
+        parsed = parse_uint32(value, &config->monte_carlo.precision_targets.min_replications);
+    }
+    else if (key == "time_budget_sec")
+    {
+        parsed = parse_double(value, &config->monte_carlo.time_budget_sec);
+    }
+    else if (key == "single_run")
+    {
+        parsed = parse_bool(value, &config->single_run);
+    }
+    else if (key == "results_path")
+    {
+        config->results_path = value;
+        parsed = !value.empty();
+    }
+    else if (key == "vehicle_results_path")
+    {
+        config->vehicle_results_path = value;
+        parsed = !value.empty();
+    }
+    else if (key == "checkpoint_path")
+    {
+        config->checkpoint_path = value;
+        parsed = !value.empty();
+    }
+    else if (key == "checkpoint_interval_hrs")
+    {
+        parsed = parse_double(value, &config->checkpoint_interval_hrs)
+                 && config->checkpoint_interval_hrs > 0;
+    }
+    else if (key == "checkpoint_stop_hrs")
+    {
+        parsed = parse_double(value, &config->checkpoint_stop_hrs);
+    }
+    else if (key == "resume_path")
+    {
+        config->resume_path = value;
+        parsed = !value.empty();
+    }
+    else if (key == "results_format")
+    {
+        parsed = parse_results_format(value, &config->results_format);
+    }
+    else if (key == "fleet_mix")
+    {
+        parsed = parse_double_list(value, &scenario.fleet_mix);
+    }
+    else if (key == "sweep_num_chargers")
+    {
+        parsed = parse_sweep_values(value, parse_uint32, &config->sweep.num_chargers);
+    }
+    else if (key == "sweep_num_vehicles")
+    {
+        parsed = parse_sweep_values(value, parse_uint32, &config->sweep.num_vehicles);
+    }
+    else if (key == "sweep_simulation_duration_hrs")
+    {
+        parsed = parse_sweep_values(value, parse_double, &config->sweep.simulation_duration_hrs);
+    }
+    else if (key == "sweep_fleet_mix")
+    {
+        std::vector<double> fleet_mix;
+        parsed = parse_double_list(value, &fleet_mix);
+        if (parsed)
+        {
+            config->sweep.fleet_mixes.push_back(fleet_mix);
+        }
+    }
+    else if (key == "sweep_batch_size")
+    {
+        parsed = parse_uint32(value, &config->sweep.batch_size);
+    }
+    else if (key == "sweep_target_relative_ci")
+    {
+        parsed = parse_double(value, &config->sweep.target_relative_ci);
+    }
+    else if (key == "vehicle_type")
+    {
+        // prints its own, more specific, error
+        return parse_vehicle_type(value, config);
+    }
+    else
+    {
+        printf("Error: unknown setting \"%s\".\n", key.c_str());
+        return false;
+    }
+
+    if (!parsed)
+    {
+        printf("Error: invalid value \"%s\" for setting \"%s\".\n", value.c_str(), key.c_str());
+    }
+    return parsed;
+}
+
+bool load_scenario_file(const std::string& path, Program_config* config)
+{
+    std::ifstream file{path};
+    if (!file.is_open())
+    {
+        printf("Error: unable to open scenario file \"%s\".\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    uint32_t line_num = 0;
+    while (std::getline(file, line))
+    {
+        line_num++;
+
+        size_t i_comment = line.find('#');
+        if (i_comment != std::string::npos)
+        {
+            line.erase(i_comment);
+        }
+        line = trim(line);
+        if (line.empty())
+        {
+            continue;
+        }
+
+        size_t i_equals = line.find('=');
+        if (i_equals == std::string::npos)
+        {
+            printf(
+                "Error: %s:%u: expected \"key = value\", but got \"%s\".\n",
+                path.c_str(),
+                line_num,
+                line.c_str());
+            return false;
+        }
+
+        std::string key = trim(line.substr(0, i_equals));
+        std::string value = trim(line.substr(i_equals + 1));
+        if (!apply_setting(key, value, config))
+        {
+            printf("  (at %s:%u)\n", path.c_str(), line_num);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool parse_args(int argc, const char* const argv[], Program_config* config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "-h" || arg == "--help")
+        {
+            config->print_help = true;
+            return true;
+        }
+
+        if (arg.rfind("--", 0) != 0)
+        {
+            printf("Error: unexpected argument \"%s\". See `--help`.\n", arg.c_str());
+            return false;
+        }
+
+        // accept both `--key value` and `--key=value`
+        std::string key;
+        std::string value;
+        size_t i_equals = arg.find('=');
+        if (i_equals != std::string::npos)
+        {
+            key = arg.substr(2, i_equals - 2);
+            value = arg.substr(i_equals + 1);
+        }
+        else
+        {
+            key = arg.substr(2);
+            if (i + 1 >= argc)
+            {
+                printf("Error: missing value for argument \"%s\".\n", arg.c_str());
+                return false;
+            }
+            i++;
+            value = argv[i];
+        }
+
+        bool success = key == "scenario" ? load_scenario_file(value, config)
+                                         : apply_setting(key, value, config);
+        if (!success)
+        {
+            return false;
+        }
+    }
+
+    if (config->scenario.vehicle_types.empty())
+    {
+        config->scenario.vehicle_types = default_vehicle_types();
+    }
+
+    if (!config->checkpoint_path.empty()
+        && config->scenario.options.engine == Engine::EVENT_DRIVEN)
+    {
+        printf("Error: the event_driven engine can't be checkpointed; use a stepped engine.\n");
+        return false;
+    }
+
+    const Monte_carlo_config& monte_carlo = config->monte_carlo;
+    if (monte_carlo.antithetic && monte_carlo.num_replications % 2 != 0)
+    {
+        printf("Error: antithetic replications run in pairs, so num_replications must be even.\n");
+        return false;
+    }
+    if (!config->sweep.empty() && monte_carlo.num_replications == 0)
+    {
+        printf("Error: a parameter sweep needs num_replications > 0.\n");
+        return false;
+    }
+    const Precision_targets& targets = monte_carlo.precision_targets;
+    if (!(targets.total_num_passenger_miles >= 0 && targets.total_num_faults >= 0
+          && targets.total_wait_time_hrs >= 0 && monte_carlo.time_budget_sec >= 0))
+    {
+        printf("Error: precision targets and time_budget_sec must be >= 0.\n");
+        return false;
+    }
+
+    return is_valid(config->scenario);
+}
+
+void print_usage(const char* program_name)
+{
+    printf(
+        "Usage: %s [--scenario <path>] [--<key> <value> | --<key>=<value>]...\n"
+        "\n"
+        "Arguments are applied in order, so settings given after `--scenario` override the\n"
+        "scenario file. The same keys are used in scenario files, as `key = value` lines.\n"
+        "\n"
+        "Keys:\n"
+        "  num_chargers              number of chargers shared by all vehicles (default %u)\n"
+        "  num_vehicles              number of vehicles, of randomly-chosen types (default %u)\n"
+        "  simulation_duration_hrs   (default %.1f)\n"
+        "  simulation_step_size_hrs  (default 1 second)\n"
+        "  simulation_step_size_sec  alternative to simulation_step_size_hrs\n"
+        "  engine                    stepped | event_driven | stepped_soa (default stepped)\n"
+        "  fault_model               per_step_bernoulli | poisson (default per_step_bernoulli)\n"
+        "  simulation_num_threads    threads to run the single run with, for the stepped_soa\n"
+        "                            engine and networks only; 0 for all hardware threads\n"
+        "                            (default 1)\n"
+        "  specialized_kernels       true | false: let the stepped_soa engine use a kernel\n"
+        "                            compiled for the default fleet, when it matches\n"
+        "                            (default true)\n"
+        "  charger_queue_policy      fifo | lowest_range_first | shortest_charge_first\n"
+        "                            (default fifo)\n"
+        "  charger_power_kw          max power of each charger, ex: \"350 350 150\"; also sets\n"
+        "                            num_chargers. Models each charger, for the event_driven\n"
+        "                            engine only (default: every charger charges every vehicle\n"
+        "                            at its full speed)\n"
+        "  site_power_cap_kw         total power all chargers may draw at once (default: none)\n"
+        "  site_power_cap_change     \"start_hrs cap_kw\": change the site power cap from then\n"
+        "                            on; may be given more than once\n"
+        "  charger_outage            \"i_charger start_hrs end_hrs\": take a charger out of\n"
+        "                            service; may be given more than once\n"
+        "  load_shedding_policy      proportional | first_come_first_served: how sessions share\n"
+        "                            a site power cap they exceed (default proportional)\n"
+        "  vertiport                 \"name num_chargers [route_weight...]\": add a vertiport\n"
+        "                            to a network, with one route weight per vertiport, in\n"
+        "                            order (default: even over the others with a route); may\n"
+        "                            be given more than once. Sets num_chargers to the total.\n"
+        "                            For the event_driven engine only\n"
+        "  route                     \"from to distance_miles\": add a route between 2\n"
+        "                            vertiports, flown either way at each vehicle type's cruise\n"
+        "                            speed; may be given more than once\n"
+        "  fleet_sampling            random | stratified: draw each vehicle's type\n"
+        "                            independently, or give each type its share of the fleet\n"
+        "                            (default random)\n"
+        "  record_fault_times        true | false (default false)\n"
+        "  trace_path                write a binary trace of every state transition and fault\n"
+        "                            in the single run to this file; read it with\n"
+        "                            evtol_trace_reader (default: no trace)\n"
+        "  seed                      seed for the single run and the Monte Carlo batch\n"
+        "                            (default: random)\n"
+        "  num_replications          Monte Carlo replications; 0 to skip (default %u)\n"
+        "  num_threads               Monte Carlo threads; 0 for all hardware threads (default 0)\n"
+        "  antithetic                run replications in antithetic pairs; needs an even\n"
+        "                            num_replications, and rounds batch sizes up to even\n"
+        "                            (default false)\n"
+        "  common_random_numbers     give every sweep grid point the same replication seeds\n"
+        "                            (default false)\n"
+        "  batch_size                Monte Carlo replications per batch, checking whether to\n"
+        "                            stop after each; 0 for one batch (default 100)\n"
+        "  target_relative_ci_passenger_miles\n"
+        "  target_relative_ci_faults\n"
+        "  target_relative_ci_wait_time\n"
+        "                            stop after the first batch in which the 95%% confidence\n"
+        "                            interval of the mean fleet-wide total is within this\n"
+        "                            fraction of the mean, for every total with a target; also\n"
+        "                            for each sweep grid point (default: no target)\n"
+        "  min_replications          never stop on a precision target before this many\n"
+        "                            replications; also for each sweep grid point (default 30)\n"
+        "  time_budget_sec           stop after the first batch, or sweep round, to end after\n"
+        "                            this much wall-clock time (default: no limit)\n"
+        "  single_run                run and print one detailed simulation first (default true)\n"
+        "  results_path              also write every Monte Carlo replication's results by\n"
+        "                            vehicle type to this file; - for stdout (default: none)\n"
+        "  vehicle_results_path      write the single run's results by vehicle to this file;\n"
+        "                            - for stdout (default: none)\n"
+        "  results_format            format of both of the above: csv | jsonl | binary | text\n"
+        "                            (default csv)\n"
+        "  checkpoint_path           periodically save a checkpoint of the single run to this\n"
+        "                            file; stepped engines only (default: none)\n"
+        "  checkpoint_interval_hrs   simulated time between checkpoints (default 1.0)\n"
+        "  checkpoint_stop_hrs       stop the single run, after checkpointing it, at this\n"
+        "                            simulated time (default: run to the end)\n"
+        "  resume_path               resume the single run from this checkpoint file, instead\n"
+        "                            of starting a new one (default: none)\n"
+        "  vehicle_type              \"name cruise_speed_mph battery_capacity_kwh\n"
+        "                            time_to_charge_hrs energy_used_kwh_per_mile\n"
+        "                            passengers_per_vehicle prob_fault_per_hr\"; may be given\n"
+        "                            more than once (default: the 5 original companies)\n"
+        "  fleet_mix                 relative weight of each vehicle type, in order, ex:\n"
+        "                            \"2 1 1 0 0\" (default: uniform)\n"
+        "\n"
+        "Parameter sweep keys; giving any of the first four runs a sweep over every combination\n"
+        "of values, instead of a single Monte Carlo batch. Lists are either comma-separated, ex:\n"
+        "\"1,2,5\", or inclusive ranges, ex: \"2:10\" or \"2:10:2\".\n"
+        "  sweep_num_chargers            list of num_chargers values\n"
+        "  sweep_num_vehicles            list of num_vehicles values\n"
+        "  sweep_simulation_duration_hrs list of simulation_duration_hrs values\n"
+        "  sweep_fleet_mix               one fleet_mix; may be given more than once\n"
+        "  sweep_batch_size              replications per grid point per round (default 100)\n"
+        "  sweep_target_relative_ci      stop a grid point once the 95%% confidence interval of\n"
+        "                                its total passenger miles is within this fraction of\n"
+        "                                the mean, ex: 0.01; 0 to disable (default 0)\n",
+        program_name,
+        NUM_CHARGERS,
+        NUM_VEHICLES,
+        SIMULATION_DURATION_HRS,
+        NUM_REPLICATIONS);
+}
+
+const char* engine_name(Engine engine)
+{
+    switch (engine)
+    {
+    case Engine::STEPPED:
+        return "stepped";
+    case Engine::EVENT_DRIVEN:
+        return "event_driven";
+    case Engine::STEPPED_SOA:
+        return "stepped_soa";
+    }
+
+    return "unknown";
+}
+
+const char* fault_model_name(Fault_model fault_model)
+{
+    switch (fault_model)
+    {
+    case Fault_model::PER_STEP_BERNOULLI:
+        return "per_step_bernoulli";
+    case Fault_model::POISSON:
+        return "poisson";
+    }
+
+    return "unknown";
+}
+
+const char* charger_queue_policy_name(Charger_queue_policy policy)
+{
+    switch (policy)
+    {
+    case Charger_queue_policy::FIFO:
+        return "fifo";
+    case Charger_queue_policy::LOWEST_RANGE_FIRST:
+        return "lowest_range_first";
+    case Charger_queue_policy::SHORTEST_CHARGE_FIRST:
+        return "shortest_charge_first";
+    }
+
+    return "unknown";
+}
+
+const char* load_shedding_policy_name(Load_shedding_policy policy)
+{
+    switch (policy)
+    {
+    case Load_shedding_policy::PROPORTIONAL:
+        return "proportional";
+    case Load_shedding_policy::FIRST_COME_FIRST_SERVED:
+        return "first_come_first_served";
+    }
+
+    return "unknown";
+}
+
+const char* fleet_sampling_name(Fleet_sampling fleet_sampling)
+{
+    switch (fleet_sampling)
+    {
+    case Fleet_sampling::RANDOM:
+        return "random";
+    case Fleet_sampling::STRATIFIED:
+        return "stratified";
+    }
+
+    return "unknown";
+}
+
+bool parse_engine(const std::string& name, Engine* engine)
+{
+    for (Engine candidate : {Engine::STEPPED, Engine::EVENT_DRIVEN, Engine::STEPPED_SOA})
+    {
+        if (name == engine_name(candidate))
+        {
+            *engine = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_fault_model(const std::string& name, Fault_model* fault_model)
+{
+    for (Fault_model candidate : {Fault_model::PER_STEP_BERNOULLI, Fault_model::POISSON})
+    {
+        if (name == fault_model_name(candidate))
+        {
+            *fault_model = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_charger_queue_policy(const std::string& name, Charger_queue_policy* policy)
+{
+    for (Charger_queue_policy candidate : {Charger_queue_policy::FIFO,
+                                           Charger_queue_policy::LOWEST_RANGE_FIRST,
+                                           Charger_queue_policy::SHORTEST_CHARGE_FIRST})
+    {
+        if (name == charger_queue_policy_name(candidate))
+        {
+            *policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_load_shedding_policy(const std::string& name, Load_shedding_policy* policy)
+{
+    for (Load_shedding_policy candidate :
+         {Load_shedding_policy::PROPORTIONAL, Load_shedding_policy::FIRST_COME_FIRST_SERVED})
+    {
+        if (name == load_shedding_policy_name(candidate))
+        {
+            *policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_fleet_sampling(const std::string& name, Fleet_sampling* fleet_sampling)
+{
+    for (Fleet_sampling candidate : {Fleet_sampling::RANDOM, Fleet_sampling::STRATIFIED})
+    {
+        if (name == fleet_sampling_name(candidate))
+        {
+            *fleet_sampling = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,85 @@
+/*
+Configuration module: load scenarios from scenario files and `main()` arguments at runtime, so one
+built binary can run any number of different scenarios without recompiling.
+
+Scenario file format: one `key = value` setting per line. `#` starts a comment. Blank lines are
+ignored. Every key can also be given on the command line as `--key value` or `--key=value`, which
+overrides the scenario file. See `print_usage()` for all keys, and "scenarios/default.scenario" for
+an example.
+*/
+
+#pragma once
+
+// local includes
+#include "monte_carlo.h"
+#include "results_writer.h"
+#include "scenario.h"
+#include "simulation.h"
+#include "sweep.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <string>
+
+/// Everything `main()` needs: the scenario to simulate, plus how to run it
+struct Program_config
+{
+    Scenario scenario;
+    Monte_carlo_config monte_carlo;
+    /// If not empty, run a parameter sweep around `scenario` instead of a single Monte Carlo batch
+    Sweep_grid sweep;
+    /// Run and print one detailed simulation before the Monte Carlo batch
+    bool single_run = true;
+    /// If not empty, also write the results of every Monte Carlo replication, by vehicle type, to
+    /// this file; "-" means stdout
+    std::string results_path;
+    /// If not empty, write the single run's results, by vehicle, to this file; "-" means stdout
+    std::string vehicle_results_path;
+    Results_format results_format = Results_format::CSV;
+    /// If not empty, periodically save a checkpoint of the single run to this file, so it can be
+    /// resumed with `resume_path` after it's stopped or killed
+    std::string checkpoint_path;
+    /// Simulated time between checkpoints
+    double checkpoint_interval_hrs = 1.0;
+    /// If positive, stop the single run, after saving a checkpoint, once it reaches this time
+    double checkpoint_stop_hrs = 0;
+    /// If not empty, resume the single run from this checkpoint file, instead of starting a new
+    /// one from `scenario`
+    std::string resume_path;
+    /// Set by `--help`
+    bool print_help = false;
+};
+
+/// Apply one `key = value` setting to `config`. Returns false, after printing an error, if the key
+/// is unknown or the value can't be parsed.
+bool apply_setting(const std::string& key, const std::string& value, Program_config* config);
+
+/// Apply every setting in the scenario file at `path` to `config`
+bool load_scenario_file(const std::string& path, Program_config* config);
+
+/// Parse `main()`'s arguments into `config`, applying them in order: `--scenario <path>` loads a
+/// scenario file, and `--<key> <value>` or `--<key>=<value>` applies any one setting. Once all
+/// arguments are applied, falls back to `default_vehicle_types()` if no vehicle types were given,
+/// and validates the resulting scenario. Returns false, after printing why, on any error.
+bool parse_args(int argc, const char* const argv[], Program_config* config);
+
+void print_usage(const char* program_name);
+
+const char* engine_name(Engine engine);
+const char* fault_model_name(Fault_model fault_model);
+const char* charger_queue_policy_name(Charger_queue_policy policy);
+const char* load_shedding_policy_name(Load_shedding_policy policy);
+const char* fleet_sampling_name(Fleet_sampling fleet_sampling);
+
+/// Parse an engine name, as returned by `engine_name()`
+bool parse_engine(const std::string& name, Engine* engine);
+/// Parse a fault model name, as returned by `fault_model_name()`
+bool parse_fault_model(const std::string& name, Fault_model* fault_model);
+/// Parse a charger queue policy name, as returned by `charger_queue_policy_name()`
+bool parse_charger_queue_policy(const std::string& name, Charger_queue_policy* policy);
+/// Parse a load shedding policy name, as returned by `load_shedding_policy_name()`
+bool parse_load_shedding_policy(const std::string& name, Load_shedding_policy* policy);
+/// Parse a fleet sampling name, as returned by `fleet_sampling_name()`
+bool parse_fleet_sampling(const std::string& name, Fleet_sampling* fleet_sampling);
@@ -0,0 +1,49 @@
+#include "fleet_catalog.h"
+
+std::vector<Vehicle_type> make_vehicle_types(const Vehicle_type_params* params, size_t num_types)
+{
+    std::vector<Vehicle_type> vehicle_types;
+    vehicle_types.reserve(num_types);
+
+    for (size_t i = 0; i < num_types; i++)
+    {
+        vehicle_types.emplace_back(params[i].name,
+                                   params[i].cruise_speed_mph,
+                                   params[i].battery_capacity_kwh,
+                                   params[i].time_to_charge_hrs,
+                                   params[i].energy_used_kwh_per_mile,
+                                   params[i].passengers_per_vehicle,
+                                   params[i].prob_fault_per_hr);
+    }
+
+    return vehicle_types;
+}
+
+bool matches_catalog(const std::vector<Vehicle_type>& vehicle_types,
+                     const Vehicle_type_params* params,
+                     size_t num_types)
+{
+    if (vehicle_types.size() != num_types)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < num_types; i++)
+    {
+        const Vehicle_type& type = vehicle_types[i];
+
+        // Note: only the values the kernels use need to match, but a different name would make
+        // for a different vehicle type, so require everything to match
+        if (type.name != params[i].name || type.cruise_speed_mph != params[i].cruise_speed_mph
+            || type.battery_capacity_kwh != params[i].battery_capacity_kwh
+            || type.time_to_charge_hrs != params[i].time_to_charge_hrs
+            || type.energy_used_kwh_per_mile != params[i].energy_used_kwh_per_mile
+            || type.passengers_per_vehicle != params[i].passengers_per_vehicle
+            || type.prob_fault_per_hr != params[i].prob_fault_per_hr)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
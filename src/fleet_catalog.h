@@ -0,0 +1,84 @@
+/*
+Fleet catalog module: built-in vehicle type tables, as compile-time constants, so that the hot
+simulation kernels can be specialized for them. See `Fleet_soa::step_specialized()`.
+*/
+
+#pragma once
+
+// local includes
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/// The primary values of one `Vehicle_type`, in a form usable at compile time
+struct Vehicle_type_params
+{
+    const char* name;
+    double cruise_speed_mph;
+    double battery_capacity_kwh;
+    double time_to_charge_hrs;
+    double energy_used_kwh_per_mile;
+    uint32_t passengers_per_vehicle;
+    double prob_fault_per_hr;
+};
+
+/// The default vehicle types: one per company in the original problem description. Any catalog
+/// usable by `Fleet_soa::step_specialized()` is a struct like this one, with a `VEHICLE_TYPES`
+/// array.
+struct Default_fleet_catalog
+{
+    // clang-format off
+    static constexpr Vehicle_type_params VEHICLE_TYPES[] = {
+        {"Alpha",    120, 320, 0.6,  1.6, 4, 0.25},
+        {"Bravo",    100, 100, 0.2,  1.5, 5, 0.10},
+        {"Charlie",  160, 220, 0.8,  2.2, 3, 0.05},
+        {"Delta",    90,  120, 0.62, 0.8, 2, 0.22},
+        {"Echo",     30,  150, 0.3,  5.8, 2, 0.61},
+    };
+    // clang-format on
+};
+
+/// Number of vehicle types in `Catalog`
+template <typename Catalog>
+constexpr size_t catalog_size()
+{
+    return std::size(Catalog::VEHICLE_TYPES);
+}
+
+/// An upper bound on the time steps of size `step_size_hrs` any full flight or full charge of
+/// `Catalog`'s vehicle types takes (see `Vehicle_type::bind_to_step_size()`)
+template <typename Catalog>
+constexpr uint64_t catalog_max_num_steps(double step_size_hrs)
+{
+    uint64_t max_num_steps = 0;
+    for (size_t i = 0; i < catalog_size<Catalog>(); i++)
+    {
+        const Vehicle_type_params& params = Catalog::VEHICLE_TYPES[i];
+        double max_flight_time_hrs =
+            params.battery_capacity_kwh / params.energy_used_kwh_per_mile / params.cruise_speed_mph;
+        // Note: truncating and adding 1 rounds up, without std::ceil(), which isn't constexpr
+        for (double duration_hrs : {max_flight_time_hrs, params.time_to_charge_hrs})
+        {
+            max_num_steps = std::max(max_num_steps, (uint64_t)(duration_hrs / step_size_hrs) + 1);
+        }
+    }
+    return max_num_steps;
+}
+
+/// Construct one `Vehicle_type` per entry of `params`, in order
+std::vector<Vehicle_type> make_vehicle_types(const Vehicle_type_params* params, size_t num_types);
+
+/// Returns true if `vehicle_types` holds exactly the vehicle types in `params`, in the same order,
+/// with identical primary values, so that kernels specialized for `params` give identical results
+bool matches_catalog(const std::vector<Vehicle_type>& vehicle_types,
+                     const Vehicle_type_params* params,
+                     size_t num_types);
+
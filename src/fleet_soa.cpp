@@ -0,0 +1,144 @@
+#include "fleet_soa.h"
+
+// local includes
+#include "instrumentation.h"
+
+/// A kernel specialized at compile time, and the catalog and step size it is specialized for
+struct Specialized_kernel
+{
+    const Vehicle_type_params* params;
+    size_t num_types;
+    double step_size_hrs;
+    size_t (Fleet_soa::*step)(size_t i_begin, size_t i_end);
+};
+
+template <typename Catalog, uint32_t STEP_SIZE_SEC>
+constexpr Specialized_kernel make_specialized_kernel()
+{
+    return {Catalog::VEHICLE_TYPES,
+            catalog_size<Catalog>(),
+            Fleet_soa_catalog_constants<Catalog, STEP_SIZE_SEC>::STEP_SIZE_HRS,
+            &Fleet_soa::step_specialized<Catalog, STEP_SIZE_SEC>};
+}
+
+/// Every specialized kernel compiled in. To specialize for another fleet or step size, add it
+/// here.
+static constexpr Specialized_kernel SPECIALIZED_KERNELS[] = {
+    make_specialized_kernel<Default_fleet_catalog, 1>(),
+    make_specialized_kernel<Default_fleet_catalog, 60>(),
+};
+
+void Fleet_soa::load(const std::vector<Vehicle>& vehicles,
+                     const std::vector<Vehicle_type>& vehicle_types,
+                     double step_size_hrs_,
+                     bool allow_specialized_kernel)
+{
+    step_size_hrs = step_size_hrs_;
+    size_t num_vehicles = vehicles.size();
+
+    specialized_step = nullptr;
+    if (allow_specialized_kernel)
+    {
+        for (const Specialized_kernel& kernel : SPECIALIZED_KERNELS)
+        {
+            if (kernel.step_size_hrs == step_size_hrs
+                && matches_catalog(vehicle_types, kernel.params, kernel.num_types))
+            {
+                specialized_step = kernel.step;
+                break;
+            }
+        }
+    }
+
+    state.resize(num_vehicles);
+    // Note: only the countdown the chosen kernel uses is filled in
+    num_steps_remaining.resize(is_specialized() ? 0 : num_vehicles);
+    num_steps_remaining_16.resize(is_specialized() ? num_vehicles : 0);
+    next_fault_flight_time_hrs.resize(num_vehicles);
+    flags.assign(num_vehicles, 0);
+    num_flight_steps.assign(num_vehicles, 0);
+    num_wait_steps.assign(num_vehicles, 0);
+    num_charge_steps.assign(num_vehicles, 0);
+    initial_flight_time_hrs.resize(num_vehicles);
+
+    for (size_t i = 0; i < num_vehicles; i++)
+    {
+        const Vehicle& vehicle = vehicles[i];
+
+        state[i] = (uint8_t)vehicle.stats.state;
+        set_steps_remaining(i, vehicle.stats.num_steps_remaining);
+        next_fault_flight_time_hrs[i] = vehicle.stats.next_fault_flight_time_hrs;
+        initial_flight_time_hrs[i] = vehicle.stats.flight_time_hrs;
+    }
+}
+
+void Fleet_soa::store(std::vector<Vehicle>* vehicles,
+                      const std::vector<Vehicle_type>& vehicle_types) const
+{
+    for (size_t i = 0; i < size(); i++)
+    {
+        Vehicle& vehicle = (*vehicles)[i];
+        const Vehicle_type& type = vehicle_types[vehicle.i_type];
+
+        vehicle.stats.flight_time_hrs = flight_time_hrs(i);
+        vehicle.stats.distance_miles += num_flight_steps[i] * type.distance_per_step_miles;
+        vehicle.stats.wait_time_hrs += num_wait_steps[i] * step_size_hrs;
+        vehicle.stats.charge_time_hrs += num_charge_steps[i] * step_size_hrs;
+
+        vehicle.stats.num_steps_remaining = steps_remaining(i);
+        vehicle.stats.next_fault_flight_time_hrs = next_fault_flight_time_hrs[i];
+        vehicle.stats.state = (Vehicle_state)state[i];
+        vehicle.stats.last_state = vehicle.stats.state;
+        vehicle.stats.battery_state_of_charge_kwh =
+            type.state_of_charge_kwh(vehicle.stats.state, steps_remaining(i));
+
+        INSTRUMENT_COUNT(FLYING_STEPS, num_flight_steps[i]);
+        INSTRUMENT_COUNT(WAITING_STEPS, num_wait_steps[i]);
+        INSTRUMENT_COUNT(CHARGING_STEPS, num_charge_steps[i]);
+    }
+}
+
+size_t Fleet_soa::step_runtime(size_t i_begin, size_t i_end)
+{
+    // Raw pointers, so the compiler can see these are distinct arrays with no aliasing between
+    // them and auto-vectorize each loop
+    const uint8_t* __restrict__ state_ = state.data();
+    uint32_t* __restrict__ steps_remaining = num_steps_remaining.data();
+    const double* __restrict__ next_fault = next_fault_flight_time_hrs.data();
+    const double* __restrict__ initial_flight_time = initial_flight_time_hrs.data();
+    uint32_t* __restrict__ flight_steps = num_flight_steps.data();
+    uint32_t* __restrict__ wait_steps = num_wait_steps.data();
+    uint32_t* __restrict__ charge_steps = num_charge_steps.data();
+    uint8_t* __restrict__ flags_ = flags.data();
+
+    // Pass 1: accumulate time in each state, and count down the current flight or charge
+    for (size_t i = i_begin; i < i_end; i++)
+    {
+        uint32_t flying = state_[i] == (uint8_t)Vehicle_state::FLYING;
+        uint32_t charging = state_[i] == (uint8_t)Vehicle_state::CHARGING;
+        flight_steps[i] += flying;
+        wait_steps[i] += state_[i] == (uint8_t)Vehicle_state::WAITING_FOR_CHARGER;
+        charge_steps[i] += charging;
+        steps_remaining[i] -= flying | charging;
+    }
+
+    // Pass 2: flag every vehicle needing a state transition or a fault check
+    size_t num_flagged = 0;
+    for (size_t i = i_begin; i < i_end; i++)
+    {
+        bool flying = state_[i] == (uint8_t)Vehicle_state::FLYING;
+        bool charging = state_[i] == (uint8_t)Vehicle_state::CHARGING;
+        bool done = steps_remaining[i] == 0;
+        double flight_time = initial_flight_time[i] + flight_steps[i] * step_size_hrs;
+
+        uint8_t flag = (uint8_t)((flying & done) * FLEET_SOA_FLAG_BATTERY_EMPTY)
+                       | (uint8_t)((charging & done) * FLEET_SOA_FLAG_FULLY_CHARGED)
+                       | (uint8_t)((flying & (next_fault[i] >= 0)
+                                    & (next_fault[i] <= flight_time))
+                                   * FLEET_SOA_FLAG_FAULT_DUE);
+        flags_[i] = flag;
+        num_flagged += flag != 0;
+    }
+
+    return num_flagged;
+}
@@ -0,0 +1,208 @@
+/*
+Structure-of-arrays (SoA) fleet module: a copy of the hot, per-vehicle state of a whole fleet laid
+out as separate contiguous arrays, plus a branch-free kernel which steps every vehicle forward in
+bulk. Used by the `Engine::STEPPED_SOA` engine.
+
+The kernel comes in 2 flavors, with identical results:
+1. the runtime kernel, for any vehicle types and step size, which counts down each flight and
+   charge in 32 bits
+1. kernels specialized at compile time for one built-in vehicle type catalog (see "fleet_catalog.h")
+   and step size, which bake in the step size and, since they know the longest flight or charge
+   takes few enough time steps, count down in 16 bits, halving the countdown's memory traffic
+*/
+
+#pragma once
+
+// local includes
+#include "fleet_catalog.h"
+#include "utils.h"
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Bit flags set by `Fleet_soa::step()` for each vehicle needing attention at the end of a step
+enum Fleet_soa_flag : uint8_t
+{
+    FLEET_SOA_FLAG_BATTERY_EMPTY = 1 << 0,
+    FLEET_SOA_FLAG_FULLY_CHARGED = 1 << 1,
+    /// The vehicle's cumulative flight time reached its next sampled `Fault_model::POISSON` fault
+    FLEET_SOA_FLAG_FAULT_DUE = 1 << 2,
+};
+
+/// Number of vehicles per chunk when `Engine::STEPPED_SOA` steps a fleet in parallel: large enough
+/// to amortize handing each chunk to a thread, and small enough to balance the load across threads
+constexpr size_t FLEET_SOA_CHUNK_SIZE = 4096;
+
+/// The constants of the kernel specialized for `Catalog` and `STEP_SIZE_SEC`, computed at compile
+/// time
+template <typename Catalog, uint32_t STEP_SIZE_SEC>
+struct Fleet_soa_catalog_constants
+{
+    /// Note: calculated the same way as from the `simulation_step_size_sec` setting, so that
+    /// `Fleet_soa::load()` matches it exactly
+    static constexpr double STEP_SIZE_HRS = STEP_SIZE_SEC / (double)SECONDS_PER_HR;
+
+    static_assert(catalog_max_num_steps<Catalog>(STEP_SIZE_HRS) <= UINT16_MAX,
+                  "the catalog's flights and charges must count down in 16 bits at this step size");
+};
+
+/// The per-vehicle state the stepped engine touches every time step, as one array per field
+/// rather than one struct per vehicle. Only the state needed every step lives here; everything
+/// touched only on state transitions (counters, random number streams, etc.) stays in `Vehicle`.
+struct Fleet_soa
+{
+    /// Copy the state of `vehicles`, whose types are `vehicle_types`, into these arrays. If
+    /// `vehicle_types` and the step size match a specialized kernel, and
+    /// `allow_specialized_kernel`, use that kernel; otherwise, use the runtime kernel.
+    void load(const std::vector<Vehicle>& vehicles,
+              const std::vector<Vehicle_type>& vehicle_types,
+              double step_size_hrs,
+              bool allow_specialized_kernel = true);
+
+    /// Write the state accumulated in these arrays back into `vehicles`, whose types,
+    /// `vehicle_types`, must already be bound to the step size (see
+    /// `Vehicle_type::bind_to_step_size()`)
+    void store(std::vector<Vehicle>* vehicles,
+               const std::vector<Vehicle_type>& vehicle_types) const;
+
+    /// Advance every vehicle forward one time step, in bulk, based on its state at the start of
+    /// the step: every flying vehicle flies, every waiting vehicle waits, and every charging
+    /// vehicle charges. No vehicle changes state here; instead, `flags[i]` is set to a combination
+    /// of `Fleet_soa_flag`s for every vehicle `i` needing a state transition or fault check at the
+    /// end of this step, and the number of such vehicles is returned.
+    size_t step()
+    {
+        return step(0, size());
+    }
+
+    /// Same as above, but only for vehicles in the range [i_begin, i_end). Steps of disjoint
+    /// ranges touch disjoint memory, so may run in parallel.
+    size_t step(size_t i_begin, size_t i_end)
+    {
+        return specialized_step ? (this->*specialized_step)(i_begin, i_end)
+                                : step_runtime(i_begin, i_end);
+    }
+
+    /// The runtime kernel: same as `step()`, for any vehicle types and step size
+    size_t step_runtime(size_t i_begin, size_t i_end);
+
+    /// Same as `step_runtime()`, but specialized at compile time for the vehicle types in
+    /// `Catalog`, at a step size of `STEP_SIZE_SEC`
+    template <typename Catalog, uint32_t STEP_SIZE_SEC>
+    size_t step_specialized(size_t i_begin, size_t i_end);
+
+    /// Returns true if `load()` chose a specialized kernel
+    bool is_specialized() const
+    {
+        return specialized_step != nullptr;
+    }
+
+    /// Time steps left in vehicle `i`'s current flight or charge; see
+    /// `Vehicle_stats::num_steps_remaining`
+    uint32_t steps_remaining(size_t i) const
+    {
+        return is_specialized() ? num_steps_remaining_16[i] : num_steps_remaining[i];
+    }
+
+    /// Start vehicle `i`'s countdown over, on a state transition, at a full flight's or full
+    /// charge's `num_steps` (see `Vehicle_type::bind_to_step_size()`)
+    void set_steps_remaining(size_t i, uint32_t num_steps)
+    {
+        if (is_specialized())
+        {
+            num_steps_remaining_16[i] = (uint16_t)num_steps;
+        }
+        else
+        {
+            num_steps_remaining[i] = num_steps;
+        }
+    }
+
+    /// Cumulative flight time of vehicle `i`, including flight time from before `load()`
+    double flight_time_hrs(size_t i) const
+    {
+        return initial_flight_time_hrs[i] + num_flight_steps[i] * step_size_hrs;
+    }
+
+    size_t size() const
+    {
+        return state.size();
+    }
+
+    double step_size_hrs = 0;
+
+    /// The specialized kernel chosen by `load()`, if any
+    size_t (Fleet_soa::*specialized_step)(size_t i_begin, size_t i_end) = nullptr;
+
+    // per-vehicle state
+
+    /// `Vehicle_state`, as a byte
+    std::vector<uint8_t> state;
+    /// See `steps_remaining()`, for the runtime kernel. Empty when using a specialized kernel.
+    std::vector<uint32_t> num_steps_remaining;
+    /// Same as above, for the specialized kernels. Empty when using the runtime kernel.
+    std::vector<uint16_t> num_steps_remaining_16;
+    /// For `Fault_model::POISSON`; see `Vehicle_stats::next_fault_flight_time_hrs`
+    std::vector<double> next_fault_flight_time_hrs;
+    std::vector<uint8_t> flags;
+
+    // accumulators, counted in whole time steps since `load()`
+
+    std::vector<uint32_t> num_flight_steps;
+    std::vector<uint32_t> num_wait_steps;
+    std::vector<uint32_t> num_charge_steps;
+    std::vector<double> initial_flight_time_hrs;
+};
+
+template <typename Catalog, uint32_t STEP_SIZE_SEC>
+size_t Fleet_soa::step_specialized(size_t i_begin, size_t i_end)
+{
+    using Constants = Fleet_soa_catalog_constants<Catalog, STEP_SIZE_SEC>;
+
+    // Same as `step_runtime()`, but with a 16-bit countdown and the step size baked in
+    const uint8_t* __restrict__ state_ = state.data();
+    uint16_t* __restrict__ steps_remaining = num_steps_remaining_16.data();
+    const double* __restrict__ next_fault = next_fault_flight_time_hrs.data();
+    const double* __restrict__ initial_flight_time = initial_flight_time_hrs.data();
+    uint32_t* __restrict__ flight_steps = num_flight_steps.data();
+    uint32_t* __restrict__ wait_steps = num_wait_steps.data();
+    uint32_t* __restrict__ charge_steps = num_charge_steps.data();
+    uint8_t* __restrict__ flags_ = flags.data();
+
+    // Pass 1: accumulate time in each state, and count down the current flight or charge
+    for (size_t i = i_begin; i < i_end; i++)
+    {
+        uint16_t flying = state_[i] == (uint8_t)Vehicle_state::FLYING;
+        uint16_t charging = state_[i] == (uint8_t)Vehicle_state::CHARGING;
+        flight_steps[i] += flying;
+        wait_steps[i] += state_[i] == (uint8_t)Vehicle_state::WAITING_FOR_CHARGER;
+        charge_steps[i] += charging;
+        steps_remaining[i] -= flying | charging;
+    }
+
+    // Pass 2: flag every vehicle needing a state transition or a fault check
+    size_t num_flagged = 0;
+    for (size_t i = i_begin; i < i_end; i++)
+    {
+        bool flying = state_[i] == (uint8_t)Vehicle_state::FLYING;
+        bool charging = state_[i] == (uint8_t)Vehicle_state::CHARGING;
+        bool done = steps_remaining[i] == 0;
+        double flight_time = initial_flight_time[i] + flight_steps[i] * Constants::STEP_SIZE_HRS;
+
+        uint8_t flag = (uint8_t)((flying & done) * FLEET_SOA_FLAG_BATTERY_EMPTY)
+                       | (uint8_t)((charging & done) * FLEET_SOA_FLAG_FULLY_CHARGED)
+                       | (uint8_t)((flying & (next_fault[i] >= 0)
+                                    & (next_fault[i] <= flight_time))
+                                   * FLEET_SOA_FLAG_FAULT_DUE);
+        flags_[i] = flag;
+        num_flagged += flag != 0;
+    }
+
+    return num_flagged;
+}
@@ -0,0 +1,192 @@
+#include "instrumentation.h"
+
+// C++ includes
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+/// Protects everything below
+std::mutex registry_mutex;
+/// The counters of every thread which is still running
+std::vector<Instrumentation_counters*> live_thread_counters;
+/// The totals of every thread which has exited
+Instrumentation_summary exited_thread_totals;
+
+void add_counters(const Instrumentation_counters& counters, Instrumentation_summary* summary)
+{
+    for (size_t i = 0; i < NUM_INSTRUMENTATION_COUNTERS; i++)
+    {
+        summary->counts[i] += counters.counts[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < NUM_INSTRUMENTATION_TIMERS; i++)
+    {
+        summary->timer_ns[i] += counters.timer_ns[i].load(std::memory_order_relaxed);
+        summary->timer_calls[i] += counters.timer_calls[i].load(std::memory_order_relaxed);
+    }
+}
+
+/// Registers a thread's counters for as long as the thread runs, and keeps their totals once it
+/// exits
+class Thread_counters_registration
+{
+public:
+    explicit Thread_counters_registration(Instrumentation_counters* counters)
+        : _counters{counters}
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        live_thread_counters.push_back(_counters);
+    }
+
+    ~Thread_counters_registration()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        add_counters(*_counters, &exited_thread_totals);
+        live_thread_counters.erase(
+            std::find(live_thread_counters.begin(), live_thread_counters.end(), _counters));
+    }
+
+private:
+    Instrumentation_counters* const _counters;
+};
+
+}  // namespace
+
+const char* instrumentation_counter_name(Instrumentation_counter counter)
+{
+    switch (counter)
+    {
+    case Instrumentation_counter::TIME_STEPS:
+        return "time_steps";
+    case Instrumentation_counter::VEHICLE_STEPS:
+        return "vehicle_steps";
+    case Instrumentation_counter::FLYING_STEPS:
+        return "flying_steps";
+    case Instrumentation_counter::WAITING_STEPS:
+        return "waiting_steps";
+    case Instrumentation_counter::CHARGING_STEPS:
+        return "charging_steps";
+    case Instrumentation_counter::EVENTS:
+        return "events";
+    case Instrumentation_counter::STATE_TRANSITIONS:
+        return "state_transitions";
+    case Instrumentation_counter::CHARGER_REQUESTS:
+        return "charger_requests";
+    case Instrumentation_counter::CHARGER_WAITS:
+        return "charger_waits";
+    case Instrumentation_counter::FAULTS:
+        return "faults";
+    case Instrumentation_counter::RNG_DRAWS:
+        return "rng_draws";
+    }
+    return "unknown";
+}
+
+const char* instrumentation_timer_name(Instrumentation_timer timer)
+{
+    switch (timer)
+    {
+    case Instrumentation_timer::RUN:
+        return "run";
+    case Instrumentation_timer::STEPPING:
+        return "stepping";
+    case Instrumentation_timer::CHARGER_ALLOCATION:
+        return "charger_allocation";
+    case Instrumentation_timer::FLYING_HANDLER:
+        return "flying_handler";
+    case Instrumentation_timer::WAITING_HANDLER:
+        return "waiting_handler";
+    case Instrumentation_timer::CHARGING_HANDLER:
+        return "charging_handler";
+    case Instrumentation_timer::AGGREGATION:
+        return "aggregation";
+    case Instrumentation_timer::PRINTING:
+        return "printing";
+    }
+    return "unknown";
+}
+
+void register_thread_instrumentation()
+{
+    // Note: the counters themselves need no destructor, so they outlive this registration, which
+    // is destroyed when the thread exits
+    thread_local Thread_counters_registration registration{&thread_instrumentation_counters};
+    thread_instrumentation_registered = true;
+}
+
+Instrumentation_summary instrumentation_summary()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    Instrumentation_summary summary = exited_thread_totals;
+    for (const Instrumentation_counters* counters : live_thread_counters)
+    {
+        add_counters(*counters, &summary);
+    }
+    return summary;
+}
+
+void reset_instrumentation()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    exited_thread_totals = Instrumentation_summary{};
+    for (Instrumentation_counters* counters : live_thread_counters)
+    {
+        for (std::atomic<uint64_t>& count : counters->counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < NUM_INSTRUMENTATION_TIMERS; i++)
+        {
+            counters->timer_ns[i].store(0, std::memory_order_relaxed);
+            counters->timer_calls[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Instrumentation_summary::print(FILE* file) const
+{
+    fprintf(file,
+            "Instrumentation:\n"
+            "  counter                       count\n"
+            "  -----------------------------------\n");
+    for (size_t i = 0; i < NUM_INSTRUMENTATION_COUNTERS; i++)
+    {
+        fprintf(file,
+                "  %-18s %16lu\n",
+                instrumentation_counter_name((Instrumentation_counter)i),
+                counts[i]);
+    }
+
+    fprintf(file,
+            "\n"
+            "  timer (summed over threads)     calls    total (s)   mean (us)\n"
+            "  --------------------------------------------------------------\n");
+    for (size_t i = 0; i < NUM_INSTRUMENTATION_TIMERS; i++)
+    {
+        Instrumentation_timer timer = (Instrumentation_timer)i;
+        fprintf(file,
+                "  %-28s %8lu %12.6f %11.3f\n",
+                instrumentation_timer_name(timer),
+                calls(timer),
+                seconds(timer),
+                calls(timer) > 0 ? seconds(timer) * 1e6 / calls(timer) : 0.0);
+    }
+
+    // Note: if both kinds of engines ran, each throughput is over their combined stepping time
+    double stepping_seconds = seconds(Instrumentation_timer::STEPPING);
+    if (stepping_seconds > 0 && count(Instrumentation_counter::VEHICLE_STEPS) > 0)
+    {
+        fprintf(file,
+                "\n  stepping throughput: %.4g vehicle steps per second per thread\n",
+                count(Instrumentation_counter::VEHICLE_STEPS) / stepping_seconds);
+    }
+    if (stepping_seconds > 0 && count(Instrumentation_counter::EVENTS) > 0)
+    {
+        fprintf(file,
+                "\n  event throughput: %.4g events per second per thread\n",
+                count(Instrumentation_counter::EVENTS) / stepping_seconds);
+    }
+    fprintf(file, "\n");
+}
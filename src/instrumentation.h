@@ -0,0 +1,205 @@
+/*
+Instrumentation module: low-overhead counters and scoped timers on the simulation's hot paths, to
+see where the time in a run goes--ex: to size hardware, or to spot regressions in production
+sweeps--without attaching a profiler.
+
+Compiled in only if `INSTRUMENTATION` is defined (see "build.sh"); otherwise every
+`INSTRUMENT_*()` macro compiles to nothing, and costs nothing. Each thread counts into its own
+thread-local counters, with no locks and no atomic read-modify-writes on the hot path, and
+`instrumentation_summary()` adds them up over all threads, including threads which have since
+exited.
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#ifdef INSTRUMENTATION
+constexpr bool INSTRUMENTATION_ENABLED = true;
+#else
+constexpr bool INSTRUMENTATION_ENABLED = false;
+#endif
+
+enum class Instrumentation_counter
+{
+    /// Time steps run by the stepped engines, or simulated by the event-driven engine
+    TIME_STEPS = 0,
+    /// Time steps times vehicles, run by the stepped engines
+    VEHICLE_STEPS,
+    /// Vehicle time steps spent in each state, by the stepped engines
+    FLYING_STEPS,
+    WAITING_STEPS,
+    CHARGING_STEPS,
+    /// Events handled by the event-driven engine
+    EVENTS,
+    STATE_TRANSITIONS,
+    /// Vehicles needing a charger, whether they got one or had to wait
+    CHARGER_REQUESTS,
+    /// Vehicles which had to get in line for a charger
+    CHARGER_WAITS,
+    FAULTS,
+    /// 64-bit draws from any `Rng`
+    RNG_DRAWS,
+};
+
+constexpr size_t NUM_INSTRUMENTATION_COUNTERS = (size_t)Instrumentation_counter::RNG_DRAWS + 1;
+
+enum class Instrumentation_timer
+{
+    /// `Simulation::run()`, start to finish
+    RUN = 0,
+    /// Running the time steps, or the events, of a simulation
+    STEPPING,
+    /// Handing out chargers: `Simulation::try_to_charge()` in the stepped engine, and the serial
+    /// phase of each time step in the stepped SoA engine
+    CHARGER_ALLOCATION,
+    /// `Simulation::iterate()`'s handler for each state, once per vehicle per time step, in the
+    /// stepped engine. Note: since each call reads the clock twice, these slow a stepped run down
+    /// noticeably, but still show how its time splits between the states.
+    FLYING_HANDLER,
+    WAITING_HANDLER,
+    CHARGING_HANDLER,
+    /// Totaling the results of a simulation, by vehicle type
+    AGGREGATION,
+    /// Printing the results of a simulation
+    PRINTING,
+};
+
+constexpr size_t NUM_INSTRUMENTATION_TIMERS = (size_t)Instrumentation_timer::PRINTING + 1;
+
+const char* instrumentation_counter_name(Instrumentation_counter counter);
+const char* instrumentation_timer_name(Instrumentation_timer timer);
+
+/// One thread's counters. Only its own thread writes to them, so relaxed loads and stores, which
+/// compile to plain moves, are enough; they're atomic only so that other threads may read them.
+struct Instrumentation_counters
+{
+    std::array<std::atomic<uint64_t>, NUM_INSTRUMENTATION_COUNTERS> counts{};
+    std::array<std::atomic<uint64_t>, NUM_INSTRUMENTATION_TIMERS> timer_ns{};
+    std::array<std::atomic<uint64_t>, NUM_INSTRUMENTATION_TIMERS> timer_calls{};
+
+    void add(std::atomic<uint64_t>* value, uint64_t amount)
+    {
+        value->store(value->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void count(Instrumentation_counter counter, uint64_t amount)
+    {
+        add(&counts[(size_t)counter], amount);
+    }
+
+    void time(Instrumentation_timer timer, uint64_t ns)
+    {
+        add(&timer_ns[(size_t)timer], ns);
+        add(&timer_calls[(size_t)timer], 1);
+    }
+};
+
+/// The calling thread's counters. They're constant-initialized, so, being defined inline here in
+/// the header, every access compiles to a plain thread-local load, with no guard or function call.
+inline thread_local Instrumentation_counters thread_instrumentation_counters;
+/// Whether the calling thread's counters are registered, so that other threads may add them up
+inline thread_local bool thread_instrumentation_registered = false;
+
+/// Register the calling thread's counters, for as long as the thread runs
+void register_thread_instrumentation();
+
+/// The calling thread's counters, registered the first time they're used
+inline Instrumentation_counters& thread_instrumentation()
+{
+    if (!thread_instrumentation_registered)
+    {
+        register_thread_instrumentation();
+    }
+    return thread_instrumentation_counters;
+}
+
+/// Totals of every thread's counters
+struct Instrumentation_summary
+{
+    std::array<uint64_t, NUM_INSTRUMENTATION_COUNTERS> counts{};
+    /// Summed over all threads, so may add up to more than the wall-clock time
+    std::array<uint64_t, NUM_INSTRUMENTATION_TIMERS> timer_ns{};
+    std::array<uint64_t, NUM_INSTRUMENTATION_TIMERS> timer_calls{};
+
+    uint64_t count(Instrumentation_counter counter) const
+    {
+        return counts[(size_t)counter];
+    }
+
+    double seconds(Instrumentation_timer timer) const
+    {
+        return timer_ns[(size_t)timer] * 1e-9;
+    }
+
+    uint64_t calls(Instrumentation_timer timer) const
+    {
+        return timer_calls[(size_t)timer];
+    }
+
+    /// Print every counter and timer, plus the stepping throughput--vehicle steps for the stepped
+    /// engines, and events for the event-driven one--to `file`
+    void print(FILE* file = stdout) const;
+};
+
+/// Add up the counters of every thread which has counted anything so far
+Instrumentation_summary instrumentation_summary();
+
+/// Zero the counters of every thread. Only call this while no other thread is counting, ex:
+/// between runs.
+void reset_instrumentation();
+
+/// Adds the time from its construction to its destruction to a timer
+class Scoped_instrumentation_timer
+{
+public:
+    explicit Scoped_instrumentation_timer(Instrumentation_timer timer)
+        : _timer{timer}, _start{std::chrono::steady_clock::now()}
+    {
+    }
+
+    ~Scoped_instrumentation_timer()
+    {
+        auto duration = std::chrono::steady_clock::now() - _start;
+        thread_instrumentation().time(
+            _timer, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    Scoped_instrumentation_timer(const Scoped_instrumentation_timer&) = delete;
+    Scoped_instrumentation_timer& operator=(const Scoped_instrumentation_timer&) = delete;
+
+private:
+    const Instrumentation_timer _timer;
+    const std::chrono::steady_clock::time_point _start;
+};
+
+/// `INSTRUMENT_COUNT(counter, amount)` adds `amount` to counter
+/// `Instrumentation_counter::<counter>`, and `INSTRUMENT_SCOPE(timer)` times the rest of the
+/// enclosing scope with timer `Instrumentation_timer::<timer>`
+#ifdef INSTRUMENTATION
+    #define INSTRUMENT_COUNT(counter, amount) \
+        thread_instrumentation().count(Instrumentation_counter::counter, (amount))
+    #define INSTRUMENT_SCOPE(timer) \
+        Scoped_instrumentation_timer instrumentation_timer_##timer{Instrumentation_timer::timer}
+#else
+    #define INSTRUMENT_COUNT(counter, amount) \
+        do                                    \
+        {                                     \
+        } while (0)
+    #define INSTRUMENT_SCOPE(timer) \
+        do                          \
+        {                           \
+        } while (0)
+#endif
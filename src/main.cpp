@@ -3,40 +3,184 @@ Main simulation file
 */
 
 // local includes
+#include "config.h"
+#include "instrumentation.h"
+#include "monte_carlo.h"
+#include "results_writer.h"
+#include "scenario.h"
 #include "simulation.h"
-#include "simulation_params.h"
+#include "sweep.h"
 
 // Linux includes
 // NA
 
 // C++ includes
+#include <algorithm>
 #include <iostream>
+#include <random>
 
-int main()
+int main(int argc, char* argv[])
 {
-    std::cout << "Running simulation\n\n";
+    // Read the scenario from a scenario file and/or the command-line arguments; see `--help`
+    Program_config config;
+    if (!parse_args(argc, argv, &config))
+    {
+        return 1;
+    }
+    if (config.print_help)
+    {
+        print_usage(argv[0]);
+        return 0;
+    }
 
-    Simulation simulation{NUM_CHARGERS, SIMULATION_DURATION_HRS, SIMULATION_STEP_SIZE_HRS};
+    // Seed randomly, unless a seed was given; print it either way so any run can be reproduced
+    if (!config.scenario.options.seed)
+    {
+        config.monte_carlo.base_seed = std::random_device{}();
+        config.scenario.options.seed = config.monte_carlo.base_seed;
+    }
 
-    // Add the various company vehicle types and stats
-    // TODO: store and read these from a .yaml file. Specify the yaml file path as an argument to
-    // `main()`. Then read them in from the yaml file instead.
-    // clang-format off
-    simulation.add_vehicle_type({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
-    simulation.add_vehicle_type({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
-    simulation.add_vehicle_type({"Charlie",  160, 220, 0.8,  2.2, 3, 0.05});
-    simulation.add_vehicle_type({"Delta",    90,  120, 0.62, 0.8, 2, 0.22});
-    simulation.add_vehicle_type({"Echo",     30,  150, 0.3,  5.8, 2, 0.61});
-    // clang-format on
+    if (config.single_run)
+    {
+        std::cout << "Running simulation\n\n";
 
-    simulation.print_vehicle_types();
+        // Randomly populate the correct total number of vehicles, or pick up where a checkpointed
+        // run left off
+        std::unique_ptr<Simulation> simulation =
+            config.resume_path.empty() ? make_simulation(config.scenario)
+                                       : Simulation::load_checkpoint(config.resume_path);
+        if (simulation == nullptr)
+        {
+            return 1;
+        }
+        if (!config.resume_path.empty())
+        {
+            printf("Resuming from a checkpoint at %.4f hrs.\n\n", simulation->current_time_hrs());
+        }
 
-    // Randomly populate the correct total number of vehicles
-    simulation.populate_vehicles(NUM_VEHICLES);
-    simulation.print_vehicles();
+        simulation->print_vehicle_types();
+        simulation->print_vehicles();
 
-    simulation.run();
-    simulation.print_results();
+        if (!config.checkpoint_path.empty())
+        {
+            double stop_time_hrs = simulation->simulation_duration_hrs();
+            if (config.checkpoint_stop_hrs > 0)
+            {
+                stop_time_hrs = std::min(config.checkpoint_stop_hrs, stop_time_hrs);
+            }
+
+            double time_hrs = simulation->current_time_hrs();
+            while (time_hrs < stop_time_hrs)
+            {
+                time_hrs = std::min(time_hrs + config.checkpoint_interval_hrs, stop_time_hrs);
+                if (!simulation->run_until(time_hrs)
+                    || !simulation->save_checkpoint(config.checkpoint_path))
+                {
+                    return 1;
+                }
+            }
+
+            if (stop_time_hrs < simulation->simulation_duration_hrs())
+            {
+                printf(
+                    "Stopped at %.4f hrs; resume with `--resume_path %s`.\n",
+                    simulation->current_time_hrs(),
+                    config.checkpoint_path.c_str());
+                return 0;
+            }
+        }
+
+        simulation->run();
+        simulation->print_results();
+
+        if (!config.vehicle_results_path.empty())
+        {
+            std::vector<std::string> vehicle_type_names;
+            for (const Vehicle_type& vehicle_type : simulation->vehicle_types())
+            {
+                vehicle_type_names.push_back(vehicle_type.name);
+            }
+
+            Results_writer vehicle_results_writer;
+            if (!vehicle_results_writer.open(config.vehicle_results_path,
+                                             config.results_format,
+                                             Results_table::VEHICLE_STATS,
+                                             vehicle_type_names))
+            {
+                return 1;
+            }
+            const std::vector<Vehicle>& vehicles = simulation->vehicles();
+            for (uint32_t i_vehicle = 0; i_vehicle < vehicles.size(); i_vehicle++)
+            {
+                const Vehicle& vehicle = vehicles[i_vehicle];
+                vehicle_results_writer.write_vehicle_stats(
+                    0, i_vehicle, vehicle.i_type, vehicle.stats);
+            }
+            if (!vehicle_results_writer.close())
+            {
+                return 1;
+            }
+        }
+    }
+
+    if (!config.sweep.empty())
+    {
+        printf(
+            "Running a parameter sweep of up to %u replications per grid point with base seed "
+            "%lu.\n",
+            config.monte_carlo.num_replications,
+            config.monte_carlo.base_seed);
+        std::vector<Sweep_point> sweep_points =
+            run_sweep(config.scenario, config.sweep, config.monte_carlo);
+        if (sweep_points.empty())
+        {
+            return 1;
+        }
+        print_sweep_results(sweep_points);
+    }
+    else if (config.monte_carlo.num_replications > 0)
+    {
+        // Now run a whole Monte Carlo batch of independent replications of the same scenario,
+        // across all hardware threads
+        bool may_stop_early = config.monte_carlo.precision_targets.any()
+                              || config.monte_carlo.time_budget_sec > 0;
+        printf(
+            "Running %s%u Monte Carlo replications with base seed %lu.\n",
+            may_stop_early ? "up to " : "",
+            config.monte_carlo.num_replications,
+            config.monte_carlo.base_seed);
+        Results_writer results_writer;
+        if (!config.results_path.empty())
+        {
+            std::vector<std::string> vehicle_type_names;
+            for (const Vehicle_type& vehicle_type : config.scenario.vehicle_types)
+            {
+                vehicle_type_names.push_back(vehicle_type.name);
+            }
+            if (!results_writer.open(config.results_path,
+                                     config.results_format,
+                                     Results_table::VEHICLE_TYPE_STATS,
+                                     vehicle_type_names))
+            {
+                return 1;
+            }
+        }
+
+        Monte_carlo_results monte_carlo_results = run_monte_carlo(
+            config.scenario,
+            config.monte_carlo,
+            config.results_path.empty() ? nullptr : &results_writer);
+        if (!results_writer.close())
+        {
+            return 1;
+        }
+        monte_carlo_results.print();
+    }
+
+    if (INSTRUMENTATION_ENABLED)
+    {
+        instrumentation_summary().print();
+    }
 
     return 0;
 }
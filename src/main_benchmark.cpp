@@ -0,0 +1,346 @@
+/*
+Google Benchmark benchmarks, to compare the simulation engines objectively and to catch
+performance regressions as fleet sizes grow.
+
+To install Google Benchmark on Ubuntu: `sudo apt install libbenchmark-dev`
+
+Useful Google Benchmark command-line options:
+1. `--benchmark_filter=<regex>` - run only the benchmarks matching the regex
+1. `--benchmark_repetitions=<n>` - repeat each benchmark n times, and report the mean, median,
+   and standard deviation, to see how noisy the measurements are
+1. `--benchmark_format=json` and `--benchmark_out=<file>` - save results, such as to compare two
+   builds with Google Benchmark's `tools/compare.py`
+
+Custom counters reported:
+1. `vehicle_step` - average time per vehicle per time step (the number of vehicles times the
+   number of time steps)
+1. `allocs` - average number of heap allocations per iteration, in the timed region only
+1. `replications` - Monte Carlo replications per second
+
+*/
+
+// Local includes
+#include "fleet_soa.h"
+#include "monte_carlo.h"
+#include "results_writer.h"
+#include "scenario.h"
+#include "simulation.h"
+#include "simulation_params.h"
+
+// 3rd-party library includes
+#include "benchmark/benchmark.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Count every heap allocation in the whole program, by replacing the global `operator new`, so
+// that benchmarks can report allocations as well as time. The default `operator new[]` calls
+// `operator new`, and the default `operator delete`s call `std::free()`, so replacing just this one
+// function counts every allocation, and stays compatible with deallocation. It is never inlined,
+// so that the compiler doesn't mistake its `std::malloc()` calls for mismatched `operator delete`s.
+static std::atomic<uint64_t> num_allocations{0};
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+/// Seed for every benchmark, so that every run does identical work
+constexpr uint64_t BENCHMARK_SEED = 1234;
+
+/// The default scenario, with the given overrides
+static Scenario make_scenario(Engine engine,
+                              uint32_t num_vehicles,
+                              uint32_t num_chargers,
+                              double simulation_duration_hrs,
+                              double simulation_step_size_sec)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = num_vehicles;
+    scenario.num_chargers = num_chargers;
+    scenario.simulation_duration_hrs = simulation_duration_hrs;
+    scenario.simulation_step_size_hrs = simulation_step_size_sec / SECONDS_PER_HR;
+    scenario.options.engine = engine;
+    scenario.options.print_progress = false;
+    return scenario;
+}
+
+/// Time `Simulation::run()`, including its result aggregation, for one scenario per iteration.
+/// Constructing and populating each fresh simulation is excluded from the timing.
+static void benchmark_run(benchmark::State& state, const Scenario& scenario)
+{
+    uint64_t num_steps = scenario.simulation_duration_hrs / scenario.simulation_step_size_hrs;
+    uint64_t num_vehicle_steps = 0;
+    uint64_t num_allocations_timed = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario, BENCHMARK_SEED);
+        uint64_t num_allocations_start = num_allocations.load(std::memory_order_relaxed);
+        state.ResumeTiming();
+
+        simulation->run();
+
+        state.PauseTiming();
+        num_allocations_timed += num_allocations.load(std::memory_order_relaxed)
+                                 - num_allocations_start;
+        num_vehicle_steps += scenario.num_vehicles * num_steps;
+        // destroy the simulation outside of the timed region too
+        simulation.reset();
+        state.ResumeTiming();
+    }
+
+    state.counters["vehicle_step"] = benchmark::Counter(
+        num_vehicle_steps, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["allocs"] =
+        benchmark::Counter(num_allocations_timed, benchmark::Counter::kAvgIterations);
+}
+
+/// Run across engines, fleet sizes, and charger counts.
+/// Args: engine, num_vehicles, num_chargers
+static void BM_run(benchmark::State& state)
+{
+    Scenario scenario = make_scenario((Engine)state.range(0),
+                                      state.range(1),
+                                      state.range(2),
+                                      SIMULATION_DURATION_HRS,
+                                      SIMULATION_STEP_SIZE_HRS * SECONDS_PER_HR);
+    benchmark_run(state, scenario);
+}
+BENCHMARK(BM_run)
+    ->ArgNames({"engine", "vehicles", "chargers"})
+    ->ArgsProduct({{(int64_t)Engine::STEPPED,
+                    (int64_t)Engine::EVENT_DRIVEN,
+                    (int64_t)Engine::STEPPED_SOA},
+                   {NUM_VEHICLES, 1000, 10000},
+                   {NUM_CHARGERS, 100}})
+    ->Unit(benchmark::kMillisecond);
+
+/// Run across engines, simulation durations, and time step sizes, for a mid-sized fleet.
+/// Args: engine, simulation_duration_hrs, simulation_step_size_sec
+static void BM_run_time_steps(benchmark::State& state)
+{
+    Scenario scenario =
+        make_scenario((Engine)state.range(0), 1000, 100, state.range(1), state.range(2));
+    benchmark_run(state, scenario);
+}
+BENCHMARK(BM_run_time_steps)
+    ->ArgNames({"engine", "hrs", "step_sec"})
+    ->ArgsProduct({{(int64_t)Engine::STEPPED,
+                    (int64_t)Engine::EVENT_DRIVEN,
+                    (int64_t)Engine::STEPPED_SOA},
+                   {1, 24},
+                   {1, 60}})
+    ->Unit(benchmark::kMillisecond);
+
+/// Time one `Fleet_soa::step()` of the whole default fleet, as used by `Engine::STEPPED_SOA`,
+/// with the runtime kernel vs the kernel specialized at compile time for the default fleet and
+/// step size.
+/// Args: specialized (0 or 1), num_vehicles
+static void BM_fleet_soa_step(benchmark::State& state)
+{
+    bool specialized = state.range(0);
+    Scenario scenario = make_scenario(Engine::STEPPED_SOA,
+                                      state.range(1),
+                                      NUM_CHARGERS,
+                                      SIMULATION_DURATION_HRS,
+                                      SIMULATION_STEP_SIZE_HRS * SECONDS_PER_HR);
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario, BENCHMARK_SEED);
+    std::vector<Vehicle> vehicles = simulation->vehicles();
+
+    // Give the kernel a realistic mix of states, with flights and charges far from over, so that
+    // every step does the same work
+    for (size_t i = 0; i < vehicles.size(); i++)
+    {
+        Vehicle& vehicle = vehicles[i];
+        vehicle.stats.state = i % 3 == 0 ? Vehicle_state::CHARGING : Vehicle_state::FLYING;
+        vehicle.stats.num_steps_remaining = UINT16_MAX;
+    }
+    Fleet_soa fleet;
+    fleet.load(vehicles,
+               simulation->vehicle_types(),
+               scenario.simulation_step_size_hrs,
+               specialized);
+    if (fleet.is_specialized() != specialized)
+    {
+        state.SkipWithError("the default fleet has no specialized kernel");
+        return;
+    }
+    state.SetLabel(specialized ? "specialized" : "runtime");
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(fleet.step());
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["vehicle_step"] = benchmark::Counter(
+        state.iterations() * fleet.size(),
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+BENCHMARK(BM_fleet_soa_step)
+    ->ArgNames({"specialized", "vehicles"})
+    ->ArgsProduct({{0, 1}, {1000, 100000, 1000000}});
+
+/// Time `Simulation::populate_vehicles()`.
+/// Args: num_vehicles
+static void BM_populate_vehicles(benchmark::State& state)
+{
+    Scenario scenario = make_scenario(Engine::STEPPED,
+                                      state.range(0),
+                                      NUM_CHARGERS,
+                                      SIMULATION_DURATION_HRS,
+                                      SIMULATION_STEP_SIZE_HRS * SECONDS_PER_HR);
+    Simulation_options options = scenario.options;
+    options.seed = BENCHMARK_SEED;
+    uint64_t num_allocations_timed = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto simulation = std::make_unique<Simulation>(scenario.num_chargers,
+                                                       scenario.simulation_duration_hrs,
+                                                       scenario.simulation_step_size_hrs,
+                                                       options);
+        for (const Vehicle_type& vehicle_type : scenario.vehicle_types)
+        {
+            simulation->add_vehicle_type(vehicle_type);
+        }
+        uint64_t num_allocations_start = num_allocations.load(std::memory_order_relaxed);
+        state.ResumeTiming();
+
+        simulation->populate_vehicles(scenario.num_vehicles);
+
+        state.PauseTiming();
+        num_allocations_timed += num_allocations.load(std::memory_order_relaxed)
+                                 - num_allocations_start;
+        simulation.reset();
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * scenario.num_vehicles);
+    state.counters["allocs"] =
+        benchmark::Counter(num_allocations_timed, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_populate_vehicles)->Arg(NUM_VEHICLES)->Arg(10000)->Arg(1000000);
+
+/// Time folding replications into `Monte_carlo_results`, which is done once per replication.
+/// Args: none
+static void BM_monte_carlo_add_replication(benchmark::State& state)
+{
+    // fold in the results of a real run, so that every vehicle type has vehicles
+    Scenario scenario = make_scenario(Engine::EVENT_DRIVEN,
+                                      NUM_VEHICLES,
+                                      NUM_CHARGERS,
+                                      SIMULATION_DURATION_HRS,
+                                      SIMULATION_STEP_SIZE_HRS * SECONDS_PER_HR);
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario, BENCHMARK_SEED);
+    simulation->run();
+    const std::vector<Vehicle_type_stats>& replication_stats = simulation->results().stats_by_type;
+    Monte_carlo_results results{simulation->vehicle_types()};
+
+    for (auto _ : state)
+    {
+        results.add_replication(replication_stats);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_monte_carlo_add_replication);
+
+/// Time writing one replication's results, by vehicle type, to a results file, as throughput in
+/// rows per second. Writes to "/dev/null", to measure formatting and buffering, not the disk.
+/// Args: (int)Results_format
+static void BM_results_writer(benchmark::State& state)
+{
+    Scenario scenario = make_scenario(Engine::EVENT_DRIVEN,
+                                      NUM_VEHICLES,
+                                      NUM_CHARGERS,
+                                      SIMULATION_DURATION_HRS,
+                                      SIMULATION_STEP_SIZE_HRS * SECONDS_PER_HR);
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario, BENCHMARK_SEED);
+    simulation->run();
+    std::vector<std::string> vehicle_type_names;
+    for (const Vehicle_type& vehicle_type : simulation->vehicle_types())
+    {
+        vehicle_type_names.push_back(vehicle_type.name);
+    }
+
+    Results_format format = (Results_format)state.range(0);
+    state.SetLabel(results_format_name(format));
+    Results_writer writer;
+    writer.open("/dev/null", format, Results_table::VEHICLE_TYPE_STATS, vehicle_type_names);
+
+    uint64_t i_replication = 0;
+    for (auto _ : state)
+    {
+        for (uint32_t i_type = 0; i_type < vehicle_type_names.size(); i_type++)
+        {
+            writer.write_vehicle_type_stats(
+                i_replication, i_type, simulation->results().stats_by_type[i_type]);
+        }
+        i_replication++;
+    }
+    writer.close();
+
+    state.SetItemsProcessed(state.iterations() * vehicle_type_names.size());
+}
+BENCHMARK(BM_results_writer)
+    ->ArgName("format")
+    ->Arg((int)Results_format::CSV)
+    ->Arg((int)Results_format::JSONL)
+    ->Arg((int)Results_format::BINARY);
+
+/// Time a whole Monte Carlo batch of the default scenario, end to end, as throughput in
+/// replications per second.
+/// Args: num_threads (0 for all hardware threads)
+static void BM_monte_carlo(benchmark::State& state)
+{
+    Scenario scenario = make_scenario(Engine::STEPPED,
+                                      NUM_VEHICLES,
+                                      NUM_CHARGERS,
+                                      SIMULATION_DURATION_HRS,
+                                      SIMULATION_STEP_SIZE_HRS * SECONDS_PER_HR);
+    Monte_carlo_config config;
+    config.num_replications = 32;
+    config.num_threads = state.range(0);
+    config.base_seed = BENCHMARK_SEED;
+
+    uint64_t num_allocations_start = num_allocations.load(std::memory_order_relaxed);
+    for (auto _ : state)
+    {
+        Monte_carlo_results results = run_monte_carlo(scenario, config);
+        benchmark::DoNotOptimize(results);
+    }
+    uint64_t num_allocations_run =
+        num_allocations.load(std::memory_order_relaxed) - num_allocations_start;
+
+    state.counters["replications"] = benchmark::Counter(
+        state.iterations() * config.num_replications, benchmark::Counter::kIsRate);
+    state.counters["allocs_per_replication"] =
+        (double)num_allocations_run / (state.iterations() * config.num_replications);
+}
+BENCHMARK(BM_monte_carlo)
+    ->ArgName("threads")
+    ->Arg(1)
+    ->Arg(0)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
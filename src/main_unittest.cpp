@@ -15,8 +15,21 @@ https://github.com/google/googletest/blob/main/docs/reference/assertions.md#expe
 */
 
 // Local includes
+#include "charger_queue.h"
+#include "charger_site.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "fleet_soa.h"
+#include "instrumentation.h"
+#include "monte_carlo.h"
+#include "results_writer.h"
+#include "rng.h"
 #include "simulation.h"
 #include "simulation_params.h"
+#include "sweep.h"
+#include "trace.h"
+#include "trace_analysis.h"
+#include "what_if.h"
 
 // 3rd-party library includes
 #include "gmock/gmock.h"
@@ -26,7 +39,14 @@ https://github.com/google/googletest/blob/main/docs/reference/assertions.md#expe
 // NA
 
 // C++ includes
-// NA
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 /// Expect or assert that value `val` is within the range of `min` to `max`,
 /// inclusive. ie: `val` is tested to be >= `min` and <= `max`.
@@ -140,8 +160,8 @@ TEST_F(SimulationTestFixture, EndToEndTest)
     // simulation.print_results(); // debugging
 
     // Ensure each vehicle has a total flight+waiting+charging time duration equal to the simulation
-    // duration, +/- some delta
-    constexpr double allowed_delta_hrs = 0.01;
+    // duration, +/- floating point error in adding up the time steps
+    constexpr double allowed_delta_hrs = 1e-9;
     for (size_t i = 0; i < simulation._vehicles.size(); i++)
     {
         const Vehicle_stats& stats = simulation._vehicles[i].stats;
@@ -172,36 +192,2282 @@ TEST(Simulation, TrivialEndToEnd)
     // simulation.print_vehicle_types(); // debugging
 
     // Force 1 of each vehicle above
-    simulation._vehicles.emplace_back(Vehicle{&simulation._vehicle_types[0]});
-    simulation._vehicles.emplace_back(Vehicle{&simulation._vehicle_types[1]});
-    simulation._vehicles.emplace_back(Vehicle{&simulation._vehicle_types[2]});
+    simulation._vehicles.emplace_back(Vehicle{0, simulation._vehicle_types[0]});
+    simulation._vehicles.emplace_back(Vehicle{1, simulation._vehicle_types[1]});
+    simulation._vehicles.emplace_back(Vehicle{2, simulation._vehicle_types[2]});
 
     // Now run the simulation and check for expected results
 
     simulation.run();
     // simulation.print_results(); // debugging
 
-    constexpr double allowed_error = 0.01;
+    // Every flight and charge counts down a whole number of time steps, so, just like in the
+    // event-driven engine, the results land exactly on the ideal values, with no drift
+    constexpr double exact_error = 1e-6;
 
     const Vehicle_type_stats* stats = nullptr;
 
     // Alpha
-    stats = &(simulation._vehicle_types[0].stats);
+    stats = &(simulation._results.stats_by_type[0]);
+    EXPECT_EQ(stats->total_num_flights, 2);
+    EXPECT_EQ(stats->total_num_charges, 1);
+    EXPECT_NEAR(stats->total_flight_time_hrs, 2.4, exact_error);
+    EXPECT_NEAR(stats->total_charge_time_hrs, 0.6, exact_error);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 1152.0, exact_error);
+
+    // Bravo
+    stats = &(simulation._results.stats_by_type[1]);
+    EXPECT_EQ(stats->total_num_flights, 4);
+    EXPECT_EQ(stats->total_num_charges, 3);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 1200.0, exact_error);
+
+    // Charlie
+    stats = &(simulation._results.stats_by_type[2]);
+    EXPECT_EQ(stats->total_num_flights, 3);
+    EXPECT_EQ(stats->total_num_charges, 2);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 672.0, exact_error);
+}
+
+/// Same as `TrivialEndToEnd`, but using the event-driven engine, which quantizes each full flight
+/// and full charge to the same whole number of time steps analytically, instead of counting them
+/// down one time step at a time.
+TEST(Simulation, EventDrivenTrivialEndToEnd)
+{
+    constexpr uint32_t num_chargers = 3;
+    constexpr double simulation_duration_hrs = 3.0;
+    constexpr double simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+
+    Simulation_options options;
+    options.engine = Engine::EVENT_DRIVEN;
+    Simulation simulation{num_chargers, simulation_duration_hrs, simulation_step_size_hrs, options};
+
+    // clang-format off
+    simulation.add_vehicle_type({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+    simulation.add_vehicle_type({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
+    simulation.add_vehicle_type({"Charlie",  160, 220, 0.8,  2.2, 3, 0.05});
+    // clang-format on
+
+    // Force 1 of each vehicle above
+    simulation._vehicles.emplace_back(Vehicle{0, simulation._vehicle_types[0]});
+    simulation._vehicles.emplace_back(Vehicle{1, simulation._vehicle_types[1]});
+    simulation._vehicles.emplace_back(Vehicle{2, simulation._vehicle_types[2]});
+
+    simulation.run();
+
+    // the exact answer, with no time step quantization error
+    constexpr double exact_error = 1e-6;
+
+    const Vehicle_type_stats* stats = nullptr;
+
+    // Alpha: fly 1.6667 hrs, charge 0.6 hrs, fly the remaining 0.7333 hrs
+    stats = &(simulation._results.stats_by_type[0]);
     EXPECT_EQ(stats->total_num_flights, 2);
-    EXPECT_RANGE(
-        stats->total_num_passenger_miles, 1151.87 - allowed_error, 1151.87 + allowed_error);
-    // TODO: check for other expected values in `stats` here.
+    EXPECT_EQ(stats->total_num_charges, 1);
+    EXPECT_NEAR(stats->total_flight_time_hrs, 2.4, exact_error);
+    EXPECT_NEAR(stats->total_charge_time_hrs, 0.6, exact_error);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 1152.0, exact_error);
 
     // Bravo
-    stats = &(simulation._vehicle_types[1].stats);
+    stats = &(simulation._results.stats_by_type[1]);
     EXPECT_EQ(stats->total_num_flights, 4);
-    EXPECT_RANGE(
-        stats->total_num_passenger_miles, 1199.58 - allowed_error, 1199.58 + allowed_error);
-    // TODO: check for other expected values in `stats` here.
+    EXPECT_EQ(stats->total_num_charges, 3);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 1200.0, exact_error);
 
     // Charlie
-    stats = &(simulation._vehicle_types[2].stats);
+    stats = &(simulation._results.stats_by_type[2]);
     EXPECT_EQ(stats->total_num_flights, 3);
-    EXPECT_RANGE(stats->total_num_passenger_miles, 671.60 - allowed_error, 671.60 + allowed_error);
-    // TODO: check for other expected values in `stats` here.
+    EXPECT_EQ(stats->total_num_charges, 2);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 672.0, exact_error);
+
+    // nobody ever had to wait
+    for (const Vehicle_type_stats& type_stats : simulation._results.stats_by_type)
+    {
+        EXPECT_EQ(type_stats.total_num_times_waiting, 0);
+        EXPECT_EQ(type_stats.total_wait_time_hrs, 0);
+    }
+}
+
+/// The same 3 vehicles as in `TrivialEndToEnd`, but sharing 1 charger, so that they wait in line,
+/// must give the same results in the stepped and event-driven engines
+TEST(Simulation, EventDrivenMatchesStepped)
+{
+    constexpr uint32_t num_chargers = 1;
+    constexpr double simulation_duration_hrs = 3.0;
+    constexpr double simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+
+    std::vector<std::unique_ptr<Simulation>> simulations;
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN})
+    {
+        Simulation_options options;
+        options.engine = engine;
+        options.print_progress = false;
+        simulations.push_back(std::make_unique<Simulation>(
+            num_chargers, simulation_duration_hrs, simulation_step_size_hrs, options));
+        Simulation& simulation = *simulations.back();
+
+        // clang-format off
+        simulation.add_vehicle_type({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+        simulation.add_vehicle_type({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
+        simulation.add_vehicle_type({"Charlie",  160, 220, 0.8,  2.2, 3, 0.05});
+        // clang-format on
+
+        simulation._vehicles.emplace_back(Vehicle{0, simulation._vehicle_types[0]});
+        simulation._vehicles.emplace_back(Vehicle{1, simulation._vehicle_types[1]});
+        simulation._vehicles.emplace_back(Vehicle{2, simulation._vehicle_types[2]});
+
+        simulation.run();
+    }
+
+    // Faults are drawn differently by each engine, but nothing else is random
+    uint32_t total_num_times_waiting = 0;
+    for (size_t i = 0; i < simulations[0]->_vehicle_types.size(); i++)
+    {
+        const Vehicle_type_stats& stepped_stats = simulations[0]->_results.stats_by_type[i];
+        const Vehicle_type_stats& stats = simulations[1]->_results.stats_by_type[i];
+        std::string message = "i = " + std::to_string(i);
+
+        EXPECT_EQ(stats.total_num_flights, stepped_stats.total_num_flights) << message;
+        EXPECT_EQ(stats.total_num_charges, stepped_stats.total_num_charges) << message;
+        EXPECT_EQ(stats.total_num_times_waiting, stepped_stats.total_num_times_waiting) << message;
+        EXPECT_NEAR(stats.total_flight_time_hrs, stepped_stats.total_flight_time_hrs, 1e-9)
+            << message;
+        EXPECT_NEAR(stats.total_wait_time_hrs, stepped_stats.total_wait_time_hrs, 1e-9) << message;
+        EXPECT_NEAR(stats.total_charge_time_hrs, stepped_stats.total_charge_time_hrs, 1e-9)
+            << message;
+        EXPECT_NEAR(stats.total_num_passenger_miles, stepped_stats.total_num_passenger_miles, 1e-6)
+            << message;
+        total_num_times_waiting += stats.total_num_times_waiting;
+    }
+    EXPECT_GT(total_num_times_waiting, 0);
+}
+
+/// Run a full, randomly-populated fleet that has to wait in line for chargers through the
+/// event-driven engine, and check that it is self-consistent.
+TEST(Simulation, EventDrivenEndToEnd)
+{
+    constexpr uint32_t num_chargers = 3;
+    constexpr double simulation_duration_hrs = 3.0;
+    constexpr double simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+
+    Simulation_options options;
+    options.engine = Engine::EVENT_DRIVEN;
+    Simulation simulation{num_chargers, simulation_duration_hrs, simulation_step_size_hrs, options};
+
+    // clang-format off
+    simulation.add_vehicle_type({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+    simulation.add_vehicle_type({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
+    simulation.add_vehicle_type({"Charlie",  160, 220, 0.8,  2.2, 3, 0.05});
+    simulation.add_vehicle_type({"Delta",    90,  120, 0.62, 0.8, 2, 0.22});
+    simulation.add_vehicle_type({"Echo",     30,  150, 0.3,  5.8, 2, 0.61});
+    // clang-format on
+
+    simulation.populate_vehicles(NUM_VEHICLES);
+    simulation.run();
+
+    // Every vehicle's flight+waiting+charging time must add up to the simulation duration
+    constexpr double allowed_delta_hrs = 1e-6;
+    uint32_t total_num_charges = 0;
+    for (size_t i = 0; i < simulation._vehicles.size(); i++)
+    {
+        const Vehicle_stats& stats = simulation._vehicles[i].stats;
+        EXPECT_NEAR(
+            stats.flight_time_hrs + stats.wait_time_hrs + stats.charge_time_hrs,
+            simulation_duration_hrs,
+            allowed_delta_hrs)
+            << "i = " << i << "\n";
+        EXPECT_NEAR(
+            stats.distance_miles,
+            stats.flight_time_hrs * simulation.type_of(simulation._vehicles[i]).cruise_speed_mph,
+            allowed_delta_hrs)
+            << "i = " << i << "\n";
+        total_num_charges += stats.num_charges;
+    }
+
+    // With 20 vehicles sharing 3 chargers, there must have been a line
+    uint32_t total_num_times_waiting = 0;
+    for (const Vehicle_type_stats& type_stats : simulation._results.stats_by_type)
+    {
+        total_num_times_waiting += type_stats.total_num_times_waiting;
+    }
+    EXPECT_GT(total_num_times_waiting, 0);
+    EXPECT_GE(total_num_charges, num_chargers);
+    EXPECT_LE(simulation._num_chargers_available, num_chargers);
+}
+
+/// Two simulations with the same seed must produce identical results
+TEST(Simulation, SeededRunsAreReproducible)
+{
+    Scenario scenario;
+    // clang-format off
+    scenario.vehicle_types.push_back({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+    scenario.vehicle_types.push_back({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
+    scenario.vehicle_types.push_back({"Echo",     30,  150, 0.3,  5.8, 2, 0.61});
+    // clang-format on
+    scenario.options.seed = 12345;
+    scenario.options.print_progress = false;
+
+    std::unique_ptr<Simulation> simulation1 = make_simulation(scenario);
+    std::unique_ptr<Simulation> simulation2 = make_simulation(scenario);
+    ASSERT_NE(simulation1, nullptr);
+    ASSERT_NE(simulation2, nullptr);
+    simulation1->run();
+    simulation2->run();
+
+    for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+    {
+        const Vehicle_type_stats& stats1 = simulation1->results().stats_by_type[i];
+        const Vehicle_type_stats& stats2 = simulation2->results().stats_by_type[i];
+        EXPECT_EQ(stats1.num_vehicles, stats2.num_vehicles) << "i = " << i << "\n";
+        EXPECT_EQ(stats1.total_num_faults, stats2.total_num_faults) << "i = " << i << "\n";
+        EXPECT_EQ(stats1.total_wait_time_hrs, stats2.total_wait_time_hrs) << "i = " << i << "\n";
+        EXPECT_EQ(stats1.total_num_passenger_miles, stats2.total_num_passenger_miles)
+            << "i = " << i << "\n";
+    }
+}
+
+/// A simulation reset and run again, as Monte Carlo batches do to reuse one simulation per
+/// thread, must give bit-for-bit identical results to a fresh simulation with the same seed, in
+/// every engine; and adding vehicle types after populating the vehicles mustn't change which type
+/// any vehicle is
+TEST(Simulation, ResetMatchesFreshSimulation)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 40;
+    scenario.num_chargers = 3;
+    scenario.simulation_duration_hrs = 2.0;
+    scenario.options.print_progress = false;
+
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN, Engine::STEPPED_SOA})
+    {
+        scenario.options.engine = engine;
+        std::string engine_message = std::string("engine = ") + engine_name(engine);
+
+        std::unique_ptr<Simulation> reused = make_simulation(scenario, 1);
+        ASSERT_NE(reused, nullptr);
+        reused->run();
+        reused->reset(2);
+        reused->populate_vehicles(scenario.num_vehicles, scenario.fleet_mix);
+        reused->run();
+
+        std::unique_ptr<Simulation> fresh = make_simulation(scenario, 2);
+        ASSERT_NE(fresh, nullptr);
+        fresh->run();
+
+        ASSERT_EQ(reused->vehicles().size(), fresh->vehicles().size()) << engine_message;
+        for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+        {
+            const Vehicle_type_stats& stats = reused->results().stats_by_type[i];
+            const Vehicle_type_stats& fresh_stats = fresh->results().stats_by_type[i];
+            for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+            {
+                Vehicle_type_metric metric = (Vehicle_type_metric)i_metric;
+                double value = metric_value(stats, metric);
+                double fresh_value = metric_value(fresh_stats, metric);
+                // averages over 0 sessions are NaN, which never compares equal
+                if (std::isnan(value) && std::isnan(fresh_value))
+                {
+                    continue;
+                }
+                EXPECT_EQ(value, fresh_value)
+                    << engine_message << ", i = " << i << ", metric = " << metric_name(metric);
+            }
+            EXPECT_EQ(stats.distributions.flight_time_hrs.moments.count(),
+                      fresh_stats.distributions.flight_time_hrs.moments.count())
+                << engine_message << ", i = " << i;
+            EXPECT_EQ(stats.distributions.flight_time_histogram.count(),
+                      fresh_stats.distributions.flight_time_histogram.count())
+                << engine_message << ", i = " << i;
+        }
+    }
+
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario, 3);
+    ASSERT_NE(simulation, nullptr);
+    std::vector<std::string> type_names;
+    for (const Vehicle& vehicle : simulation->vehicles())
+    {
+        type_names.push_back(simulation->type_of(vehicle).name);
+    }
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(simulation->add_vehicle_type(
+            {"Extra " + std::to_string(i), 100, 100, 0.5, 1.0, 2, 0.1}));
+    }
+    for (size_t i = 0; i < simulation->vehicles().size(); i++)
+    {
+        EXPECT_EQ(simulation->type_of(simulation->vehicles()[i]).name, type_names[i])
+            << "i = " << i;
+    }
+}
+
+/// A Monte Carlo batch must give bit-for-bit identical summaries regardless of the number of
+/// threads it runs on, and its confidence intervals must be sane.
+TEST(MonteCarlo, ReproducibleAcrossThreadCounts)
+{
+    Scenario scenario;
+    // clang-format off
+    scenario.vehicle_types.push_back({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+    scenario.vehicle_types.push_back({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
+    scenario.vehicle_types.push_back({"Charlie",  160, 220, 0.8,  2.2, 3, 0.05});
+    scenario.vehicle_types.push_back({"Delta",    90,  120, 0.62, 0.8, 2, 0.22});
+    scenario.vehicle_types.push_back({"Echo",     30,  150, 0.3,  5.8, 2, 0.61});
+    // clang-format on
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+
+    Monte_carlo_config config;
+    config.num_replications = 200;
+    config.base_seed = 42;
+
+    config.num_threads = 1;
+    Monte_carlo_results results_1_thread = run_monte_carlo(scenario, config);
+    config.num_threads = 4;
+    Monte_carlo_results results_4_threads = run_monte_carlo(scenario, config);
+
+    EXPECT_EQ(results_1_thread.num_replications, 200);
+    EXPECT_EQ(results_4_threads.num_replications, 200);
+
+    uint64_t total_num_vehicles = 0;
+    for (size_t i_type = 0; i_type < scenario.vehicle_types.size(); i_type++)
+    {
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            const Replication_stats& stats1 = results_1_thread.stats_by_type[i_type][i_metric];
+            const Replication_stats& stats4 = results_4_threads.stats_by_type[i_type][i_metric];
+            EXPECT_EQ(stats1.count(), stats4.count());
+            EXPECT_EQ(stats1.mean(), stats4.mean());
+            EXPECT_EQ(stats1.variance(), stats4.variance());
+            EXPECT_GE(stats1.confidence_interval_half_width(), 0);
+        }
+
+        const Replication_stats& num_vehicles =
+            results_1_thread.get(i_type, Vehicle_type_metric::NUM_VEHICLES);
+        total_num_vehicles += std::llround(num_vehicles.mean() * num_vehicles.count());
+    }
+
+    EXPECT_EQ(total_num_vehicles, 200 * NUM_VEHICLES);
+}
+
+/// Check the Philox block function against the published known-answer test vectors
+TEST(Rng, PhiloxKnownAnswers)
+{
+    std::array<uint32_t, 4> expected_zeros = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+    EXPECT_EQ(philox4x32_10({0, 0, 0, 0}, {0, 0}), expected_zeros);
+
+    std::array<uint32_t, 4> expected_ones = {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+    EXPECT_EQ(
+        philox4x32_10(
+            {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}),
+        expected_ones);
+}
+
+/// Streams must be reproducible from their seed, and split streams must be independent of each
+/// other and of the order in which they are drawn from
+TEST(Rng, ReproducibleAndSplittable)
+{
+    Rng rng1{123};
+    Rng rng2{123};
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(rng1(), rng2());
+    }
+
+    // Drawing from the parent doesn't change what the children produce
+    Rng parent{7};
+    Rng child_a = parent.split(0);
+    parent();
+    Rng child_a_again = parent.split(0);
+    Rng child_b = parent.split(1);
+    EXPECT_EQ(child_a(), child_a_again());
+    EXPECT_NE(child_a.stream_id(), child_b.stream_id());
+
+    uint32_t num_equal = 0;
+    Running_stats uniform_stats;
+    for (uint32_t i = 0; i < 10000; i++)
+    {
+        if (child_a() == child_b())
+        {
+            num_equal++;
+        }
+
+        double uniform = child_a.uniform_0_to_1();
+        ASSERT_RANGE(uniform, 0.0, 1.0);
+        EXPECT_LT(uniform, 1.0);
+        uniform_stats.add(uniform);
+    }
+    EXPECT_EQ(num_equal, 0);
+    EXPECT_NEAR(uniform_stats.mean(), 0.5, 0.01);
+    EXPECT_NEAR(uniform_stats.variance(), 1.0 / 12, 0.005);
+}
+
+TEST(Statistics, QuantileSketchAndHistogram)
+{
+    // log-uniform samples over 6 decades, plus some zeros
+    Rng rng{11};
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < 20000; i++)
+    {
+        samples.push_back(i % 100 == 0 ? 0 : std::pow(10, 6 * rng.uniform_0_to_1() - 3));
+    }
+
+    Quantile_sketch sketch;
+    Quantile_sketch first_half;
+    Quantile_sketch second_half;
+    Histogram histogram{0, 1, 10};
+    Histogram first_half_histogram{0, 1, 10};
+    Histogram second_half_histogram{0, 1, 10};
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        sketch.add(samples[i]);
+        histogram.add(samples[i] - 0.001);
+        if (i < samples.size() / 2)
+        {
+            first_half.add(samples[i]);
+            first_half_histogram.add(samples[i] - 0.001);
+        }
+        else
+        {
+            second_half.add(samples[i]);
+            second_half_histogram.add(samples[i] - 0.001);
+        }
+    }
+    EXPECT_EQ(sketch.count(), samples.size());
+
+    std::vector<double> sorted_samples = samples;
+    std::sort(sorted_samples.begin(), sorted_samples.end());
+    for (double fraction : {0.0, 0.005, 0.01, 0.25, 0.5, 0.9, 0.95, 0.99, 1.0})
+    {
+        double exact = sorted_samples[(size_t)(fraction * (sorted_samples.size() - 1))];
+        EXPECT_NEAR(sketch.quantile(fraction), exact, exact * QUANTILE_SKETCH_RELATIVE_ACCURACY)
+            << "fraction = " << fraction;
+    }
+
+    // Merging is exact, in either order
+    Quantile_sketch merged = second_half;
+    ASSERT_TRUE(merged.merge(first_half));
+    EXPECT_EQ(merged.count(), sketch.count());
+    for (double fraction : {0.0, 0.01, 0.5, 0.99, 1.0})
+    {
+        EXPECT_EQ(merged.quantile(fraction), sketch.quantile(fraction));
+    }
+    EXPECT_FALSE(merged.merge(Quantile_sketch{0.05}));
+
+    // Histograms: all samples are counted once, including the ones out of range
+    EXPECT_EQ(histogram.count(), samples.size());
+    EXPECT_GT(histogram.num_below(), 0);
+    EXPECT_GT(histogram.num_above(), 0);
+    // an empty histogram takes on the bins of the first histogram merged into it
+    Histogram merged_histogram;
+    ASSERT_TRUE(merged_histogram.merge(first_half_histogram));
+    ASSERT_TRUE(merged_histogram.merge(Histogram{}));
+    ASSERT_TRUE(merged_histogram.merge(second_half_histogram));
+    EXPECT_FALSE(merged_histogram.merge(Histogram{0, 2, 10}));
+    ASSERT_EQ(merged_histogram.num_bins(), histogram.num_bins());
+    for (size_t i_bin = 0; i_bin < histogram.num_bins(); i_bin++)
+    {
+        EXPECT_EQ(merged_histogram.bin_count(i_bin), histogram.bin_count(i_bin));
+    }
+    EXPECT_EQ(merged_histogram.num_below(), histogram.num_below());
+    EXPECT_EQ(merged_histogram.num_above(), histogram.num_above());
+}
+
+/// Sampling faults as a Poisson process must give the same expected number of faults as drawing
+/// once per time step, in both engines, and the recorded fault times must be consistent.
+TEST(Simulation, PoissonFaultsMatchBernoulliFaults)
+{
+    constexpr uint32_t num_vehicles = 500;
+    constexpr double simulation_duration_hrs = 3.0;
+    constexpr double simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+    constexpr double prob_fault_per_hr = 2.0;
+    // The battery outlasts the simulation, so every vehicle flies the whole time
+    constexpr double expected_num_faults =
+        num_vehicles * simulation_duration_hrs * prob_fault_per_hr;
+    // 5 standard deviations of a Poisson distribution
+    const double allowed_error = 5 * std::sqrt(expected_num_faults);
+
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN})
+    {
+        for (Fault_model fault_model : {Fault_model::PER_STEP_BERNOULLI, Fault_model::POISSON})
+        {
+            Simulation_options options;
+            options.engine = engine;
+            options.fault_model = fault_model;
+            options.record_fault_times = true;
+            options.seed = 99;
+            options.print_progress = false;
+            Simulation simulation{
+                1, simulation_duration_hrs, simulation_step_size_hrs, options};
+            simulation.add_vehicle_type({"LongRange", 100, 1000, 1, 1, 1, prob_fault_per_hr});
+            simulation.populate_vehicles(num_vehicles);
+            simulation.run();
+
+            const Vehicle_type_stats& stats = simulation._results.stats_by_type[0];
+            EXPECT_NEAR(stats.total_num_faults, expected_num_faults, allowed_error)
+                << "engine = " << (int)engine << ", fault_model = " << (int)fault_model;
+
+            for (const Vehicle& vehicle : simulation._vehicles)
+            {
+                ASSERT_EQ(vehicle.fault_times_hrs.size(), vehicle.stats.num_faults);
+                for (size_t i = 0; i < vehicle.fault_times_hrs.size(); i++)
+                {
+                    EXPECT_RANGE(vehicle.fault_times_hrs[i], 0.0, simulation_duration_hrs);
+                    if (i > 0)
+                    {
+                        EXPECT_GE(vehicle.fault_times_hrs[i], vehicle.fault_times_hrs[i - 1]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// The structure-of-arrays engine follows exactly the same state of charge trajectories as the
+/// `STEPPED` engine, so it must reproduce `TrivialEndToEnd`'s results, and a full fleet through it
+/// must be self-consistent.
+TEST(Simulation, SoaTrivialEndToEnd)
+{
+    constexpr uint32_t num_chargers = 3;
+    constexpr double simulation_duration_hrs = 3.0;
+    constexpr double simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+
+    Simulation_options options;
+    options.engine = Engine::STEPPED_SOA;
+    Simulation simulation{num_chargers, simulation_duration_hrs, simulation_step_size_hrs, options};
+
+    // clang-format off
+    simulation.add_vehicle_type({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+    simulation.add_vehicle_type({"Bravo",    100, 100, 0.2,  1.5, 5, 0.10});
+    simulation.add_vehicle_type({"Charlie",  160, 220, 0.8,  2.2, 3, 0.05});
+    // clang-format on
+
+    // Force 1 of each vehicle above
+    simulation._vehicles.emplace_back(Vehicle{0, simulation._vehicle_types[0]});
+    simulation._vehicles.emplace_back(Vehicle{1, simulation._vehicle_types[1]});
+    simulation._vehicles.emplace_back(Vehicle{2, simulation._vehicle_types[2]});
+
+    simulation.run();
+
+    constexpr double exact_error = 1e-6;
+
+    const Vehicle_type_stats* stats = nullptr;
+
+    stats = &(simulation._results.stats_by_type[0]);
+    EXPECT_EQ(stats->total_num_flights, 2);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 1152.0, exact_error);
+
+    stats = &(simulation._results.stats_by_type[1]);
+    EXPECT_EQ(stats->total_num_flights, 4);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 1200.0, exact_error);
+
+    stats = &(simulation._results.stats_by_type[2]);
+    EXPECT_EQ(stats->total_num_flights, 3);
+    EXPECT_NEAR(stats->total_num_passenger_miles, 672.0, exact_error);
+
+    // Now a full fleet, which has to wait in line for chargers
+    for (Fault_model fault_model : {Fault_model::PER_STEP_BERNOULLI, Fault_model::POISSON})
+    {
+        Scenario scenario;
+        // clang-format off
+        scenario.vehicle_types.push_back({"Alpha",    120, 320, 0.6,  1.6, 4, 0.25});
+        scenario.vehicle_types.push_back({"Delta",    90,  120, 0.62, 0.8, 2, 0.22});
+        scenario.vehicle_types.push_back({"Echo",     30,  150, 0.3,  5.8, 2, 0.61});
+        // clang-format on
+        scenario.options.engine = Engine::STEPPED_SOA;
+        scenario.options.fault_model = fault_model;
+        scenario.options.seed = 5;
+        scenario.options.print_progress = false;
+
+        std::unique_ptr<Simulation> fleet_simulation = make_simulation(scenario);
+        ASSERT_NE(fleet_simulation, nullptr);
+        fleet_simulation->run();
+
+        uint32_t total_num_times_waiting = 0;
+        for (const Vehicle& vehicle : fleet_simulation->_vehicles)
+        {
+            const Vehicle_stats& vehicle_stats = vehicle.stats;
+            EXPECT_NEAR(
+                vehicle_stats.flight_time_hrs + vehicle_stats.wait_time_hrs
+                    + vehicle_stats.charge_time_hrs,
+                simulation_duration_hrs,
+                1e-9);
+            total_num_times_waiting += vehicle_stats.num_times_waiting;
+        }
+        EXPECT_GT(total_num_times_waiting, 0);
+    }
+}
+
+/// Settings from `main()` arguments must be applied in order, and invalid scenarios rejected
+TEST(Config, ParseArgs)
+{
+    {
+        const char* argv[] = {
+            "evtol_simulation",
+            "--num_chargers",
+            "7",
+            "--num_vehicles=1000",
+            "--engine",
+            "event_driven",
+            "--fault_model=poisson",
+            "--seed",
+            "123",
+            "--simulation_step_size_sec",
+            "10",
+            "--vehicle_type",
+            "Zulu 100 200 0.5 1.0 3 0.1",
+        };
+        Program_config config;
+        ASSERT_TRUE(parse_args(sizeof(argv) / sizeof(argv[0]), argv, &config));
+
+        EXPECT_EQ(config.scenario.num_chargers, 7);
+        EXPECT_EQ(config.scenario.num_vehicles, 1000);
+        EXPECT_EQ(config.scenario.options.engine, Engine::EVENT_DRIVEN);
+        EXPECT_EQ(config.scenario.options.fault_model, Fault_model::POISSON);
+        EXPECT_EQ(config.scenario.options.seed, 123);
+        EXPECT_EQ(config.monte_carlo.base_seed, 123);
+        EXPECT_DOUBLE_EQ(config.scenario.simulation_step_size_hrs, 10.0 / SECONDS_PER_HR);
+        // the given vehicle type replaces the defaults
+        ASSERT_EQ(config.scenario.vehicle_types.size(), 1);
+        EXPECT_EQ(config.scenario.vehicle_types[0].name, "Zulu");
+        EXPECT_EQ(config.scenario.vehicle_types[0].passengers_per_vehicle, 3);
+    }
+
+    {
+        // no vehicle types given, so fall back to the defaults
+        const char* argv[] = {"evtol_simulation"};
+        Program_config config;
+        ASSERT_TRUE(parse_args(1, argv, &config));
+        EXPECT_EQ(config.scenario.vehicle_types.size(), 5);
+        EXPECT_EQ(config.scenario.num_vehicles, NUM_VEHICLES);
+        // only the single run is made, unless a Monte Carlo batch is asked for
+        EXPECT_TRUE(config.single_run);
+        EXPECT_EQ(config.monte_carlo.num_replications, 0);
+    }
+
+    // Each of these must be rejected
+    std::vector<std::vector<const char*>> invalid_argvs = {
+        {"evtol_simulation", "--num_chargers", "-1"},
+        {"evtol_simulation", "--num_chargers", "3x"},
+        {"evtol_simulation", "--engine", "warp_drive"},
+        {"evtol_simulation", "--unknown_key", "1"},
+        {"evtol_simulation", "--num_vehicles"},
+        {"evtol_simulation", "--simulation_duration_hrs", "0"},
+        {"evtol_simulation", "--simulation_step_size_hrs", "5"},
+        {"evtol_simulation", "--scenario", "does/not/exist.scenario"},
+        // zero cruise speed or time to charge would produce infinite derived values
+        {"evtol_simulation", "--vehicle_type", "Zulu 0 200 0.5 1.0 3 0.1"},
+        {"evtol_simulation", "--vehicle_type", "Zulu 100 200 0 1.0 3 0.1"},
+        {"evtol_simulation", "--vehicle_type", "Zulu 100 200 0.5 1.0 3"},
+        // a full flight of far more 1 second time steps than can be counted
+        {"evtol_simulation", "--vehicle_type", "Zulu 100 1e12 0.5 1.0 3 0.1"},
+        {"evtol_simulation",
+         "--vehicle_type",
+         "Zulu 100 200 0.5 1.0 3 0.1",
+         "--vehicle_type",
+         "Zulu 100 200 0.5 1.0 3 0.1"},
+        // a sweep with no replications to run at each grid point
+        {"evtol_simulation", "--sweep_num_chargers", "1:3"},
+    };
+    for (const std::vector<const char*>& argv : invalid_argvs)
+    {
+        Program_config config;
+        EXPECT_FALSE(parse_args(argv.size(), argv.data(), &config)) << argv[1];
+    }
+}
+
+/// A sweep must run every grid point, stop grid points early once precise enough, and be
+/// independent of the number of threads
+TEST(Sweep, GridAndEarlyStopping)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+
+    Sweep_grid grid;
+    grid.num_chargers = {1, 3, 20};
+    grid.fleet_mixes = {{1, 1, 1, 1, 1}, {1, 0, 0, 0, 0}};
+    grid.batch_size = 50;
+    grid.target_relative_ci = 0.02;
+
+    Monte_carlo_config config;
+    config.num_replications = 1000;
+    config.base_seed = 7;
+
+    config.num_threads = 1;
+    std::vector<Sweep_point> points_1_thread = run_sweep(scenario, grid, config);
+    config.num_threads = 3;
+    std::vector<Sweep_point> points_3_threads = run_sweep(scenario, grid, config);
+
+    ASSERT_EQ(points_1_thread.size(), 6);
+    ASSERT_EQ(points_3_threads.size(), 6);
+    for (size_t i = 0; i < points_1_thread.size(); i++)
+    {
+        const Sweep_point& point = points_1_thread[i];
+        EXPECT_EQ(point.results.num_replications, points_3_threads[i].results.num_replications);
+        EXPECT_EQ(
+            point.results.total_num_passenger_miles.mean(),
+            points_3_threads[i].results.total_num_passenger_miles.mean());
+
+        // whole batches only, and never more than the maximum
+        EXPECT_EQ(point.results.num_replications % grid.batch_size, 0);
+        EXPECT_LE(point.results.num_replications, config.num_replications);
+        if (point.converged)
+        {
+            EXPECT_LE(
+                point.results.total_num_passenger_miles.confidence_interval_half_width(),
+                grid.target_relative_ci * point.results.total_num_passenger_miles.mean());
+        }
+    }
+
+    // Grid order: fleet mix, then number of chargers
+    EXPECT_EQ(points_1_thread[0].scenario->num_chargers, 1);
+    EXPECT_EQ(points_1_thread[2].scenario->num_chargers, 20);
+    EXPECT_EQ(points_1_thread[3].scenario->fleet_mix, std::vector<double>({1, 0, 0, 0, 0}));
+
+    // An all-Alpha fleet with a charger per vehicle never waits, and each vehicle makes exactly
+    // 288 miles in 3 hrs, carrying 4 passengers: see `EventDrivenTrivialEndToEnd`
+    const Sweep_point& all_alpha = points_1_thread[5];
+    EXPECT_TRUE(all_alpha.converged);
+    EXPECT_EQ(all_alpha.results.total_wait_time_hrs.mean(), 0);
+    EXPECT_NEAR(
+        all_alpha.results.get(0, Vehicle_type_metric::TOTAL_DISTANCE_MILES).mean(),
+        288.0 * NUM_VEHICLES,
+        1e-6);
+    EXPECT_EQ(all_alpha.results.get(1, Vehicle_type_metric::NUM_VEHICLES).count(), 0);
+
+    // With small rounds, even a grid point with no variance at all runs the minimum number of
+    // replications before it stops
+    grid.num_chargers = {20};
+    grid.fleet_mixes = {{1, 0, 0, 0, 0}};
+    grid.batch_size = 2;
+    std::vector<Sweep_point> small_rounds = run_sweep(scenario, grid, config);
+    ASSERT_EQ(small_rounds.size(), 1);
+    EXPECT_TRUE(small_rounds[0].converged);
+    EXPECT_EQ(small_rounds[0].results.num_replications,
+              config.precision_targets.min_replications);
+}
+
+/// Each variance reduction mode must keep results reproducible, and do what it promises: stratified
+/// fleets give each type its share of the fleet, antithetic pairs share a seed and draw mirrored
+/// faults, and common random numbers give identical grid points identical results
+TEST(MonteCarlo, VarianceReduction)
+{
+    // An antithetic stream draws the complement of every draw of the usual one, even in children
+    Rng rng{11};
+    Rng antithetic_rng{11};
+    antithetic_rng.set_antithetic(true);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        EXPECT_EQ(rng() ^ antithetic_rng(), UINT64_MAX);
+    }
+    EXPECT_TRUE(antithetic_rng.split(3).antithetic());
+    EXPECT_EQ(rng.split(3)() ^ antithetic_rng.split(3)(), UINT64_MAX);
+
+    // Each sample of an antithetic pair is the pair's mean
+    Replication_stats pairs{2};
+    for (double value : {1.0, 3.0, 5.0, std::nan(""), 2.0, 2.0, 0.0, 4.0})
+    {
+        pairs.add(value);
+    }
+    EXPECT_EQ(pairs.count(), 7);
+    EXPECT_EQ(pairs.samples().count(), 3);
+    EXPECT_EQ(pairs.samples().mean(), 2);
+    EXPECT_EQ(pairs.confidence_interval_half_width(), 0);
+    EXPECT_EQ(pairs.effective_sample_size(), INFINITY);
+
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 20;
+    scenario.fleet_mix = {3, 1, 0, 0, 1};
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+    scenario.options.fault_model = Fault_model::POISSON;
+    scenario.options.fleet_sampling = Fleet_sampling::STRATIFIED;
+    scenario.options.print_progress = false;
+    for (uint64_t seed = 0; seed < 10; seed++)
+    {
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario, seed);
+        ASSERT_NE(simulation, nullptr);
+        std::vector<uint32_t> num_vehicles_by_type(scenario.vehicle_types.size(), 0);
+        for (const Vehicle& vehicle : simulation->vehicles())
+        {
+            num_vehicles_by_type[vehicle.i_type]++;
+        }
+        EXPECT_EQ(num_vehicles_by_type, std::vector<uint32_t>({12, 4, 0, 0, 4}));
+    }
+
+    // Antithetic pairs fly the same fleet, with mirrored faults, which mostly cancel out
+    Monte_carlo_config config;
+    config.num_replications = 400;
+    config.base_seed = 5;
+    config.antithetic = true;
+    bool antithetic_0 = true;
+    bool antithetic_1 = false;
+    EXPECT_EQ(replication_seed(config.base_seed, 6, true, &antithetic_0),
+              replication_seed(config.base_seed, 7, true, &antithetic_1));
+    EXPECT_FALSE(antithetic_0);
+    EXPECT_TRUE(antithetic_1);
+
+    config.num_threads = 1;
+    Monte_carlo_results results_1_thread = run_monte_carlo(scenario, config);
+    config.num_threads = 3;
+    Monte_carlo_results results_3_threads = run_monte_carlo(scenario, config);
+    const Vehicle_type_metric metric = Vehicle_type_metric::TOTAL_NUM_FAULTS;
+    const Replication_stats& faults = results_1_thread.get(0, metric);
+    EXPECT_EQ(faults.mean(), results_3_threads.get(0, metric).mean());
+    EXPECT_EQ(faults.samples().count(), config.num_replications / 2);
+    EXPECT_GT(faults.effective_sample_size(), config.num_replications);
+
+    // Common random numbers: grid points which differ only by chargers no vehicle ever waits for
+    // get identical results
+    Sweep_grid grid;
+    grid.num_chargers = {20, 25};
+    grid.batch_size = 20;
+    config.num_replications = 20;
+    config.common_random_numbers = true;
+    std::vector<Sweep_point> points = run_sweep(scenario, grid, config);
+    ASSERT_EQ(points.size(), 2);
+    EXPECT_EQ(points[0].results.total_num_faults.mean(),
+              points[1].results.total_num_faults.mean());
+    EXPECT_EQ(points[0].results.total_num_passenger_miles.mean(),
+              points[1].results.total_num_passenger_miles.mean());
+    config.common_random_numbers = false;
+    points = run_sweep(scenario, grid, config);
+    EXPECT_NE(points[0].results.total_num_faults.mean(),
+              points[1].results.total_num_faults.mean());
+}
+
+/// A Monte Carlo batch must stop after the first batch of replications which meets its precision
+/// targets, at the same point for any number of threads, or once its time budget is spent
+TEST(MonteCarlo, SequentialStopping)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+
+    Monte_carlo_config config;
+    config.num_replications = 10000;
+    config.base_seed = 3;
+    config.batch_size = 20;
+    config.precision_targets.total_num_passenger_miles = 0.05;
+    config.precision_targets.total_wait_time_hrs = 0.1;
+
+    config.num_threads = 1;
+    Monte_carlo_results results_1_thread = run_monte_carlo(scenario, config);
+    config.num_threads = 3;
+    Monte_carlo_results results_3_threads = run_monte_carlo(scenario, config);
+
+    EXPECT_EQ(results_1_thread.stop_reason, Stop_reason::PRECISION_REACHED);
+    EXPECT_EQ(results_1_thread.num_replications, results_3_threads.num_replications);
+    EXPECT_EQ(results_1_thread.total_wait_time_hrs.mean(),
+              results_3_threads.total_wait_time_hrs.mean());
+    EXPECT_EQ(results_1_thread.num_replications % config.batch_size, 0);
+    EXPECT_LT(results_1_thread.num_replications, config.num_replications);
+    EXPECT_TRUE(results_1_thread.meets(config.precision_targets));
+    for (const Replication_stats* total :
+         {&results_1_thread.total_num_passenger_miles, &results_1_thread.total_wait_time_hrs})
+    {
+        EXPECT_LE(total->confidence_interval_half_width(), 0.1 * total->mean());
+    }
+
+    // The batch before must not have met the targets yet
+    config.num_replications = results_1_thread.num_replications - config.batch_size;
+    Monte_carlo_results one_batch_less = run_monte_carlo(scenario, config);
+    EXPECT_EQ(one_batch_less.stop_reason, Stop_reason::ALL_REPLICATIONS_RUN);
+    EXPECT_FALSE(one_batch_less.meets(config.precision_targets));
+
+    // Any time budget at all still runs a whole first batch
+    config.num_replications = 10000;
+    config.precision_targets = Precision_targets{};
+    config.time_budget_sec = 1e-9;
+    Monte_carlo_results out_of_time = run_monte_carlo(scenario, config);
+    EXPECT_EQ(out_of_time.stop_reason, Stop_reason::TIME_BUDGET_SPENT);
+    EXPECT_EQ(out_of_time.num_replications, config.batch_size);
+
+    // An odd batch size is rounded up, so that it never splits an antithetic pair
+    config.antithetic = true;
+    config.batch_size = 3;
+    Monte_carlo_results antithetic_out_of_time = run_monte_carlo(scenario, config);
+    EXPECT_EQ(antithetic_out_of_time.stop_reason, Stop_reason::TIME_BUDGET_SPENT);
+    EXPECT_EQ(antithetic_out_of_time.num_replications, 4);
+
+    // A small first batch can't stop on a precision target, even if its few independent samples
+    // happen to agree closely: without a minimum, base seed 1 stops after its first 2 pairs
+    config.base_seed = 1;
+    config.time_budget_sec = 0;
+    config.precision_targets.total_num_faults = 0.2;
+    Monte_carlo_results small_batches = run_monte_carlo(scenario, config);
+    EXPECT_EQ(small_batches.stop_reason, Stop_reason::PRECISION_REACHED);
+    EXPECT_GE(small_batches.num_replications, config.precision_targets.min_replications);
+    config.num_replications = 4;
+    Monte_carlo_results one_small_batch = run_monte_carlo(scenario, config);
+    EXPECT_EQ(one_small_batch.stop_reason, Stop_reason::ALL_REPLICATIONS_RUN);
+    EXPECT_FALSE(one_small_batch.meets(config.precision_targets));
+}
+
+/// Check the order vehicles leave the charger line in, under each policy, including across the
+/// FIFO ring buffer wrapping around and growing
+TEST(ChargerQueue, PolicyOrder)
+{
+    Charger_queue fifo{Charger_queue_policy::FIFO};
+    uint32_t i_vehicle = 0;
+    uint32_t i_next_in = 0;
+    uint32_t i_next_out = 0;
+
+    // Interleave pushes and pops so that the ring wraps before it grows
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        fifo.push(i_next_in++);
+        fifo.push(i_next_in++);
+        ASSERT_TRUE(fifo.pop(&i_vehicle));
+        EXPECT_EQ(i_vehicle, i_next_out++);
+    }
+    EXPECT_EQ(fifo.size(), 100);
+    while (fifo.pop(&i_vehicle))
+    {
+        EXPECT_EQ(i_vehicle, i_next_out++);
+    }
+    EXPECT_EQ(i_next_out, i_next_in);
+    EXPECT_TRUE(fifo.empty());
+
+    // Lowest key first; FIFO among equal keys
+    Charger_queue priority{Charger_queue_policy::SHORTEST_CHARGE_FIRST};
+    priority.push(0, 0.6);
+    priority.push(1, 0.2);
+    priority.push(2, 0.8);
+    priority.push(3, 0.2);
+    priority.push(4, 0.6);
+    std::vector<uint32_t> order;
+    while (priority.pop(&i_vehicle))
+    {
+        order.push_back(i_vehicle);
+    }
+    EXPECT_EQ(order, std::vector<uint32_t>({1, 3, 0, 4, 2}));
+}
+
+/// A charger site must start each session on its most powerful free charger, share a capped
+/// site's power per its load shedding policy, and end a session when its charger goes out
+TEST(ChargerSite, SharesCappedPower)
+{
+    Charger_site_config config;
+    config.charger_power_kw = {100, 150, 50};
+    config.site_power_cap_kw = 150;
+    config.outages.push_back({1, 0.5, 1.0});
+    ASSERT_TRUE(config.is_valid());
+
+    for (Load_shedding_policy policy :
+         {Load_shedding_policy::PROPORTIONAL, Load_shedding_policy::FIRST_COME_FIRST_SERVED})
+    {
+        config.load_shedding_policy = policy;
+        Charger_site site;
+        site.init(config, 0.25);
+        std::string message = std::string("policy = ") + load_shedding_policy_name(policy);
+
+        ASSERT_EQ(site.schedule().size(), 2) << message;
+        EXPECT_EQ(site.schedule()[0].step, 2) << message;
+        EXPECT_EQ(site.schedule()[1].step, 4) << message;
+
+        // vehicles 7, 8 and 9 can each take 80 kW, and each need 40 kWh
+        std::vector<uint32_t> i_chargers(3);
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            ASSERT_TRUE(site.start_session(7 + i, 80, 40, &i_chargers[i])) << message;
+        }
+        EXPECT_EQ(i_chargers, std::vector<uint32_t>({1, 0, 2})) << message;
+        uint32_t i_charger;
+        EXPECT_FALSE(site.start_session(10, 80, 40, &i_charger)) << message;
+        EXPECT_FALSE(site.has_free_charger()) << message;
+
+        // 80 + 80 + 50 kW wanted, but only 150 kW allowed
+        std::vector<uint32_t> changed;
+        site.allocate_power(&changed);
+        double total_power_kw = 0;
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            total_power_kw += site.charger(i).power_kw;
+        }
+        EXPECT_NEAR(total_power_kw, 150, 1e-9) << message;
+        if (policy == Load_shedding_policy::PROPORTIONAL)
+        {
+            EXPECT_EQ(changed.size(), 3) << message;
+            EXPECT_NEAR(site.charger(1).power_kw, 80 * 150.0 / 210, 1e-9) << message;
+            EXPECT_NEAR(site.charger(2).power_kw, 50 * 150.0 / 210, 1e-9) << message;
+        }
+        else
+        {
+            // in the order the sessions started; the last one gets no power at all, so is
+            // unchanged
+            EXPECT_EQ(changed, std::vector<uint32_t>({1, 0})) << message;
+            EXPECT_EQ(site.charger(1).power_kw, 80) << message;
+            EXPECT_EQ(site.charger(0).power_kw, 70) << message;
+            EXPECT_EQ(site.charger(2).power_kw, 0) << message;
+        }
+
+        // charger 1 goes out half an hour in, under vehicle 7
+        site.advance(0.5);
+        uint32_t i_vehicle;
+        double energy_remaining_kwh;
+        ASSERT_TRUE(site.apply(site.schedule()[0], &i_vehicle, &energy_remaining_kwh)) << message;
+        EXPECT_EQ(i_vehicle, 7) << message;
+        double power_kw = policy == Load_shedding_policy::PROPORTIONAL ? 80 * 150.0 / 210 : 80;
+        EXPECT_NEAR(energy_remaining_kwh, 40 - 0.5 * power_kw, 1e-9) << message;
+        EXPECT_FALSE(site.charger(1).in_use()) << message;
+        EXPECT_FALSE(site.has_free_charger()) << message;
+
+        // the remaining 2 sessions want 130 kW, which the cap now allows
+        changed.clear();
+        site.allocate_power(&changed);
+        EXPECT_EQ(site.charger(0).power_kw, 80) << message;
+        EXPECT_EQ(site.charger(2).power_kw, 50) << message;
+
+        site.end_session(0);
+        EXPECT_TRUE(site.has_free_charger()) << message;
+        EXPECT_FALSE(site.charger(1).in_service()) << message;
+        EXPECT_FALSE(site.apply(site.schedule()[1], &i_vehicle, &energy_remaining_kwh))
+            << message;
+        EXPECT_TRUE(site.charger(1).in_service()) << message;
+        ASSERT_TRUE(site.start_session(7, 80, 20, &i_charger)) << message;
+        EXPECT_EQ(i_charger, 1) << message;
+    }
+}
+
+/// The event-driven engine must model a charger site with fast, uncapped, always-working chargers
+/// exactly like the same number of plain chargers, slow charges down under a site power cap, and
+/// charge nothing while every charger is out
+TEST(Simulation, ChargerSiteEventDriven)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 30;
+    scenario.num_chargers = 3;
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+    scenario.options.print_progress = false;
+
+    std::unique_ptr<Simulation> plain = make_simulation(scenario, 4);
+    ASSERT_NE(plain, nullptr);
+    plain->run();
+
+    scenario.options.charger_site.charger_power_kw = {1e6, 1e6, 1e6};
+    ASSERT_TRUE(is_valid(scenario));
+    std::unique_ptr<Simulation> site = make_simulation(scenario, 4);
+    ASSERT_NE(site, nullptr);
+    site->run();
+
+    for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+    {
+        const Vehicle_type_stats& stats = site->results().stats_by_type[i];
+        const Vehicle_type_stats& plain_stats = plain->results().stats_by_type[i];
+        EXPECT_EQ(stats.total_num_flights, plain_stats.total_num_flights);
+        EXPECT_EQ(stats.total_num_charges, plain_stats.total_num_charges);
+        EXPECT_EQ(stats.total_num_times_waiting, plain_stats.total_num_times_waiting);
+        EXPECT_DOUBLE_EQ(stats.total_wait_time_hrs, plain_stats.total_wait_time_hrs);
+        EXPECT_DOUBLE_EQ(stats.total_charge_time_hrs, plain_stats.total_charge_time_hrs);
+        EXPECT_DOUBLE_EQ(stats.total_distance_miles, plain_stats.total_distance_miles);
+    }
+
+    // Every charger out for the whole simulation: nobody ever charges
+    for (uint32_t i_charger = 0; i_charger < 3; i_charger++)
+    {
+        scenario.options.charger_site.outages.push_back({i_charger, 0, 100});
+    }
+    std::unique_ptr<Simulation> out = make_simulation(scenario, 4);
+    ASSERT_NE(out, nullptr);
+    out->run();
+    for (size_t i = 0; i < out->vehicle_types().size(); i++)
+    {
+        const Vehicle_type_stats& stats = out->results().stats_by_type[i];
+        EXPECT_EQ(stats.total_num_charges, 0) << out->vehicle_types()[i].name;
+        EXPECT_EQ(stats.total_charge_time_hrs, 0) << out->vehicle_types()[i].name;
+    }
+
+    // One vehicle, capped at half its charge power, charges in twice the time
+    Scenario capped;
+    capped.vehicle_types.push_back({"Alpha", 120, 320, 0.6, 1.6, 4, 0});
+    capped.num_vehicles = 1;
+    capped.num_chargers = 1;
+    capped.simulation_duration_hrs = 3.0;
+    capped.options.engine = Engine::EVENT_DRIVEN;
+    capped.options.print_progress = false;
+    capped.options.charger_site.charger_power_kw = {1000};
+    capped.options.charger_site.site_power_cap_kw = 320 / 0.6 / 2;
+    ASSERT_TRUE(is_valid(capped));
+    std::unique_ptr<Simulation> slow = make_simulation(capped, 1);
+    ASSERT_NE(slow, nullptr);
+    slow->run();
+    const Vehicle_type_stats& stats = slow->results().stats_by_type[0];
+    EXPECT_EQ(stats.total_num_charges, 1);
+    EXPECT_NEAR(stats.total_charge_time_hrs, 1.2, capped.simulation_step_size_hrs);
+    EXPECT_EQ(stats.total_num_flights, 2);
+}
+
+/// Every flight in a network must take its route's distance at the vehicle type's cruise speed, use
+/// only that distance's energy, and charge back to full from there
+TEST(Network, FlightsFollowRoutes)
+{
+    Scenario scenario;
+    // Alpha only
+    scenario.vehicle_types.push_back(default_vehicle_types()[0]);
+    scenario.num_vehicles = 1;
+    scenario.simulation_duration_hrs = 2.0;
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+    scenario.options.seed = 22;
+    scenario.options.print_progress = false;
+    scenario.options.network.vertiports = {{"a", 1, {}}, {"b", 1, {}}};
+    scenario.options.network.routes = {{"a", "b", 60}};
+    scenario.num_chargers = scenario.options.network.num_chargers();
+    ASSERT_TRUE(is_valid(scenario));
+
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+    ASSERT_NE(simulation, nullptr);
+    simulation->run();
+
+    // Alpha flies the 60 miles in 0.5 hrs, using 96 of its 320 kWh, which takes 0.18 hrs to charge
+    // back. So it flies 3 times, and is 0.14 hrs into its third charge when the simulation ends.
+    const Vehicle_stats& stats = simulation->vehicles()[0].stats;
+    const double allowed_error = scenario.simulation_step_size_hrs;
+    EXPECT_EQ(stats.num_flights, 3);
+    EXPECT_EQ(stats.num_charges, 3);
+    EXPECT_EQ(stats.state, Vehicle_state::CHARGING);
+    EXPECT_NEAR(stats.flight_time_hrs, 1.5, 1e-9);
+    EXPECT_NEAR(stats.distance_miles, 180, 1e-6);
+    EXPECT_NEAR(stats.charge_time_hrs, 0.5, allowed_error);
+    // the energy actually delivered during the last 0.14 hrs, not a charge from empty
+    EXPECT_NEAR(stats.battery_state_of_charge_kwh,
+                224 + 0.14 * 320 / 0.6,
+                allowed_error * 320 / 0.6);
+    for (const Vertiport_stats& vertiport_stats : simulation->vertiport_stats())
+    {
+        EXPECT_GT(vertiport_stats.num_arrivals, 0);
+    }
+
+    // Every route must be flyable by every vehicle type, and vehicles may only fly routes
+    Scenario too_far = scenario;
+    too_far.options.network.routes[0].distance_miles = 201;
+    EXPECT_FALSE(is_valid(too_far));
+    Scenario no_route = scenario;
+    no_route.options.network.routes.clear();
+    EXPECT_FALSE(is_valid(no_route));
+    Scenario weight_without_route = scenario;
+    weight_without_route.options.network.vertiports.push_back({"c", 1, {}});
+    weight_without_route.options.network.vertiports[0].route_weights = {0, 1, 1};
+    weight_without_route.options.network.routes.push_back({"b", "c", 10});
+    weight_without_route.num_chargers = weight_without_route.options.network.num_chargers();
+    EXPECT_FALSE(is_valid(weight_without_route));
+    weight_without_route.options.network.vertiports[0].route_weights = {0, 1, 0};
+    EXPECT_TRUE(is_valid(weight_without_route));
+}
+
+/// A network runs each vertiport as its own partition, so its results must not depend on the number
+/// of threads, and every charge and wait must be at some vertiport
+TEST(Network, PartitionsMatchAcrossThreadCounts)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 40;
+    scenario.simulation_duration_hrs = 4.0;
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+    scenario.options.seed = 7;
+    scenario.options.print_progress = false;
+    scenario.options.network.vertiports = {
+        {"north", 1, {}}, {"south", 2, {}}, {"hub", 3, {1, 1, 0}}};
+    scenario.options.network.routes = {
+        {"north", "south", 20}, {"hub", "north", 12}, {"south", "hub", 15}};
+    scenario.num_chargers = scenario.options.network.num_chargers();
+    ASSERT_TRUE(is_valid(scenario));
+
+    std::vector<std::unique_ptr<Simulation>> simulations;
+    for (uint32_t num_threads : {1, 4})
+    {
+        scenario.options.num_threads = num_threads;
+        simulations.push_back(make_simulation(scenario));
+        ASSERT_NE(simulations.back(), nullptr);
+        simulations.back()->run();
+    }
+
+    uint32_t total_num_charges = 0;
+    uint32_t total_num_times_waiting = 0;
+    for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+    {
+        const Vehicle_type_stats& serial_stats = simulations[0]->results().stats_by_type[i];
+        const Vehicle_type_stats& stats = simulations[1]->results().stats_by_type[i];
+        total_num_charges += serial_stats.total_num_charges;
+        total_num_times_waiting += serial_stats.total_num_times_waiting;
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            Vehicle_type_metric metric = (Vehicle_type_metric)i_metric;
+            double value = metric_value(stats, metric);
+            double serial_value = metric_value(serial_stats, metric);
+            // averages over 0 sessions are NaN, which never compares equal
+            if (std::isnan(value) && std::isnan(serial_value))
+            {
+                continue;
+            }
+            EXPECT_EQ(value, serial_value)
+                << "i = " << i << ", metric = " << metric_name(metric) << "\n";
+        }
+    }
+
+    const std::vector<Vertiport_stats>& vertiport_stats = simulations[0]->vertiport_stats();
+    ASSERT_EQ(vertiport_stats.size(), 3);
+    uint32_t num_charges = 0;
+    uint32_t num_times_waiting = 0;
+    for (size_t i_vertiport = 0; i_vertiport < vertiport_stats.size(); i_vertiport++)
+    {
+        const Vertiport_stats& stats = vertiport_stats[i_vertiport];
+        const Vertiport_stats& parallel_stats = simulations[1]->vertiport_stats()[i_vertiport];
+        EXPECT_EQ(stats.num_arrivals, parallel_stats.num_arrivals);
+        EXPECT_EQ(stats.num_charges, parallel_stats.num_charges);
+        EXPECT_EQ(stats.wait_time_hrs, parallel_stats.wait_time_hrs);
+        // every vehicle which landed charged, or is still waiting
+        EXPECT_LE(stats.num_charges, stats.num_arrivals);
+        EXPECT_LE(stats.num_arrivals - stats.num_charges, stats.max_num_waiting);
+        num_charges += stats.num_charges;
+        num_times_waiting += stats.num_times_waiting;
+    }
+    EXPECT_EQ(num_charges, total_num_charges);
+    EXPECT_EQ(num_times_waiting, total_num_times_waiting);
+
+    // Make sure the test covers vehicles waiting in line
+    EXPECT_GT(total_num_times_waiting, 0);
+}
+
+/// With more vehicles than chargers, the stepped engine must hand each released charger directly
+/// to a waiting vehicle: every vehicle spends the whole simulation either flying, waiting, or
+/// charging, and the single charger is never in use by more than 1 vehicle at a time
+TEST(Simulation, ChargerLineHandsOffChargers)
+{
+    constexpr uint32_t num_chargers = 1;
+    constexpr double simulation_duration_hrs = 3.0;
+    constexpr double simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+
+    for (Charger_queue_policy policy : {Charger_queue_policy::FIFO,
+                                        Charger_queue_policy::LOWEST_RANGE_FIRST,
+                                        Charger_queue_policy::SHORTEST_CHARGE_FIRST})
+    {
+        Simulation_options options;
+        options.charger_queue_policy = policy;
+        options.print_progress = false;
+        Simulation simulation{
+            num_chargers, simulation_duration_hrs, simulation_step_size_hrs, options};
+
+        // clang-format off
+        simulation.add_vehicle_type({"Alpha",    120, 320, 0.6,  1.6, 4, 0});
+        simulation.add_vehicle_type({"Bravo",    100, 100, 0.2,  1.5, 5, 0});
+        simulation.add_vehicle_type({"Charlie",  160, 220, 0.8,  2.2, 3, 0});
+        // clang-format on
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            simulation._vehicles.emplace_back(Vehicle{0, simulation._vehicle_types[0]});
+            simulation._vehicles.emplace_back(Vehicle{1, simulation._vehicle_types[1]});
+            simulation._vehicles.emplace_back(Vehicle{2, simulation._vehicle_types[2]});
+        }
+
+        simulation.run();
+
+        double total_time_hrs = 0;
+        double total_charge_time_hrs = 0;
+        uint32_t total_num_times_waiting = 0;
+        for (const Vehicle_type_stats& type_stats : simulation._results.stats_by_type)
+        {
+            total_time_hrs += type_stats.total_flight_time_hrs + type_stats.total_wait_time_hrs
+                              + type_stats.total_charge_time_hrs;
+            total_charge_time_hrs += type_stats.total_charge_time_hrs;
+            total_num_times_waiting += type_stats.total_num_times_waiting;
+        }
+
+        EXPECT_NEAR(total_time_hrs, simulation._vehicles.size() * simulation_duration_hrs, 1e-6);
+        EXPECT_LE(total_charge_time_hrs, num_chargers * simulation_duration_hrs + 1e-6);
+        EXPECT_GT(total_num_times_waiting, 0);
+    }
+}
+
+/// A vehicle handed a charger waits out the time step it was handed it in, and starts charging
+/// at the end of it, in every engine, whichever of the two vehicles comes first in the fleet, so
+/// that a charger never serves two vehicles during the same time step
+TEST(Simulation, ChargerHandOffMatchesAcrossEngines)
+{
+    // 2 of the same vehicle type sharing 1 charger, and a full fleet sharing a few
+    std::vector<Scenario> scenarios(2);
+    scenarios[0].vehicle_types.push_back({"Bravo", 100, 100, 0.2, 1.5, 5, 0.10});
+    scenarios[0].num_vehicles = 2;
+    scenarios[0].num_chargers = 1;
+    scenarios[0].simulation_duration_hrs = 1.0;
+    scenarios[1].vehicle_types = default_vehicle_types();
+
+    // Seeds 5, 221 and 229 have a vehicle's battery empty in the same step as a higher-indexed
+    // vehicle finishes charging, with no other charger free: it must take the freed charger
+    // without waiting in line
+    for (uint64_t seed : {5, 8, 221, 229})
+    {
+        for (Fault_model fault_model : {Fault_model::PER_STEP_BERNOULLI, Fault_model::POISSON})
+        {
+            for (size_t i_scenario = 0; i_scenario < scenarios.size(); i_scenario++)
+            {
+                Scenario& scenario = scenarios[i_scenario];
+                scenario.simulation_step_size_hrs = 1.0 / (double)SECONDS_PER_HR;
+                scenario.options.seed = seed;
+                scenario.options.fault_model = fault_model;
+                scenario.options.print_progress = false;
+
+                std::vector<std::unique_ptr<Simulation>> simulations;
+                for (Engine engine : {Engine::EVENT_DRIVEN, Engine::STEPPED, Engine::STEPPED_SOA})
+                {
+                    scenario.options.engine = engine;
+                    simulations.push_back(make_simulation(scenario));
+                    ASSERT_NE(simulations.back(), nullptr);
+                    simulations.back()->run();
+                }
+
+                uint32_t total_num_times_waiting = 0;
+                for (size_t i_simulation = 1; i_simulation < simulations.size(); i_simulation++)
+                {
+                    for (size_t i = 0; i < scenario.num_vehicles; i++)
+                    {
+                        const Vehicle_stats& expected = simulations[0]->vehicles()[i].stats;
+                        const Vehicle_stats& stats = simulations[i_simulation]->vehicles()[i].stats;
+                        std::string message = "seed = " + std::to_string(seed)
+                                              + ", fault_model = " + fault_model_name(fault_model)
+                                              + ", i_scenario = " + std::to_string(i_scenario)
+                                              + ", i_simulation = " + std::to_string(i_simulation)
+                                              + ", i = " + std::to_string(i);
+
+                        EXPECT_EQ(stats.num_flights, expected.num_flights) << message;
+                        EXPECT_EQ(stats.num_charges, expected.num_charges) << message;
+                        EXPECT_EQ(stats.num_times_waiting, expected.num_times_waiting) << message;
+                        EXPECT_EQ(stats.state, expected.state) << message;
+                        EXPECT_NEAR(stats.flight_time_hrs, expected.flight_time_hrs, 1e-9)
+                            << message;
+                        EXPECT_NEAR(stats.wait_time_hrs, expected.wait_time_hrs, 1e-9) << message;
+                        EXPECT_NEAR(stats.charge_time_hrs, expected.charge_time_hrs, 1e-9)
+                            << message;
+                        total_num_times_waiting += stats.num_times_waiting;
+                    }
+                }
+
+                // Make sure the test covers vehicles waiting in line
+                EXPECT_GT(total_num_times_waiting, 0);
+            }
+        }
+    }
+}
+
+/// Stepping one large `STEPPED_SOA` simulation across many threads must give bit-for-bit identical
+/// results to stepping it on 1 thread, including which vehicles wait for which chargers
+TEST(Simulation, SoaParallelMatchesSerial)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 3 * FLEET_SOA_CHUNK_SIZE + 123;
+    scenario.num_chargers = 100;
+    scenario.simulation_duration_hrs = 1.0;
+    scenario.simulation_step_size_hrs = 10.0 / (double)SECONDS_PER_HR;
+    scenario.options.engine = Engine::STEPPED_SOA;
+    scenario.options.seed = 2024;
+    scenario.options.print_progress = false;
+
+    std::vector<std::unique_ptr<Simulation>> simulations;
+    for (uint32_t num_threads : {1, 2, 5})
+    {
+        scenario.options.num_threads = num_threads;
+        simulations.push_back(make_simulation(scenario));
+        ASSERT_NE(simulations.back(), nullptr);
+        simulations.back()->run();
+    }
+
+    double total_wait_time_hrs = 0;
+    for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+    {
+        const Vehicle_type_stats& serial_stats = simulations[0]->results().stats_by_type[i];
+        total_wait_time_hrs += serial_stats.total_wait_time_hrs;
+
+        for (size_t i_simulation = 1; i_simulation < simulations.size(); i_simulation++)
+        {
+            const Vehicle_type_stats& stats = simulations[i_simulation]->results().stats_by_type[i];
+            for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+            {
+                Vehicle_type_metric metric = (Vehicle_type_metric)i_metric;
+                double value = metric_value(stats, metric);
+                double serial_value = metric_value(serial_stats, metric);
+                // averages over 0 sessions are NaN, which never compares equal
+                if (std::isnan(value) && std::isnan(serial_value))
+                {
+                    continue;
+                }
+                EXPECT_EQ(value, serial_value)
+                    << "i = " << i << ", metric = " << metric_name(metric) << "\n";
+            }
+        }
+    }
+
+    // Make sure the test covers vehicles waiting in line
+    EXPECT_GT(total_wait_time_hrs, 0);
+}
+
+/// The kernels specialized for the default fleet must be chosen only for exactly that fleet and a
+/// matching step size, and must give bit-identical results to the runtime kernel
+TEST(Simulation, SoaSpecializedMatchesRuntime)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 2 * FLEET_SOA_CHUNK_SIZE + 7;
+    scenario.num_chargers = 100;
+    scenario.simulation_duration_hrs = 1.0;
+    scenario.options.engine = Engine::STEPPED_SOA;
+    scenario.options.fault_model = Fault_model::POISSON;
+    scenario.options.seed = 77;
+    scenario.options.print_progress = false;
+
+    // which fleets get a specialized kernel
+    {
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+        ASSERT_NE(simulation, nullptr);
+        Fleet_soa fleet;
+        fleet.load(simulation->vehicles(), simulation->vehicle_types(), SIMULATION_STEP_SIZE_HRS);
+        EXPECT_TRUE(fleet.is_specialized());
+        EXPECT_TRUE(fleet.num_steps_remaining.empty());
+        EXPECT_EQ(fleet.num_steps_remaining_16.size(), scenario.num_vehicles);
+        fleet.load(simulation->vehicles(),
+                   simulation->vehicle_types(),
+                   SIMULATION_STEP_SIZE_HRS,
+                   /*allow_specialized_kernel*/ false);
+        EXPECT_FALSE(fleet.is_specialized());
+        EXPECT_TRUE(fleet.num_steps_remaining_16.empty());
+        fleet.load(simulation->vehicles(), simulation->vehicle_types(), 2.0 / SECONDS_PER_HR);
+        EXPECT_FALSE(fleet.is_specialized());
+
+        Scenario other_scenario = scenario;
+        other_scenario.vehicle_types.pop_back();
+        std::unique_ptr<Simulation> other_simulation = make_simulation(other_scenario);
+        ASSERT_NE(other_simulation, nullptr);
+        fleet.load(other_simulation->vehicles(),
+                   other_simulation->vehicle_types(),
+                   SIMULATION_STEP_SIZE_HRS);
+        EXPECT_FALSE(fleet.is_specialized());
+    }
+
+    for (double step_size_sec : {1.0, 60.0})
+    {
+        scenario.simulation_step_size_hrs = step_size_sec / SECONDS_PER_HR;
+
+        std::vector<std::unique_ptr<Simulation>> simulations;
+        for (bool specialized_kernels : {false, true})
+        {
+            scenario.options.specialized_kernels = specialized_kernels;
+            simulations.push_back(make_simulation(scenario));
+            ASSERT_NE(simulations.back(), nullptr);
+            simulations.back()->run();
+        }
+
+        for (size_t i = 0; i < scenario.num_vehicles; i++)
+        {
+            const Vehicle_stats& runtime_stats = simulations[0]->vehicles()[i].stats;
+            const Vehicle_stats& stats = simulations[1]->vehicles()[i].stats;
+            ASSERT_EQ(stats.battery_state_of_charge_kwh, runtime_stats.battery_state_of_charge_kwh)
+                << "step_size_sec = " << step_size_sec << ", i = " << i << "\n";
+            ASSERT_EQ(stats.num_steps_remaining, runtime_stats.num_steps_remaining);
+            ASSERT_EQ(stats.flight_time_hrs, runtime_stats.flight_time_hrs);
+            ASSERT_EQ(stats.wait_time_hrs, runtime_stats.wait_time_hrs);
+            ASSERT_EQ(stats.charge_time_hrs, runtime_stats.charge_time_hrs);
+            ASSERT_EQ(stats.num_flights, runtime_stats.num_flights);
+            ASSERT_EQ(stats.num_charges, runtime_stats.num_charges);
+            ASSERT_EQ(stats.num_faults, runtime_stats.num_faults);
+        }
+    }
+}
+
+/// Fleets larger than `RESULTS_CHUNK_SIZE` are summed up by chunk, in parallel, and the chunks
+/// merged in order, so the results must be identical for any number of threads. Passenger miles
+/// must count each vehicle's miles once, no matter how many vehicles of its type there are.
+TEST(Simulation, ResultsMatchAcrossThreadCounts)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 2 * RESULTS_CHUNK_SIZE + 123;
+    scenario.num_chargers = 1000;
+    scenario.simulation_duration_hrs = 0.5;
+    scenario.simulation_step_size_hrs = 10.0 / (double)SECONDS_PER_HR;
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+    scenario.options.seed = 2025;
+    scenario.options.print_progress = false;
+
+    std::vector<std::unique_ptr<Simulation>> simulations;
+    for (uint32_t num_threads : {1, 3})
+    {
+        scenario.options.num_threads = num_threads;
+        simulations.push_back(make_simulation(scenario));
+        ASSERT_NE(simulations.back(), nullptr);
+        simulations.back()->run();
+    }
+
+    uint32_t num_vehicles = 0;
+    for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+    {
+        const Vehicle_type& vehicle_type = simulations[0]->vehicle_types()[i];
+        const Vehicle_type_stats& serial_stats = simulations[0]->results().stats_by_type[i];
+        num_vehicles += serial_stats.num_vehicles;
+        EXPECT_GT(serial_stats.num_vehicles, 1);
+        EXPECT_DOUBLE_EQ(serial_stats.total_num_passenger_miles,
+                         vehicle_type.passengers_per_vehicle * serial_stats.total_distance_miles);
+
+        const Vehicle_type_stats& stats = simulations[1]->results().stats_by_type[i];
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            Vehicle_type_metric metric = (Vehicle_type_metric)i_metric;
+            double value = metric_value(stats, metric);
+            double serial_value = metric_value(serial_stats, metric);
+            if (std::isnan(value) && std::isnan(serial_value))
+            {
+                continue;
+            }
+            EXPECT_EQ(value, serial_value)
+                << "i = " << i << ", metric = " << metric_name(metric) << "\n";
+        }
+        EXPECT_EQ(stats.distributions.wait_time_hrs.moments.count(),
+                  serial_stats.distributions.wait_time_hrs.moments.count());
+        EXPECT_EQ(stats.distributions.flight_time_hrs.moments.mean(),
+                  serial_stats.distributions.flight_time_hrs.moments.mean());
+    }
+    EXPECT_EQ(num_vehicles, scenario.num_vehicles);
+}
+
+/// With enough chargers that no vehicle ever waits, every engine quantizes each flight and charge
+/// to the same whole number of time steps, so all of them must give the same results, with no
+/// drift in the stepped engines over many flights and charges
+TEST(Simulation, SteppedEnginesMatchEventDriven)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 50;
+    scenario.num_chargers = scenario.num_vehicles;
+    scenario.simulation_duration_hrs = 24.0;
+    scenario.options.fault_model = Fault_model::POISSON;
+    scenario.options.seed = 16;
+    scenario.options.print_progress = false;
+
+    std::vector<std::unique_ptr<Simulation>> simulations;
+    for (Engine engine : {Engine::EVENT_DRIVEN, Engine::STEPPED, Engine::STEPPED_SOA})
+    {
+        scenario.options.engine = engine;
+        simulations.push_back(make_simulation(scenario));
+        ASSERT_NE(simulations.back(), nullptr);
+        simulations.back()->run();
+    }
+
+    for (size_t i_simulation = 1; i_simulation < simulations.size(); i_simulation++)
+    {
+        for (size_t i = 0; i < scenario.num_vehicles; i++)
+        {
+            const Vehicle_stats& expected = simulations[0]->vehicles()[i].stats;
+            const Vehicle_stats& stats = simulations[i_simulation]->vehicles()[i].stats;
+            std::string message =
+                "i_simulation = " + std::to_string(i_simulation) + ", i = " + std::to_string(i);
+
+            EXPECT_EQ(stats.num_flights, expected.num_flights) << message;
+            EXPECT_EQ(stats.num_charges, expected.num_charges) << message;
+            EXPECT_EQ(stats.num_times_waiting, 0) << message;
+            EXPECT_EQ(stats.num_faults, expected.num_faults) << message;
+            EXPECT_EQ(stats.state, expected.state) << message;
+            EXPECT_NEAR(stats.flight_time_hrs, expected.flight_time_hrs, 1e-9) << message;
+            EXPECT_NEAR(stats.charge_time_hrs, expected.charge_time_hrs, 1e-9) << message;
+            EXPECT_NEAR(stats.distance_miles, expected.distance_miles, 1e-6) << message;
+            EXPECT_NEAR(stats.battery_state_of_charge_kwh,
+                        expected.battery_state_of_charge_kwh,
+                        1e-6)
+                << message;
+        }
+    }
+}
+
+/// A trace must hold exactly the transitions and faults the simulation counted, in every engine,
+/// and tracing must not change the results
+TEST(Trace, RecordsMatchStats)
+{
+    const std::string trace_path = testing::TempDir() + "evtol_trace_test.bin";
+
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN, Engine::STEPPED_SOA})
+    {
+        Scenario scenario;
+        scenario.vehicle_types = default_vehicle_types();
+        scenario.options.engine = engine;
+        scenario.options.seed = 99;
+        scenario.options.print_progress = false;
+
+        std::unique_ptr<Simulation> untraced_simulation = make_simulation(scenario);
+        ASSERT_NE(untraced_simulation, nullptr);
+        untraced_simulation->run();
+
+        scenario.options.trace_path = trace_path;
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+        ASSERT_NE(simulation, nullptr);
+        simulation->run();
+
+        Trace_reader reader;
+        ASSERT_TRUE(reader.open(trace_path));
+        EXPECT_EQ(reader.header().num_vehicles, scenario.num_vehicles);
+        ASSERT_EQ(reader.vehicle_types().size(), scenario.vehicle_types.size());
+        EXPECT_STREQ(reader.vehicle_types()[0].name, "Alpha");
+
+        std::vector<Vehicle_type_stats> traced_stats(scenario.vehicle_types.size());
+        Trace_record record;
+        double last_state_change_time_hrs = 0;
+        while (reader.next(&record))
+        {
+            ASSERT_LT(record.i_vehicle_type, traced_stats.size());
+            Vehicle_type_stats& stats = traced_stats[record.i_vehicle_type];
+
+            switch ((Trace_event)record.event)
+            {
+            case Trace_event::INITIAL_STATE:
+                (stats.num_vehicles)++;
+                EXPECT_EQ(record.time_hrs, 0);
+                break;
+            case Trace_event::STATE_CHANGE:
+                // all state changes are traced serially, in time order
+                EXPECT_GE(record.time_hrs, last_state_change_time_hrs);
+                last_state_change_time_hrs = record.time_hrs;
+                EXPECT_NE(record.from_state, record.to_state);
+                break;
+            case Trace_event::FAULT:
+                (stats.total_num_faults)++;
+                EXPECT_LE(record.time_hrs, scenario.simulation_duration_hrs);
+                continue;
+            }
+
+            switch ((Vehicle_state)record.to_state)
+            {
+            case Vehicle_state::FLYING:
+                (stats.total_num_flights)++;
+                break;
+            case Vehicle_state::WAITING_FOR_CHARGER:
+                (stats.total_num_times_waiting)++;
+                break;
+            case Vehicle_state::CHARGING:
+                (stats.total_num_charges)++;
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+        {
+            const Vehicle_type_stats& stats = simulation->results().stats_by_type[i];
+            const Vehicle_type_stats& untraced_stats =
+                untraced_simulation->results().stats_by_type[i];
+            std::string message = std::string("engine = ") + engine_name(engine)
+                                  + ", i = " + std::to_string(i) + "\n";
+
+            EXPECT_EQ(traced_stats[i].num_vehicles, stats.num_vehicles) << message;
+            EXPECT_EQ(traced_stats[i].total_num_flights, stats.total_num_flights) << message;
+            EXPECT_EQ(traced_stats[i].total_num_times_waiting, stats.total_num_times_waiting)
+                << message;
+            EXPECT_EQ(traced_stats[i].total_num_charges, stats.total_num_charges) << message;
+            EXPECT_EQ(traced_stats[i].total_num_faults, stats.total_num_faults) << message;
+
+            EXPECT_EQ(stats.total_num_faults, untraced_stats.total_num_faults) << message;
+            EXPECT_EQ(stats.total_wait_time_hrs, untraced_stats.total_wait_time_hrs) << message;
+        }
+    }
+
+    std::remove(trace_path.c_str());
+}
+
+TEST(TraceAnalysis, ReplayMatchesStats)
+{
+    const std::string trace_path = testing::TempDir() + "evtol_trace_analysis_test.bin";
+
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN, Engine::STEPPED_SOA})
+    {
+        Scenario scenario;
+        scenario.vehicle_types = default_vehicle_types();
+        scenario.options.engine = engine;
+        scenario.options.seed = 7;
+        scenario.options.print_progress = false;
+        scenario.options.trace_path = trace_path;
+
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+        ASSERT_NE(simulation, nullptr);
+        simulation->run();
+
+        Trace_mapped_file trace;
+        ASSERT_TRUE(trace.open(trace_path));
+
+        Trace_analysis_config config;
+        config.num_threads = 1;
+        Trace_analysis analysis;
+        ASSERT_TRUE(analyze_trace(trace, config, &analysis));
+        ASSERT_EQ(analysis.stats_by_type.size(), scenario.vehicle_types.size());
+
+        std::string message = std::string("engine = ") + engine_name(engine) + "\n";
+        for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+        {
+            const Vehicle_type_stats& stats = simulation->results().stats_by_type[i];
+            const Vehicle_type_stats& replayed = analysis.stats_by_type[i];
+            EXPECT_EQ(analysis.vehicle_type_names[i], scenario.vehicle_types[i].name) << message;
+
+            EXPECT_EQ(replayed.num_vehicles, stats.num_vehicles) << message;
+            EXPECT_EQ(replayed.total_num_flights, stats.total_num_flights) << message;
+            EXPECT_EQ(replayed.total_num_times_waiting, stats.total_num_times_waiting)
+                << message;
+            EXPECT_EQ(replayed.total_num_charges, stats.total_num_charges) << message;
+            EXPECT_EQ(replayed.total_num_faults, stats.total_num_faults) << message;
+
+            EXPECT_NEAR(replayed.total_flight_time_hrs, stats.total_flight_time_hrs, 1e-6)
+                << message;
+            EXPECT_NEAR(replayed.total_distance_miles, stats.total_distance_miles, 1e-3)
+                << message;
+            // The stepped engine steps a vehicle handed a charger by a vehicle earlier in the
+            // fleet as charging within that same step, so may count up to 1 step of its wait as
+            // charge time instead, which the trace, at step boundaries, doesn't
+            double tolerance_hrs = 1e-6;
+            if (engine == Engine::STEPPED)
+            {
+                tolerance_hrs += stats.total_num_charges * scenario.simulation_step_size_hrs;
+            }
+            EXPECT_NEAR(replayed.total_wait_time_hrs, stats.total_wait_time_hrs, tolerance_hrs)
+                << message;
+            EXPECT_NEAR(replayed.total_charge_time_hrs, stats.total_charge_time_hrs, tolerance_hrs)
+                << message;
+            EXPECT_NEAR(replayed.total_wait_time_hrs + replayed.total_charge_time_hrs,
+                        stats.total_wait_time_hrs + stats.total_charge_time_hrs,
+                        1e-6)
+                << message;
+            EXPECT_NEAR(replayed.total_num_passenger_miles,
+                        stats.total_num_passenger_miles,
+                        1e-2)
+                << message;
+        }
+
+        for (double utilization : analysis.charger_utilization_by_bin)
+        {
+            EXPECT_RANGE(utilization, 0, 1 + 1e-9);
+        }
+        EXPECT_RANGE(analysis.avg_charger_utilization, 0, 1 + 1e-9);
+        EXPECT_LE(analysis.queue_length_percentile(0.5), analysis.queue_length_percentile(0.9));
+        EXPECT_LE(analysis.queue_length_percentile(0.9), analysis.queue_length_percentile(1));
+        EXPECT_LE(analysis.avg_queue_length, analysis.queue_length_percentile(1));
+
+        // Tiny chunks, scanned by several threads, must give exactly the same results
+        config.num_threads = 3;
+        config.num_records_per_chunk = 7;
+        Trace_analysis chunked_analysis;
+        ASSERT_TRUE(analyze_trace(trace, config, &chunked_analysis));
+        for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+        {
+            EXPECT_EQ(chunked_analysis.stats_by_type[i].total_num_flights,
+                      analysis.stats_by_type[i].total_num_flights)
+                << message;
+            EXPECT_NEAR(chunked_analysis.stats_by_type[i].total_wait_time_hrs,
+                        analysis.stats_by_type[i].total_wait_time_hrs,
+                        1e-6)
+                << message;
+        }
+        ASSERT_EQ(chunked_analysis.charger_utilization_by_bin.size(),
+                  analysis.charger_utilization_by_bin.size());
+        for (size_t i_bin = 0; i_bin < analysis.charger_utilization_by_bin.size(); i_bin++)
+        {
+            EXPECT_NEAR(chunked_analysis.charger_utilization_by_bin[i_bin],
+                        analysis.charger_utilization_by_bin[i_bin],
+                        1e-9)
+                << message;
+        }
+        EXPECT_NEAR(chunked_analysis.avg_queue_length, analysis.avg_queue_length, 1e-9)
+            << message;
+        EXPECT_EQ(chunked_analysis.queue_length_percentile(0.9),
+                  analysis.queue_length_percentile(0.9))
+            << message;
+    }
+
+    std::remove(trace_path.c_str());
+}
+
+TEST(Simulation, DistributionsMatchTotals)
+{
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN, Engine::STEPPED_SOA})
+    {
+        Scenario scenario;
+        scenario.vehicle_types = default_vehicle_types();
+        scenario.options.engine = engine;
+        scenario.options.seed = 5;
+        scenario.options.print_progress = false;
+
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+        ASSERT_NE(simulation, nullptr);
+        simulation->run();
+
+        std::string message = std::string("engine = ") + engine_name(engine) + "\n";
+        Monte_carlo_results results{simulation->vehicle_types()};
+        std::vector<Vehicle_type_stats> replication_stats;
+        for (size_t i_type = 0; i_type < simulation->vehicle_types().size(); i_type++)
+        {
+            const Vehicle_type& vehicle_type = simulation->vehicle_types()[i_type];
+            const Vehicle_type_stats& stats = simulation->results().stats_by_type[i_type];
+            const Vehicle_type_distributions& distributions = stats.distributions;
+            replication_stats.push_back(stats);
+
+            // Every stint is counted, even one cut short by the end of the simulation, so the
+            // distributions add up to the totals
+            const Running_stats& flights = distributions.flight_time_hrs.moments;
+            const Running_stats& waits = distributions.wait_time_hrs.moments;
+            const Running_stats& charges = distributions.charge_time_hrs.moments;
+            EXPECT_EQ(flights.count(), distributions.flight_time_hrs.quantiles.count());
+            EXPECT_EQ(flights.count(), distributions.flight_time_histogram.count());
+            EXPECT_EQ(distributions.flight_time_histogram.num_above(), 0) << message;
+
+            EXPECT_NEAR(flights.mean() * flights.count(), stats.total_flight_time_hrs, 1e-6)
+                << message;
+            EXPECT_NEAR(waits.mean() * waits.count() + charges.mean() * charges.count(),
+                        stats.total_wait_time_hrs + stats.total_charge_time_hrs,
+                        1e-6)
+                << message;
+            EXPECT_LE(flights.max(), vehicle_type.max_flight_time_hrs * 1.01) << message;
+            EXPECT_LE(distributions.wait_time_hrs.quantiles.quantile(0.5),
+                      distributions.wait_time_hrs.quantiles.quantile(0.99));
+        }
+
+        // Merging a replication twice doubles the counts, and leaves the extremes unchanged
+        results.add_replication(replication_stats);
+        results.add_replication(replication_stats);
+        for (size_t i = 0; i < replication_stats.size(); i++)
+        {
+            const Sample_distribution& single = replication_stats[i].distributions.wait_time_hrs;
+            const Sample_distribution& merged = results.distributions_by_type[i].wait_time_hrs;
+            EXPECT_EQ(merged.moments.count(), 2 * single.moments.count()) << message;
+            EXPECT_EQ(merged.quantiles.quantile(0), single.quantiles.quantile(0)) << message;
+            EXPECT_EQ(merged.quantiles.quantile(1), single.quantiles.quantile(1)) << message;
+        }
+    }
+}
+
+TEST(ResultsWriter, FormatsRoundTrip)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.options.seed = 3;
+    scenario.options.print_progress = false;
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+    ASSERT_NE(simulation, nullptr);
+    simulation->run();
+
+    // a name which needs quoting in both CSV and JSON
+    std::vector<std::string> names;
+    for (const Vehicle_type& vehicle_type : simulation->vehicle_types())
+    {
+        names.push_back(vehicle_type.name);
+    }
+    names[1] = "Br,a\"vo";
+
+    const std::vector<std::string>& field_names =
+        results_field_names(Results_table::VEHICLE_TYPE_STATS);
+    auto write_all = [&](const std::string& path, Results_format format) {
+        Results_writer writer;
+        ASSERT_TRUE(writer.open(path, format, Results_table::VEHICLE_TYPE_STATS, names));
+        for (uint32_t i_type = 0; i_type < names.size(); i_type++)
+        {
+            writer.write_vehicle_type_stats(7, i_type, simulation->results().stats_by_type[i_type]);
+        }
+        ASSERT_TRUE(writer.close());
+    };
+    auto read_lines = [](const std::string& path) {
+        std::ifstream file{path};
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            lines.push_back(line);
+        }
+        return lines;
+    };
+
+    // CSV: a header, then one row per vehicle type, with every number read back exactly
+    const std::string csv_path = testing::TempDir() + "evtol_results_test.csv";
+    write_all(csv_path, Results_format::CSV);
+    std::vector<std::string> lines = read_lines(csv_path);
+    ASSERT_EQ(lines.size(), names.size() + 1);
+    EXPECT_EQ(lines[0].rfind("replication,vehicle_type,avg_flight_time_per_flight_hrs,", 0), 0);
+    EXPECT_EQ(lines[2].rfind("7,\"Br,a\"\"vo\",", 0), 0);
+    {
+        std::istringstream row{lines[1]};
+        std::string field;
+        std::getline(row, field, ',');
+        EXPECT_EQ(field, "7");
+        std::getline(row, field, ',');
+        EXPECT_EQ(field, "Alpha");
+        const Vehicle_type_stats& stats = simulation->results().stats_by_type[0];
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            std::getline(row, field, ',');
+            EXPECT_EQ(strtod(field.c_str(), nullptr),
+                      metric_value(stats, (Vehicle_type_metric)i_metric))
+                << field_names[i_metric];
+        }
+    }
+
+    // JSON lines: one object per vehicle type
+    const std::string jsonl_path = testing::TempDir() + "evtol_results_test.jsonl";
+    write_all(jsonl_path, Results_format::JSONL);
+    lines = read_lines(jsonl_path);
+    ASSERT_EQ(lines.size(), names.size());
+    EXPECT_EQ(lines[0].rfind("{\"replication\":7,\"vehicle_type\":\"Alpha\",", 0), 0);
+    EXPECT_NE(lines[1].find("\"vehicle_type\":\"Br,a\\\"vo\""), std::string::npos);
+    EXPECT_EQ(lines[0].back(), '}');
+
+    // Binary: a header, the names, then fixed-size records
+    const std::string binary_path = testing::TempDir() + "evtol_results_test.bin";
+    write_all(binary_path, Results_format::BINARY);
+    FILE* file = fopen(binary_path.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    Results_file_header header;
+    ASSERT_EQ(fread(&header, sizeof(header), 1, file), 1);
+    EXPECT_EQ(memcmp(header.magic, RESULTS_FILE_MAGIC, sizeof(header.magic)), 0);
+    EXPECT_EQ(header.table, (uint32_t)Results_table::VEHICLE_TYPE_STATS);
+    ASSERT_EQ(header.num_vehicle_types, names.size());
+    ASSERT_EQ(header.num_fields, field_names.size());
+    std::vector<char> name(RESULTS_NAME_SIZE);
+    for (size_t i = 0; i < names.size() + field_names.size(); i++)
+    {
+        ASSERT_EQ(fread(name.data(), 1, name.size(), file), name.size());
+        EXPECT_STREQ(name.data(),
+                     i < names.size() ? names[i].c_str() : field_names[i - names.size()].c_str());
+    }
+    for (uint32_t i_type = 0; i_type < names.size(); i_type++)
+    {
+        Results_record_header record_header;
+        std::vector<double> values(field_names.size());
+        ASSERT_EQ(fread(&record_header, sizeof(record_header), 1, file), 1);
+        ASSERT_EQ(fread(values.data(), sizeof(double), values.size(), file), values.size());
+        EXPECT_EQ(record_header.i_replication, 7);
+        EXPECT_EQ(record_header.i_vehicle_type, i_type);
+        EXPECT_EQ(values[(size_t)Vehicle_type_metric::TOTAL_NUM_FLIGHTS],
+                  simulation->results().stats_by_type[i_type].total_num_flights);
+    }
+    EXPECT_EQ(fgetc(file), EOF);
+    fclose(file);
+
+    std::remove(csv_path.c_str());
+    std::remove(jsonl_path.c_str());
+    std::remove(binary_path.c_str());
+}
+
+/// Pausing a simulation, checkpointing it, and resuming it from the checkpoint, any number of
+/// times, must give the same results as running it straight through, in both stepped engines
+TEST(Checkpoint, ResumeMatchesUninterruptedRun)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 40;
+    scenario.num_chargers = 3;
+    scenario.simulation_duration_hrs = 3.0;
+    scenario.options.charger_queue_policy = Charger_queue_policy::LOWEST_RANGE_FIRST;
+    scenario.options.record_fault_times = true;
+    scenario.options.seed = 17;
+    scenario.options.print_progress = false;
+
+    for (Engine engine : {Engine::STEPPED, Engine::STEPPED_SOA})
+    {
+        scenario.options.engine = engine;
+        std::string engine_message = std::string("engine = ") + engine_name(engine);
+
+        std::unique_ptr<Simulation> expected = make_simulation(scenario);
+        ASSERT_NE(expected, nullptr);
+        expected->run();
+
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+        ASSERT_NE(simulation, nullptr);
+        for (double pause_time_hrs : {0.0, 1.3, 2.0})
+        {
+            ASSERT_TRUE(simulation->run_until(pause_time_hrs)) << engine_message;
+            EXPECT_NEAR(simulation->current_time_hrs(), pause_time_hrs, 1e-9) << engine_message;
+
+            Checkpoint_writer writer;
+            ASSERT_TRUE(simulation->save_checkpoint(&writer)) << engine_message;
+            Checkpoint_reader reader{writer.data()};
+            simulation = Simulation::load_checkpoint(&reader);
+            ASSERT_NE(simulation, nullptr) << engine_message;
+        }
+        // can't go back in time
+        EXPECT_FALSE(simulation->run_until(1.0)) << engine_message;
+        simulation->run();
+
+        uint32_t total_num_times_waiting = 0;
+        for (size_t i = 0; i < scenario.num_vehicles; i++)
+        {
+            const Vehicle& expected_vehicle = expected->vehicles()[i];
+            const Vehicle& vehicle = simulation->vehicles()[i];
+            const Vehicle_stats& expected_stats = expected_vehicle.stats;
+            const Vehicle_stats& stats = vehicle.stats;
+            std::string message = engine_message + ", i = " + std::to_string(i);
+
+            EXPECT_EQ(vehicle.i_type, expected_vehicle.i_type) << message;
+            EXPECT_EQ(stats.num_flights, expected_stats.num_flights) << message;
+            EXPECT_EQ(stats.num_charges, expected_stats.num_charges) << message;
+            EXPECT_EQ(stats.num_times_waiting, expected_stats.num_times_waiting) << message;
+            EXPECT_EQ(stats.num_faults, expected_stats.num_faults) << message;
+            EXPECT_EQ(stats.state, expected_stats.state) << message;
+            EXPECT_EQ(vehicle.fault_times_hrs.size(), expected_vehicle.fault_times_hrs.size())
+                << message;
+            // the stepped SoA engine re-sums its per-vehicle totals from each pause, so they may
+            // differ from an uninterrupted run by rounding
+            EXPECT_NEAR(stats.flight_time_hrs, expected_stats.flight_time_hrs, 1e-9) << message;
+            EXPECT_NEAR(stats.wait_time_hrs, expected_stats.wait_time_hrs, 1e-9) << message;
+            EXPECT_NEAR(stats.charge_time_hrs, expected_stats.charge_time_hrs, 1e-9) << message;
+            EXPECT_NEAR(stats.distance_miles, expected_stats.distance_miles, 1e-6) << message;
+            EXPECT_NEAR(stats.battery_state_of_charge_kwh,
+                        expected_stats.battery_state_of_charge_kwh,
+                        1e-6)
+                << message;
+            total_num_times_waiting += stats.num_times_waiting;
+        }
+
+        for (size_t i = 0; i < scenario.vehicle_types.size(); i++)
+        {
+            const Vehicle_type_stats& expected_stats = expected->results().stats_by_type[i];
+            const Vehicle_type_stats& stats = simulation->results().stats_by_type[i];
+            EXPECT_EQ(stats.distributions.flight_time_hrs.moments.count(),
+                      expected_stats.distributions.flight_time_hrs.moments.count())
+                << engine_message;
+            EXPECT_EQ(stats.distributions.charge_time_hrs.moments.count(),
+                      expected_stats.distributions.charge_time_hrs.moments.count())
+                << engine_message;
+            EXPECT_NEAR(stats.total_num_passenger_miles,
+                        expected_stats.total_num_passenger_miles,
+                        1e-6)
+                << engine_message;
+        }
+
+        // Make sure the test covers vehicles waiting in line across a checkpoint
+        EXPECT_GT(total_num_times_waiting, 0) << engine_message;
+
+        // a finished simulation can't be checkpointed
+        Checkpoint_writer writer;
+        EXPECT_FALSE(simulation->save_checkpoint(&writer)) << engine_message;
+    }
+
+    // Malformed checkpoints must be rejected, not loaded
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+    ASSERT_NE(simulation, nullptr);
+    ASSERT_TRUE(simulation->run_until(1.0));
+    Checkpoint_writer writer;
+    ASSERT_TRUE(simulation->save_checkpoint(&writer));
+    std::vector<char> data = writer.data();
+
+    std::vector<char> truncated_data(data.begin(), data.end() - 1);
+    Checkpoint_reader truncated_reader{truncated_data};
+    EXPECT_EQ(Simulation::load_checkpoint(&truncated_reader), nullptr);
+
+    std::vector<char> extra_data = data;
+    extra_data.push_back(0);
+    Checkpoint_reader extra_reader{extra_data};
+    EXPECT_EQ(Simulation::load_checkpoint(&extra_reader), nullptr);
+
+    std::vector<char> bad_magic_data = data;
+    bad_magic_data[0] = 'X';
+    Checkpoint_reader bad_magic_reader{bad_magic_data};
+    EXPECT_EQ(Simulation::load_checkpoint(&bad_magic_reader), nullptr);
+}
+
+/// A fork with no changes must play out exactly like the original; forks with changes must still
+/// account for all of every vehicle's time, and running forks in parallel must give the same
+/// results as running them one at a time
+TEST(WhatIf, ForksFromSnapshot)
+{
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 30;
+    scenario.num_chargers = 4;
+    scenario.simulation_duration_hrs = 4.0;
+    scenario.options.record_fault_times = true;
+    scenario.options.seed = 18;
+    scenario.options.print_progress = false;
+    constexpr double fork_time_hrs = 2.5;
+
+    for (Engine engine : {Engine::STEPPED, Engine::STEPPED_SOA})
+    {
+        scenario.options.engine = engine;
+        std::string engine_message = std::string("engine = ") + engine_name(engine);
+
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+        ASSERT_NE(simulation, nullptr);
+        ASSERT_TRUE(simulation->run_until(fork_time_hrs));
+
+        Fork_changes fewer_chargers;
+        fewer_chargers.num_chargers = 1;
+        Fork_changes more_chargers_and_vehicles;
+        more_chargers_and_vehicles.num_chargers = 10;
+        more_chargers_and_vehicles.num_vehicles_added = {0, 3, 0, 0, 2};
+        Fork_changes reseeded;
+        reseeded.seed = 1;
+        std::vector<Fork_changes> changes = {
+            Fork_changes{}, fewer_chargers, more_chargers_and_vehicles, reseeded};
+
+        std::vector<std::unique_ptr<Simulation>> forks = run_forks(*simulation, changes, 3);
+        ASSERT_EQ(forks.size(), changes.size()) << engine_message;
+
+        // forking mustn't change the original, and each fork must be independent of the others
+        std::unique_ptr<Simulation> serial_fork = simulation->fork(fewer_chargers);
+        ASSERT_NE(serial_fork, nullptr) << engine_message;
+        serial_fork->run();
+        simulation->run();
+
+        for (size_t i = 0; i < scenario.num_vehicles; i++)
+        {
+            const Vehicle_stats& expected = simulation->vehicles()[i].stats;
+            const Vehicle_stats& stats = forks[0]->vehicles()[i].stats;
+            std::string message = engine_message + ", i = " + std::to_string(i);
+
+            EXPECT_EQ(stats.num_flights, expected.num_flights) << message;
+            EXPECT_EQ(stats.num_charges, expected.num_charges) << message;
+            EXPECT_EQ(stats.num_times_waiting, expected.num_times_waiting) << message;
+            EXPECT_EQ(stats.num_faults, expected.num_faults) << message;
+            EXPECT_NEAR(stats.flight_time_hrs, expected.flight_time_hrs, 1e-9) << message;
+            EXPECT_NEAR(stats.wait_time_hrs, expected.wait_time_hrs, 1e-9) << message;
+
+            const Vehicle_stats& serial_stats = serial_fork->vehicles()[i].stats;
+            const Vehicle_stats& parallel_stats = forks[1]->vehicles()[i].stats;
+            EXPECT_EQ(parallel_stats.num_charges, serial_stats.num_charges) << message;
+            EXPECT_EQ(parallel_stats.num_faults, serial_stats.num_faults) << message;
+            EXPECT_NEAR(parallel_stats.wait_time_hrs, serial_stats.wait_time_hrs, 1e-9)
+                << message;
+        }
+
+        // Every vehicle's time must be accounted for, from when it joined to the end
+        std::vector<double> total_wait_time_hrs;
+        for (const std::unique_ptr<Simulation>& fork : forks)
+        {
+            total_wait_time_hrs.push_back(0);
+            for (size_t i = 0; i < fork->vehicles().size(); i++)
+            {
+                const Vehicle_stats& stats = fork->vehicles()[i].stats;
+                double expected_time_hrs = i < scenario.num_vehicles
+                                               ? scenario.simulation_duration_hrs
+                                               : scenario.simulation_duration_hrs - fork_time_hrs;
+                EXPECT_NEAR(stats.flight_time_hrs + stats.wait_time_hrs + stats.charge_time_hrs,
+                            expected_time_hrs,
+                            1e-6)
+                    << engine_message << ", i = " << i;
+                total_wait_time_hrs.back() += stats.wait_time_hrs;
+            }
+        }
+        EXPECT_EQ(forks[2]->vehicles().size(), scenario.num_vehicles + 5) << engine_message;
+        EXPECT_GT(total_wait_time_hrs[1], total_wait_time_hrs[0]) << engine_message;
+        EXPECT_LT(total_wait_time_hrs[2], total_wait_time_hrs[0]) << engine_message;
+
+        std::vector<double> fault_times_hrs;
+        std::vector<double> reseeded_fault_times_hrs;
+        for (size_t i = 0; i < scenario.num_vehicles; i++)
+        {
+            const std::vector<double>& times = forks[0]->vehicles()[i].fault_times_hrs;
+            const std::vector<double>& reseeded_times = forks[3]->vehicles()[i].fault_times_hrs;
+            fault_times_hrs.insert(fault_times_hrs.end(), times.begin(), times.end());
+            reseeded_fault_times_hrs.insert(
+                reseeded_fault_times_hrs.end(), reseeded_times.begin(), reseeded_times.end());
+        }
+        EXPECT_NE(reseeded_fault_times_hrs, fault_times_hrs) << engine_message;
+    }
+
+    // Invalid changes are rejected
+    std::unique_ptr<Simulation> simulation = make_simulation(scenario);
+    ASSERT_NE(simulation, nullptr);
+    Fork_changes bad_changes;
+    bad_changes.num_vehicles_added = {1, 2};
+    EXPECT_EQ(simulation->fork(bad_changes), nullptr);
+    EXPECT_TRUE(run_forks(*simulation, {Fork_changes{}, bad_changes}).empty());
+}
+
+/// The instrumentation counters must agree with what the simulation itself counted, in every
+/// engine, and add up over all threads
+TEST(Instrumentation, CountsMatchSimulation)
+{
+    if (!INSTRUMENTATION_ENABLED)
+    {
+        GTEST_SKIP() << "built without `-DINSTRUMENTATION`";
+    }
+
+    Scenario scenario;
+    scenario.vehicle_types = default_vehicle_types();
+    scenario.num_vehicles = 40;
+    scenario.num_chargers = 3;
+    scenario.options.print_progress = false;
+    const uint64_t num_steps =
+        scenario.simulation_duration_hrs / scenario.simulation_step_size_hrs;
+
+    for (Engine engine : {Engine::STEPPED, Engine::EVENT_DRIVEN, Engine::STEPPED_SOA})
+    {
+        scenario.options.engine = engine;
+        std::string message = std::string("engine = ") + engine_name(engine);
+
+        std::unique_ptr<Simulation> simulation = make_simulation(scenario, 3);
+        ASSERT_NE(simulation, nullptr);
+        reset_instrumentation();
+        simulation->run();
+        Instrumentation_summary summary = instrumentation_summary();
+
+        uint64_t num_faults = 0;
+        uint64_t num_stints = 0;
+        for (const Vehicle_type_stats& stats : simulation->results().stats_by_type)
+        {
+            const Vehicle_type_distributions& distributions = stats.distributions;
+            num_faults += stats.total_num_faults;
+            num_stints += distributions.flight_time_hrs.moments.count()
+                          + distributions.wait_time_hrs.moments.count()
+                          + distributions.charge_time_hrs.moments.count();
+        }
+
+        EXPECT_EQ(summary.count(Instrumentation_counter::TIME_STEPS), num_steps) << message;
+        EXPECT_EQ(summary.count(Instrumentation_counter::FAULTS), num_faults) << message;
+        // every vehicle's last stint ends with the simulation, not with a state transition
+        EXPECT_EQ(summary.count(Instrumentation_counter::STATE_TRANSITIONS),
+                  num_stints - scenario.num_vehicles)
+            << message;
+        EXPECT_LE(summary.count(Instrumentation_counter::CHARGER_WAITS),
+                  summary.count(Instrumentation_counter::CHARGER_REQUESTS))
+            << message;
+        EXPECT_GT(summary.count(Instrumentation_counter::RNG_DRAWS), 0) << message;
+        EXPECT_EQ(summary.calls(Instrumentation_timer::RUN), 1) << message;
+        EXPECT_EQ(summary.calls(Instrumentation_timer::STEPPING), 1) << message;
+        EXPECT_EQ(summary.calls(Instrumentation_timer::AGGREGATION), 1) << message;
+        EXPECT_GE(summary.timer_ns[(size_t)Instrumentation_timer::RUN],
+                  summary.timer_ns[(size_t)Instrumentation_timer::STEPPING])
+            << message;
+
+        if (engine == Engine::EVENT_DRIVEN)
+        {
+            // the event-driven engine counts events, not vehicle steps
+            EXPECT_GT(summary.count(Instrumentation_counter::EVENTS), 0) << message;
+            EXPECT_EQ(summary.count(Instrumentation_counter::VEHICLE_STEPS), 0) << message;
+        }
+        else
+        {
+            EXPECT_EQ(summary.count(Instrumentation_counter::VEHICLE_STEPS),
+                      num_steps * scenario.num_vehicles)
+                << message;
+            EXPECT_EQ(summary.count(Instrumentation_counter::EVENTS), 0) << message;
+            EXPECT_EQ(summary.count(Instrumentation_counter::FLYING_STEPS)
+                          + summary.count(Instrumentation_counter::WAITING_STEPS)
+                          + summary.count(Instrumentation_counter::CHARGING_STEPS),
+                      summary.count(Instrumentation_counter::VEHICLE_STEPS))
+                << message;
+        }
+
+        // only the stepped engine runs `Simulation::iterate()`'s per-state handlers
+        bool stepped = engine == Engine::STEPPED;
+        EXPECT_EQ(summary.calls(Instrumentation_timer::FLYING_HANDLER),
+                  stepped ? summary.count(Instrumentation_counter::FLYING_STEPS) : 0)
+            << message;
+        EXPECT_EQ(summary.calls(Instrumentation_timer::WAITING_HANDLER),
+                  stepped ? summary.count(Instrumentation_counter::WAITING_STEPS) : 0)
+            << message;
+        EXPECT_EQ(summary.calls(Instrumentation_timer::CHARGING_HANDLER),
+                  stepped ? summary.count(Instrumentation_counter::CHARGING_STEPS) : 0)
+            << message;
+    }
+
+    // Counts from every worker thread add up, including threads which have since exited
+    scenario.options.engine = Engine::EVENT_DRIVEN;
+    Monte_carlo_config config;
+    config.num_replications = 20;
+    config.base_seed = 42;
+    config.num_threads = 4;
+    reset_instrumentation();
+    run_monte_carlo(scenario, config);
+    Instrumentation_summary summary = instrumentation_summary();
+    EXPECT_EQ(summary.count(Instrumentation_counter::TIME_STEPS),
+              config.num_replications * num_steps);
+    EXPECT_EQ(summary.calls(Instrumentation_timer::RUN), config.num_replications);
 }
@@ -0,0 +1,253 @@
+#include "monte_carlo.h"
+
+// local includes
+#include "rng.h"
+#include "thread_pool.h"
+
+// C++ includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+Monte_carlo_results::Monte_carlo_results(const std::vector<Vehicle_type>& vehicle_types,
+                                         bool antithetic)
+    : distributions_by_type(vehicle_types.size()),
+      total_num_passenger_miles{antithetic ? 2U : 1U},
+      total_num_faults{antithetic ? 2U : 1U},
+      total_wait_time_hrs{antithetic ? 2U : 1U}
+{
+    std::array<Replication_stats, NUM_VEHICLE_TYPE_METRICS> stats;
+    stats.fill(Replication_stats{antithetic ? 2U : 1U});
+    stats_by_type.assign(vehicle_types.size(), stats);
+
+    for (const Vehicle_type& vehicle_type : vehicle_types)
+    {
+        vehicle_type_names.push_back(vehicle_type.name);
+    }
+}
+
+void Monte_carlo_results::add_replication(const std::vector<Vehicle_type_stats>& replication_stats)
+{
+    double passenger_miles = 0;
+    double num_faults = 0;
+    double wait_time_hrs = 0;
+    for (size_t i_type = 0; i_type < replication_stats.size(); i_type++)
+    {
+        const Vehicle_type_stats& stats = replication_stats[i_type];
+        passenger_miles += stats.total_num_passenger_miles;
+        num_faults += stats.total_num_faults;
+        wait_time_hrs += stats.total_wait_time_hrs;
+
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            // Note: NaN values are skipped, but still added, to keep antithetic pairs together.
+            // Ex: the average charge time is NaN (0/0) if no vehicle of this type ever charged.
+            double value = stats.num_vehicles == 0
+                               ? std::numeric_limits<double>::quiet_NaN()
+                               : metric_value(stats, (Vehicle_type_metric)i_metric);
+            stats_by_type[i_type][i_metric].add(value);
+        }
+
+        if (stats.num_vehicles > 0)
+        {
+            distributions_by_type[i_type].merge(stats.distributions);
+        }
+    }
+
+    total_num_passenger_miles.add(passenger_miles);
+    total_num_faults.add(num_faults);
+    total_wait_time_hrs.add(wait_time_hrs);
+    num_replications++;
+}
+
+bool Monte_carlo_results::meets(const Precision_targets& targets) const
+{
+    auto meets_target = [](const Replication_stats& stats, double target) {
+        return target <= 0
+               || (stats.samples().count() >= 2
+                   && stats.confidence_interval_half_width() <= target * std::fabs(stats.mean()));
+    };
+
+    return targets.any() && num_replications >= targets.min_replications
+           && meets_target(total_num_passenger_miles, targets.total_num_passenger_miles)
+           && meets_target(total_num_faults, targets.total_num_faults)
+           && meets_target(total_wait_time_hrs, targets.total_wait_time_hrs);
+}
+
+void Monte_carlo_results::print() const
+{
+    printf(
+        "\nMonte Carlo results: %u replications in %.3f sec%s\n"
+        "- Each value is: mean +/- 95%% confidence interval half-width (standard deviation) "
+        "[effective sample size]\n\n",
+        num_replications,
+        wall_time_sec,
+        stop_reason == Stop_reason::PRECISION_REACHED   ? ", stopped once precise enough"
+        : stop_reason == Stop_reason::TIME_BUDGET_SPENT ? ", stopped at the time budget"
+                                                        : "");
+
+    printf("Fleet-wide totals:\n");
+    auto print_total = [](const char* name, const Replication_stats& stats) {
+        printf("    %-32s = %f +/- %f (%f) [%.0f]\n",
+               name,
+               stats.mean(),
+               stats.confidence_interval_half_width(),
+               stats.stddev(),
+               stats.effective_sample_size());
+    };
+    print_total("total_num_passenger_miles", total_num_passenger_miles);
+    print_total("total_num_faults", total_num_faults);
+    print_total("total_wait_time_hrs", total_wait_time_hrs);
+    printf("\n");
+
+    for (size_t i_type = 0; i_type < stats_by_type.size(); i_type++)
+    {
+        printf("Vehicle type: %s\n", vehicle_type_names[i_type].c_str());
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            const Replication_stats& stats = stats_by_type[i_type][i_metric];
+            printf(
+                "    %-32s = %f +/- %f (%f) [%.0f]\n",
+                metric_name((Vehicle_type_metric)i_metric),
+                stats.mean(),
+                stats.confidence_interval_half_width(),
+                stats.stddev(),
+                stats.effective_sample_size());
+        }
+        printf("  Distributions, pooled across replications:\n");
+        distributions_by_type[i_type].print();
+        printf("\n");
+    }
+}
+
+uint64_t replication_seed(uint64_t base_seed, uint64_t i_replication)
+{
+    // consecutive replication indices map to well-separated, statistically independent seeds
+    return mix64(base_seed ^ mix64(i_replication));
+}
+
+uint64_t replication_seed(uint64_t base_seed,
+                          uint64_t i_replication,
+                          bool antithetic_pairs,
+                          bool* antithetic)
+{
+    *antithetic = antithetic_pairs && i_replication % 2 == 1;
+    return replication_seed(base_seed, antithetic_pairs ? i_replication / 2 : i_replication);
+}
+
+std::vector<Vehicle_type_stats> run_replication(const Scenario& scenario, uint64_t seed)
+{
+    std::unique_ptr<Simulation> simulation;
+    return run_replication(scenario, seed, &simulation);
+}
+
+std::vector<Vehicle_type_stats> run_replication(const Scenario& scenario,
+                                                uint64_t seed,
+                                                std::unique_ptr<Simulation>* reusable_simulation,
+                                                bool antithetic)
+{
+    std::vector<Vehicle_type_stats> replication_stats;
+
+    std::unique_ptr<Simulation>& simulation = *reusable_simulation;
+    bool reuse = simulation != nullptr;
+    if (!reuse)
+    {
+        simulation = make_simulation(scenario, seed);
+        if (simulation == nullptr)
+        {
+            return replication_stats;
+        }
+    }
+    // a new simulation is populated by the scenario's options, so repopulate it if antithetic
+    if (reuse || antithetic)
+    {
+        simulation->reset(seed, antithetic);
+        simulation->populate_vehicles(scenario.num_vehicles, scenario.fleet_mix);
+    }
+    simulation->run();
+
+    replication_stats = simulation->results().stats_by_type;
+    return replication_stats;
+}
+
+Monte_carlo_results run_monte_carlo(const Scenario& scenario,
+                                    const Monte_carlo_config& config,
+                                    Results_writer* results_writer)
+{
+    auto time_start = std::chrono::steady_clock::now();
+    auto seconds_since_start = [&]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start)
+            .count();
+    };
+
+    Monte_carlo_results results{scenario.vehicle_types, config.antithetic};
+    uint64_t batch_size =
+        config.batch_size > 0 ? config.batch_size : std::max(config.num_replications, 1U);
+    // Keep both halves of each antithetic pair in the same batch, so that no batch stops between
+    // them
+    if (config.antithetic)
+    {
+        batch_size += batch_size % 2;
+    }
+
+    Thread_pool thread_pool{config.num_threads};
+    // one simulation per worker, reused for every replication it runs
+    std::vector<std::unique_ptr<Simulation>> simulations_by_worker(thread_pool.num_threads());
+    // Keep each batch's results, then fold them together in replication order below, so that the
+    // summary is bit-for-bit identical no matter how many threads ran the replications
+    std::vector<std::vector<Vehicle_type_stats>> results_by_replication;
+
+    for (uint64_t i_first = 0; i_first < config.num_replications; i_first += batch_size)
+    {
+        uint64_t i_end = std::min<uint64_t>(config.num_replications, i_first + batch_size);
+        results_by_replication.resize(i_end - i_first);
+        thread_pool.parallel_for_by_worker(
+            i_end - i_first, [&](uint64_t i_job, uint32_t i_worker) {
+                bool antithetic = false;
+                uint64_t seed = replication_seed(
+                    config.base_seed, i_first + i_job, config.antithetic, &antithetic);
+                results_by_replication[i_job] =
+                    run_replication(scenario, seed, &simulations_by_worker[i_worker], antithetic);
+            });
+
+        for (uint64_t i_job = 0; i_job < results_by_replication.size(); i_job++)
+        {
+            const std::vector<Vehicle_type_stats>& replication_stats =
+                results_by_replication[i_job];
+            if (replication_stats.empty())
+            {
+                continue;
+            }
+
+            results.add_replication(replication_stats);
+            if (results_writer != nullptr)
+            {
+                for (uint32_t i_type = 0; i_type < replication_stats.size(); i_type++)
+                {
+                    results_writer->write_vehicle_type_stats(
+                        i_first + i_job, i_type, replication_stats[i_type]);
+                }
+            }
+        }
+
+        if (i_end == config.num_replications)
+        {
+            break;
+        }
+        if (results.meets(config.precision_targets))
+        {
+            results.stop_reason = Stop_reason::PRECISION_REACHED;
+            break;
+        }
+        if (config.time_budget_sec > 0 && seconds_since_start() >= config.time_budget_sec)
+        {
+            results.stop_reason = Stop_reason::TIME_BUDGET_SPENT;
+            break;
+        }
+    }
+
+    results.wall_time_sec = seconds_since_start();
+    return results;
+}
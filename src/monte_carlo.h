@@ -0,0 +1,176 @@
+/*
+Monte Carlo module: run many independent replications of one scenario across a thread pool, and
+summarize their results.
+
+Replications run in batches. After each batch, the batch stops early once the confidence intervals
+of the fleet-wide totals with precision targets are narrow enough, or once its time budget is spent,
+so a scenario only runs as many replications as it needs.
+*/
+
+#pragma once
+
+// local includes
+#include "results_writer.h"
+#include "scenario.h"
+#include "simulation.h"
+#include "simulation_params.h"
+#include "statistics.h"
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Relative precision targets for the fleet-wide totals of a Monte Carlo batch: each one is met
+/// once the 95% confidence interval half-width of the total's mean is within that fraction of the
+/// mean. 0 means no target.
+struct Precision_targets
+{
+    double total_num_passenger_miles = 0;
+    double total_num_faults = 0;
+    double total_wait_time_hrs = 0;
+    /// No target is met before this many replications: the confidence interval uses the normal
+    /// distribution's 1.96, which is far too narrow for only a few independent samples, and a
+    /// small first batch could otherwise stop on a chance run of nearly equal samples
+    uint32_t min_replications = 30;
+
+    /// True if any target is set
+    bool any() const
+    {
+        return total_num_passenger_miles > 0 || total_num_faults > 0 || total_wait_time_hrs > 0;
+    }
+};
+
+/// Why a Monte Carlo batch stopped
+enum class Stop_reason
+{
+    /// Ran every replication of `Monte_carlo_config::num_replications`
+    ALL_REPLICATIONS_RUN = 0,
+    /// Met every `Monte_carlo_config::precision_targets` first
+    PRECISION_REACHED,
+    /// Spent `Monte_carlo_config::time_budget_sec` first
+    TIME_BUDGET_SPENT,
+};
+
+struct Monte_carlo_config
+{
+    /// The most replications to run
+    uint32_t num_replications = NUM_REPLICATIONS;
+    /// 0 means one thread per hardware thread
+    uint32_t num_threads = 0;
+    /// The seed of every replication is derived from this one, so the whole batch is reproducible
+    /// from this single number, regardless of the number of threads used.
+    uint64_t base_seed = 0;
+
+    // Variance reduction: ways to reach the same precision with fewer replications, each of
+    // which keeps every estimate unbiased. See also `Simulation_options::fleet_sampling`.
+
+    /// Antithetic variates: run the replications in pairs with the same seed, and so the same
+    /// fleet, the second drawing every vehicle's random numbers, such as for faults, from
+    /// antithetic streams. Each pair's mean is then one independent sample, whose two halves'
+    /// errors tend to cancel. `num_replications` must be even.
+    bool antithetic = false;
+    /// Common random numbers: run every configuration compared, such as every grid point of a
+    /// sweep, with the same replication seeds, so the differences between them aren't swamped by
+    /// the noise between replications
+    bool common_random_numbers = false;
+
+    // Sequential stopping
+
+    /// Replications are run in batches of this many, checking whether to stop after each one. 0
+    /// runs them all in one batch. Rounded up to even for `antithetic`.
+    uint32_t batch_size = 100;
+    /// Stop after the first batch which meets every target set. The stopping point, and so the
+    /// results, are still identical for any number of threads.
+    Precision_targets precision_targets;
+    /// If positive, stop after the first batch which ends this many seconds of wall-clock time
+    /// after the start. Unlike every other setting, this makes the number of replications run
+    /// depend on the machine and its load.
+    double time_budget_sec = 0;
+};
+
+/// Summary statistics, across all replications, of every `Vehicle_type_stats` output, by vehicle
+/// type
+struct Monte_carlo_results
+{
+    std::vector<std::string> vehicle_type_names;
+    /// Indexed by `[i_vehicle_type][(size_t)Vehicle_type_metric]`. A replication only contributes
+    /// samples to a vehicle type if it had at least one vehicle of that type.
+    std::vector<std::array<Replication_stats, NUM_VEHICLE_TYPE_METRICS>> stats_by_type;
+    /// The durations of every flight, wait and charge session in every replication, pooled by
+    /// vehicle type
+    std::vector<Vehicle_type_distributions> distributions_by_type;
+
+    // Fleet-wide totals (summed over all vehicle types), per replication
+
+    Replication_stats total_num_passenger_miles;
+    Replication_stats total_num_faults;
+    Replication_stats total_wait_time_hrs;
+
+    uint32_t num_replications = 0;
+    double wall_time_sec = 0;
+    Stop_reason stop_reason = Stop_reason::ALL_REPLICATIONS_RUN;
+
+    /// Create empty results for the given vehicle types, of replications which are run in
+    /// antithetic pairs if `antithetic`
+    explicit Monte_carlo_results(const std::vector<Vehicle_type>& vehicle_types,
+                                 bool antithetic = false);
+
+    /// Fold the results of one finished replication into these results. `replication_stats` is
+    /// indexed by vehicle type, in the same order as the vehicle types passed to the constructor.
+    void add_replication(const std::vector<Vehicle_type_stats>& replication_stats);
+
+    const Replication_stats& get(size_t i_vehicle_type, Vehicle_type_metric metric) const
+    {
+        return stats_by_type[i_vehicle_type][(size_t)metric];
+    }
+
+    /// True if `targets` has any target set, at least `targets.min_replications` replications
+    /// have been added, and the fleet-wide totals meet all of the targets
+    bool meets(const Precision_targets& targets) const;
+
+    /// Print the mean, standard deviation, 95% confidence interval and effective sample size of
+    /// every output, and the pooled distributions
+    void print() const;
+};
+
+/// Derive the seed of replication `i_replication` from the batch's `base_seed`
+uint64_t replication_seed(uint64_t base_seed, uint64_t i_replication);
+
+/// Same as above, but if `antithetic_pairs`, for a batch run in antithetic pairs: both
+/// replications of a pair get the seed of pair `i_replication / 2`, and the second one, for which
+/// `antithetic` is set to true, is the antithetic one
+uint64_t replication_seed(uint64_t base_seed,
+                          uint64_t i_replication,
+                          bool antithetic_pairs,
+                          bool* antithetic);
+
+/// Run one replication of `scenario` with the given seed, and return its results, indexed by
+/// vehicle type. Returns an empty vector if the simulation could not be created.
+std::vector<Vehicle_type_stats> run_replication(const Scenario& scenario, uint64_t seed);
+
+/// Same as above, but reuse `*simulation`, if not null--which must have been made for the same
+/// `scenario` by an earlier call--rather than making a new simulation, so that a thread running
+/// many replications of one scenario doesn't allocate a whole new one for every replication. The
+/// results are identical either way. On return, `*simulation` holds this replication's
+/// simulation, for the next call to reuse. `antithetic` replaces
+/// `Simulation_options::antithetic`.
+std::vector<Vehicle_type_stats> run_replication(const Scenario& scenario,
+                                                uint64_t seed,
+                                                std::unique_ptr<Simulation>* simulation,
+                                                bool antithetic = false);
+
+/// Run up to `config.num_replications` independent replications of `scenario` in parallel, in
+/// batches, each with its own seed derived from `config.base_seed`, stopping early per
+/// `config.precision_targets` and `config.time_budget_sec`, and summarize the results. If
+/// `results_writer` isn't null, every replication's results are also written to it, in
+/// replication order; it must be open for `Results_table::VEHICLE_TYPE_STATS`.
+Monte_carlo_results run_monte_carlo(const Scenario& scenario,
+                                    const Monte_carlo_config& config,
+                                    Results_writer* results_writer = nullptr);
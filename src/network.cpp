@@ -0,0 +1,166 @@
+#include "network.h"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+
+uint32_t Network_config::num_chargers() const
+{
+    uint32_t num_chargers = 0;
+    for (const Vertiport_config& vertiport : vertiports)
+    {
+        num_chargers += vertiport.num_chargers;
+    }
+    return num_chargers;
+}
+
+std::vector<std::vector<double>> Network_config::route_distances_miles() const
+{
+    std::unordered_map<std::string, size_t> i_vertiport_by_name;
+    for (size_t i_vertiport = 0; i_vertiport < vertiports.size(); i_vertiport++)
+    {
+        i_vertiport_by_name.emplace(vertiports[i_vertiport].name, i_vertiport);
+    }
+
+    std::vector<std::vector<double>> distances_miles(vertiports.size(),
+                                                     std::vector<double>(vertiports.size(), 0));
+    for (const Route_config& route : routes)
+    {
+        auto from = i_vertiport_by_name.find(route.from);
+        auto to = i_vertiport_by_name.find(route.to);
+        if (from == i_vertiport_by_name.end() || to == i_vertiport_by_name.end())
+        {
+            continue;
+        }
+        distances_miles[from->second][to->second] = route.distance_miles;
+        distances_miles[to->second][from->second] = route.distance_miles;
+    }
+    return distances_miles;
+}
+
+bool Network_config::is_valid() const
+{
+    bool valid = true;
+
+    if (vertiports.size() == 1)
+    {
+        printf("Error: a network needs at least 2 vertiports to fly between.\n");
+        valid = false;
+    }
+
+    std::unordered_set<std::string> names;
+    for (const Vertiport_config& vertiport : vertiports)
+    {
+        if (!names.insert(vertiport.name).second)
+        {
+            printf("Error: vertiport \"%s\" is listed more than once.\n", vertiport.name.c_str());
+            valid = false;
+        }
+    }
+
+    std::unordered_set<std::string> route_names;
+    for (const Route_config& route : routes)
+    {
+        if (names.count(route.from) == 0 || names.count(route.to) == 0)
+        {
+            printf("Error: the route from \"%s\" to \"%s\" names an unknown vertiport.\n",
+                   route.from.c_str(),
+                   route.to.c_str());
+            valid = false;
+        }
+        else if (route.from == route.to)
+        {
+            printf("Error: the route from \"%s\" goes nowhere.\n", route.from.c_str());
+            valid = false;
+        }
+        else
+        {
+            // Note: routes are flown in either direction, so a route back is the same route
+            std::string key =
+                std::min(route.from, route.to) + "\n" + std::max(route.from, route.to);
+            if (!route_names.insert(key).second)
+            {
+                printf("Error: the route between \"%s\" and \"%s\" is listed more than once.\n",
+                       route.from.c_str(),
+                       route.to.c_str());
+                valid = false;
+            }
+        }
+        if (!(route.distance_miles > 0 && std::isfinite(route.distance_miles)))
+        {
+            printf("Error: the route from \"%s\" to \"%s\" must be > 0 miles, but got %f.\n",
+                   route.from.c_str(),
+                   route.to.c_str(),
+                   route.distance_miles);
+            valid = false;
+        }
+    }
+
+    std::vector<std::vector<double>> distances_miles = route_distances_miles();
+    for (size_t i_from = 0; i_from < vertiports.size(); i_from++)
+    {
+        const Vertiport_config& vertiport = vertiports[i_from];
+
+        if (vertiport.route_weights.empty())
+        {
+            bool has_route = false;
+            for (double distance_miles : distances_miles[i_from])
+            {
+                has_route = has_route || distance_miles > 0;
+            }
+            if (!has_route && vertiports.size() > 1)
+            {
+                printf("Error: vertiport \"%s\" has no route to any other vertiport.\n",
+                       vertiport.name.c_str());
+                valid = false;
+            }
+            continue;
+        }
+
+        double total_weight = 0;
+        for (double weight : vertiport.route_weights)
+        {
+            if (!(weight >= 0 && std::isfinite(weight)))
+            {
+                printf("Error: every route weight of vertiport \"%s\" must be >= 0, but got %f.\n",
+                       vertiport.name.c_str(),
+                       weight);
+                valid = false;
+            }
+            total_weight += weight;
+        }
+        if (vertiport.route_weights.size() != vertiports.size())
+        {
+            printf("Error: vertiport \"%s\" has %lu route weights, but there are %lu vertiports.\n",
+                   vertiport.name.c_str(),
+                   vertiport.route_weights.size(),
+                   vertiports.size());
+            valid = false;
+        }
+        else if (!(total_weight > 0))
+        {
+            printf("Error: at least one route weight of vertiport \"%s\" must be > 0.\n",
+                   vertiport.name.c_str());
+            valid = false;
+        }
+        else
+        {
+            for (size_t i_to = 0; i_to < vertiports.size(); i_to++)
+            {
+                if (vertiport.route_weights[i_to] > 0 && !(distances_miles[i_from][i_to] > 0))
+                {
+                    printf("Error: vertiport \"%s\" has a route weight to \"%s\", but no route "
+                           "there.\n",
+                           vertiport.name.c_str(),
+                           vertiports[i_to].name.c_str());
+                    valid = false;
+                }
+            }
+        }
+    }
+
+    return valid;
+}
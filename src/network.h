@@ -0,0 +1,84 @@
+/*
+Network module: a network of vertiports, each with its own chargers and line of vehicles waiting
+for them, with vehicles flying between them.
+
+Every flight takes off fully charged from one vertiport and flies a route to another one, picked
+at random by the route weights of the vertiport it took off from. The flight takes the route's
+distance at the vehicle type's cruise speed, and uses the energy for that distance. The vehicle
+then charges back to full there, or waits in that vertiport's line, and takes off again.
+
+The `Engine::EVENT_DRIVEN` engine simulates a network partitioned by vertiport, and runs the
+partitions in parallel, in the conservative parallel discrete-event style: since no flight is
+shorter than the shortest route flown by the fastest vehicle type, a vehicle taking off during a
+window of time that long can't land anywhere before the window ends. So every vertiport runs each
+window on its own, with no locks, and vertiports exchange the vehicles which took off only between
+windows. The results are identical for any number of threads.
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Vertiport_config
+{
+    std::string name;
+    uint32_t num_chargers = 0;
+    /// Relative weight of flying from here to each vertiport, in the same order as
+    /// `Network_config::vertiports`. Empty means every other vertiport with a route from here is
+    /// equally likely.
+    std::vector<double> route_weights;
+};
+
+/// A route between 2 vertiports, flown in either direction
+struct Route_config
+{
+    /// The names of the vertiports at either end
+    std::string from;
+    std::string to;
+    double distance_miles = 0;
+};
+
+/// The vertiports of a network. Vehicles are based at each vertiport in turn, and all take off from
+/// their base at the start of the simulation.
+struct Network_config
+{
+    std::vector<Vertiport_config> vertiports;
+    /// Vehicles only fly between vertiports with a route between them
+    std::vector<Route_config> routes;
+
+    bool enabled() const
+    {
+        return !vertiports.empty();
+    }
+
+    /// Total chargers over all vertiports
+    uint32_t num_chargers() const;
+
+    /// The distance of the route between each pair of vertiports, indexed by their index into
+    /// `vertiports`, or 0 where there is no route
+    std::vector<std::vector<double>> route_distances_miles() const;
+
+    /// Returns true if every vertiport, and its routes, are meaningful, and otherwise prints why
+    /// not and returns false
+    bool is_valid() const;
+};
+
+/// Totals for one vertiport of a network, over one simulation
+struct Vertiport_stats
+{
+    uint32_t num_arrivals = 0;
+    uint32_t num_charges = 0;
+    uint32_t num_times_waiting = 0;
+    double wait_time_hrs = 0;
+    /// The longest the line of vehicles waiting for a charger got
+    uint32_t max_num_waiting = 0;
+};
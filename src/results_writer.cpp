@@ -0,0 +1,528 @@
+#include "results_writer.h"
+
+// C++ includes
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+/// Write the buffer out once it holds this many bytes: 1 MiB
+constexpr size_t RESULTS_BUFFER_SIZE = 1 << 20;
+
+/// The distributions' percentiles written with each vehicle type's stats
+constexpr double RESULTS_PERCENTILES[] = {0.5, 0.95, 0.99};
+constexpr const char* RESULTS_PERCENTILE_NAMES[] = {"p50", "p95", "p99"};
+constexpr size_t NUM_RESULTS_PERCENTILES = sizeof(RESULTS_PERCENTILES) / sizeof(double);
+
+/// Per-vehicle fields, in order
+enum class Vehicle_field
+{
+    NUM_FLIGHTS = 0,
+    FLIGHT_TIME_HRS,
+    DISTANCE_MILES,
+    NUM_TIMES_WAITING,
+    WAIT_TIME_HRS,
+    NUM_CHARGES,
+    CHARGE_TIME_HRS,
+    NUM_FAULTS,
+    BATTERY_STATE_OF_CHARGE_KWH,
+    STATE,
+};
+
+constexpr size_t NUM_VEHICLE_FIELDS = (size_t)Vehicle_field::STATE + 1;
+
+static const char* vehicle_field_name(Vehicle_field field)
+{
+    switch (field)
+    {
+    case Vehicle_field::NUM_FLIGHTS:
+        return "num_flights";
+    case Vehicle_field::FLIGHT_TIME_HRS:
+        return "flight_time_hrs";
+    case Vehicle_field::DISTANCE_MILES:
+        return "distance_miles";
+    case Vehicle_field::NUM_TIMES_WAITING:
+        return "num_times_waiting";
+    case Vehicle_field::WAIT_TIME_HRS:
+        return "wait_time_hrs";
+    case Vehicle_field::NUM_CHARGES:
+        return "num_charges";
+    case Vehicle_field::CHARGE_TIME_HRS:
+        return "charge_time_hrs";
+    case Vehicle_field::NUM_FAULTS:
+        return "num_faults";
+    case Vehicle_field::BATTERY_STATE_OF_CHARGE_KWH:
+        return "battery_state_of_charge_kwh";
+    case Vehicle_field::STATE:
+        return "state";
+    }
+
+    return "unknown";
+}
+
+static double vehicle_field_value(const Vehicle_stats& stats, Vehicle_field field)
+{
+    switch (field)
+    {
+    case Vehicle_field::NUM_FLIGHTS:
+        return stats.num_flights;
+    case Vehicle_field::FLIGHT_TIME_HRS:
+        return stats.flight_time_hrs;
+    case Vehicle_field::DISTANCE_MILES:
+        return stats.distance_miles;
+    case Vehicle_field::NUM_TIMES_WAITING:
+        return stats.num_times_waiting;
+    case Vehicle_field::WAIT_TIME_HRS:
+        return stats.wait_time_hrs;
+    case Vehicle_field::NUM_CHARGES:
+        return stats.num_charges;
+    case Vehicle_field::CHARGE_TIME_HRS:
+        return stats.charge_time_hrs;
+    case Vehicle_field::NUM_FAULTS:
+        return stats.num_faults;
+    case Vehicle_field::BATTERY_STATE_OF_CHARGE_KWH:
+        return stats.battery_state_of_charge_kwh;
+    case Vehicle_field::STATE:
+        return (double)stats.state;
+    }
+
+    return 0;
+}
+
+const char* results_format_name(Results_format format)
+{
+    switch (format)
+    {
+    case Results_format::TEXT:
+        return "text";
+    case Results_format::CSV:
+        return "csv";
+    case Results_format::JSONL:
+        return "jsonl";
+    case Results_format::BINARY:
+        return "binary";
+    }
+
+    return "unknown";
+}
+
+bool parse_results_format(const std::string& name, Results_format* format)
+{
+    for (Results_format candidate : {Results_format::TEXT,
+                                     Results_format::CSV,
+                                     Results_format::JSONL,
+                                     Results_format::BINARY})
+    {
+        if (name == results_format_name(candidate))
+        {
+            *format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<std::string>& results_field_names(Results_table table)
+{
+    static const std::vector<std::string> vehicle_type_field_names = []() {
+        std::vector<std::string> names;
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            names.push_back(metric_name((Vehicle_type_metric)i_metric));
+        }
+        for (const char* distribution : {"flight_time_hrs", "wait_time_hrs", "charge_time_hrs"})
+        {
+            for (const char* percentile : RESULTS_PERCENTILE_NAMES)
+            {
+                names.push_back(std::string(distribution) + "_" + percentile);
+            }
+        }
+        return names;
+    }();
+    static const std::vector<std::string> vehicle_field_names = []() {
+        std::vector<std::string> names;
+        for (size_t i_field = 0; i_field < NUM_VEHICLE_FIELDS; i_field++)
+        {
+            names.push_back(vehicle_field_name((Vehicle_field)i_field));
+        }
+        return names;
+    }();
+
+    return table == Results_table::VEHICLE_TYPE_STATS ? vehicle_type_field_names
+                                                      : vehicle_field_names;
+}
+
+Results_writer::~Results_writer()
+{
+    close();
+}
+
+bool Results_writer::open(const std::string& path,
+                          Results_format format,
+                          Results_table table,
+                          const std::vector<std::string>& vehicle_type_names)
+{
+    close();
+
+    if (path == "-")
+    {
+        _file = stdout;
+    }
+    else
+    {
+        _file = fopen(path.c_str(), format == Results_format::BINARY ? "wb" : "w");
+        if (_file == nullptr)
+        {
+            printf("Error: failed to open results file \"%s\": %s\n",
+                   path.c_str(),
+                   strerror(errno));
+            return false;
+        }
+    }
+    _path = path;
+    _format = format;
+    _table = table;
+    _vehicle_type_names = vehicle_type_names;
+    _buffer.clear();
+    _buffer.reserve(RESULTS_BUFFER_SIZE + 4096);
+    _write_failed = false;
+
+    const std::vector<std::string>& field_names = results_field_names(table);
+    switch (format)
+    {
+    case Results_format::TEXT:
+        if (table == Results_table::VEHICLE_TYPE_STATS)
+        {
+            append("\nResults by vehicle type:\n"
+                   "- The most important results, in my opinion, are marked with \"<====\".\n\n");
+        }
+        break;
+    case Results_format::CSV:
+        append(table == Results_table::VEHICLE_TYPE_STATS ? "replication,vehicle_type"
+                                                          : "replication,vehicle,vehicle_type");
+        for (const std::string& field_name : field_names)
+        {
+            append(",");
+            append(field_name);
+        }
+        append("\n");
+        break;
+    case Results_format::JSONL:
+        break;
+    case Results_format::BINARY:
+    {
+        Results_file_header header{};
+        memcpy(header.magic, RESULTS_FILE_MAGIC, sizeof(header.magic));
+        header.version = RESULTS_FILE_VERSION;
+        header.table = (uint32_t)table;
+        header.num_vehicle_types = vehicle_type_names.size();
+        header.num_fields = field_names.size();
+        append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        auto append_padded_name = [this](const std::string& name) {
+            char padded_name[RESULTS_NAME_SIZE] = {};
+            strncpy(padded_name, name.c_str(), sizeof(padded_name) - 1);
+            append(padded_name, sizeof(padded_name));
+        };
+        for (const std::string& name : vehicle_type_names)
+        {
+            append_padded_name(name);
+        }
+        for (const std::string& field_name : field_names)
+        {
+            append_padded_name(field_name);
+        }
+        break;
+    }
+    }
+
+    return true;
+}
+
+void Results_writer::write_vehicle_type_stats(uint64_t i_replication,
+                                              uint32_t i_vehicle_type,
+                                              const Vehicle_type_stats& stats)
+{
+    if (_format == Results_format::TEXT)
+    {
+        char text[2048];
+        int size = snprintf(
+            text,
+            sizeof(text),
+            "Vehicle type: %s\n"
+            "  Extra data:\n"
+            "    num_vehicles                     = %u\n"
+            "    total_num_flights                = %u\n"
+            "    total_flight_time_hrs            = %f\n"
+            "    total_distance_miles             = %f\n"
+            "    total_num_charges                = %u\n"
+            "    total_charge_time_hrs            = %f\n"
+            "    total_num_times_waiting          = %u\n"
+            "    total_wait_time_hrs              = %f\n"
+            "    sum of all 3 times (hrs)         = %f\n"
+            "    avg faults per vehicle           = %f  <==\n"
+            "    avg passenger miles per vehicle  = %f  <====\n"
+            "  Required data:\n"
+            "    avg_flight_time_per_flight_hrs   = %f\n"
+            "    avg_distance_per_flight_miles    = %f\n"
+            "    avg_charge_time_per_session_hrs  = %f\n"
+            "    total_num_faults                 = %u\n"
+            "    total_num_passenger_miles        = %f\n\n",
+            _vehicle_type_names[i_vehicle_type].c_str(),
+            // extra data
+            stats.num_vehicles,
+            stats.total_num_flights,
+            stats.total_flight_time_hrs,
+            stats.total_distance_miles,
+            stats.total_num_charges,
+            stats.total_charge_time_hrs,
+            stats.total_num_times_waiting,
+            stats.total_wait_time_hrs,
+            stats.total_flight_time_hrs + stats.total_charge_time_hrs + stats.total_wait_time_hrs,
+            (double)(stats.total_num_faults) / stats.num_vehicles,
+            stats.total_num_passenger_miles / stats.num_vehicles,
+            // required data
+            stats.avg_flight_time_per_flight_hrs,
+            stats.avg_distance_per_flight_miles,
+            stats.avg_charge_time_per_session_hrs,
+            stats.total_num_faults,
+            stats.total_num_passenger_miles);
+        append(text, std::min((size_t)size, sizeof(text) - 1));
+
+        // the distributions print straight to the file, so write out everything before them
+        append("  Distributions:\n");
+        flush();
+        stats.distributions.print(_file);
+        append("\n");
+        return;
+    }
+
+    double values[NUM_VEHICLE_TYPE_METRICS + 3 * NUM_RESULTS_PERCENTILES];
+    for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+    {
+        values[i_metric] = metric_value(stats, (Vehicle_type_metric)i_metric);
+    }
+    size_t i_value = NUM_VEHICLE_TYPE_METRICS;
+    for (const Sample_distribution* distribution : {&stats.distributions.flight_time_hrs,
+                                                    &stats.distributions.wait_time_hrs,
+                                                    &stats.distributions.charge_time_hrs})
+    {
+        for (double percentile : RESULTS_PERCENTILES)
+        {
+            values[i_value] = distribution->quantiles.quantile(percentile);
+            i_value++;
+        }
+    }
+
+    write_row(i_replication, i_vehicle_type, i_vehicle_type, values);
+}
+
+void Results_writer::write_vehicle_stats(uint64_t i_replication,
+                                         uint32_t i_vehicle,
+                                         uint32_t i_vehicle_type,
+                                         const Vehicle_stats& stats)
+{
+    if (_format == Results_format::TEXT)
+    {
+        char text[512];
+        int size = snprintf(
+            text,
+            sizeof(text),
+            "%3u: %10s, num_flights = %u, flight_time_hrs = %f, distance_miles = %f, "
+            "num_times_waiting = %u, wait_time_hrs = %f, num_charges = %u, "
+            "charge_time_hrs = %f, num_faults = %u, state = %s\n",
+            i_vehicle,
+            _vehicle_type_names[i_vehicle_type].c_str(),
+            stats.num_flights,
+            stats.flight_time_hrs,
+            stats.distance_miles,
+            stats.num_times_waiting,
+            stats.wait_time_hrs,
+            stats.num_charges,
+            stats.charge_time_hrs,
+            stats.num_faults,
+            vehicle_state_name(stats.state));
+        append(text, std::min((size_t)size, sizeof(text) - 1));
+        return;
+    }
+
+    double values[NUM_VEHICLE_FIELDS];
+    for (size_t i_field = 0; i_field < NUM_VEHICLE_FIELDS; i_field++)
+    {
+        values[i_field] = vehicle_field_value(stats, (Vehicle_field)i_field);
+    }
+
+    write_row(i_replication, i_vehicle, i_vehicle_type, values);
+}
+
+void Results_writer::write_row(uint64_t i_replication,
+                               uint32_t i_row,
+                               uint32_t i_vehicle_type,
+                               const double* values)
+{
+    const std::vector<std::string>& field_names = results_field_names(_table);
+
+    switch (_format)
+    {
+    case Results_format::TEXT:
+        break;
+    case Results_format::CSV:
+        append_number(i_replication);
+        append(",");
+        if (_table == Results_table::VEHICLE_STATS)
+        {
+            append_number((uint64_t)i_row);
+            append(",");
+        }
+        append_name(_vehicle_type_names[i_vehicle_type]);
+        for (size_t i_field = 0; i_field < field_names.size(); i_field++)
+        {
+            append(",");
+            append_number(values[i_field]);
+        }
+        append("\n");
+        break;
+    case Results_format::JSONL:
+        append("{\"replication\":");
+        append_number(i_replication);
+        if (_table == Results_table::VEHICLE_STATS)
+        {
+            append(",\"vehicle\":");
+            append_number((uint64_t)i_row);
+        }
+        append(",\"vehicle_type\":");
+        append_name(_vehicle_type_names[i_vehicle_type]);
+        for (size_t i_field = 0; i_field < field_names.size(); i_field++)
+        {
+            append(",\"");
+            append(field_names[i_field]);
+            append("\":");
+            append_number(values[i_field]);
+        }
+        append("}\n");
+        break;
+    case Results_format::BINARY:
+    {
+        Results_record_header record_header{i_replication, i_row, i_vehicle_type};
+        append(reinterpret_cast<const char*>(&record_header), sizeof(record_header));
+        append(reinterpret_cast<const char*>(values), field_names.size() * sizeof(double));
+        break;
+    }
+    }
+}
+
+void Results_writer::append(const char* data, size_t size)
+{
+    _buffer.insert(_buffer.end(), data, data + size);
+    if (_buffer.size() >= RESULTS_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void Results_writer::append_name(const std::string& name)
+{
+    if (_format == Results_format::JSONL)
+    {
+        append("\"");
+        for (char c : name)
+        {
+            if (c == '"' || c == '\\')
+            {
+                append("\\");
+                append(&c, 1);
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                append(escaped);
+            }
+            else
+            {
+                append(&c, 1);
+            }
+        }
+        append("\"");
+        return;
+    }
+
+    // CSV: quote the name only if it must be
+    if (name.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        append(name);
+        return;
+    }
+    append("\"");
+    for (char c : name)
+    {
+        // a quote is escaped by doubling it
+        append(&c, 1);
+        if (c == '"')
+        {
+            append(&c, 1);
+        }
+    }
+    append("\"");
+}
+
+void Results_writer::append_number(uint64_t value)
+{
+    char text[24];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    append(text, result.ptr - text);
+}
+
+void Results_writer::append_number(double value)
+{
+    if (_format == Results_format::JSONL && !std::isfinite(value))
+    {
+        append("null");
+        return;
+    }
+
+    // the shortest text which reads back as exactly the same `double`
+    char text[32];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    append(text, result.ptr - text);
+}
+
+void Results_writer::flush()
+{
+    if (_file == nullptr || _buffer.empty())
+    {
+        return;
+    }
+    if (fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size())
+    {
+        _write_failed = true;
+    }
+    _buffer.clear();
+}
+
+bool Results_writer::close()
+{
+    if (_file == nullptr)
+    {
+        return true;
+    }
+
+    flush();
+    bool success = !_write_failed;
+    if (_file == stdout)
+    {
+        success = fflush(stdout) == 0 && success;
+    }
+    else if (fclose(_file) != 0)
+    {
+        success = false;
+    }
+    _file = nullptr;
+
+    if (!success)
+    {
+        printf("Error: failed to write results file \"%s\".\n", _path.c_str());
+    }
+    return success;
+}
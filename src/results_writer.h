@@ -0,0 +1,153 @@
+/*
+Results writer module: write simulation results as structured, machine-readable records--CSV,
+JSON lines, or a compact binary format for bulk runs--or as the human-readable text report. Every
+format goes through the same `Results_writer`, so the text report is just one more sink.
+
+Output is buffered in large blocks, and numbers are formatted with `std::to_chars()`, so writing
+even hundreds of thousands of replications' results isn't dominated by formatted I/O.
+
+Binary file layout, in native byte order:
+1. one `Results_file_header`
+1. `Results_file_header::num_vehicle_types` vehicle type names, `RESULTS_NAME_SIZE` bytes each
+1. `Results_file_header::num_fields` field names, `RESULTS_NAME_SIZE` bytes each
+1. records until the end of the file: one `Results_record_header`, followed by `num_fields`
+   `double`s
+*/
+
+#pragma once
+
+// local includes
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+enum class Results_format
+{
+    /// The human-readable report
+    TEXT = 0,
+    CSV,
+    /// One JSON object per line
+    JSONL,
+    BINARY,
+};
+
+const char* results_format_name(Results_format format);
+
+/// Parse a results format name, as returned by `results_format_name()`
+bool parse_results_format(const std::string& name, Results_format* format);
+
+/// Which results a file holds; each file holds only one kind of row
+enum class Results_table
+{
+    /// One row per vehicle type per replication
+    VEHICLE_TYPE_STATS = 0,
+    /// One row per vehicle per replication
+    VEHICLE_STATS,
+};
+
+constexpr char RESULTS_FILE_MAGIC[8] = {'E', 'V', 'T', 'O', 'L', 'R', 'E', 'S'};
+constexpr uint32_t RESULTS_FILE_VERSION = 1;
+/// Size of each null-terminated name in a binary results file
+constexpr size_t RESULTS_NAME_SIZE = 32;
+
+struct Results_file_header
+{
+    char magic[8];
+    uint32_t version;
+    /// `Results_table`
+    uint32_t table;
+    uint32_t num_vehicle_types;
+    uint32_t num_fields;
+};
+static_assert(sizeof(Results_file_header) == 24, "Results_file_header must be packed");
+
+struct Results_record_header
+{
+    uint64_t i_replication;
+    /// The vehicle's index, for `Results_table::VEHICLE_STATS`; the same as `i_vehicle_type`
+    /// otherwise
+    uint32_t i_row;
+    uint32_t i_vehicle_type;
+};
+static_assert(sizeof(Results_record_header) == 16, "Results_record_header must be packed");
+
+/// Names of the numeric fields written for each row of `table`, in order
+const std::vector<std::string>& results_field_names(Results_table table);
+
+/// Writes one table of results to a file, or to stdout
+class Results_writer
+{
+public:
+    Results_writer() = default;
+    ~Results_writer();
+
+    Results_writer(const Results_writer&) = delete;
+    Results_writer& operator=(const Results_writer&) = delete;
+
+    /// Create the file at `path`, or use stdout if `path` is "-", and write the header, if the
+    /// format has one. Rows refer to vehicle types by their index into `vehicle_type_names`.
+    /// Returns false, after printing why, on any error.
+    bool open(const std::string& path,
+              Results_format format,
+              Results_table table,
+              const std::vector<std::string>& vehicle_type_names);
+
+    /// Write the results of vehicle type `i_vehicle_type` in replication `i_replication`. For
+    /// `Results_table::VEHICLE_TYPE_STATS` only.
+    void write_vehicle_type_stats(uint64_t i_replication,
+                                  uint32_t i_vehicle_type,
+                                  const Vehicle_type_stats& stats);
+
+    /// Write the results of one vehicle in replication `i_replication`. For
+    /// `Results_table::VEHICLE_STATS` only.
+    void write_vehicle_stats(uint64_t i_replication,
+                             uint32_t i_vehicle,
+                             uint32_t i_vehicle_type,
+                             const Vehicle_stats& stats);
+
+    /// Write out everything buffered, and close the file, unless it's stdout. Returns false,
+    /// after printing why, if any write failed.
+    bool close();
+
+private:
+    /// Write a row of `values`, one per `results_field_names(_table)`, in any format but text
+    void write_row(uint64_t i_replication,
+                   uint32_t i_row,
+                   uint32_t i_vehicle_type,
+                   const double* values);
+
+    void append(const char* data, size_t size);
+    void append(const char* str)
+    {
+        append(str, strlen(str));
+    }
+    void append(const std::string& str)
+    {
+        append(str.data(), str.size());
+    }
+    /// Append a vehicle type name as a quoted JSON string, or as a CSV field, quoted if need be
+    void append_name(const std::string& name);
+    void append_number(uint64_t value);
+    /// Written as `null` in JSON if not finite, since JSON has no NaN or infinity
+    void append_number(double value);
+
+    /// Write the buffer out to the file
+    void flush();
+
+    FILE* _file = nullptr;
+    std::string _path;
+    Results_format _format = Results_format::CSV;
+    Results_table _table = Results_table::VEHICLE_TYPE_STATS;
+    std::vector<std::string> _vehicle_type_names;
+    std::vector<char> _buffer;
+    bool _write_failed = false;
+};
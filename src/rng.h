@@ -0,0 +1,167 @@
+/*
+Random number generation module: deterministic, seedable and splittable random number streams.
+
+These functions are called in the innermost simulation loops, so they are all defined inline here in
+the header.
+*/
+
+#pragma once
+
+// local includes
+#include "instrumentation.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <array>
+#include <cstdint>
+#include <limits>
+
+/// SplitMix64 finalizer: a fast, high-quality 64-bit mixing function. Use it to turn sequential or
+/// otherwise correlated numbers (ex: replication indices) into well-separated seeds.
+inline uint64_t mix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/// The Philox4x32-10 counter-based block function (Salmon et al., "Parallel Random Numbers: As
+/// Easy as 1, 2, 3", 2011): a keyed bijection from a 128-bit counter to 128 random bits. Every
+/// (key, counter) pair produces an independent random block, with no state carried between calls.
+inline std::array<uint32_t, 4> philox4x32_10(
+    std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+{
+    constexpr uint32_t MULTIPLIER_0 = 0xD2511F53;
+    constexpr uint32_t MULTIPLIER_1 = 0xCD9E8D57;
+    constexpr uint32_t KEY_BUMP_0 = 0x9E3779B9;
+    constexpr uint32_t KEY_BUMP_1 = 0xBB67AE85;
+
+    for (uint32_t round = 0; round < 10; round++)
+    {
+        if (round > 0)
+        {
+            key[0] += KEY_BUMP_0;
+            key[1] += KEY_BUMP_1;
+        }
+
+        uint64_t product_0 = (uint64_t)MULTIPLIER_0 * counter[0];
+        uint64_t product_1 = (uint64_t)MULTIPLIER_1 * counter[2];
+        counter = {
+            (uint32_t)(product_1 >> 32) ^ counter[1] ^ key[0],
+            (uint32_t)product_1,
+            (uint32_t)(product_0 >> 32) ^ counter[3] ^ key[1],
+            (uint32_t)product_0,
+        };
+    }
+
+    return counter;
+}
+
+/// A counter-based random number stream, built on `philox4x32_10()`. A stream is fully identified
+/// by a (seed, stream id) pair plus a position counter--only 40 bytes of state, vs. ~5 KB for a
+/// `std::mt19937`--so it is nearly free to construct, copy, and give one to every vehicle or every
+/// replication. `split()` derives independent child streams from a parent without advancing or
+/// sharing any state, so results are bit-for-bit reproducible no matter which thread draws from
+/// which stream, or in what order.
+///
+/// Satisfies the C++ `UniformRandomBitGenerator` requirements, so it can be used with any
+/// `std::*_distribution`.
+class Rng
+{
+public:
+    using result_type = uint64_t;
+
+    explicit Rng(uint64_t seed = 0, uint64_t stream_id = 0) : _seed{seed}, _stream_id{stream_id}
+    {
+    }
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    /// Return the next 64 random bits in this stream
+    result_type operator()()
+    {
+        INSTRUMENT_COUNT(RNG_DRAWS, 1);
+
+        // Each Philox block yields 2 x 64 bits; hand out the buffered second half on every other
+        // call
+        // an antithetic stream flips every bit of every draw
+        const uint64_t antithetic_mask = 0 - (uint64_t)_antithetic;
+        if (_has_buffered_value)
+        {
+            _has_buffered_value = false;
+            return _buffered_value ^ antithetic_mask;
+        }
+
+        std::array<uint32_t, 4> block = philox4x32_10(
+            {(uint32_t)_counter,
+             (uint32_t)(_counter >> 32),
+             (uint32_t)_stream_id,
+             (uint32_t)(_stream_id >> 32)},
+            {(uint32_t)_seed, (uint32_t)(_seed >> 32)});
+        _counter++;
+
+        _buffered_value = ((uint64_t)block[3] << 32) | block[2];
+        _has_buffered_value = true;
+        return (((uint64_t)block[1] << 32) | block[0]) ^ antithetic_mask;
+    }
+
+    /// Return a uniformly-distributed random `double` in the range [0.0, 1.0). Cheaper than going
+    /// through `std::uniform_real_distribution`.
+    double uniform_0_to_1()
+    {
+        // use the top 53 bits, which is the full precision of a `double` mantissa
+        return ((*this)() >> 11) * 0x1.0p-53;
+    }
+
+    /// Derive the independent child stream `i_child` of this stream. This stream is unaffected.
+    Rng split(uint64_t i_child) const
+    {
+        Rng child{_seed, mix64(_stream_id ^ mix64(i_child))};
+        child._antithetic = _antithetic;
+        return child;
+    }
+
+    /// Make this stream antithetic, or not: an antithetic stream returns the bitwise complement of
+    /// every draw of the same stream, so `uniform_0_to_1()` returns 1 - u - 2^-53 wherever the
+    /// usual stream returns u. Its draws are just as uniform, but negatively correlated with the
+    /// usual stream's, for antithetic variates. Child streams from `split()` inherit this.
+    void set_antithetic(bool antithetic)
+    {
+        _antithetic = antithetic;
+    }
+
+    bool antithetic() const
+    {
+        return _antithetic;
+    }
+
+    uint64_t seed() const
+    {
+        return _seed;
+    }
+
+    uint64_t stream_id() const
+    {
+        return _stream_id;
+    }
+
+private:
+    uint64_t _seed;
+    uint64_t _stream_id;
+    /// Index of the next Philox block to generate in this stream
+    uint64_t _counter = 0;
+    uint64_t _buffered_value = 0;
+    bool _has_buffered_value = false;
+    bool _antithetic = false;
+};
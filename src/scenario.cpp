@@ -0,0 +1,206 @@
+#include "scenario.h"
+
+// local includes
+#include "fleet_catalog.h"
+
+// C++ includes
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <unordered_set>
+
+std::vector<Vehicle_type> default_vehicle_types()
+{
+    return make_vehicle_types(Default_fleet_catalog::VEHICLE_TYPES,
+                              catalog_size<Default_fleet_catalog>());
+}
+
+bool is_valid(const Scenario& scenario)
+{
+    bool valid = true;
+
+    if (!(scenario.simulation_duration_hrs > 0 && std::isfinite(scenario.simulation_duration_hrs)))
+    {
+        printf(
+            "Error: simulation_duration_hrs must be > 0, but is %f.\n",
+            scenario.simulation_duration_hrs);
+        valid = false;
+    }
+    if (!(scenario.simulation_step_size_hrs > 0
+          && scenario.simulation_step_size_hrs <= scenario.simulation_duration_hrs))
+    {
+        printf(
+            "Error: simulation_step_size_hrs must be > 0 and <= simulation_duration_hrs, but is "
+            "%f.\n",
+            scenario.simulation_step_size_hrs);
+        valid = false;
+    }
+    else if (
+        scenario.simulation_duration_hrs / scenario.simulation_step_size_hrs
+        > std::numeric_limits<uint32_t>::max())
+    {
+        printf("Error: too many time steps; increase simulation_step_size_hrs.\n");
+        valid = false;
+    }
+
+    if (scenario.num_vehicles > 0 && scenario.vehicle_types.empty())
+    {
+        printf("Error: at least one vehicle type is required.\n");
+        valid = false;
+    }
+
+    if (!scenario.fleet_mix.empty())
+    {
+        double total_weight = 0;
+        for (double weight : scenario.fleet_mix)
+        {
+            if (!(weight >= 0 && std::isfinite(weight)))
+            {
+                printf("Error: every fleet_mix weight must be >= 0, but got %f.\n", weight);
+                valid = false;
+            }
+            total_weight += weight;
+        }
+        if (scenario.fleet_mix.size() != scenario.vehicle_types.size())
+        {
+            printf(
+                "Error: fleet_mix has %lu weights, but there are %lu vehicle types.\n",
+                scenario.fleet_mix.size(),
+                scenario.vehicle_types.size());
+            valid = false;
+        }
+        else if (!(total_weight > 0))
+        {
+            printf("Error: at least one fleet_mix weight must be > 0.\n");
+            valid = false;
+        }
+    }
+
+    const Charger_site_config& charger_site = scenario.options.charger_site;
+    if (!charger_site.is_valid())
+    {
+        valid = false;
+    }
+    if (charger_site.enabled())
+    {
+        if (charger_site.charger_power_kw.size() != scenario.num_chargers)
+        {
+            printf(
+                "Error: charger_power_kw has %lu chargers, but num_chargers is %u.\n",
+                charger_site.charger_power_kw.size(),
+                scenario.num_chargers);
+            valid = false;
+        }
+        if (scenario.options.engine != Engine::EVENT_DRIVEN)
+        {
+            printf("Error: only the event_driven engine models charger power, outages and site "
+                   "power caps.\n");
+            valid = false;
+        }
+    }
+
+    const Network_config& network = scenario.options.network;
+    if (!network.is_valid())
+    {
+        valid = false;
+    }
+    if (network.enabled())
+    {
+        if (network.num_chargers() != scenario.num_chargers)
+        {
+            printf("Error: the vertiports have %u chargers in all, but num_chargers is %u.\n",
+                   network.num_chargers(),
+                   scenario.num_chargers);
+            valid = false;
+        }
+        if (scenario.options.engine != Engine::EVENT_DRIVEN)
+        {
+            printf("Error: only the event_driven engine simulates vertiport networks.\n");
+            valid = false;
+        }
+        if (charger_site.enabled())
+        {
+            printf("Error: charger_power_kw can't be combined with vertiports.\n");
+            valid = false;
+        }
+        for (const Route_config& route : network.routes)
+        {
+            for (const Vehicle_type& vehicle_type : scenario.vehicle_types)
+            {
+                if (route.distance_miles > vehicle_type.max_range_miles)
+                {
+                    printf("Error: the route from \"%s\" to \"%s\" is %f miles, but vehicle type "
+                           "\"%s\" can only fly %f miles.\n",
+                           route.from.c_str(),
+                           route.to.c_str(),
+                           route.distance_miles,
+                           vehicle_type.name.c_str(),
+                           vehicle_type.max_range_miles);
+                    valid = false;
+                }
+            }
+        }
+    }
+
+    std::unordered_set<std::string> vehicle_type_names;
+    for (const Vehicle_type& vehicle_type : scenario.vehicle_types)
+    {
+        if (!vehicle_type.is_valid())
+        {
+            valid = false;
+        }
+        else if (scenario.simulation_step_size_hrs > 0
+                 && !vehicle_type.fits_step_size(scenario.simulation_step_size_hrs))
+        {
+            valid = false;
+        }
+        if (!vehicle_type_names.insert(vehicle_type.name).second)
+        {
+            printf("Error: vehicle type \"%s\" is listed more than once.\n",
+                   vehicle_type.name.c_str());
+            valid = false;
+        }
+    }
+
+    return valid;
+}
+
+/// Construct, add vehicle types to, and populate a `Simulation` for `scenario`, using `options`
+/// in place of `scenario.options`
+static std::unique_ptr<Simulation> make_simulation_with_options(
+    const Scenario& scenario, const Simulation_options& options)
+{
+    auto simulation = std::make_unique<Simulation>(
+        scenario.num_chargers,
+        scenario.simulation_duration_hrs,
+        scenario.simulation_step_size_hrs,
+        options);
+
+    for (const Vehicle_type& vehicle_type : scenario.vehicle_types)
+    {
+        if (!simulation->add_vehicle_type(vehicle_type))
+        {
+            return nullptr;
+        }
+    }
+
+    simulation->populate_vehicles(scenario.num_vehicles, scenario.fleet_mix);
+    return simulation;
+}
+
+std::unique_ptr<Simulation> make_simulation(const Scenario& scenario)
+{
+    return make_simulation_with_options(scenario, scenario.options);
+}
+
+std::unique_ptr<Simulation> make_simulation(const Scenario& scenario, uint64_t seed)
+{
+    Simulation_options options = scenario.options;
+    options.seed = seed;
+    options.print_progress = false;
+    // replications already run in parallel with each other, so each one runs single-threaded
+    options.num_threads = 1;
+    // only the single run is traced; replications would all overwrite the same trace file
+    options.trace_path.clear();
+    return make_simulation_with_options(scenario, options);
+}
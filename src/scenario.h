@@ -0,0 +1,48 @@
+/*
+Scenario module: a complete, copyable description of one simulation setup, from which any number of
+independent `Simulation` objects can be built (ex: one per Monte Carlo replication).
+*/
+
+#pragma once
+
+// local includes
+#include "simulation.h"
+#include "simulation_params.h"
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Everything needed to construct, populate and run one `Simulation`
+struct Scenario
+{
+    uint32_t num_chargers = NUM_CHARGERS;
+    double simulation_duration_hrs = SIMULATION_DURATION_HRS;
+    double simulation_step_size_hrs = SIMULATION_STEP_SIZE_HRS;
+    uint32_t num_vehicles = NUM_VEHICLES;
+    std::vector<Vehicle_type> vehicle_types;
+    /// Relative weight of each vehicle type, in the same order as `vehicle_types`, when randomly
+    /// populating the fleet. Empty means every vehicle type is equally likely.
+    std::vector<double> fleet_mix;
+    Simulation_options options;
+};
+
+/// The default vehicle types: one per company in the original problem description
+std::vector<Vehicle_type> default_vehicle_types();
+
+/// Returns true if `scenario` can be simulated, and otherwise prints why not and returns false
+bool is_valid(const Scenario& scenario);
+
+/// Construct a `Simulation` for `scenario`, add all of its vehicle types, and randomly populate its
+/// vehicles, ready to `run()`. Returns nullptr if the vehicle types could not be added.
+std::unique_ptr<Simulation> make_simulation(const Scenario& scenario);
+
+/// Same as above, but for one replication among many: seed the simulation with `seed` instead of
+/// `scenario.options.seed`, silence its progress messages, run it single-threaded, and don't trace
+/// it. This avoids copying the whole scenario just to change those options.
+std::unique_ptr<Simulation> make_simulation(const Scenario& scenario, uint64_t seed);
@@ -1,12 +1,41 @@
 #include "simulation.h"
 
+// local includes
+#include "fleet_soa.h"
+#include "instrumentation.h"
+#include "results_writer.h"
+#include "thread_pool.h"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+
 Simulation::Simulation(
-    uint32_t num_chargers, double simulation_duration_hrs, double simulation_step_size_hrs)
+    uint32_t num_chargers,
+    double simulation_duration_hrs,
+    double simulation_step_size_hrs,
+    Simulation_options options)
     : _num_chargers{num_chargers},
       _simulation_duration_hrs{simulation_duration_hrs},
       _simulation_step_size_hrs{simulation_step_size_hrs},
-      _num_chargers_available{_num_chargers}
+      _options{options},
+      _num_chargers_available{_num_chargers},
+      _charger_queue{_options.charger_queue_policy}
 {
+    if (_options.seed)
+    {
+        _rng = Rng{*_options.seed};
+    }
+    else
+    {
+        std::random_device random_device;
+        _rng = Rng{((uint64_t)random_device() << 32) | random_device()};
+    }
 }
 
 bool Simulation::add_vehicle_type(Vehicle_type vehicle_type)
@@ -18,23 +47,115 @@ bool Simulation::add_vehicle_type(Vehicle_type vehicle_type)
         return false;
     }
 
+    if (!vehicle_type.is_valid() || !vehicle_type.fits_step_size(_simulation_step_size_hrs))
+    {
+        return false;
+    }
+    if (_vehicle_types.size() == MAX_NUM_VEHICLE_TYPES)
+    {
+        printf("Error: can't add more than %lu vehicle types.\n", MAX_NUM_VEHICLE_TYPES);
+        return false;
+    }
+
     _vehicle_type_names.insert(vehicle_type.name);
     _vehicle_types.push_back(vehicle_type);
+    _results.stats_by_type.emplace_back();
     return true;
 }
 
 void Simulation::populate_vehicles(uint32_t num_vehicles)
 {
+    populate_vehicles(num_vehicles, {});
+}
+
+void Simulation::populate_vehicles(uint32_t num_vehicles, const std::vector<double>& type_weights)
+{
+    if (_vehicle_types.empty())
+    {
+        printf("Error: no vehicle types have been added, so no vehicles can be populated.\n");
+        return;
+    }
+    if (!type_weights.empty() && type_weights.size() != _vehicle_types.size())
+    {
+        printf(
+            "Error: got %lu vehicle type weights for %lu vehicle types.\n",
+            type_weights.size(),
+            _vehicle_types.size());
+        return;
+    }
+
     std::uniform_int_distribution<uint32_t> distribution(0, _vehicle_types.size() - 1);
+    std::discrete_distribution<uint32_t> weighted_distribution(
+        type_weights.begin(), type_weights.end());
+
+    std::vector<uint16_t> stratified_types;
+    if (_options.fleet_sampling == Fleet_sampling::STRATIFIED && num_vehicles > 0)
+    {
+        // Systematic sampling: vehicle `i` takes the type whose share of the cumulative weights
+        // holds `(i + offset) / num_vehicles`, for one random offset in [0, 1)
+        std::vector<double> cumulative_weights;
+        double total_weight = 0;
+        for (size_t i_type = 0; i_type < _vehicle_types.size(); i_type++)
+        {
+            total_weight += type_weights.empty() ? 1 : type_weights[i_type];
+            cumulative_weights.push_back(total_weight);
+        }
+        double offset = _rng.uniform_0_to_1();
+        stratified_types.reserve(num_vehicles);
+        for (uint32_t i = 0; i < num_vehicles; i++)
+        {
+            double weight = (i + offset) / num_vehicles * total_weight;
+            size_t i_type =
+                std::upper_bound(cumulative_weights.begin(), cumulative_weights.end(), weight)
+                - cumulative_weights.begin();
+            stratified_types.push_back(std::min(i_type, _vehicle_types.size() - 1));
+        }
+        // so a vehicle's type doesn't depend on its index, and so neither does its place in line
+        std::shuffle(stratified_types.begin(), stratified_types.end(), _rng);
+    }
 
+    // size the fleet up front, so that even a very large one is constructed in place, in one
+    // allocation at most
+    _vehicles.reserve(_vehicles.size() + num_vehicles);
     for (uint32_t i = 0; i < num_vehicles; i++)
     {
         // get a random number from the index range in the distribution, and then add a vehicle
         // of this type
-        uint32_t i_vehicle_type = distribution(_generator);
-        Vehicle random_vehicle{&_vehicle_types[i_vehicle_type]};
-        _vehicles.emplace_back(random_vehicle);
+        uint16_t i_vehicle_type;
+        if (!stratified_types.empty())
+        {
+            i_vehicle_type = stratified_types[i];
+        }
+        else
+        {
+            i_vehicle_type =
+                type_weights.empty() ? distribution(_rng) : weighted_distribution(_rng);
+        }
+        Vehicle& random_vehicle =
+            _vehicles.emplace_back(i_vehicle_type, _vehicle_types[i_vehicle_type]);
+        random_vehicle.rng = _rng.split(_vehicles.size() - 1);
+        random_vehicle.rng.set_antithetic(_options.antithetic);
+    }
+}
+
+void Simulation::reset(uint64_t seed, bool antithetic)
+{
+    finish_trace();
+
+    _options.seed = seed;
+    _options.antithetic = antithetic;
+    _rng = Rng{seed};
+    _vehicles.clear();
+    for (Vehicle_type_stats& stats : _results.stats_by_type)
+    {
+        stats.clear();
     }
+
+    _num_chargers_available = _num_chargers;
+    _num_chargers_to_remove = 0;
+    _charger_queue.clear();
+    _current_step = 0;
+    _run_phase = Run_phase::NOT_STARTED;
 }
 
 void Simulation::print_vehicle_types()
@@ -54,235 +175,1840 @@ void Simulation::print_vehicles()
            "----------\n");
     for (size_t i = 0; i < _vehicles.size(); i++)
     {
-        printf("%3lu: %s\n", i, _vehicles[i].type->name.c_str());
+        printf("%3lu: %s\n", i, type_of(_vehicles[i]).name.c_str());
     }
     printf("\n\n");
 }
 
 void Simulation::run()
 {
-    uint32_t num_steps = _simulation_duration_hrs / _simulation_step_size_hrs;
-    DEBUG_PRINTF("num_steps = %u\n", num_steps);
+    INSTRUMENT_SCOPE(RUN);
 
-    // for all time steps
-    for (uint32_t i = 0; i < num_steps; i++)
+    if (!run_until(_simulation_duration_hrs))
     {
-        // for all vehicles
-        for (Vehicle& vehicle : _vehicles)
+        return;
+    }
+
+    finish_trace();
+
+    if (_options.print_progress)
+    {
+        printf("Done running simulation. Calculating results.\n\n");
+    }
+
+    calculate_results();
+    _run_phase = Run_phase::FINISHED;
+}
+
+bool Simulation::run_until(double time_hrs)
+{
+    const uint64_t num_steps = _simulation_duration_hrs / _simulation_step_size_hrs;
+    // Note: add a tiny epsilon so that a time which is an exact multiple of the step size doesn't
+    // get rounded down an extra step due to floating point error
+    uint64_t end_step =
+        std::min((uint64_t)std::max(time_hrs / _simulation_step_size_hrs + 1e-9, 0.0), num_steps);
+
+    if (_run_phase == Run_phase::FINISHED)
+    {
+        printf("Error: the simulation has already finished running.\n");
+        return false;
+    }
+    if (end_step < _current_step)
+    {
+        printf("Error: can't run the simulation back to %f hrs from %f hrs.\n",
+               time_hrs,
+               current_time_hrs());
+        return false;
+    }
+    if (_options.engine == Engine::EVENT_DRIVEN && end_step < num_steps)
+    {
+        printf("Error: the event_driven engine can't pause before the end of the simulation.\n");
+        return false;
+    }
+
+    if (_run_phase == Run_phase::NOT_STARTED)
+    {
+        start();
+        _run_phase = Run_phase::PAUSED;
+    }
+
+    INSTRUMENT_SCOPE(STEPPING);
+    INSTRUMENT_COUNT(TIME_STEPS, end_step - _current_step);
+
+    // Note: the event-driven engine counts its events instead of vehicle steps
+    switch (_options.engine)
+    {
+    case Engine::STEPPED:
+        INSTRUMENT_COUNT(VEHICLE_STEPS, (end_step - _current_step) * _vehicles.size());
+        run_stepped(end_step);
+        break;
+    case Engine::EVENT_DRIVEN:
+        if (_options.network.enabled())
         {
-            // TODO: to make this application multi-threaded, spawn threads here to call
-            // `iterate()` rapidly, in different threads. Call either the number of threads equal
-            // to your number of CPUs, or the number of threads equal to the number of vehicles,
-            // whichever is smaller.
-            // - NB: use a mutex to protect `_num_chargers_available` in the
-            //   `try_to_charge()` function when it is read and decremented (the combination of
-            //   those two things must be made atomic), as well as in the `CHARGING` state when
-            //   it is incremented.
-            // - This shared resource of the `_num_chargers_available` must be shared among all
-            //   threads.
-            // - Note: making it a `std::atomic<uint32_t>` is not enough.
-            iterate(&vehicle);
+            run_network();
+        }
+        else
+        {
+            run_event_driven();
         }
+        _current_step = num_steps;
+        break;
+    case Engine::STEPPED_SOA:
+        INSTRUMENT_COUNT(VEHICLE_STEPS, (end_step - _current_step) * _vehicles.size());
+        run_stepped_soa(end_step);
+        break;
     }
 
-    printf("Done running simulation. Calculating results.\n\n");
+    return true;
+}
 
-    // For all vehicles, sum up the stats by vehicle type.
-    size_t i = 0;
+void Simulation::start()
+{
+    bind_to_step_size();
     for (Vehicle& vehicle : _vehicles)
     {
-        DEBUG_PRINTF(
-            "%3lu: %10s, num_flights = %u, flight_time_hrs = %f, distance_miles = %f, "
-            "num_times_waiting = %u, wait_time_hrs = %f, num_charges = %u, "
-            "charge_time_hrs = %f, flight+wait+charge-time(hrs) = %f, num_faults = %u\n",
-            i,
-            vehicle.type->name.c_str(),
-            vehicle.stats.num_flights,
-            vehicle.stats.flight_time_hrs,
-            vehicle.stats.distance_miles,
-            vehicle.stats.num_times_waiting,
-            vehicle.stats.wait_time_hrs,
-            vehicle.stats.num_charges,
-            vehicle.stats.charge_time_hrs,
-            vehicle.stats.flight_time_hrs + vehicle.stats.wait_time_hrs
-                + vehicle.stats.charge_time_hrs,
-            vehicle.stats.num_faults);
-
-        // sum the totals by vehicle type
-        (vehicle.type->stats.num_vehicles)++;
-        vehicle.type->stats.total_num_flights += vehicle.stats.num_flights;
-        vehicle.type->stats.total_flight_time_hrs += vehicle.stats.flight_time_hrs;
-        vehicle.type->stats.total_distance_miles += vehicle.stats.distance_miles;
-        vehicle.type->stats.total_num_times_waiting += vehicle.stats.num_times_waiting;
-        vehicle.type->stats.total_wait_time_hrs += vehicle.stats.wait_time_hrs;
-        vehicle.type->stats.total_num_charges += vehicle.stats.num_charges;
-        vehicle.type->stats.total_charge_time_hrs += vehicle.stats.charge_time_hrs;
-        vehicle.type->stats.total_num_faults += vehicle.stats.num_faults;
-
-        i++;
+        vehicle.stats.num_steps_remaining = type_of(vehicle).num_steps_remaining(
+            vehicle.stats.state, vehicle.stats.battery_state_of_charge_kwh);
     }
 
-    // calculate additional compound stats by vehicle type
-    for (Vehicle_type& vehicle_type : _vehicle_types)
+    init_distributions();
+    start_trace();
+
+    if (_options.engine == Engine::STEPPED_SOA)
+    {
+        start_stepped_soa();
+    }
+}
+
+void Simulation::start_trace()
+{
+    if (_options.trace_path.empty())
+    {
+        return;
+    }
+
+    Trace_file_header header{};
+    header.num_vehicles = _vehicles.size();
+    header.num_chargers = _num_chargers;
+    header.simulation_duration_hrs = _simulation_duration_hrs;
+    header.simulation_step_size_hrs = _simulation_step_size_hrs;
+
+    std::vector<Trace_vehicle_type> trace_vehicle_types;
+    for (const Vehicle_type& vehicle_type : _vehicle_types)
+    {
+        trace_vehicle_types.push_back(make_trace_vehicle_type(vehicle_type));
+    }
+
+    _trace_writer = std::make_unique<Trace_writer>();
+    if (!_trace_writer->open(_options.trace_path, header, trace_vehicle_types))
     {
-        // passenger miles = num_passengers * num_miles
-        vehicle_type.stats.total_num_passenger_miles = vehicle_type.stats.num_vehicles
-                                                       * vehicle_type.passengers_per_vehicle
-                                                       * vehicle_type.stats.total_distance_miles;
+        printf("Error: running without a trace.\n");
+        _trace_writer.reset();
+        return;
+    }
+    _trace = _trace_writer->add_channel();
 
-        vehicle_type.stats.avg_flight_time_per_flight_hrs =
-            vehicle_type.stats.total_flight_time_hrs / vehicle_type.stats.total_num_flights;
-        vehicle_type.stats.avg_distance_per_flight_miles =
-            vehicle_type.stats.total_distance_miles / vehicle_type.stats.total_num_flights;
-        vehicle_type.stats.avg_charge_time_per_session_hrs =
-            vehicle_type.stats.total_charge_time_hrs / vehicle_type.stats.total_num_charges;
+    for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+    {
+        Vehicle_state state = _vehicles[i_vehicle].stats.state;
+        trace_event(_trace, Trace_event::INITIAL_STATE, i_vehicle, state, state, 0);
     }
 }
 
-void Simulation::print_results()
+void Simulation::record_state_change(uint32_t i_vehicle,
+                                     Vehicle_state from_state,
+                                     Vehicle_state to_state,
+                                     double time_hrs)
+{
+    INSTRUMENT_COUNT(STATE_TRANSITIONS, 1);
+
+    Vehicle& vehicle = _vehicles[i_vehicle];
+    _results.stats_by_type[vehicle.i_type].distributions.add(
+        from_state, time_hrs - vehicle.stats.state_start_time_hrs);
+    vehicle.stats.state_start_time_hrs = time_hrs;
+
+    trace_event(_trace, Trace_event::STATE_CHANGE, i_vehicle, from_state, to_state, time_hrs);
+}
+
+void Simulation::record_state_change(uint32_t i_vehicle,
+                                     Vehicle_state from_state,
+                                     Vehicle_state to_state,
+                                     double time_hrs,
+                                     std::vector<Vehicle_type_distributions>* distributions_by_type,
+                                     Trace_channel* trace)
 {
-    printf("\nResults by vehicle type:\n"
-           "- The most important results, in my opinion, are marked with \"<====\".\n\n");
+    INSTRUMENT_COUNT(STATE_TRANSITIONS, 1);
+
+    Vehicle& vehicle = _vehicles[i_vehicle];
+    (*distributions_by_type)[vehicle.i_type].add(from_state,
+                                                 time_hrs - vehicle.stats.state_start_time_hrs);
+    vehicle.stats.state_start_time_hrs = time_hrs;
+
+    trace_event(trace, Trace_event::STATE_CHANGE, i_vehicle, from_state, to_state, time_hrs);
+}
 
+void Simulation::bind_to_step_size()
+{
     for (Vehicle_type& vehicle_type : _vehicle_types)
     {
-        printf(
-            "Vehicle type: %s\n"
-            "  Extra data:\n"
-            "    num_vehicles                     = %u\n"
-            "    total_num_flights                = %u\n"
-            "    total_flight_time_hrs            = %f\n"
-            "    total_distance_miles             = %f\n"
-            "    total_num_charges                = %u\n"
-            "    total_charge_time_hrs            = %f\n"
-            "    total_num_times_waiting          = %u\n"
-            "    total_wait_time_hrs              = %f\n"
-            "    sum of all 3 times (hrs)         = %f\n"
-            "    avg faults per vehicle           = %f  <==\n"
-            "    avg passenger miles per vehicle  = %f  <====\n"
-            "  Required data:\n"
-            "    avg_flight_time_per_flight_hrs   = %f\n"
-            "    avg_distance_per_flight_miles    = %f\n"
-            "    avg_charge_time_per_session_hrs  = %f\n"
-            "    total_num_faults                 = %u\n"
-            "    total_num_passenger_miles        = %f\n\n",
-            vehicle_type.name.c_str(),
-            // extra data
-            vehicle_type.stats.num_vehicles,
-            vehicle_type.stats.total_num_flights,
-            vehicle_type.stats.total_flight_time_hrs,
-            vehicle_type.stats.total_distance_miles,
-            vehicle_type.stats.total_num_charges,
-            vehicle_type.stats.total_charge_time_hrs,
-            vehicle_type.stats.total_num_times_waiting,
-            vehicle_type.stats.total_wait_time_hrs,
-            vehicle_type.stats.total_flight_time_hrs + vehicle_type.stats.total_charge_time_hrs
-                + vehicle_type.stats.total_wait_time_hrs,
-            (double)(vehicle_type.stats.total_num_faults) / vehicle_type.stats.num_vehicles,
-            vehicle_type.stats.total_num_passenger_miles / vehicle_type.stats.num_vehicles,
-            // required data
-            vehicle_type.stats.avg_flight_time_per_flight_hrs,
-            vehicle_type.stats.avg_distance_per_flight_miles,
-            vehicle_type.stats.avg_charge_time_per_session_hrs,
-            vehicle_type.stats.total_num_faults,
-            vehicle_type.stats.total_num_passenger_miles);
-    }
-}
-
-void Simulation::check_for_fault(Vehicle* vehicle)
-{
-    double random_num = _dist_0_to_1(_generator);
-    double prob_fault_this_iteration = vehicle->type->prob_fault_per_hr * _simulation_step_size_hrs;
-    if (random_num <= prob_fault_this_iteration)
-    {
-        (vehicle->stats.num_faults)++;
+        vehicle_type.bind_to_step_size(_simulation_step_size_hrs);
     }
 }
 
-void Simulation::try_to_charge(Vehicle* vehicle)
+void Simulation::init_distributions()
 {
-    if (_num_chargers_available > 0)
+    for (size_t i_type = 0; i_type < _vehicle_types.size(); i_type++)
     {
-        // start charging
-        _num_chargers_available--;
-        vehicle->stats.state = Vehicle_state::CHARGING;
-        (vehicle->stats.num_charges)++;
+        // Every flight takes at most `num_flight_steps` whole time steps. Allow half a step
+        // beyond that, since flight times, as differences of simulation times, have floating
+        // point error.
+        double max_flight_time_hrs =
+            (_vehicle_types[i_type].num_flight_steps + 0.5) * _simulation_step_size_hrs;
+        _results.stats_by_type[i_type].distributions.flight_time_histogram.reset(
+            0, max_flight_time_hrs, FLIGHT_TIME_HISTOGRAM_NUM_BINS);
     }
-    else
+}
+
+Thread_pool* Simulation::thread_pool()
+{
+    if (!_thread_pool)
     {
-        // get in the charge line
-        vehicle->stats.state = Vehicle_state::WAITING_FOR_CHARGER;
+        _thread_pool = std::make_unique<Thread_pool>(_options.num_threads);
     }
+    return _thread_pool.get();
 }
 
-void Simulation::iterate(Vehicle* vehicle)
+void Simulation::finish_trace()
 {
-    Vehicle_state state_at_start = vehicle->stats.state;
+    if (!_trace_writer)
+    {
+        return;
+    }
 
-    switch (vehicle->stats.state)
+    _trace_writer->close();
+    _trace_writer.reset();
+    _trace = nullptr;
+}
+
+void Simulation::run_stepped(uint64_t end_step)
+{
+    DEBUG_PRINTF("steps %lu to %lu\n", _current_step, end_step);
+
+    // for all time steps
+    for (; _current_step < end_step; _current_step++)
     {
-    case Vehicle_state::FLYING:
+        // for all vehicles
+        for (Vehicle& vehicle : _vehicles)
+        {
+            // Note: this engine is single-threaded. To step one very large fleet across many
+            // threads, use `Engine::STEPPED_SOA` with `Simulation_options::num_threads`, which
+            // allocates chargers in a serial phase after each parallel step, to stay
+            // deterministic.
+            iterate(&vehicle);
+        }
+
+        // start the sessions of the vehicles handed a charger during this time step
+        double time_hrs = (_current_step + 1) * _simulation_step_size_hrs;
+        for (uint32_t i_next_vehicle : _vehicles_to_start_charging)
+        {
+            Vehicle& next_vehicle = _vehicles[i_next_vehicle];
+            next_vehicle.stats.state = Vehicle_state::CHARGING;
+            next_vehicle.stats.num_steps_remaining = type_of(next_vehicle).num_charge_steps;
+            (next_vehicle.stats.num_charges)++;
+            record_state_change(i_next_vehicle,
+                                Vehicle_state::WAITING_FOR_CHARGER,
+                                Vehicle_state::CHARGING,
+                                time_hrs);
+        }
+        _vehicles_to_start_charging.clear();
+    }
+
+    for (Vehicle& vehicle : _vehicles)
     {
-        if (vehicle->stats.last_state == Vehicle_state::CHARGING)
+        vehicle.stats.battery_state_of_charge_kwh = type_of(vehicle).state_of_charge_kwh(
+            vehicle.stats.state, vehicle.stats.num_steps_remaining);
+    }
+}
+
+void Simulation::start_stepped_soa()
+{
+    for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+    {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+
+        // Count the flight or wait each vehicle is starting out in, since the kernel only counts
+        // them when vehicles transition into them
+        if (vehicle.stats.state == Vehicle_state::FLYING
+            && vehicle.stats.last_state != Vehicle_state::FLYING)
         {
-            // We just started a new flight, so increment the flight counter
-            (vehicle->stats.num_flights)++;
+            (vehicle.stats.num_flights)++;
+        }
+        else if (vehicle.stats.state == Vehicle_state::WAITING_FOR_CHARGER)
+        {
+            if (vehicle.stats.last_state != Vehicle_state::WAITING_FOR_CHARGER)
+            {
+                (vehicle.stats.num_times_waiting)++;
+            }
+            get_in_charger_line(i_vehicle);
         }
 
-        vehicle->stats.flight_time_hrs += _simulation_step_size_hrs;
+        // sample each vehicle's first fault ahead of time, so the kernel can check for it
+        if (_options.fault_model == Fault_model::POISSON)
+        {
+            advance_poisson_faults(&vehicle, 0, _trace);
+        }
+    }
+}
+
+void Simulation::run_stepped_soa(uint64_t end_step)
+{
+    DEBUG_PRINTF("steps %lu to %lu\n", _current_step, end_step);
 
-        double distance_this_itn_miles =
-            vehicle->type->cruise_speed_mph * _simulation_step_size_hrs;
-        vehicle->stats.distance_miles += distance_this_itn_miles;
+    Fleet_soa fleet;
+    fleet.load(
+        _vehicles, _vehicle_types, _simulation_step_size_hrs, _options.specialized_kernels);
 
-        check_for_fault(vehicle);
+    // Each time step runs in 2 phases. First, every chunk of the fleet is stepped forward, and
+    // its faults checked, independently--in parallel if `Simulation_options::num_threads` allows.
+    // Each chunk also collects its vehicles needing a charger or releasing one. Then, all charger
+    // transitions are made serially, in vehicle index order, so that which vehicle gets which
+    // charger, and so the results, never depend on the number of threads.
+    const size_t num_chunks = (fleet.size() + FLEET_SOA_CHUNK_SIZE - 1) / FLEET_SOA_CHUNK_SIZE;
+    std::vector<std::vector<uint32_t>> charger_transitions_by_chunk(num_chunks);
 
-        // check for conditions of next state, which are that if the vehicle is out of battery
-        // (it has traveled its max range in this case), then it must recharge or get in line
-        // to recharge
+    // Each chunk traces its faults into its own channel, since chunks may run in parallel
+    std::vector<Trace_channel*> trace_by_chunk(num_chunks, nullptr);
+    if (_trace_writer)
+    {
+        for (Trace_channel*& trace : trace_by_chunk)
+        {
+            trace = _trace_writer->add_channel();
+        }
+    }
 
-        // Note: alternatively, I could calculate the discharge rate here, in kW, and
-        // use that to adjust the energy used this iteration.
-        double energy_used_this_iteration_kwh =
-            distance_this_itn_miles * vehicle->type->energy_used_kwh_per_mile;
-        vehicle->stats.battery_state_of_charge_kwh -= energy_used_this_iteration_kwh;
+    const std::function<void(uint64_t)> step_chunk = [&](uint64_t i_chunk) {
+        uint32_t i_begin = i_chunk * FLEET_SOA_CHUNK_SIZE;
+        uint32_t i_end = std::min(fleet.size(), (size_t)i_begin + FLEET_SOA_CHUNK_SIZE);
+        std::vector<uint32_t>& charger_transitions = charger_transitions_by_chunk[i_chunk];
+        Trace_channel* trace = trace_by_chunk[i_chunk];
+        charger_transitions.clear();
 
-        if (vehicle->stats.battery_state_of_charge_kwh <= 0)
+        size_t num_flagged = fleet.step(i_begin, i_end);
+
+        if (_options.fault_model == Fault_model::PER_STEP_BERNOULLI)
         {
-            try_to_charge(vehicle);
+            for (uint32_t i_vehicle = i_begin; i_vehicle < i_end; i_vehicle++)
+            {
+                if (fleet.state[i_vehicle] == (uint8_t)Vehicle_state::FLYING)
+                {
+                    check_for_fault(&_vehicles[i_vehicle], trace);
+                }
+            }
         }
 
-        break;
+        for (uint32_t i_vehicle = i_begin; num_flagged > 0; i_vehicle++)
+        {
+            uint8_t flags = fleet.flags[i_vehicle];
+            if (flags == 0)
+            {
+                continue;
+            }
+            num_flagged--;
+
+            if (flags & FLEET_SOA_FLAG_FAULT_DUE)
+            {
+                Vehicle& vehicle = _vehicles[i_vehicle];
+                vehicle.stats.flight_time_hrs = fleet.flight_time_hrs(i_vehicle);
+                vehicle.stats.next_fault_flight_time_hrs =
+                    fleet.next_fault_flight_time_hrs[i_vehicle];
+                advance_poisson_faults(
+                    &vehicle, (_current_step + 1) * _simulation_step_size_hrs, trace);
+                fleet.next_fault_flight_time_hrs[i_vehicle] =
+                    vehicle.stats.next_fault_flight_time_hrs;
+            }
+
+            if (flags & (FLEET_SOA_FLAG_FULLY_CHARGED | FLEET_SOA_FLAG_BATTERY_EMPTY))
+            {
+                charger_transitions.push_back(i_vehicle);
+            }
+        }
+    };
+
+    Thread_pool* pool = _options.num_threads != 1 && num_chunks > 1 ? thread_pool() : nullptr;
+
+    for (; _current_step < end_step; _current_step++)
+    {
+        if (pool)
+        {
+            pool->parallel_for(num_chunks, step_chunk);
+        }
+        else
+        {
+            for (size_t i_chunk = 0; i_chunk < num_chunks; i_chunk++)
+            {
+                step_chunk(i_chunk);
+            }
+        }
+
+        // Handle charger transitions in vehicle index order, just like the `STEPPED` engine. Every
+        // charger freed this step is released (and handed off) first, so a vehicle whose battery
+        // empties in the same step as a lower-indexed vehicle finishes charging takes the freed
+        // charger without a zero-length wait, like in the other engines.
+        INSTRUMENT_SCOPE(CHARGER_ALLOCATION);
+        double time_hrs = (_current_step + 1) * _simulation_step_size_hrs;
+        for (const std::vector<uint32_t>& charger_transitions : charger_transitions_by_chunk)
+        {
+            for (uint32_t i_vehicle : charger_transitions)
+            {
+                Vehicle& vehicle = _vehicles[i_vehicle];
+
+                if (fleet.flags[i_vehicle] & FLEET_SOA_FLAG_FULLY_CHARGED)
+                {
+                    uint32_t i_next_vehicle;
+                    if (release_charger(&i_next_vehicle))
+                    {
+                        fleet.state[i_next_vehicle] = (uint8_t)Vehicle_state::CHARGING;
+                        fleet.set_steps_remaining(
+                            i_next_vehicle, type_of(_vehicles[i_next_vehicle]).num_charge_steps);
+                        (_vehicles[i_next_vehicle].stats.num_charges)++;
+                        record_state_change(i_next_vehicle,
+                                            Vehicle_state::WAITING_FOR_CHARGER,
+                                            Vehicle_state::CHARGING,
+                                            time_hrs);
+                    }
+
+                    fleet.state[i_vehicle] = (uint8_t)Vehicle_state::FLYING;
+                    fleet.set_steps_remaining(i_vehicle, type_of(vehicle).num_flight_steps);
+                    (vehicle.stats.num_flights)++;
+                    record_state_change(
+                        i_vehicle, Vehicle_state::CHARGING, Vehicle_state::FLYING, time_hrs);
+                }
+            }
+        }
+        for (const std::vector<uint32_t>& charger_transitions : charger_transitions_by_chunk)
+        {
+            for (uint32_t i_vehicle : charger_transitions)
+            {
+                Vehicle& vehicle = _vehicles[i_vehicle];
+
+                if (fleet.flags[i_vehicle] & FLEET_SOA_FLAG_FULLY_CHARGED)
+                {
+                    continue;
+                }
+
+                if (_num_chargers_available > 0)
+                {
+                    INSTRUMENT_COUNT(CHARGER_REQUESTS, 1);
+                    _num_chargers_available--;
+                    fleet.state[i_vehicle] = (uint8_t)Vehicle_state::CHARGING;
+                    fleet.set_steps_remaining(i_vehicle, type_of(vehicle).num_charge_steps);
+                    (vehicle.stats.num_charges)++;
+                    record_state_change(
+                        i_vehicle, Vehicle_state::FLYING, Vehicle_state::CHARGING, time_hrs);
+                }
+                else
+                {
+                    INSTRUMENT_COUNT(CHARGER_REQUESTS, 1);
+                    fleet.state[i_vehicle] = (uint8_t)Vehicle_state::WAITING_FOR_CHARGER;
+                    (vehicle.stats.num_times_waiting)++;
+                    get_in_charger_line(i_vehicle);
+                    record_state_change(i_vehicle,
+                                        Vehicle_state::FLYING,
+                                        Vehicle_state::WAITING_FOR_CHARGER,
+                                        time_hrs);
+                }
+            }
+        }
     }
-    case Vehicle_state::WAITING_FOR_CHARGER:
+
+    fleet.store(&_vehicles, _vehicle_types);
+}
+
+void Simulation::run_event_driven()
+{
+    uint64_t num_steps = _simulation_duration_hrs / _simulation_step_size_hrs;
+    DEBUG_PRINTF("num_steps = %lu\n", num_steps);
+
+    // Note: every full flight takes its vehicle type's whole number of time steps,
+    // `Vehicle_type::num_flight_steps`, just like in the stepped engines. So does every full
+    // charge, unless modeling a charger site, in which case each charge lasts as long as the
+    // power it's given, which may change at any event, takes to fill up the battery, rounded up to
+    // a whole time step.
+
+    // The time step at which each vehicle entered its current state
+    std::vector<uint64_t> segment_start_steps(_vehicles.size(), 0);
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+    // For a charger site: the charger each vehicle is charging on, and the time step its
+    // charge is currently scheduled to complete at. A charge-complete event at any other time step
+    // was rescheduled since, and is skipped.
+    const bool model_charger_site = _options.charger_site.enabled();
+    constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+    std::vector<uint32_t> charger_by_vehicle;
+    std::vector<uint64_t> charge_complete_steps;
+    std::vector<uint32_t> chargers_changed;
+    if (model_charger_site)
     {
-        if (vehicle->stats.last_state != Vehicle_state::WAITING_FOR_CHARGER)
+        _charger_site.init(_options.charger_site, _simulation_step_size_hrs);
+        charger_by_vehicle.assign(_vehicles.size(), Charger::NO_VEHICLE);
+        charge_complete_steps.assign(_vehicles.size(), NEVER);
+        for (uint32_t i_change = 0; i_change < _charger_site.schedule().size(); i_change++)
         {
-            // We just started waiting, so increment the wait counter
-            (vehicle->stats.num_times_waiting)++;
+            events.push(
+                {_charger_site.schedule()[i_change].step, Event_type::SITE_CHANGE, i_change});
         }
+    }
 
-        vehicle->stats.wait_time_hrs += _simulation_step_size_hrs;
+    auto start_flying = [&](uint32_t i_vehicle, uint64_t step) {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        vehicle.stats.last_state = vehicle.stats.state;
+        vehicle.stats.state = Vehicle_state::FLYING;
+        (vehicle.stats.num_flights)++;
+        segment_start_steps[i_vehicle] = step;
+        events.push({step + type_of(vehicle).num_flight_steps,
+                     Event_type::BATTERY_EMPTY,
+                     i_vehicle});
+    };
 
-        try_to_charge(vehicle);
-        break;
+    // Take a free charger for vehicle `i_vehicle`, if there is one
+    auto take_charger = [&](uint32_t i_vehicle) {
+        if (!model_charger_site)
+        {
+            if (_num_chargers_available == 0)
+            {
+                return false;
+            }
+            _num_chargers_available--;
+            return true;
+        }
+
+        const Vehicle& vehicle = _vehicles[i_vehicle];
+        const Vehicle_type& type = type_of(vehicle);
+        return _charger_site.start_session(
+            i_vehicle,
+            type.charge_power_kw,
+            type.battery_capacity_kwh - vehicle.stats.battery_state_of_charge_kwh,
+            &charger_by_vehicle[i_vehicle]);
+    };
+
+    // Start charging on the charger just taken by `take_charger()`
+    auto start_charging = [&](uint32_t i_vehicle, uint64_t step) {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        vehicle.stats.last_state = vehicle.stats.state;
+        vehicle.stats.state = Vehicle_state::CHARGING;
+        (vehicle.stats.num_charges)++;
+        segment_start_steps[i_vehicle] = step;
+        // a charger site schedules the charge's completion once it gives it power
+        if (!model_charger_site)
+        {
+            events.push({step + type_of(vehicle).num_charge_steps,
+                         Event_type::CHARGE_COMPLETE,
+                         i_vehicle});
+        }
+    };
+
+    auto get_in_line = [&](uint32_t i_vehicle, uint64_t step) {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        vehicle.stats.last_state = vehicle.stats.state;
+        vehicle.stats.state = Vehicle_state::WAITING_FOR_CHARGER;
+        (vehicle.stats.num_times_waiting)++;
+        segment_start_steps[i_vehicle] = step;
+        get_in_charger_line(i_vehicle);
+    };
+
+    // Hand every free charger in service at a charger site to the next vehicle in line, if any
+    auto serve_charger_line = [&](uint64_t step) {
+        uint32_t i_next_vehicle;
+        while (_charger_site.has_free_charger() && _charger_queue.pop(&i_next_vehicle))
+        {
+            Vehicle& next_vehicle = _vehicles[i_next_vehicle];
+            next_vehicle.stats.wait_time_hrs +=
+                (step - segment_start_steps[i_next_vehicle]) * _simulation_step_size_hrs;
+            take_charger(i_next_vehicle);
+            start_charging(i_next_vehicle, step);
+            record_state_change(i_next_vehicle,
+                                Vehicle_state::WAITING_FOR_CHARGER,
+                                Vehicle_state::CHARGING,
+                                step * _simulation_step_size_hrs);
+        }
+    };
+
+    // Share a charger site's power out again after any change to it, and reschedule the
+    // completion of every charge whose power changed
+    auto reschedule_charges = [&](uint64_t step) {
+        chargers_changed.clear();
+        _charger_site.allocate_power(&chargers_changed);
+        for (uint32_t i_charger : chargers_changed)
+        {
+            const Charger& charger = _charger_site.charger(i_charger);
+            uint64_t complete_step = NEVER;
+            if (charger.power_kw > 0)
+            {
+                complete_step = step
+                                + std::max<uint64_t>(
+                                    num_steps_to_complete(
+                                        charger.energy_remaining_kwh / charger.power_kw,
+                                        _simulation_step_size_hrs),
+                                    1);
+            }
+            if (complete_step != charge_complete_steps[charger.i_vehicle])
+            {
+                charge_complete_steps[charger.i_vehicle] = complete_step;
+                if (complete_step != NEVER)
+                {
+                    events.push({complete_step, Event_type::CHARGE_COMPLETE, charger.i_vehicle});
+                }
+            }
+        }
+    };
+
+    // Every vehicle starts out flying with a fully-charged battery
+    for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+    {
+        _vehicles[i_vehicle].stats.state = Vehicle_state::CHARGING;
+        start_flying(i_vehicle, 0);
     }
-    case Vehicle_state::CHARGING:
+
+    // Events at or beyond `num_steps` fall outside of the simulation
+    while (!events.empty() && events.top().step < num_steps)
     {
-        vehicle->stats.charge_time_hrs += _simulation_step_size_hrs;
+        Event event = events.top();
+        events.pop();
+        INSTRUMENT_COUNT(EVENTS, 1);
 
-        double charge_rate_kw =
-            vehicle->type->battery_capacity_kwh / vehicle->type->time_to_charge_hrs;
+        double time_hrs = event.step * _simulation_step_size_hrs;
+        if (event.type == Event_type::SITE_CHANGE)
+        {
+            _charger_site.advance(time_hrs);
 
-        double charge_energy_this_itn_kwh = charge_rate_kw * _simulation_step_size_hrs;
+            uint32_t i_vehicle;
+            double energy_remaining_kwh;
+            if (_charger_site.apply(
+                    _charger_site.schedule()[event.i_vehicle], &i_vehicle, &energy_remaining_kwh))
+            {
+                // the charger went out of service under this vehicle, which gets back in line
+                // with the charge it has so far
+                Vehicle& vehicle = _vehicles[i_vehicle];
+                vehicle.stats.charge_time_hrs +=
+                    (event.step - segment_start_steps[i_vehicle]) * _simulation_step_size_hrs;
+                vehicle.stats.battery_state_of_charge_kwh =
+                    type_of(vehicle).battery_capacity_kwh - energy_remaining_kwh;
+                charge_complete_steps[i_vehicle] = NEVER;
+                get_in_line(i_vehicle, event.step);
+                record_state_change(i_vehicle,
+                                    Vehicle_state::CHARGING,
+                                    Vehicle_state::WAITING_FOR_CHARGER,
+                                    time_hrs);
+            }
 
-        vehicle->stats.battery_state_of_charge_kwh += charge_energy_this_itn_kwh;
+            serve_charger_line(event.step);
+            reschedule_charges(event.step);
+            continue;
+        }
 
-        // if you're fully charged, get off the charger and start flying again!
-        if (vehicle->stats.battery_state_of_charge_kwh >= vehicle->type->battery_capacity_kwh)
+        if (model_charger_site && event.type == Event_type::CHARGE_COMPLETE
+            && event.step != charge_complete_steps[event.i_vehicle])
+        {
+            continue;
+        }
+
+        Vehicle& vehicle = _vehicles[event.i_vehicle];
+        uint64_t segment_steps = event.step - segment_start_steps[event.i_vehicle];
+
+        switch (event.type)
+        {
+        case Event_type::BATTERY_EMPTY:
+        {
+            INSTRUMENT_COUNT(CHARGER_REQUESTS, 1);
+            add_flight_steps(
+                &vehicle, segment_start_steps[event.i_vehicle], segment_steps, _trace);
+            vehicle.stats.battery_state_of_charge_kwh = 0;
+
+            if (model_charger_site)
+            {
+                _charger_site.advance(time_hrs);
+            }
+            if (take_charger(event.i_vehicle))
+            {
+                start_charging(event.i_vehicle, event.step);
+                record_state_change(
+                    event.i_vehicle, Vehicle_state::FLYING, Vehicle_state::CHARGING, time_hrs);
+            }
+            else
+            {
+                get_in_line(event.i_vehicle, event.step);
+                record_state_change(event.i_vehicle,
+                                    Vehicle_state::FLYING,
+                                    Vehicle_state::WAITING_FOR_CHARGER,
+                                    time_hrs);
+            }
+
+            if (model_charger_site)
+            {
+                reschedule_charges(event.step);
+            }
+            break;
+        }
+        case Event_type::CHARGE_COMPLETE:
+        {
+            vehicle.stats.charge_time_hrs += segment_steps * _simulation_step_size_hrs;
+            vehicle.stats.battery_state_of_charge_kwh = type_of(vehicle).battery_capacity_kwh;
+
+            if (model_charger_site)
+            {
+                _charger_site.advance(time_hrs);
+                _charger_site.end_session(charger_by_vehicle[event.i_vehicle]);
+                charge_complete_steps[event.i_vehicle] = NEVER;
+                serve_charger_line(event.step);
+            }
+            else
+            {
+                uint32_t i_next_vehicle;
+                if (release_charger(&i_next_vehicle))
+                {
+                    Vehicle& next_vehicle = _vehicles[i_next_vehicle];
+                    next_vehicle.stats.wait_time_hrs +=
+                        (event.step - segment_start_steps[i_next_vehicle])
+                        * _simulation_step_size_hrs;
+                    start_charging(i_next_vehicle, event.step);
+                    record_state_change(i_next_vehicle,
+                                        Vehicle_state::WAITING_FOR_CHARGER,
+                                        Vehicle_state::CHARGING,
+                                        time_hrs);
+                }
+            }
+
+            start_flying(event.i_vehicle, event.step);
+            record_state_change(
+                event.i_vehicle, Vehicle_state::CHARGING, Vehicle_state::FLYING, time_hrs);
+
+            if (model_charger_site)
+            {
+                reschedule_charges(event.step);
+            }
+            break;
+        }
+        case Event_type::SITE_CHANGE:
+            // handled above
+            break;
+        }
+    }
+
+    // Close out whatever segment each vehicle is in the middle of when the simulation ends
+    if (model_charger_site)
+    {
+        _charger_site.advance(num_steps * _simulation_step_size_hrs);
+    }
+    for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+    {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        const Vehicle_type& type = type_of(vehicle);
+        uint64_t segment_steps = num_steps - segment_start_steps[i_vehicle];
+        double segment_hrs = segment_steps * _simulation_step_size_hrs;
+
+        switch (vehicle.stats.state)
+        {
+        case Vehicle_state::FLYING:
+            add_flight_steps(&vehicle, segment_start_steps[i_vehicle], segment_steps, _trace);
+            vehicle.stats.battery_state_of_charge_kwh =
+                type.battery_capacity_kwh - segment_hrs * type.cruise_power_kw;
+            break;
+        case Vehicle_state::WAITING_FOR_CHARGER:
+            vehicle.stats.wait_time_hrs += segment_hrs;
+            break;
+        case Vehicle_state::CHARGING:
+            vehicle.stats.charge_time_hrs += segment_hrs;
+            if (model_charger_site)
+            {
+                vehicle.stats.battery_state_of_charge_kwh =
+                    type.battery_capacity_kwh
+                    - _charger_site.charger(charger_by_vehicle[i_vehicle]).energy_remaining_kwh;
+            }
+            else
+            {
+                vehicle.stats.battery_state_of_charge_kwh =
+                    segment_hrs * type.battery_capacity_kwh / type.time_to_charge_hrs;
+            }
+            break;
+        }
+    }
+}
+
+void Simulation::run_network()
+{
+    const uint64_t num_steps = _simulation_duration_hrs / _simulation_step_size_hrs;
+    const std::vector<Vertiport_config>& vertiports = _options.network.vertiports;
+    const uint32_t num_vertiports = vertiports.size();
+
+    const std::vector<std::vector<double>> route_distances_miles =
+        _options.network.route_distances_miles();
+
+    // The cumulative route weights from each vertiport, to pick each flight's destination
+    std::vector<std::vector<double>> cumulative_route_weights(num_vertiports);
+    for (uint32_t i_from = 0; i_from < num_vertiports; i_from++)
+    {
+        double total_weight = 0;
+        for (uint32_t i_to = 0; i_to < num_vertiports; i_to++)
         {
-            _num_chargers_available++;
+            const std::vector<double>& route_weights = vertiports[i_from].route_weights;
+            total_weight += route_weights.empty() ? (route_distances_miles[i_from][i_to] > 0)
+                                                  : route_weights[i_to];
+            cumulative_route_weights[i_from].push_back(total_weight);
+        }
+    }
+
+    // The time steps each vehicle type takes to fly each route, at its cruise speed, indexed by
+    // `(i_from * num_vertiports + i_to) * num_types + i_type`. No flight lands sooner than the
+    // shortest of these after it takes off, so every vertiport can run that many time steps at a
+    // time on its own.
+    const size_t num_types = _vehicle_types.size();
+    std::vector<uint64_t> route_flight_steps(num_vertiports * num_vertiports * num_types, 0);
+    uint64_t window_steps = std::numeric_limits<uint32_t>::max();
+    for (uint32_t i_from = 0; i_from < num_vertiports; i_from++)
+    {
+        for (uint32_t i_to = 0; i_to < num_vertiports; i_to++)
+        {
+            double distance_miles = route_distances_miles[i_from][i_to];
+            if (!(distance_miles > 0))
+            {
+                continue;
+            }
+            for (size_t i_type = 0; i_type < num_types; i_type++)
+            {
+                // every flight takes at least 1 time step
+                uint64_t num_flight_steps = std::max<uint64_t>(
+                    num_steps_to_complete(distance_miles / _vehicle_types[i_type].cruise_speed_mph,
+                                          _simulation_step_size_hrs),
+                    1);
+                route_flight_steps[(i_from * num_vertiports + i_to) * num_types + i_type] =
+                    num_flight_steps;
+                window_steps = std::min(window_steps, num_flight_steps);
+            }
+        }
+    }
+
+    // One vertiport, run as its own partition
+    struct Partition
+    {
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+        /// Landings elsewhere of the vehicles which took off from here this window, handed over to
+        /// their destinations between windows
+        std::vector<Event> departures;
+        Charger_queue charger_queue;
+        uint32_t num_chargers_available = 0;
+        std::vector<Vehicle_type_distributions> distributions_by_type;
+        Trace_channel* trace = nullptr;
+        Vertiport_stats stats;
+    };
+
+    std::vector<Partition> partitions(num_vertiports);
+    for (uint32_t i_vertiport = 0; i_vertiport < num_vertiports; i_vertiport++)
+    {
+        Partition& partition = partitions[i_vertiport];
+        partition.charger_queue = Charger_queue{_options.charger_queue_policy};
+        partition.num_chargers_available = vertiports[i_vertiport].num_chargers;
+        for (const Vehicle_type_stats& stats : _results.stats_by_type)
+        {
+            // the same bins, but no samples
+            partition.distributions_by_type.push_back(stats.distributions);
+            partition.distributions_by_type.back().clear();
+        }
+        if (_trace_writer)
+        {
+            partition.trace = _trace_writer->add_channel();
+        }
+    }
+
+    // The vertiport each vehicle is at, or flying to, and the time step at which it entered its
+    // current state. Each vehicle's entries are only touched by the partition it's at.
+    std::vector<uint32_t> vertiport_by_vehicle(_vehicles.size());
+    std::vector<uint64_t> segment_start_steps(_vehicles.size(), 0);
+
+    auto take_off = [&](Partition* partition, uint32_t i_vehicle, uint64_t step) {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        vehicle.stats.last_state = vehicle.stats.state;
+        vehicle.stats.state = Vehicle_state::FLYING;
+        (vehicle.stats.num_flights)++;
+        segment_start_steps[i_vehicle] = step;
+
+        uint32_t i_from = vertiport_by_vehicle[i_vehicle];
+        const std::vector<double>& cumulative_weights = cumulative_route_weights[i_from];
+        double weight = vehicle.rng.uniform_0_to_1() * cumulative_weights.back();
+        // Note: `upper_bound()` skips over vertiports with a weight of 0
+        size_t i_destination =
+            std::upper_bound(cumulative_weights.begin(), cumulative_weights.end(), weight)
+            - cumulative_weights.begin();
+        uint32_t i_to = std::min<size_t>(i_destination, num_vertiports - 1);
+        vertiport_by_vehicle[i_vehicle] = i_to;
+
+        // Note: the landing reuses the battery-empty event, though the battery is only empty
+        // after a route as long as the vehicle's range
+        uint64_t num_flight_steps =
+            route_flight_steps[(i_from * num_vertiports + i_to) * num_types + vehicle.i_type];
+        partition->departures.push_back(
+            {step + num_flight_steps, Event_type::BATTERY_EMPTY, i_vehicle});
+    };
+
+    // Charge a vehicle back to full, from the state of charge it landed with
+    auto start_charging = [&](Partition* partition, uint32_t i_vehicle, uint64_t step) {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        vehicle.stats.last_state = vehicle.stats.state;
+        vehicle.stats.state = Vehicle_state::CHARGING;
+        (vehicle.stats.num_charges)++;
+        (partition->stats.num_charges)++;
+        segment_start_steps[i_vehicle] = step;
+        uint32_t num_charge_steps = type_of(vehicle).num_steps_remaining(
+            Vehicle_state::CHARGING, vehicle.stats.battery_state_of_charge_kwh);
+        partition->events.push({step + num_charge_steps, Event_type::CHARGE_COMPLETE, i_vehicle});
+    };
+
+    // Run one vertiport's events up to, but not including, time step `end_step`
+    auto run_partition = [&](Partition* partition, uint64_t end_step) {
+        while (!partition->events.empty() && partition->events.top().step < end_step)
+        {
+            Event event = partition->events.top();
+            partition->events.pop();
+            INSTRUMENT_COUNT(EVENTS, 1);
+
+            Vehicle& vehicle = _vehicles[event.i_vehicle];
+            uint64_t segment_steps = event.step - segment_start_steps[event.i_vehicle];
+            double time_hrs = event.step * _simulation_step_size_hrs;
+
+            switch (event.type)
+            {
+            case Event_type::BATTERY_EMPTY:
+            {
+                // landed here
+                INSTRUMENT_COUNT(CHARGER_REQUESTS, 1);
+                (partition->stats.num_arrivals)++;
+                add_flight_steps(&vehicle,
+                                 segment_start_steps[event.i_vehicle],
+                                 segment_steps,
+                                 partition->trace);
+                const Vehicle_type& type = type_of(vehicle);
+                vehicle.stats.battery_state_of_charge_kwh =
+                    std::max(type.battery_capacity_kwh
+                                 - segment_steps * _simulation_step_size_hrs * type.cruise_power_kw,
+                             0.0);
+
+                if (partition->num_chargers_available > 0)
+                {
+                    partition->num_chargers_available--;
+                    start_charging(partition, event.i_vehicle, event.step);
+                    record_state_change(event.i_vehicle,
+                                        Vehicle_state::FLYING,
+                                        Vehicle_state::CHARGING,
+                                        time_hrs,
+                                        &partition->distributions_by_type,
+                                        partition->trace);
+                }
+                else
+                {
+                    // get in this vertiport's charge line
+                    INSTRUMENT_COUNT(CHARGER_WAITS, 1);
+                    vehicle.stats.last_state = vehicle.stats.state;
+                    vehicle.stats.state = Vehicle_state::WAITING_FOR_CHARGER;
+                    (vehicle.stats.num_times_waiting)++;
+                    (partition->stats.num_times_waiting)++;
+                    segment_start_steps[event.i_vehicle] = event.step;
+                    partition->charger_queue.push(event.i_vehicle,
+                                                  charger_priority_key(type_of(vehicle)));
+                    partition->stats.max_num_waiting = std::max<uint32_t>(
+                        partition->stats.max_num_waiting, partition->charger_queue.size());
+                    record_state_change(event.i_vehicle,
+                                        Vehicle_state::FLYING,
+                                        Vehicle_state::WAITING_FOR_CHARGER,
+                                        time_hrs,
+                                        &partition->distributions_by_type,
+                                        partition->trace);
+                }
+                break;
+            }
+            case Event_type::CHARGE_COMPLETE:
+            {
+                vehicle.stats.charge_time_hrs += segment_steps * _simulation_step_size_hrs;
+                vehicle.stats.battery_state_of_charge_kwh = type_of(vehicle).battery_capacity_kwh;
+
+                uint32_t i_next_vehicle;
+                if (partition->charger_queue.pop(&i_next_vehicle))
+                {
+                    double wait_time_hrs = (event.step - segment_start_steps[i_next_vehicle])
+                                           * _simulation_step_size_hrs;
+                    _vehicles[i_next_vehicle].stats.wait_time_hrs += wait_time_hrs;
+                    partition->stats.wait_time_hrs += wait_time_hrs;
+                    start_charging(partition, i_next_vehicle, event.step);
+                    record_state_change(i_next_vehicle,
+                                        Vehicle_state::WAITING_FOR_CHARGER,
+                                        Vehicle_state::CHARGING,
+                                        time_hrs,
+                                        &partition->distributions_by_type,
+                                        partition->trace);
+                }
+                else
+                {
+                    partition->num_chargers_available++;
+                }
+
+                take_off(partition, event.i_vehicle, event.step);
+                record_state_change(event.i_vehicle,
+                                    Vehicle_state::CHARGING,
+                                    Vehicle_state::FLYING,
+                                    time_hrs,
+                                    &partition->distributions_by_type,
+                                    partition->trace);
+                break;
+            }
+            case Event_type::SITE_CHANGE:
+                // networks have no charger sites
+                break;
+            }
+        }
+    };
+
+    // Hand every vehicle which took off over to the vertiport it's flying to
+    auto hand_over_departures = [&]() {
+        for (Partition& partition : partitions)
+        {
+            for (const Event& landing : partition.departures)
+            {
+                partitions[vertiport_by_vehicle[landing.i_vehicle]].events.push(landing);
+            }
+            partition.departures.clear();
+        }
+    };
+
+    // Every vehicle starts out flying with a fully-charged battery, from its base
+    for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+    {
+        uint32_t i_base = i_vehicle % num_vertiports;
+        vertiport_by_vehicle[i_vehicle] = i_base;
+        _vehicles[i_vehicle].stats.state = Vehicle_state::CHARGING;
+        take_off(&partitions[i_base], i_vehicle, 0);
+    }
+
+    Thread_pool* pool =
+        _options.num_threads != 1 && num_vertiports > 1 ? thread_pool() : nullptr;
+
+    for (uint64_t window_start = 0; window_start < num_steps; window_start += window_steps)
+    {
+        uint64_t window_end = std::min(window_start + window_steps, num_steps);
+        hand_over_departures();
+
+        if (pool)
+        {
+            pool->parallel_for(num_vertiports, [&](uint64_t i_vertiport) {
+                run_partition(&partitions[i_vertiport], window_end);
+            });
+        }
+        else
+        {
+            for (Partition& partition : partitions)
+            {
+                run_partition(&partition, window_end);
+            }
+        }
+    }
+
+    // Close out whatever segment each vehicle is in the middle of when the simulation ends
+    for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+    {
+        Vehicle& vehicle = _vehicles[i_vehicle];
+        const Vehicle_type& type = type_of(vehicle);
+        uint64_t segment_steps = num_steps - segment_start_steps[i_vehicle];
+        double segment_hrs = segment_steps * _simulation_step_size_hrs;
+
+        switch (vehicle.stats.state)
+        {
+        case Vehicle_state::FLYING:
+            add_flight_steps(&vehicle, segment_start_steps[i_vehicle], segment_steps, _trace);
+            vehicle.stats.battery_state_of_charge_kwh =
+                type.battery_capacity_kwh - segment_hrs * type.cruise_power_kw;
+            break;
+        case Vehicle_state::WAITING_FOR_CHARGER:
+            vehicle.stats.wait_time_hrs += segment_hrs;
+            partitions[vertiport_by_vehicle[i_vehicle]].stats.wait_time_hrs += segment_hrs;
+            break;
+        case Vehicle_state::CHARGING:
+            // the energy delivered so far, on top of what was left in the battery on landing
+            vehicle.stats.charge_time_hrs += segment_hrs;
+            vehicle.stats.battery_state_of_charge_kwh =
+                std::min(vehicle.stats.battery_state_of_charge_kwh
+                             + segment_hrs * type.charge_power_kw,
+                         type.battery_capacity_kwh);
+            break;
+        }
+    }
+
+    // Merge every vertiport's distributions, in vertiport order, to stay deterministic
+    _vertiport_stats.clear();
+    for (const Partition& partition : partitions)
+    {
+        for (uint32_t i_type = 0; i_type < _vehicle_types.size(); i_type++)
+        {
+            _results.stats_by_type[i_type].distributions.merge(
+                partition.distributions_by_type[i_type]);
+        }
+        _vertiport_stats.push_back(partition.stats);
+    }
+}
+
+void Simulation::add_flight_steps(Vehicle* vehicle,
+                                  uint64_t start_step,
+                                  uint64_t num_steps,
+                                  Trace_channel* trace)
+{
+    vehicle->stats.flight_time_hrs += num_steps * _simulation_step_size_hrs;
+    vehicle->stats.distance_miles += num_steps * type_of(*vehicle).distance_per_step_miles;
+
+    switch (_options.fault_model)
+    {
+    case Fault_model::PER_STEP_BERNOULLI:
+    {
+        // Sample the number of faults over all of these steps at once. This is the exact
+        // equivalent of calling `check_for_fault()` once per time step.
+        double prob_fault_per_step = type_of(*vehicle).prob_fault_per_step;
+        if (num_steps == 0 || prob_fault_per_step <= 0)
+        {
+            break;
+        }
+
+        std::binomial_distribution<uint64_t> dist_num_faults{
+            num_steps, std::min(prob_fault_per_step, 1.0)};
+        uint64_t num_faults = dist_num_faults(vehicle->rng);
+
+        // The individual fault times are only needed if recording or tracing them
+        if (!_options.record_fault_times && trace == nullptr)
+        {
+            INSTRUMENT_COUNT(FAULTS, num_faults);
+            vehicle->stats.num_faults += num_faults;
+            break;
+        }
+
+        // Given the number of faults, the time step each one occurred in is uniformly distributed
+        // over the segment. Draw these from a child stream, so that recording or tracing fault
+        // times never changes the vehicle's main stream, and so never changes any other results.
+        Rng fault_time_rng = vehicle->rng.split(start_step);
+        std::vector<double> fault_times_hrs;
+        fault_times_hrs.reserve(num_faults);
+        for (uint64_t i = 0; i < num_faults; i++)
+        {
+            uint64_t fault_step =
+                start_step + (uint64_t)(fault_time_rng.uniform_0_to_1() * num_steps);
+            fault_times_hrs.push_back(fault_step * _simulation_step_size_hrs);
+        }
+        std::sort(fault_times_hrs.begin(), fault_times_hrs.end());
+        for (double fault_time_hrs : fault_times_hrs)
+        {
+            record_fault(vehicle, fault_time_hrs, trace);
+        }
+        break;
+    }
+    case Fault_model::POISSON:
+    {
+        advance_poisson_faults(
+            vehicle, (start_step + num_steps) * _simulation_step_size_hrs, trace);
+        break;
+    }
+    }
+}
+
+void Simulation::calculate_results()
+{
+    INSTRUMENT_SCOPE(AGGREGATION);
+
+    // the end of the last whole time step run
+    const uint64_t num_steps = _simulation_duration_hrs / _simulation_step_size_hrs;
+    const double end_time_hrs = num_steps * _simulation_step_size_hrs;
+
+    // Sum up the stats of each chunk of the fleet by vehicle type on its own--in parallel if
+    // `Simulation_options::num_threads` allows--then merge the chunks in order, so that the results
+    // never depend on the number of threads
+    const size_t num_chunks =
+        std::max((size_t)1, (_vehicles.size() + RESULTS_CHUNK_SIZE - 1) / RESULTS_CHUNK_SIZE);
+    _results_by_chunk.resize(num_chunks);
+
+    const std::function<void(uint64_t)> sum_chunk = [&](uint64_t i_chunk) {
+        size_t i_begin = i_chunk * RESULTS_CHUNK_SIZE;
+        size_t i_end = std::min(_vehicles.size(), i_begin + RESULTS_CHUNK_SIZE);
+        Fleet_results& results = _results_by_chunk[i_chunk];
+        results.reset(_results);
+
+        for (size_t i = i_begin; i < i_end; i++)
+        {
+            const Vehicle& vehicle = _vehicles[i];
+            DEBUG_PRINTF(
+                "%3lu: %10s, num_flights = %u, flight_time_hrs = %f, distance_miles = %f, "
+                "num_times_waiting = %u, wait_time_hrs = %f, num_charges = %u, "
+                "charge_time_hrs = %f, flight+wait+charge-time(hrs) = %f, num_faults = %u\n",
+                i,
+                type_of(vehicle).name.c_str(),
+                vehicle.stats.num_flights,
+                vehicle.stats.flight_time_hrs,
+                vehicle.stats.distance_miles,
+                vehicle.stats.num_times_waiting,
+                vehicle.stats.wait_time_hrs,
+                vehicle.stats.num_charges,
+                vehicle.stats.charge_time_hrs,
+                vehicle.stats.flight_time_hrs + vehicle.stats.wait_time_hrs
+                    + vehicle.stats.charge_time_hrs,
+                vehicle.stats.num_faults);
+
+            results.add(vehicle.i_type, vehicle.stats, end_time_hrs);
+        }
+    };
+
+    if (_options.num_threads != 1 && num_chunks > 1)
+    {
+        thread_pool()->parallel_for(num_chunks, sum_chunk);
+    }
+    else
+    {
+        for (size_t i_chunk = 0; i_chunk < num_chunks; i_chunk++)
+        {
+            sum_chunk(i_chunk);
+        }
+    }
+
+    for (const Fleet_results& results : _results_by_chunk)
+    {
+        _results.merge(results);
+    }
+
+    // calculate additional compound stats by vehicle type
+    for (size_t i_type = 0; i_type < _vehicle_types.size(); i_type++)
+    {
+        calculate_compound_stats(_vehicle_types[i_type].passengers_per_vehicle,
+                                 &_results.stats_by_type[i_type]);
+    }
+}
+
+void Simulation::print_results()
+{
+    INSTRUMENT_SCOPE(PRINTING);
+
+    std::vector<std::string> vehicle_type_names;
+    for (const Vehicle_type& vehicle_type : _vehicle_types)
+    {
+        vehicle_type_names.push_back(vehicle_type.name);
+    }
+
+    Results_writer writer;
+    writer.open("-", Results_format::TEXT, Results_table::VEHICLE_TYPE_STATS, vehicle_type_names);
+    for (uint32_t i_type = 0; i_type < _vehicle_types.size(); i_type++)
+    {
+        writer.write_vehicle_type_stats(0, i_type, _results.stats_by_type[i_type]);
+    }
+    writer.close();
+
+    if (_options.network.enabled())
+    {
+        printf("\n%-16s %8s %8s %8s %8s %10s %8s\n",
+               "vertiport",
+               "chargers",
+               "arrivals",
+               "charges",
+               "waits",
+               "wait_hrs",
+               "max_line");
+        for (uint32_t i_vertiport = 0; i_vertiport < _vertiport_stats.size(); i_vertiport++)
+        {
+            const Vertiport_config& vertiport = _options.network.vertiports[i_vertiport];
+            const Vertiport_stats& stats = _vertiport_stats[i_vertiport];
+            printf("%-16s %8u %8u %8u %8u %10.3f %8u\n",
+                   vertiport.name.c_str(),
+                   vertiport.num_chargers,
+                   stats.num_arrivals,
+                   stats.num_charges,
+                   stats.num_times_waiting,
+                   stats.wait_time_hrs,
+                   stats.max_num_waiting);
+        }
+    }
+}
+
+bool Simulation::save_checkpoint(const std::string& path) const
+{
+    Checkpoint_writer writer;
+    return save_checkpoint(&writer) && writer.write_file(path);
+}
+
+bool Simulation::save_checkpoint(Checkpoint_writer* writer) const
+{
+    if (_run_phase == Run_phase::FINISHED)
+    {
+        printf("Error: can't checkpoint a simulation which has finished running.\n");
+        return false;
+    }
+
+    Checkpoint_file_header header{};
+    memcpy(header.magic, CHECKPOINT_FILE_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_FILE_VERSION;
+    header.vehicle_stats_size = sizeof(Vehicle_stats);
+    writer->write(header);
+
+    writer->write(_num_chargers);
+    writer->write(_simulation_duration_hrs);
+    writer->write(_simulation_step_size_hrs);
+
+    writer->write(_options.engine);
+    writer->write(_options.seed.has_value());
+    writer->write(_options.seed.value_or(0));
+    writer->write(_options.fault_model);
+    writer->write(_options.num_threads);
+    writer->write(_options.charger_queue_policy);
+    writer->write(_options.fleet_sampling);
+    writer->write(_options.antithetic);
+    writer->write(_options.record_fault_times);
+    writer->write(_options.print_progress);
+    writer->write_string(_options.trace_path);
+
+    writer->write((uint64_t)_vehicle_types.size());
+    for (size_t i_type = 0; i_type < _vehicle_types.size(); i_type++)
+    {
+        const Vehicle_type& vehicle_type = _vehicle_types[i_type];
+        writer->write_string(vehicle_type.name);
+        writer->write(vehicle_type.cruise_speed_mph);
+        writer->write(vehicle_type.battery_capacity_kwh);
+        writer->write(vehicle_type.time_to_charge_hrs);
+        writer->write(vehicle_type.energy_used_kwh_per_mile);
+        writer->write(vehicle_type.passengers_per_vehicle);
+        writer->write(vehicle_type.prob_fault_per_hr);
+        // Note: the rest of the stats are only calculated once the simulation finishes
+        _results.stats_by_type[i_type].distributions.save(writer);
+    }
+
+    writer->write((uint64_t)_vehicles.size());
+    for (const Vehicle& vehicle : _vehicles)
+    {
+        writer->write((uint32_t)vehicle.i_type);
+        writer->write(vehicle.stats);
+        writer->write(vehicle.rng);
+        writer->write_vector(vehicle.fault_times_hrs);
+    }
+
+    writer->write(_run_phase);
+    writer->write(_num_chargers_available);
+    writer->write(_num_chargers_to_remove);
+    _charger_queue.save(writer);
+    writer->write(_current_step);
+    writer->write(_rng);
+
+    return true;
+}
+
+std::unique_ptr<Simulation> Simulation::load_checkpoint(const std::string& path)
+{
+    Checkpoint_reader reader;
+    if (!reader.read_file(path))
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr<Simulation> simulation = load_checkpoint(&reader);
+    if (simulation == nullptr)
+    {
+        printf("Error: failed to load checkpoint file \"%s\".\n", path.c_str());
+    }
+    return simulation;
+}
+
+std::unique_ptr<Simulation> Simulation::load_checkpoint(Checkpoint_reader* reader)
+{
+    return load_checkpoint(reader, nullptr);
+}
+
+std::unique_ptr<Simulation> Simulation::load_checkpoint(Checkpoint_reader* reader,
+                                                        const Fork_changes* changes)
+{
+    Checkpoint_file_header header{};
+    if (!reader->read(&header)
+        || memcmp(header.magic, CHECKPOINT_FILE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        printf("Error: not a checkpoint.\n");
+        return nullptr;
+    }
+    if (header.version != CHECKPOINT_FILE_VERSION
+        || header.vehicle_stats_size != sizeof(Vehicle_stats))
+    {
+        printf("Error: checkpoint version %u is incompatible with this build.\n", header.version);
+        return nullptr;
+    }
+
+    uint32_t num_chargers = 0;
+    double simulation_duration_hrs = 0;
+    double simulation_step_size_hrs = 0;
+    reader->read(&num_chargers);
+    reader->read(&simulation_duration_hrs);
+    reader->read(&simulation_step_size_hrs);
+
+    Simulation_options options;
+    bool has_seed = false;
+    uint64_t seed = 0;
+    reader->read(&options.engine);
+    reader->read(&has_seed);
+    reader->read(&seed);
+    reader->read(&options.fault_model);
+    reader->read(&options.num_threads);
+    reader->read(&options.charger_queue_policy);
+    reader->read(&options.fleet_sampling);
+    reader->read(&options.antithetic);
+    reader->read(&options.record_fault_times);
+    reader->read(&options.print_progress);
+    reader->read_string(&options.trace_path);
+    if (has_seed)
+    {
+        options.seed = seed;
+    }
+    if (!reader->ok())
+    {
+        printf("Error: checkpoint is truncated.\n");
+        return nullptr;
+    }
+
+    uint32_t fork_num_chargers = num_chargers;
+    if (changes != nullptr)
+    {
+        fork_num_chargers = changes->num_chargers.value_or(num_chargers);
+        if (changes->seed)
+        {
+            options.seed = changes->seed;
+        }
+        options.print_progress = false;
+        options.trace_path.clear();
+    }
+
+    auto simulation = std::make_unique<Simulation>(
+        fork_num_chargers, simulation_duration_hrs, simulation_step_size_hrs, options);
+
+    uint64_t num_vehicle_types = 0;
+    reader->read(&num_vehicle_types);
+    for (uint64_t i_type = 0; i_type < num_vehicle_types && reader->ok(); i_type++)
+    {
+        std::string name;
+        double cruise_speed_mph = 0;
+        double battery_capacity_kwh = 0;
+        double time_to_charge_hrs = 0;
+        double energy_used_kwh_per_mile = 0;
+        uint32_t passengers_per_vehicle = 0;
+        double prob_fault_per_hr = 0;
+        reader->read_string(&name);
+        reader->read(&cruise_speed_mph);
+        reader->read(&battery_capacity_kwh);
+        reader->read(&time_to_charge_hrs);
+        reader->read(&energy_used_kwh_per_mile);
+        reader->read(&passengers_per_vehicle);
+        reader->read(&prob_fault_per_hr);
+        if (!reader->ok()
+            || !simulation->add_vehicle_type({name,
+                                              cruise_speed_mph,
+                                              battery_capacity_kwh,
+                                              time_to_charge_hrs,
+                                              energy_used_kwh_per_mile,
+                                              passengers_per_vehicle,
+                                              prob_fault_per_hr})
+            || !simulation->_results.stats_by_type.back().distributions.load(reader))
+        {
+            printf("Error: checkpoint has an invalid vehicle type.\n");
+            return nullptr;
+        }
+    }
+
+    uint64_t num_vehicles = 0;
+    reader->read(&num_vehicles);
+    if (!reader->ok() || num_vehicles > UINT32_MAX)
+    {
+        printf("Error: checkpoint is truncated.\n");
+        return nullptr;
+    }
+    for (uint64_t i_vehicle = 0; i_vehicle < num_vehicles && reader->ok(); i_vehicle++)
+    {
+        uint32_t i_type = 0;
+        if (!reader->read(&i_type) || i_type >= simulation->_vehicle_types.size())
+        {
+            printf("Error: checkpoint has an invalid vehicle.\n");
+            return nullptr;
+        }
+        Vehicle vehicle{(uint16_t)i_type, simulation->_vehicle_types[i_type]};
+        reader->read(&vehicle.stats);
+        reader->read(&vehicle.rng);
+        reader->read_vector(&vehicle.fault_times_hrs);
+        if ((uint32_t)vehicle.stats.state > (uint32_t)Vehicle_state::CHARGING
+            || (uint32_t)vehicle.stats.last_state > (uint32_t)Vehicle_state::CHARGING)
+        {
+            printf("Error: checkpoint has an invalid vehicle.\n");
+            return nullptr;
+        }
+        simulation->_vehicles.push_back(std::move(vehicle));
+    }
+
+    reader->read(&simulation->_run_phase);
+    reader->read(&simulation->_num_chargers_available);
+    reader->read(&simulation->_num_chargers_to_remove);
+    if (!simulation->_charger_queue.load(reader, num_vehicles)
+        || !reader->read(&simulation->_current_step) || !reader->read(&simulation->_rng))
+    {
+        printf("Error: checkpoint is truncated, or has an invalid charger line.\n");
+        return nullptr;
+    }
+    if (!reader->at_end())
+    {
+        printf("Error: checkpoint has unexpected data at the end.\n");
+        return nullptr;
+    }
+    if (simulation->_run_phase > Run_phase::PAUSED
+        || simulation->_num_chargers_available > num_chargers
+        || simulation->_num_chargers_to_remove > num_vehicles
+        || simulation->_current_step * simulation_step_size_hrs > simulation_duration_hrs)
+    {
+        printf("Error: checkpoint has an invalid simulation state.\n");
+        return nullptr;
+    }
+
+    // A simulation which has started is resumed without running `start()` again, so bind its
+    // vehicle types to the step size here
+    if (simulation->_run_phase == Run_phase::PAUSED)
+    {
+        simulation->bind_to_step_size();
+    }
+
+    if (changes != nullptr && !simulation->apply_fork_changes(*changes, num_chargers))
+    {
+        return nullptr;
+    }
+
+    return simulation;
+}
+
+std::unique_ptr<Simulation> Simulation::fork(const Fork_changes& changes) const
+{
+    Checkpoint_writer writer;
+    if (!save_checkpoint(&writer))
+    {
+        return nullptr;
+    }
+
+    Checkpoint_reader reader{writer.data()};
+    return fork(&reader, changes);
+}
+
+std::unique_ptr<Simulation> Simulation::fork(Checkpoint_reader* reader,
+                                             const Fork_changes& changes)
+{
+    return load_checkpoint(reader, &changes);
+}
+
+bool Simulation::apply_fork_changes(const Fork_changes& changes, uint32_t original_num_chargers)
+{
+    if (!changes.num_vehicles_added.empty()
+        && changes.num_vehicles_added.size() != _vehicle_types.size())
+    {
+        printf(
+            "Error: got %lu numbers of vehicles to add for %lu vehicle types.\n",
+            changes.num_vehicles_added.size(),
+            _vehicle_types.size());
+        return false;
+    }
+
+    if (changes.seed)
+    {
+        _rng = Rng{*changes.seed};
+        for (uint32_t i_vehicle = 0; i_vehicle < _vehicles.size(); i_vehicle++)
+        {
+            _vehicles[i_vehicle].rng = _rng.split(i_vehicle);
+            _vehicles[i_vehicle].rng.set_antithetic(_options.antithetic);
+        }
+    }
+
+    // The chargers in use stay in use until their vehicles finish charging, however many
+    // chargers there are now
+    uint32_t num_chargers_in_use =
+        original_num_chargers - _num_chargers_available + _num_chargers_to_remove;
+    if (_num_chargers >= num_chargers_in_use)
+    {
+        _num_chargers_available = _num_chargers - num_chargers_in_use;
+        _num_chargers_to_remove = 0;
+    }
+    else
+    {
+        _num_chargers_available = 0;
+        _num_chargers_to_remove = num_chargers_in_use - _num_chargers;
+    }
+
+    // Hand any chargers added straight to the vehicles waiting in line, if any. The new states
+    // start now, at the start of the next time step.
+    double time_hrs = current_time_hrs();
+    uint32_t i_next_vehicle;
+    while (_num_chargers_available > 0 && _charger_queue.pop(&i_next_vehicle))
+    {
+        _num_chargers_available--;
+
+        Vehicle* next_vehicle = &_vehicles[i_next_vehicle];
+        // the stepped engine only counts a wait once the vehicle has waited a time step, which
+        // it now never will
+        if (next_vehicle->stats.last_state != Vehicle_state::WAITING_FOR_CHARGER)
+        {
+            (next_vehicle->stats.num_times_waiting)++;
+            next_vehicle->stats.last_state = Vehicle_state::WAITING_FOR_CHARGER;
+        }
+        next_vehicle->stats.state = Vehicle_state::CHARGING;
+        next_vehicle->stats.num_steps_remaining = type_of(*next_vehicle).num_charge_steps;
+        (next_vehicle->stats.num_charges)++;
+        record_state_change(
+            i_next_vehicle, Vehicle_state::WAITING_FOR_CHARGER, Vehicle_state::CHARGING, time_hrs);
+    }
+
+    for (uint32_t i_vehicle_type = 0; i_vehicle_type < changes.num_vehicles_added.size();
+         i_vehicle_type++)
+    {
+        for (uint32_t i = 0; i < changes.num_vehicles_added[i_vehicle_type]; i++)
+        {
+            Vehicle vehicle{(uint16_t)i_vehicle_type, _vehicle_types[i_vehicle_type]};
+            vehicle.rng = _rng.split(_vehicles.size());
+            vehicle.rng.set_antithetic(_options.antithetic);
+
+            // A simulation which hasn't started yet sets up all of its vehicles when it starts;
+            // set up a vehicle joining part way through as if it had just been handed its first
+            // flight
+            if (_run_phase == Run_phase::PAUSED)
+            {
+                vehicle.stats.state_start_time_hrs = time_hrs;
+                vehicle.stats.num_steps_remaining = type_of(vehicle).num_flight_steps;
+                // the stepped engine counts a new flight in its first time step, but the stepped
+                // SoA engine only counts flights when they start
+                if (_options.engine == Engine::STEPPED_SOA)
+                {
+                    (vehicle.stats.num_flights)++;
+                    vehicle.stats.last_state = Vehicle_state::FLYING;
+                }
+                if (_options.fault_model == Fault_model::POISSON)
+                {
+                    advance_poisson_faults(&vehicle, time_hrs, nullptr);
+                }
+            }
+
+            _vehicles.push_back(std::move(vehicle));
+        }
+    }
+
+    return true;
+}
+
+void Simulation::check_for_fault(Vehicle* vehicle, Trace_channel* trace)
+{
+    switch (_options.fault_model)
+    {
+    case Fault_model::PER_STEP_BERNOULLI:
+    {
+        double random_num = vehicle->rng.uniform_0_to_1();
+        if (random_num <= type_of(*vehicle).prob_fault_per_step)
+        {
+            record_fault(vehicle, _current_step * _simulation_step_size_hrs, trace);
+        }
+        break;
+    }
+    case Fault_model::POISSON:
+    {
+        // No random draws at all unless a fault actually occurred this time step
+        advance_poisson_faults(vehicle, (_current_step + 1) * _simulation_step_size_hrs, trace);
+        break;
+    }
+    }
+}
+
+void Simulation::advance_poisson_faults(Vehicle* vehicle,
+                                        double time_now_hrs,
+                                        Trace_channel* trace)
+{
+    double prob_fault_per_hr = type_of(*vehicle).prob_fault_per_hr;
+    if (prob_fault_per_hr <= 0)
+    {
+        return;
+    }
+
+    // The flight time between faults is exponentially distributed with a rate of
+    // `prob_fault_per_hr` faults per hour. Sample it by inverting the exponential CDF.
+    auto sample_flight_time_to_next_fault_hrs = [&]() {
+        return -std::log1p(-vehicle->rng.uniform_0_to_1()) / prob_fault_per_hr;
+    };
+
+    if (vehicle->stats.next_fault_flight_time_hrs < 0)
+    {
+        vehicle->stats.next_fault_flight_time_hrs = sample_flight_time_to_next_fault_hrs();
+    }
+
+    while (vehicle->stats.next_fault_flight_time_hrs <= vehicle->stats.flight_time_hrs)
+    {
+        double fault_time_hrs = time_now_hrs
+                                - (vehicle->stats.flight_time_hrs
+                                   - vehicle->stats.next_fault_flight_time_hrs);
+        record_fault(vehicle, fault_time_hrs, trace);
+        vehicle->stats.next_fault_flight_time_hrs += sample_flight_time_to_next_fault_hrs();
+    }
+}
+
+void Simulation::record_fault(Vehicle* vehicle, double time_hrs, Trace_channel* trace)
+{
+    INSTRUMENT_COUNT(FAULTS, 1);
+
+    (vehicle->stats.num_faults)++;
+    if (_options.record_fault_times)
+    {
+        vehicle->fault_times_hrs.push_back(time_hrs);
+    }
+    trace_event(trace,
+                Trace_event::FAULT,
+                vehicle - _vehicles.data(),
+                Vehicle_state::FLYING,
+                Vehicle_state::FLYING,
+                time_hrs);
+}
+
+void Simulation::try_to_charge(Vehicle* vehicle)
+{
+    INSTRUMENT_SCOPE(CHARGER_ALLOCATION);
+    INSTRUMENT_COUNT(CHARGER_REQUESTS, 1);
+
+    uint32_t i_vehicle = vehicle - _vehicles.data();
+    // the new state starts at the end of this time step
+    double time_hrs = (_current_step + 1) * _simulation_step_size_hrs;
+
+    if (_num_chargers_available > 0)
+    {
+        // start charging
+        _num_chargers_available--;
+        vehicle->stats.state = Vehicle_state::CHARGING;
+        vehicle->stats.num_steps_remaining = type_of(*vehicle).num_charge_steps;
+        (vehicle->stats.num_charges)++;
+    }
+    else
+    {
+        // get in the charge line
+        vehicle->stats.state = Vehicle_state::WAITING_FOR_CHARGER;
+        get_in_charger_line(i_vehicle);
+    }
+
+    record_state_change(i_vehicle, Vehicle_state::FLYING, vehicle->stats.state, time_hrs);
+}
+
+void Simulation::get_in_charger_line(uint32_t i_vehicle)
+{
+    INSTRUMENT_COUNT(CHARGER_WAITS, 1);
+
+    _charger_queue.push(i_vehicle, charger_priority_key(type_of(_vehicles[i_vehicle])));
+}
+
+double Simulation::charger_priority_key(const Vehicle_type& type) const
+{
+    switch (_options.charger_queue_policy)
+    {
+    case Charger_queue_policy::FIFO:
+        break;
+    case Charger_queue_policy::LOWEST_RANGE_FIRST:
+        return type.max_range_miles;
+    case Charger_queue_policy::SHORTEST_CHARGE_FIRST:
+        return type.time_to_charge_hrs;
+    }
+
+    return 0;
+}
+
+bool Simulation::release_charger(uint32_t* i_next_vehicle)
+{
+    // a charger taken away by a fork while in use goes away now, instead of to the next vehicle
+    if (_num_chargers_to_remove > 0)
+    {
+        _num_chargers_to_remove--;
+        return false;
+    }
+
+    if (_charger_queue.pop(i_next_vehicle))
+    {
+        return true;
+    }
+
+    _num_chargers_available++;
+    return false;
+}
+
+void Simulation::iterate(Vehicle* vehicle)
+{
+    Vehicle_state state_at_start = vehicle->stats.state;
+
+    switch (vehicle->stats.state)
+    {
+    case Vehicle_state::FLYING:
+    {
+        INSTRUMENT_SCOPE(FLYING_HANDLER);
+        if (vehicle->stats.last_state == Vehicle_state::CHARGING)
+        {
+            // We just started a new flight, so increment the flight counter
+            (vehicle->stats.num_flights)++;
+        }
+
+        INSTRUMENT_COUNT(FLYING_STEPS, 1);
+        vehicle->stats.flight_time_hrs += _simulation_step_size_hrs;
+        vehicle->stats.distance_miles += type_of(*vehicle).distance_per_step_miles;
+
+        check_for_fault(vehicle, _trace);
+
+        // check for conditions of next state, which are that if the vehicle is out of battery
+        // (it has flown all of its flight's time steps in this case), then it must recharge or
+        // get in line to recharge
+        (vehicle->stats.num_steps_remaining)--;
+        if (vehicle->stats.num_steps_remaining == 0)
+        {
+            vehicle->stats.battery_state_of_charge_kwh = 0;
+            try_to_charge(vehicle);
+        }
+
+        break;
+    }
+    case Vehicle_state::WAITING_FOR_CHARGER:
+    {
+        INSTRUMENT_SCOPE(WAITING_HANDLER);
+        if (vehicle->stats.last_state != Vehicle_state::WAITING_FOR_CHARGER)
+        {
+            // We just started waiting, so increment the wait counter
+            (vehicle->stats.num_times_waiting)++;
+        }
+
+        INSTRUMENT_COUNT(WAITING_STEPS, 1);
+        vehicle->stats.wait_time_hrs += _simulation_step_size_hrs;
+
+        // Nothing else to do: a vehicle waiting in line is handed a charger directly, in the
+        // `CHARGING` state below, as soon as one is released, and starts charging at the end of
+        // that time step
+        break;
+    }
+    case Vehicle_state::CHARGING:
+    {
+        INSTRUMENT_SCOPE(CHARGING_HANDLER);
+        INSTRUMENT_COUNT(CHARGING_STEPS, 1);
+        vehicle->stats.charge_time_hrs += _simulation_step_size_hrs;
+
+        // if you're fully charged, get off the charger and start flying again!
+        (vehicle->stats.num_steps_remaining)--;
+        if (vehicle->stats.num_steps_remaining == 0)
+        {
+            vehicle->stats.battery_state_of_charge_kwh = type_of(*vehicle).battery_capacity_kwh;
+
+            // the new states start at the end of this time step
+            double time_hrs = (_current_step + 1) * _simulation_step_size_hrs;
+
+            // The charger goes to the next vehicle in line now, but that vehicle still waits out
+            // this time step, and only starts charging once every vehicle has been stepped, so
+            // that it isn't also stepped as charging during this same time step
+            uint32_t i_next_vehicle;
+            if (release_charger(&i_next_vehicle))
+            {
+                _vehicles_to_start_charging.push_back(i_next_vehicle);
+            }
             vehicle->stats.state = Vehicle_state::FLYING;
+            vehicle->stats.num_steps_remaining = type_of(*vehicle).num_flight_steps;
+            record_state_change(vehicle - _vehicles.data(),
+                                Vehicle_state::CHARGING,
+                                Vehicle_state::FLYING,
+                                time_hrs);
         }
 
         break;
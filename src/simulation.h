@@ -5,6 +5,13 @@ Simulation class module
 #pragma once
 
 // local includes
+#include "charger_queue.h"
+#include "charger_site.h"
+#include "checkpoint.h"
+#include "network.h"
+#include "rng.h"
+#include "thread_pool.h"
+#include "trace.h"
 #include "utils.h"
 #include "vehicle.h"
 
@@ -15,12 +22,121 @@ Simulation class module
 // NA
 
 // C++ includes
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <random>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
+/// Which engine `Simulation::run()` uses to advance the simulation through time
+enum class Engine
+{
+    /// Iterate every vehicle forward one time step at a time, for every time step, counting down
+    /// each flight's and charge's whole number of time steps
+    STEPPED = 0,
+    /// Compute battery-empty and charge-complete times analytically, and jump straight from one
+    /// state transition to the next via a priority queue of events. Runtime scales with the number
+    /// of state transitions rather than with the simulation duration / step size.
+    EVENT_DRIVEN,
+    /// Same time stepping as `STEPPED`, but over a structure-of-arrays copy of the fleet (see
+    /// "fleet_soa.h"), using a vectorized kernel which counts down every flight and charge in
+    /// bulk. Vehicles waiting for a charger cost nothing per step. Best combined with
+    /// `Fault_model::POISSON`, which needs no random draws per step.
+    STEPPED_SOA,
+};
+
+/// How faults are sampled while a vehicle is flying
+enum class Fault_model
+{
+    /// Draw a uniform random number every flying time step, and fault if it is below
+    /// `prob_fault_per_hr * step_size_hrs`. (The event-driven engine draws the equivalent binomial
+    /// number of faults once per flight segment instead.)
+    PER_STEP_BERNOULLI = 0,
+    /// Treat faults as a Poisson process over flight time: sample the flight time until the next
+    /// fault from an exponential distribution with rate `prob_fault_per_hr`. This costs one random
+    /// draw per fault rather than one per vehicle per time step, independent of step size.
+    POISSON,
+};
+
+/// How `Simulation::populate_vehicles()` picks each vehicle's type
+enum class Fleet_sampling
+{
+    /// Draw every vehicle's type independently, by the type weights
+    RANDOM = 0,
+    /// Stratified (systematic) sampling: give each type its weight's share of the vehicles, off
+    /// by less than 1, with only which type gets each fractional vehicle drawn at random, then
+    /// shuffle which vehicle gets which type. Every type is still as likely per vehicle, but
+    /// replications no longer differ by fleet composition, so their results vary less.
+    STRATIFIED,
+};
+
+/// Optional settings for a `Simulation`; the defaults reproduce the original behavior
+struct Simulation_options
+{
+    Engine engine = Engine::STEPPED;
+    /// Seed for all random number generation in the simulation, to make runs reproducible. If not
+    /// set, the simulation is seeded nondeterministically from `std::random_device`.
+    std::optional<uint64_t> seed;
+    Fault_model fault_model = Fault_model::PER_STEP_BERNOULLI;
+    /// Threads to step a single `Engine::STEPPED_SOA` simulation with, for very large fleets, or
+    /// to run the vertiports of a `network` with; 0 means one per hardware thread. The results
+    /// are identical for any number of threads.
+    uint32_t num_threads = 1;
+    /// Set to false to always use the runtime `Engine::STEPPED_SOA` kernel, even when the fleet
+    /// matches a kernel specialized at compile time (see "fleet_soa.h"). The results are identical
+    /// either way.
+    bool specialized_kernels = true;
+    /// The order in which vehicles waiting in line get the next free charger
+    Charger_queue_policy charger_queue_policy = Charger_queue_policy::FIFO;
+    /// If enabled, model each charger's power, outages, and the site's power cap, in place of
+    /// just a number of chargers. Only the `Engine::EVENT_DRIVEN` engine models these; see
+    /// "charger_site.h".
+    Charger_site_config charger_site;
+    /// If enabled, simulate a network of vertiports, each with its own chargers, in place of the
+    /// simulation's single pool of chargers. Only the `Engine::EVENT_DRIVEN` engine simulates
+    /// networks; see "network.h".
+    Network_config network;
+    Fleet_sampling fleet_sampling = Fleet_sampling::RANDOM;
+    /// Set to true to draw every vehicle's random numbers (ex: for faults) from antithetic
+    /// streams; see `Rng::set_antithetic()`. The fleet itself is drawn as usual, so a simulation
+    /// with the same seed flies the same fleet. Set by Monte Carlo batches for the second
+    /// replication of each antithetic pair; see `Monte_carlo_config::antithetic`.
+    bool antithetic = false;
+    /// Set to true to record the simulation time of every fault in `Vehicle::fault_times_hrs`
+    bool record_fault_times = false;
+    /// If not empty, write a binary trace of every vehicle state transition and fault to this
+    /// file, for later analysis; see "trace.h"
+    std::string trace_path;
+    /// Set to false to silence progress messages, such as when running thousands of simulations
+    bool print_progress = true;
+};
+
+/// What to change in a simulation forked by `Simulation::fork()`, to explore a different future
+/// from the same point in time. Everything not changed is carried over as is.
+struct Fork_changes
+{
+    /// If set, change the number of chargers to this. Chargers are taken away idle ones first;
+    /// any more are taken away as soon as the vehicles using them finish charging. Chargers added
+    /// go straight to the vehicles waiting in line, if any.
+    std::optional<uint32_t> num_chargers;
+    /// If not empty, add `num_vehicles_added[i_vehicle_type]` new vehicles of each vehicle type,
+    /// which take off fully charged at the time of the fork
+    std::vector<uint32_t> num_vehicles_added;
+    /// If set, draw all of the fork's random numbers from here on from new streams with this
+    /// seed, so that forks with the same changes play out differently. Otherwise the fork carries
+    /// on the original's random streams, so an unchanged fork plays out exactly like the
+    /// original. Note: a fault already scheduled by `Fault_model::POISSON` is kept either way.
+    std::optional<uint64_t> seed;
+};
+
+/// Number of vehicles per chunk when summing up a simulation's results by vehicle type. Summing up
+/// a vehicle takes far less time than stepping it, so the chunks are much larger than
+/// `FLEET_SOA_CHUNK_SIZE`, and only very large fleets are summed up in parallel.
+constexpr size_t RESULTS_CHUNK_SIZE = 1 << 16;
+
 /// The main class required to create vehicles and run the whole simulation.
 /// \note  Running many simulations at once could easily be parallelized as part of a larger
 ///        Monte Carlo method simulation by creating and running one `Simulation` class per
@@ -30,7 +146,10 @@ class Simulation
 public:
     // constructor
     Simulation(
-        uint32_t num_chargers, double simulation_duration_hrs, double simulation_step_size_hrs);
+        uint32_t num_chargers,
+        double simulation_duration_hrs,
+        double simulation_step_size_hrs,
+        Simulation_options options = Simulation_options{});
 
     // returns true if successful and false otherwise
     // TODO: improve error handling; ex: return enums instead. Ex: see `enum class Error_code`
@@ -40,18 +159,110 @@ public:
 
     void populate_vehicles(uint32_t num_vehicles);
 
+    /// Same as above, but pick each vehicle's type with probability proportional to
+    /// `type_weights[i_vehicle_type]`, rather than uniformly, by
+    /// `Simulation_options::fleet_sampling`. An empty `type_weights` means uniform.
+    void populate_vehicles(uint32_t num_vehicles, const std::vector<double>& type_weights);
+
     void print_vehicle_types();
 
     void print_vehicles();
 
-    /// Run the whole simulation for all vehicles
+    /// Run the whole simulation for all vehicles--or, if paused by `run_until()`, the rest of
+    /// it--and calculate the results
     void run();
 
-    /// Print required simulation results
+    /// Run the simulation up to simulation time `time_hrs`, rounded down to a whole time step,
+    /// and pause, so that it can be checkpointed, or continued by another `run_until()` or by
+    /// `run()`. The results are identical to running it all at once. The `Engine::EVENT_DRIVEN`
+    /// engine only keeps its schedule of future events while running, so can't pause before the
+    /// end. Returns false, after printing why, if the simulation can't be run up to `time_hrs`.
+    bool run_until(double time_hrs);
+
+    /// Simulation time up to which the simulation has run so far
+    double current_time_hrs() const
+    {
+        return _current_step * _simulation_step_size_hrs;
+    }
+
+    double simulation_duration_hrs() const
+    {
+        return _simulation_duration_hrs;
+    }
+
+    /// Write the full state of this simulation, which must not have finished running, to a
+    /// checkpoint file at `path`, from which `load_checkpoint()` can resume it later. See
+    /// "checkpoint.h". Returns false, after printing why, on any error.
+    bool save_checkpoint(const std::string& path) const;
+
+    /// Same as above, but to an in-memory checkpoint
+    bool save_checkpoint(Checkpoint_writer* writer) const;
+
+    /// Recreate a simulation from a checkpoint file written by `save_checkpoint()`, ready to
+    /// continue running with `run_until()` or `run()`. A simulation resumed part way through
+    /// isn't traced, even if its options say to. Returns nullptr, after printing why, on any
+    /// error.
+    static std::unique_ptr<Simulation> load_checkpoint(const std::string& path);
+
+    /// Same as above, but from an in-memory checkpoint
+    static std::unique_ptr<Simulation> load_checkpoint(Checkpoint_reader* reader);
+
+    /// Copy this simulation, which must not have finished running, with `changes` applied, so
+    /// that the copy can run on from the same point in time, independently of this one. The
+    /// copy never prints its progress, nor writes a trace. Returns nullptr, after printing why,
+    /// if `changes` are invalid. See also `run_forks()`, in "what_if.h", to run many forks at
+    /// once.
+    std::unique_ptr<Simulation> fork(const Fork_changes& changes = Fork_changes{}) const;
+
+    /// Same as above, but fork the simulation saved in an in-memory checkpoint, so that many
+    /// forks can share one copy of the original's state
+    static std::unique_ptr<Simulation> fork(Checkpoint_reader* reader,
+                                            const Fork_changes& changes);
+
+    /// Print required simulation results, as the text report of a `Results_writer`
     void print_results();
 
+    const std::vector<Vehicle_type>& vehicle_types() const
+    {
+        return _vehicle_types;
+    }
+
+    /// The results by vehicle type, in the same order as `vehicle_types()`, once `run()` has
+    /// completed
+    const Fleet_results& results() const
+    {
+        return _results;
+    }
+
+    /// The vehicles, including their stats once `run()` has completed
+    const std::vector<Vehicle>& vehicles() const
+    {
+        return _vehicles;
+    }
+
+    /// For a network, the totals of each vertiport, once `run()` has completed
+    const std::vector<Vertiport_stats>& vertiport_stats() const
+    {
+        return _vertiport_stats;
+    }
+
+    /// The type of a vehicle of this simulation
+    const Vehicle_type& type_of(const Vehicle& vehicle) const
+    {
+        return _vehicle_types[vehicle.i_type];
+    }
+
+    /// Reset this simulation to how it was just after its vehicle types were added--with no
+    /// vehicles, and nothing run--but seeded with `seed`, and keeping all of the memory it has
+    /// allocated so far, so that it can be populated and run again without allocating, such as
+    /// for the next replication of a Monte Carlo batch. `antithetic` replaces
+    /// `Simulation_options::antithetic`.
+    void reset(uint64_t seed, bool antithetic = false);
+
 private:
     std::vector<Vehicle_type> _vehicle_types;
+    /// The fleet, stored contiguously, and sized up front by `populate_vehicles()`. Vehicles are
+    /// referred to everywhere by their index in here, which never changes.
     std::vector<Vehicle> _vehicles;
     /// Used to keep track of whether or not a particular vehicle type has already been added
     std::unordered_set<std::string> _vehicle_type_names;
@@ -59,30 +270,224 @@ private:
     const uint32_t _num_chargers;
     const double _simulation_duration_hrs;
     const double _simulation_step_size_hrs;
+    Simulation_options _options;
 
     uint32_t _num_chargers_available;
+    /// Chargers which are still in use, but are taken away as soon as they're released, after a
+    /// fork with fewer chargers
+    uint32_t _num_chargers_to_remove = 0;
+    /// The line of vehicles waiting for a charger, shared by all engines
+    Charger_queue _charger_queue;
+    /// For the `Engine::STEPPED` engine: vehicles handed a charger during the current time step,
+    /// which start charging once every vehicle has been stepped
+    std::vector<uint32_t> _vehicles_to_start_charging;
+    /// The chargers, if `Simulation_options::charger_site` is enabled
+    Charger_site _charger_site;
+    /// The totals of each vertiport, if `Simulation_options::network` is enabled
+    std::vector<Vertiport_stats> _vertiport_stats;
+    /// The results by vehicle type. Their distributions are recorded as the simulation runs; their
+    /// totals are summed up once it completes.
+    Fleet_results _results;
+    /// The results of each chunk of `RESULTS_CHUNK_SIZE` vehicles, kept to reuse their memory
+    std::vector<Fleet_results> _results_by_chunk;
+    /// The threads to run a single simulation with, per `Simulation_options::num_threads`;
+    /// created the first time they're needed, then reused. See `thread_pool()`.
+    std::unique_ptr<Thread_pool> _thread_pool;
+
+    /// The time step currently being run by the stepped engines, and, while paused, the number
+    /// of time steps run so far
+    uint64_t _current_step = 0;
+
+    enum class Run_phase : uint8_t
+    {
+        NOT_STARTED = 0,
+        /// Started, and paused by `run_until()`
+        PAUSED,
+        FINISHED,
+    };
+    Run_phase _run_phase = Run_phase::NOT_STARTED;
+
+    /// The simulation's own random number stream, used to populate the vehicles, and from which
+    /// each vehicle's stream is split
+    Rng _rng;
+
+    /// Writes the trace, if `Simulation_options::trace_path` is set; null otherwise
+    std::unique_ptr<Trace_writer> _trace_writer;
+    /// The trace channel for everything done serially; null if not tracing
+    Trace_channel* _trace = nullptr;
+
+    /// Open the trace file, if any, and trace every vehicle's initial state
+    void start_trace();
+
+    /// Write out and close the trace file, if any
+    void finish_trace();
+
+    /// Trace one event for vehicle `i_vehicle` into `trace`, unless `trace` is null
+    void trace_event(Trace_channel* trace,
+                     Trace_event event,
+                     uint32_t i_vehicle,
+                     Vehicle_state from_state,
+                     Vehicle_state to_state,
+                     double time_hrs) const
+    {
+        if (trace != nullptr)
+        {
+            trace->append({time_hrs,
+                           i_vehicle,
+                           (uint8_t)event,
+                           (uint8_t)from_state,
+                           (uint8_t)to_state,
+                           (uint8_t)_vehicles[i_vehicle].i_type});
+        }
+    }
+
+    /// Record vehicle `i_vehicle` changing state at `time_hrs`: add the stint in `from_state` which
+    /// just ended to its type's distributions, and trace the change, if tracing. Note: the caller
+    /// changes the state itself.
+    void record_state_change(uint32_t i_vehicle,
+                             Vehicle_state from_state,
+                             Vehicle_state to_state,
+                             double time_hrs);
+
+    /// Same as above, but add the stint to `distributions_by_type`, indexed by vehicle type, and
+    /// trace the change into `trace`, if not null, such as for one partition of many running in
+    /// parallel
+    void record_state_change(uint32_t i_vehicle,
+                             Vehicle_state from_state,
+                             Vehicle_state to_state,
+                             double time_hrs,
+                             std::vector<Vehicle_type_distributions>* distributions_by_type,
+                             Trace_channel* trace);
+
+    /// Load a checkpoint, applying `changes`, if not null, to make a fork
+    static std::unique_ptr<Simulation> load_checkpoint(Checkpoint_reader* reader,
+                                                       const Fork_changes* changes);
+
+    /// Apply `changes` to a newly-loaded fork of a simulation with `original_num_chargers`
+    /// chargers
+    bool apply_fork_changes(const Fork_changes& changes, uint32_t original_num_chargers);
+
+    /// Get ready to run the first time step: bind the vehicle types to the step size, set each
+    /// vehicle's time steps left in its current flight or charge, and start the distributions
+    /// and the trace
+    void start();
+
+    /// The "bind" phase of `start()`: compute each vehicle type's per-step constants for the step
+    /// size. Also done on loading a checkpoint.
+    void bind_to_step_size();
 
-    // For random number generation
+    /// Give each vehicle type's flight time histogram its bins, from 0 to its longest flight
+    void init_distributions();
 
-    std::random_device _random_device;
-    /// Standard mersenne_twister_engine
-    std::mt19937 _generator{_random_device()};
+    /// The threads to run a single simulation with, per `Simulation_options::num_threads`
+    Thread_pool* thread_pool();
 
-    /// Random number generator of `double` numbers from 0.0 to 1.0.
-    std::uniform_real_distribution<double> _dist_0_to_1{0.0, 1.0};
+    /// Check for a simulated fault this time step (while flying only). Faults are traced into
+    /// `trace`, if not null.
+    void check_for_fault(Vehicle* vehicle, Trace_channel* trace);
 
-    /// Check for a simulated fault this time step (while flying only)
-    void check_for_fault(Vehicle* vehicle);
+    /// For `Fault_model::POISSON`: count every fault which occurred as the vehicle's cumulative
+    /// flight time advanced up to its current `flight_time_hrs`, which it reached at simulation
+    /// time `time_now_hrs` after flying continuously since the faults occurred. Faults are traced
+    /// into `trace`, if not null.
+    void advance_poisson_faults(Vehicle* vehicle, double time_now_hrs, Trace_channel* trace);
+
+    /// Count one fault for this vehicle, which occurred at simulation time `time_hrs`, and trace
+    /// it into `trace`, if not null
+    void record_fault(Vehicle* vehicle, double time_hrs, Trace_channel* trace);
 
     /// Start charging now if a charger is free; otherwise, get in line to charge
     void try_to_charge(Vehicle* vehicle);
 
+    /// Put vehicle `i_vehicle` in the charger line, with its priority per
+    /// `Simulation_options::charger_queue_policy`
+    void get_in_charger_line(uint32_t i_vehicle);
+
+    /// The priority of a vehicle of type `type` in a charger line, per
+    /// `Simulation_options::charger_queue_policy`; lowest first
+    double charger_priority_key(const Vehicle_type& type) const;
+
+    /// Release a charger by handing it directly to the next vehicle in line, if any. Returns true
+    /// and sets `i_next_vehicle` if a vehicle took the charger; the caller must then start that
+    /// vehicle charging. Otherwise, returns false and the charger becomes available.
+    bool release_charger(uint32_t* i_next_vehicle);
+
     /// Iterate one time step forward in the simulation for one vehicle
     void iterate(Vehicle* vehicle);
 
+    /// Run the simulation up to time step `end_step` using the `Engine::STEPPED` engine
+    void run_stepped(uint64_t end_step);
+
+    /// Get the vehicles ready for the first time step of the `Engine::STEPPED_SOA` engine
+    void start_stepped_soa();
+
+    /// Run the simulation up to time step `end_step` using the `Engine::STEPPED_SOA` engine
+    void run_stepped_soa(uint64_t end_step);
+
+    // For the `Engine::EVENT_DRIVEN` engine
+
+    enum class Event_type
+    {
+        // Note: at equal time steps, charge-complete events are handled first, so that a vehicle
+        // whose battery empties at the same time step that a charger frees up can take it.
+        CHARGE_COMPLETE = 0,
+        /// A scheduled change to the charger site
+        SITE_CHANGE,
+        BATTERY_EMPTY,
+    };
+
+    /// A scheduled state transition for one vehicle, or change to the charger site
+    struct Event
+    {
+        uint64_t step;  /// the time step at which this event occurs
+        Event_type type;
+        /// The vehicle, or, for `Event_type::SITE_CHANGE`, the index of the change in
+        /// `Charger_site::schedule()`
+        uint32_t i_vehicle;
+
+        /// For use with a min-heap; ties are broken by vehicle index to stay deterministic
+        bool operator>(const Event& other) const
+        {
+            if (step != other.step)
+            {
+                return step > other.step;
+            }
+            if (type != other.type)
+            {
+                return type > other.type;
+            }
+            return i_vehicle > other.i_vehicle;
+        }
+    };
+
+    /// Run the whole simulation using the `Engine::EVENT_DRIVEN` engine
+    void run_event_driven();
+
+    /// Add `num_steps` time steps worth of flying, starting at time step `start_step`, to a
+    /// vehicle's stats, including sampling the faults which occurred during those steps. Faults
+    /// are traced into `trace`, if not null.
+    void add_flight_steps(Vehicle* vehicle,
+                          uint64_t start_step,
+                          uint64_t num_steps,
+                          Trace_channel* trace);
+
+    /// Run the whole simulation of a `Simulation_options::network` using the
+    /// `Engine::EVENT_DRIVEN` engine, partitioned by vertiport
+    void run_network();
+
+    /// Sum up all per-vehicle stats by vehicle type, add every vehicle's unfinished stint to its
+    /// type's distributions, and calculate the compound stats
+    void calculate_results();
+
     // for unit testing private members of this class
 
     friend class SimulationTestFixture;
     FRIEND_TEST(SimulationTestFixture, EndToEndTest);
     FRIEND_TEST(Simulation, TrivialEndToEnd);
+    FRIEND_TEST(Simulation, EventDrivenTrivialEndToEnd);
+    FRIEND_TEST(Simulation, EventDrivenMatchesStepped);
+    FRIEND_TEST(Simulation, EventDrivenEndToEnd);
+    FRIEND_TEST(Simulation, PoissonFaultsMatchBernoulliFaults);
+    FRIEND_TEST(Simulation, SoaTrivialEndToEnd);
+    FRIEND_TEST(Simulation, ChargerLineHandsOffChargers);
 };
@@ -16,9 +16,13 @@ Simulation Parameters
 // C and C++ includes
 // NA
 
-// TODO: read these as input arguments to `main()`, to rapidly run a variety of simulations.
+// Defaults only; override any of these at runtime with a scenario file or `main()` arguments. See
+// "config.h".
 constexpr uint32_t NUM_VEHICLES = 20;
 constexpr uint32_t NUM_CHARGERS = 3;
 constexpr double SIMULATION_DURATION_HRS = 3.0;
 constexpr double SIMULATION_STEP_SIZE_HRS =
     1.0 / (double)SECONDS_PER_HR;  /// 1 second time step size
+/// Number of independent replications to run in the Monte Carlo batch. 0 runs no batch, so that
+/// by default only the single run is made, as before; ask for a batch with `num_replications`.
+constexpr uint32_t NUM_REPLICATIONS = 0;
@@ -0,0 +1,349 @@
+#include "statistics.h"
+
+// local includes
+#include "checkpoint.h"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+void Running_stats::add(double sample)
+{
+    if (_count == 0)
+    {
+        _min = sample;
+        _max = sample;
+    }
+    else
+    {
+        _min = std::min(_min, sample);
+        _max = std::max(_max, sample);
+    }
+
+    _count++;
+    double delta = sample - _mean;
+    _mean += delta / _count;
+    _m2 += delta * (sample - _mean);
+}
+
+void Running_stats::merge(const Running_stats& other)
+{
+    if (other._count == 0)
+    {
+        return;
+    }
+    if (_count == 0)
+    {
+        *this = other;
+        return;
+    }
+
+    // Chan et al.'s parallel algorithm for combining two sets of Welford statistics
+    uint64_t total_count = _count + other._count;
+    double delta = other._mean - _mean;
+    _mean += delta * other._count / total_count;
+    _m2 += other._m2 + delta * delta * ((double)_count * other._count / total_count);
+    _count = total_count;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+}
+
+double Running_stats::variance() const
+{
+    if (_count < 2)
+    {
+        return 0;
+    }
+    return _m2 / (_count - 1);
+}
+
+double Running_stats::stddev() const
+{
+    return std::sqrt(variance());
+}
+
+double Running_stats::standard_error() const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+    return stddev() / std::sqrt((double)_count);
+}
+
+double Running_stats::confidence_interval_half_width(double z_score) const
+{
+    return z_score * standard_error();
+}
+
+void Replication_stats::add(double value)
+{
+    if (std::isnan(value))
+    {
+        _sample_skipped = true;
+    }
+    else
+    {
+        _replications.add(value);
+        _sample_sum += value;
+    }
+
+    _sample_size++;
+    if (_sample_size == _replications_per_sample)
+    {
+        if (!_sample_skipped)
+        {
+            _samples.add(_sample_sum / _replications_per_sample);
+        }
+        _sample_sum = 0;
+        _sample_size = 0;
+        _sample_skipped = false;
+    }
+}
+
+double Replication_stats::effective_sample_size() const
+{
+    double variance_of_mean = _samples.standard_error() * _samples.standard_error();
+    if (_samples.count() < 2 || _replications.variance() == 0)
+    {
+        return _replications.count();
+    }
+    if (variance_of_mean == 0)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    return _replications.variance() / variance_of_mean;
+}
+
+Quantile_sketch::Quantile_sketch(double relative_accuracy)
+    : _relative_accuracy{relative_accuracy},
+      _gamma{(1 + relative_accuracy) / (1 - relative_accuracy)},
+      _log_gamma{std::log(_gamma)}
+{
+}
+
+void Quantile_sketch::add(double sample)
+{
+    _count++;
+    // Note: written this way so that NaN counts as 0 too
+    if (!(sample >= QUANTILE_SKETCH_MIN_VALUE))
+    {
+        _num_zeros++;
+        return;
+    }
+
+    int32_t index = (int32_t)std::ceil(std::log(sample) / _log_gamma);
+    if (_bucket_counts.empty())
+    {
+        _min_index = index;
+        _bucket_counts.push_back(0);
+    }
+    else if (index < _min_index)
+    {
+        _bucket_counts.insert(_bucket_counts.begin(), _min_index - index, 0);
+        _min_index = index;
+    }
+    else if (index >= _min_index + (int32_t)_bucket_counts.size())
+    {
+        _bucket_counts.resize(index - _min_index + 1, 0);
+    }
+    (_bucket_counts[index - _min_index])++;
+}
+
+void Quantile_sketch::clear()
+{
+    _count = 0;
+    _num_zeros = 0;
+    _min_index = 0;
+    _bucket_counts.clear();
+}
+
+bool Quantile_sketch::merge(const Quantile_sketch& other)
+{
+    if (other._relative_accuracy != _relative_accuracy)
+    {
+        printf("Error: can't merge quantile sketches with relative accuracies of %f and %f.\n",
+               _relative_accuracy,
+               other._relative_accuracy);
+        return false;
+    }
+    if (other._count == 0)
+    {
+        return true;
+    }
+    if (_bucket_counts.empty())
+    {
+        _min_index = other._min_index;
+    }
+
+    _count += other._count;
+    _num_zeros += other._num_zeros;
+    if (other._bucket_counts.empty())
+    {
+        return true;
+    }
+
+    int32_t min_index = std::min(_min_index, other._min_index);
+    int32_t end_index = std::max(_min_index + (int32_t)_bucket_counts.size(),
+                                 other._min_index + (int32_t)other._bucket_counts.size());
+    if (min_index < _min_index)
+    {
+        _bucket_counts.insert(_bucket_counts.begin(), _min_index - min_index, 0);
+        _min_index = min_index;
+    }
+    _bucket_counts.resize(end_index - _min_index, 0);
+    for (size_t i = 0; i < other._bucket_counts.size(); i++)
+    {
+        _bucket_counts[other._min_index - _min_index + i] += other._bucket_counts[i];
+    }
+    return true;
+}
+
+void Quantile_sketch::save(Checkpoint_writer* writer) const
+{
+    writer->write(_relative_accuracy);
+    writer->write(_count);
+    writer->write(_num_zeros);
+    writer->write(_min_index);
+    writer->write_vector(_bucket_counts);
+}
+
+bool Quantile_sketch::load(Checkpoint_reader* reader)
+{
+    double relative_accuracy = 0;
+    if (!reader->read(&relative_accuracy) || !(relative_accuracy > 0 && relative_accuracy < 1))
+    {
+        return false;
+    }
+
+    *this = Quantile_sketch{relative_accuracy};
+    return reader->read(&_count) && reader->read(&_num_zeros) && reader->read(&_min_index)
+           && reader->read_vector(&_bucket_counts);
+}
+
+double Quantile_sketch::quantile(double fraction) const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+
+    // the rank, from 0, of the sample to return
+    uint64_t rank = (uint64_t)(std::clamp(fraction, 0.0, 1.0) * (_count - 1));
+    uint64_t num_at_or_below = _num_zeros;
+    if (rank < num_at_or_below)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < _bucket_counts.size(); i++)
+    {
+        num_at_or_below += _bucket_counts[i];
+        if (rank < num_at_or_below)
+        {
+            // the value within relative accuracy of every sample in the bucket
+            return 2 * std::pow(_gamma, _min_index + (int32_t)i) / (_gamma + 1);
+        }
+    }
+    return 2 * std::pow(_gamma, _min_index + (int32_t)_bucket_counts.size() - 1) / (_gamma + 1);
+}
+
+Histogram::Histogram(double min, double max, size_t num_bins)
+    : _min{min},
+      _max{max},
+      _bin_width{(max - min) / num_bins},
+      _bin_counts(num_bins, 0)
+{
+}
+
+void Histogram::reset(double min, double max, size_t num_bins)
+{
+    _min = min;
+    _max = max;
+    _bin_width = (max - min) / num_bins;
+    _bin_counts.assign(num_bins, 0);
+    _num_below = 0;
+    _num_above = 0;
+}
+
+void Histogram::add(double sample)
+{
+    if (sample < _min)
+    {
+        _num_below++;
+    }
+    else if (sample > _max || _bin_counts.empty())
+    {
+        _num_above++;
+    }
+    else
+    {
+        size_t i_bin = std::min((size_t)((sample - _min) / _bin_width), _bin_counts.size() - 1);
+        (_bin_counts[i_bin])++;
+    }
+}
+
+bool Histogram::merge(const Histogram& other)
+{
+    if (other._bin_counts.empty() && other.count() == 0)
+    {
+        return true;
+    }
+    if (_bin_counts.empty() && count() == 0)
+    {
+        *this = other;
+        return true;
+    }
+    if (other._min != _min || other._max != _max || other._bin_counts.size() != _bin_counts.size())
+    {
+        printf("Error: can't merge histograms with different bins.\n");
+        return false;
+    }
+
+    for (size_t i_bin = 0; i_bin < _bin_counts.size(); i_bin++)
+    {
+        _bin_counts[i_bin] += other._bin_counts[i_bin];
+    }
+    _num_below += other._num_below;
+    _num_above += other._num_above;
+    return true;
+}
+
+uint64_t Histogram::count() const
+{
+    uint64_t count = _num_below + _num_above;
+    for (uint64_t bin_count : _bin_counts)
+    {
+        count += bin_count;
+    }
+    return count;
+}
+
+void Histogram::save(Checkpoint_writer* writer) const
+{
+    writer->write(_min);
+    writer->write(_max);
+    writer->write(_bin_width);
+    writer->write_vector(_bin_counts);
+    writer->write(_num_below);
+    writer->write(_num_above);
+}
+
+bool Histogram::load(Checkpoint_reader* reader)
+{
+    return reader->read(&_min) && reader->read(&_max) && reader->read(&_bin_width)
+           && reader->read_vector(&_bin_counts) && reader->read(&_num_below)
+           && reader->read(&_num_above);
+}
+
+void Sample_distribution::save(Checkpoint_writer* writer) const
+{
+    writer->write(moments);
+    quantiles.save(writer);
+}
+
+bool Sample_distribution::load(Checkpoint_reader* reader)
+{
+    return reader->read(&moments) && quantiles.load(reader);
+}
@@ -0,0 +1,307 @@
+/*
+Statistics module: online, mergeable statistics accumulators. Each one takes constant (or, for
+`Quantile_sketch`, range-bounded) memory, no matter how many samples it sees, and merges exactly
+with another one of its kind, so that accumulators filled in separate threads or replications can
+be combined cheaply.
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Checkpoint_reader;
+class Checkpoint_writer;
+
+/// z-score for a two-sided 95% confidence interval of a normally-distributed mean
+constexpr double Z_95_PERCENT = 1.959964;
+
+/// Running mean and variance of a stream of samples, in constant memory, using Welford's online
+/// algorithm. Two `Running_stats` objects accumulated independently (ex: in different threads) can
+/// be merged together exactly.
+class Running_stats
+{
+public:
+    void add(double sample);
+
+    /// Merge in all the samples accumulated by `other`
+    void merge(const Running_stats& other);
+
+    uint64_t count() const
+    {
+        return _count;
+    }
+
+    double mean() const
+    {
+        return _mean;
+    }
+
+    /// Unbiased sample variance; 0 if there are fewer than 2 samples
+    double variance() const;
+
+    double stddev() const;
+
+    /// Standard error of the mean
+    double standard_error() const;
+
+    /// Half-width of the confidence interval of the mean for the given z-score. The confidence
+    /// interval is `mean() +/- confidence_interval_half_width()`.
+    double confidence_interval_half_width(double z_score = Z_95_PERCENT) const;
+
+    double min() const
+    {
+        return _min;
+    }
+
+    double max() const
+    {
+        return _max;
+    }
+
+private:
+    uint64_t _count = 0;
+    double _mean = 0;
+    /// Sum of squared differences from the mean
+    double _m2 = 0;
+    double _min = 0;
+    double _max = 0;
+};
+
+/// Running stats of one output over a batch of replications, which may be run in antithetic pairs
+/// (see `Monte_carlo_config::antithetic`). The mean and spread are over every replication, but
+/// the confidence interval is over independent samples--each replication, or each pair's mean--
+/// since the two replications of a pair are correlated.
+class Replication_stats
+{
+public:
+    explicit Replication_stats(uint32_t replications_per_sample = 1)
+        : _replications_per_sample{replications_per_sample}
+    {
+    }
+
+    /// Add the next replication's value. A NaN value is skipped, and so is the rest of its sample.
+    void add(double value);
+
+    uint64_t count() const
+    {
+        return _replications.count();
+    }
+
+    double mean() const
+    {
+        return _replications.mean();
+    }
+
+    double variance() const
+    {
+        return _replications.variance();
+    }
+
+    double stddev() const
+    {
+        return _replications.stddev();
+    }
+
+    double confidence_interval_half_width(double z_score = Z_95_PERCENT) const
+    {
+        return _samples.confidence_interval_half_width(z_score);
+    }
+
+    /// The number of independent replications which would give the mean the same variance: the
+    /// number of replications, scaled by how much pairing them reduced the variance
+    double effective_sample_size() const;
+
+    /// Over every replication
+    const Running_stats& replications() const
+    {
+        return _replications;
+    }
+
+    /// Over every independent sample
+    const Running_stats& samples() const
+    {
+        return _samples;
+    }
+
+private:
+    uint32_t _replications_per_sample;
+    Running_stats _replications;
+    Running_stats _samples;
+
+    // The sample being added
+
+    double _sample_sum = 0;
+    uint32_t _sample_size = 0;
+    bool _sample_skipped = false;
+};
+
+/// Default relative accuracy of a `Quantile_sketch`: 1%
+constexpr double QUANTILE_SKETCH_RELATIVE_ACCURACY = 0.01;
+/// Samples smaller than this are counted as exactly 0 by a `Quantile_sketch`
+constexpr double QUANTILE_SKETCH_MIN_VALUE = 1e-9;
+
+/// Approximate quantiles of a stream of non-negative samples: a DDSketch (Masson, Rim and Lee,
+/// 2019). Samples are counted in logarithmically-sized buckets, so every quantile returned is
+/// within `relative_accuracy` of a true sample, and memory grows only with the samples' dynamic
+/// range--about 1200 buckets from 1e-9 to 1e3 at 1% accuracy--never with their count. Two sketches
+/// with the same accuracy merge exactly, by adding up their bucket counts, so merging is
+/// independent of order.
+class Quantile_sketch
+{
+public:
+    explicit Quantile_sketch(double relative_accuracy = QUANTILE_SKETCH_RELATIVE_ACCURACY);
+
+    /// Negative samples are counted as 0
+    void add(double sample);
+
+    /// Merge in all the samples accumulated by `other`, which must have the same relative
+    /// accuracy. Returns false, after printing why, if it doesn't.
+    bool merge(const Quantile_sketch& other);
+
+    uint64_t count() const
+    {
+        return _count;
+    }
+
+    /// The sample at `fraction` (0 to 1) of the way through all samples, in sorted order; ex:
+    /// `quantile(0.95)` is the 95th percentile. 0 if there are no samples.
+    double quantile(double fraction) const;
+
+    double relative_accuracy() const
+    {
+        return _relative_accuracy;
+    }
+
+    /// Remove all samples, keeping the memory allocated for the buckets
+    void clear();
+
+    /// Write this sketch to a checkpoint
+    void save(Checkpoint_writer* writer) const;
+    /// Read this sketch back from a checkpoint. Returns false if the checkpoint is malformed.
+    bool load(Checkpoint_reader* reader);
+
+private:
+    double _relative_accuracy;
+    /// Bucket `i` holds samples in `(gamma^(i-1), gamma^i]`
+    double _gamma;
+    double _log_gamma;
+
+    uint64_t _count = 0;
+    uint64_t _num_zeros = 0;
+    /// The bucket index of `_bucket_counts[0]`
+    int32_t _min_index = 0;
+    std::vector<uint64_t> _bucket_counts;
+};
+
+/// Counts of samples in equal-width bins from `min` to `max`, plus counts of samples below and
+/// above that range. Two histograms with the same bins merge exactly.
+class Histogram
+{
+public:
+    /// An empty histogram with no bins, which takes on the bins of the first histogram merged in
+    Histogram() = default;
+
+    /// The last bin includes `max` itself
+    Histogram(double min, double max, size_t num_bins);
+
+    void add(double sample);
+
+    /// Merge in all the samples counted by `other`, which must have the same bins, unless either
+    /// one has no bins. Returns false, after printing why, if it doesn't.
+    bool merge(const Histogram& other);
+
+    size_t num_bins() const
+    {
+        return _bin_counts.size();
+    }
+
+    double bin_width() const
+    {
+        return _bin_width;
+    }
+
+    /// The lower edge of bin `i_bin`
+    double bin_min(size_t i_bin) const
+    {
+        return _min + i_bin * _bin_width;
+    }
+
+    uint64_t bin_count(size_t i_bin) const
+    {
+        return _bin_counts[i_bin];
+    }
+
+    uint64_t num_below() const
+    {
+        return _num_below;
+    }
+
+    uint64_t num_above() const
+    {
+        return _num_above;
+    }
+
+    /// Total number of samples, including those out of range
+    uint64_t count() const;
+
+    /// Same as assigning `Histogram{min, max, num_bins}`, but reusing the memory already
+    /// allocated for the bins
+    void reset(double min, double max, size_t num_bins);
+
+    /// Remove all samples, keeping the bins
+    void clear()
+    {
+        reset(_min, _max, _bin_counts.size());
+    }
+
+    /// Write this histogram to a checkpoint
+    void save(Checkpoint_writer* writer) const;
+    /// Read this histogram back from a checkpoint. Returns false if the checkpoint is malformed.
+    bool load(Checkpoint_reader* reader);
+
+private:
+    double _min = 0;
+    double _max = 0;
+    double _bin_width = 0;
+    std::vector<uint64_t> _bin_counts;
+    uint64_t _num_below = 0;
+    uint64_t _num_above = 0;
+};
+
+/// The distribution of a stream of non-negative samples: the exact mean, variance, min and max,
+/// plus approximate quantiles
+struct Sample_distribution
+{
+    Running_stats moments;
+    Quantile_sketch quantiles;
+
+    void add(double sample)
+    {
+        moments.add(sample);
+        quantiles.add(sample);
+    }
+
+    void merge(const Sample_distribution& other)
+    {
+        moments.merge(other.moments);
+        quantiles.merge(other.quantiles);
+    }
+
+    void clear()
+    {
+        moments = Running_stats{};
+        quantiles.clear();
+    }
+
+    void save(Checkpoint_writer* writer) const;
+    bool load(Checkpoint_reader* reader);
+};
@@ -0,0 +1,273 @@
+#include "sweep.h"
+
+// local includes
+#include "thread_pool.h"
+
+// C++ includes
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+void Sweep_point::add_replication(const std::vector<Vehicle_type_stats>& replication_stats)
+{
+    results.add_replication(replication_stats);
+}
+
+/// Build every combination of values in `grid`. Each grid point's scenario is built once and then
+/// only shared, never copied, by its replications.
+static std::vector<Sweep_point> make_grid(const Scenario& base_scenario,
+                                          const Sweep_grid& grid,
+                                          bool antithetic)
+{
+    // an empty list means "just the base scenario's value"
+    std::vector<uint32_t> num_chargers_values = grid.num_chargers;
+    if (num_chargers_values.empty())
+    {
+        num_chargers_values.push_back(base_scenario.num_chargers);
+    }
+    std::vector<uint32_t> num_vehicles_values = grid.num_vehicles;
+    if (num_vehicles_values.empty())
+    {
+        num_vehicles_values.push_back(base_scenario.num_vehicles);
+    }
+    std::vector<double> duration_values = grid.simulation_duration_hrs;
+    if (duration_values.empty())
+    {
+        duration_values.push_back(base_scenario.simulation_duration_hrs);
+    }
+    std::vector<std::vector<double>> fleet_mixes = grid.fleet_mixes;
+    if (fleet_mixes.empty())
+    {
+        fleet_mixes.push_back(base_scenario.fleet_mix);
+    }
+
+    std::vector<Sweep_point> points;
+    for (const std::vector<double>& fleet_mix : fleet_mixes)
+    {
+        for (double duration_hrs : duration_values)
+        {
+            for (uint32_t num_vehicles : num_vehicles_values)
+            {
+                for (uint32_t num_chargers : num_chargers_values)
+                {
+                    auto scenario = std::make_shared<Scenario>(base_scenario);
+                    scenario->num_chargers = num_chargers;
+                    scenario->num_vehicles = num_vehicles;
+                    scenario->simulation_duration_hrs = duration_hrs;
+                    scenario->fleet_mix = fleet_mix;
+                    points.emplace_back(scenario, antithetic);
+                }
+            }
+        }
+    }
+
+    return points;
+}
+
+std::vector<Sweep_point> run_sweep(
+    const Scenario& base_scenario, const Sweep_grid& grid, const Monte_carlo_config& config)
+{
+    std::vector<Sweep_point> points = make_grid(base_scenario, grid, config.antithetic);
+    for (const Sweep_point& point : points)
+    {
+        if (!is_valid(*point.scenario))
+        {
+            return {};
+        }
+    }
+
+    /// One replication of one grid point
+    struct Job
+    {
+        size_t i_point;
+        uint64_t i_replication;
+    };
+
+    auto time_start = std::chrono::steady_clock::now();
+
+    Precision_targets targets = config.precision_targets;
+    if (grid.target_relative_ci > 0)
+    {
+        targets.total_num_passenger_miles = grid.target_relative_ci;
+    }
+
+    std::vector<bool> is_running(points.size(), true);
+    size_t num_running = points.size();
+    uint64_t batch_size = std::max(1U, grid.batch_size);
+    // Keep both halves of each antithetic pair in the same round, so that no grid point stops
+    // between them
+    if (config.antithetic)
+    {
+        batch_size += batch_size % 2;
+    }
+    Thread_pool thread_pool{config.num_threads};
+
+    // Run in rounds: each round schedules the next batch of replications of every still-running
+    // grid point over the whole thread pool at once, so that small grid points don't leave
+    // threads idle. Between rounds, grid points which are precise enough are stopped.
+    /// A simulation kept by one worker thread, to reuse for the replications of one grid point
+    struct Worker_simulation
+    {
+        size_t i_point = SIZE_MAX;
+        std::unique_ptr<Simulation> simulation;
+    };
+    std::vector<Worker_simulation> worker_simulations(thread_pool.num_threads());
+
+    while (num_running > 0)
+    {
+        std::vector<Job> jobs;
+        for (size_t i_point = 0; i_point < points.size(); i_point++)
+        {
+            if (!is_running[i_point])
+            {
+                continue;
+            }
+
+            uint64_t i_first = points[i_point].results.num_replications;
+            uint64_t i_end = std::min<uint64_t>(config.num_replications, i_first + batch_size);
+            for (uint64_t i_replication = i_first; i_replication < i_end; i_replication++)
+            {
+                jobs.push_back({i_point, i_replication});
+            }
+        }
+
+        std::vector<std::vector<Vehicle_type_stats>> results_by_job(jobs.size());
+        thread_pool.parallel_for_by_worker(jobs.size(), [&](uint64_t i_job, uint32_t i_worker) {
+            const Job& job = jobs[i_job];
+            // each worker reuses its simulation for as long as it keeps running the same grid
+            // point, which, since jobs are dealt out in contiguous blocks, is most of the time
+            Worker_simulation& worker_simulation = worker_simulations[i_worker];
+            if (worker_simulation.i_point != job.i_point)
+            {
+                worker_simulation.i_point = job.i_point;
+                worker_simulation.simulation.reset();
+            }
+            // every grid point gets its own independent stream of replication seeds, unless
+            // they all share one, to compare them by common random numbers
+            uint64_t point_seed = config.common_random_numbers
+                                      ? config.base_seed
+                                      : replication_seed(config.base_seed, job.i_point);
+            bool antithetic = false;
+            uint64_t seed = replication_seed(
+                point_seed, job.i_replication, config.antithetic, &antithetic);
+            results_by_job[i_job] = run_replication(*points[job.i_point].scenario,
+                                                    seed,
+                                                    &worker_simulation.simulation,
+                                                    antithetic);
+        });
+
+        // fold results in job order, so they don't depend on the number of threads
+        for (size_t i_job = 0; i_job < jobs.size(); i_job++)
+        {
+            if (!results_by_job[i_job].empty())
+            {
+                points[jobs[i_job].i_point].add_replication(results_by_job[i_job]);
+            }
+        }
+
+        double elapsed_sec =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+        bool out_of_time = config.time_budget_sec > 0 && elapsed_sec >= config.time_budget_sec;
+
+        for (size_t i_point = 0; i_point < points.size(); i_point++)
+        {
+            if (!is_running[i_point])
+            {
+                continue;
+            }
+
+            Sweep_point& point = points[i_point];
+            if (point.results.num_replications >= config.num_replications)
+            {
+                point.results.stop_reason = Stop_reason::ALL_REPLICATIONS_RUN;
+            }
+            else if (point.results.meets(targets))
+            {
+                point.converged = true;
+                point.results.stop_reason = Stop_reason::PRECISION_REACHED;
+            }
+            else if (out_of_time)
+            {
+                point.results.stop_reason = Stop_reason::TIME_BUDGET_SPENT;
+            }
+            else
+            {
+                continue;
+            }
+
+            point.results.wall_time_sec = elapsed_sec;
+            is_running[i_point] = false;
+            num_running--;
+        }
+    }
+
+    return points;
+}
+
+void print_sweep_results(const std::vector<Sweep_point>& points)
+{
+    printf(
+        "\nSweep results: %lu grid points\n"
+        "- Totals are summed over all vehicle types, per replication: mean +/- 95%% confidence "
+        "interval half-width\n"
+        "- ess = effective sample size of the total passenger miles\n\n",
+        points.size());
+
+    printf(
+        "%8s %8s %8s %-20s %8s %8s %28s %20s %20s\n",
+        "chargers",
+        "vehicles",
+        "hrs",
+        "fleet_mix",
+        "reps",
+        "ess",
+        "total_passenger_miles",
+        "total_faults",
+        "total_wait_hrs");
+
+    for (const Sweep_point& point : points)
+    {
+        std::string fleet_mix = "uniform";
+        if (!point.scenario->fleet_mix.empty())
+        {
+            fleet_mix.clear();
+            for (double weight : point.scenario->fleet_mix)
+            {
+                char weight_str[32];
+                snprintf(weight_str, sizeof(weight_str), "%s%g", fleet_mix.empty() ? "" : ":", weight);
+                fleet_mix += weight_str;
+            }
+        }
+
+        const char* stop_mark = " ";
+        if (point.converged)
+        {
+            stop_mark = "*";
+        }
+        else if (point.results.stop_reason == Stop_reason::TIME_BUDGET_SPENT)
+        {
+            stop_mark = "t";
+        }
+
+        printf(
+            "%8u %8u %8.2f %-20s %7u%s %8.0f %14.2f +/- %9.2f %9.2f +/- %6.2f %9.2f +/- %6.2f\n",
+            point.scenario->num_chargers,
+            point.scenario->num_vehicles,
+            point.scenario->simulation_duration_hrs,
+            fleet_mix.c_str(),
+            point.results.num_replications,
+            stop_mark,
+            point.results.total_num_passenger_miles.effective_sample_size(),
+            point.results.total_num_passenger_miles.mean(),
+            point.results.total_num_passenger_miles.confidence_interval_half_width(),
+            point.results.total_num_faults.mean(),
+            point.results.total_num_faults.confidence_interval_half_width(),
+            point.results.total_wait_time_hrs.mean(),
+            point.results.total_wait_time_hrs.confidence_interval_half_width());
+    }
+
+    printf("\n* = stopped early, once the target confidence interval was reached\n"
+           "t = stopped when the sweep's time budget ran out\n");
+}
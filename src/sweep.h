@@ -0,0 +1,81 @@
+/*
+Parameter sweep module: run a Monte Carlo batch for every point in a grid of scenarios (ex: to
+answer "how many chargers do we need for a fleet of size X?"), scheduling all of the grid points'
+replications together over one thread pool, and stopping each grid point early once its results
+are precise enough, and the whole sweep once its time budget is spent.
+*/
+
+#pragma once
+
+// local includes
+#include "monte_carlo.h"
+#include "scenario.h"
+#include "statistics.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// The grid of scenarios to sweep over: every combination of the values below is run. An empty
+/// list means "just use the base scenario's value".
+struct Sweep_grid
+{
+    std::vector<uint32_t> num_chargers;
+    std::vector<uint32_t> num_vehicles;
+    std::vector<double> simulation_duration_hrs;
+    /// Each entry is one `Scenario::fleet_mix`
+    std::vector<std::vector<double>> fleet_mixes;
+
+    /// Replications are scheduled in rounds of this many per still-running grid point. Rounded up
+    /// to even for `Monte_carlo_config::antithetic`, to keep each pair in one round.
+    uint32_t batch_size = 100;
+    /// Stop running a grid point's replications early, at the end of a round, once the 95%
+    /// confidence interval half-width of its mean total passenger miles is within this fraction of
+    /// that mean. Overrides `Monte_carlo_config::precision_targets.total_num_passenger_miles`, if
+    /// set; a grid point stops once it meets all of those targets.
+    double target_relative_ci = 0;
+
+    /// True if no values to sweep over have been given
+    bool empty() const
+    {
+        return num_chargers.empty() && num_vehicles.empty() && simulation_duration_hrs.empty()
+               && fleet_mixes.empty();
+    }
+};
+
+/// One point in the grid, and its results
+struct Sweep_point
+{
+    /// Immutable, and shared by all of this grid point's replications rather than copied per job
+    std::shared_ptr<const Scenario> scenario;
+    /// Per vehicle type and fleet-wide results
+    Monte_carlo_results results;
+
+    /// True if this grid point stopped early because it met its precision targets
+    bool converged = false;
+
+    /// `antithetic`: if this grid point's replications are run in antithetic pairs
+    explicit Sweep_point(std::shared_ptr<const Scenario> scenario_, bool antithetic = false)
+        : scenario{scenario_}, results{scenario_->vehicle_types, antithetic}
+    {
+    }
+
+    /// Fold in the results of one replication of this grid point
+    void add_replication(const std::vector<Vehicle_type_stats>& replication_stats);
+};
+
+/// Run every grid point in `grid`, built from `base_scenario`, for up to
+/// `config.num_replications` replications each, or until `config.time_budget_sec` runs out.
+/// Results are deterministic for a given `config.base_seed`, regardless of `config.num_threads`,
+/// unless stopped by the time budget. Every grid point gets its own independent replication seeds,
+/// unless `config.common_random_numbers`. `config.batch_size` is ignored, for
+/// `grid.batch_size`.
+std::vector<Sweep_point> run_sweep(
+    const Scenario& base_scenario, const Sweep_grid& grid, const Monte_carlo_config& config);
+
+/// Print all grid points' results as a single table, one row per grid point
+void print_sweep_results(const std::vector<Sweep_point>& points);
@@ -0,0 +1,153 @@
+#include "thread_pool.h"
+
+// C++ includes
+#include <algorithm>
+
+Thread_pool::Thread_pool(uint32_t num_threads)
+    : _num_threads{num_threads > 0 ? num_threads
+                                   : std::max(1U, std::thread::hardware_concurrency())}
+{
+    _task_queues.reserve(_num_threads);
+    for (uint32_t i = 0; i < _num_threads; i++)
+    {
+        _task_queues.push_back(std::make_unique<Task_queue>());
+    }
+
+    // worker 0 is the thread which calls `parallel_for()`
+    _threads.reserve(_num_threads - 1);
+    for (uint32_t i_worker = 1; i_worker < _num_threads; i_worker++)
+    {
+        _threads.emplace_back(&Thread_pool::worker_loop, this, i_worker);
+    }
+}
+
+Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _start_cv.notify_all();
+
+    for (std::thread& thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+void Thread_pool::parallel_for(uint64_t num_tasks, const std::function<void(uint64_t)>& task)
+{
+    parallel_for_by_worker(num_tasks, [&task](uint64_t i_task, uint32_t) { task(i_task); });
+}
+
+void Thread_pool::parallel_for_by_worker(uint64_t num_tasks,
+                                         const std::function<void(uint64_t, uint32_t)>& task)
+{
+    if (num_tasks == 0)
+    {
+        return;
+    }
+
+    // Deal out contiguous blocks of task indices to each worker's queue, so that neighboring
+    // tasks tend to run on the same thread, and stealing only kicks in to balance the load.
+    uint64_t num_tasks_per_worker = (num_tasks + _num_threads - 1) / _num_threads;
+    for (uint32_t i_worker = 0; i_worker < _num_threads; i_worker++)
+    {
+        uint64_t i_begin = std::min(num_tasks, i_worker * num_tasks_per_worker);
+        uint64_t i_end = std::min(num_tasks, i_begin + num_tasks_per_worker);
+
+        Task_queue& task_queue = *_task_queues[i_worker];
+        std::lock_guard<std::mutex> lock(task_queue.mutex);
+        for (uint64_t i_task = i_begin; i_task < i_end; i_task++)
+        {
+            task_queue.task_indices.push_back(i_task);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _generation++;
+        _num_threads_busy = _threads.size();
+    }
+    _start_cv.notify_all();
+
+    run_tasks(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this]() { return _num_threads_busy == 0; });
+    _task = nullptr;
+}
+
+void Thread_pool::worker_loop(uint32_t i_worker)
+{
+    uint64_t last_generation = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _start_cv.wait(
+                lock, [&]() { return _stop || _generation != last_generation; });
+            if (_stop)
+            {
+                return;
+            }
+            last_generation = _generation;
+        }
+
+        run_tasks(i_worker);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _num_threads_busy--;
+            if (_num_threads_busy == 0)
+            {
+                _done_cv.notify_all();
+            }
+        }
+    }
+}
+
+void Thread_pool::run_tasks(uint32_t i_worker)
+{
+    uint64_t task_index;
+    while (pop_own_task(i_worker, &task_index) || steal_task(i_worker, &task_index))
+    {
+        (*_task)(task_index, i_worker);
+    }
+}
+
+bool Thread_pool::pop_own_task(uint32_t i_worker, uint64_t* task_index)
+{
+    Task_queue& task_queue = *_task_queues[i_worker];
+    std::lock_guard<std::mutex> lock(task_queue.mutex);
+    if (task_queue.task_indices.empty())
+    {
+        return false;
+    }
+
+    // take from the front of our own queue, in index order
+    *task_index = task_queue.task_indices.front();
+    task_queue.task_indices.pop_front();
+    return true;
+}
+
+bool Thread_pool::steal_task(uint32_t i_worker, uint64_t* task_index)
+{
+    // Try every other worker once, starting with the next one over, and steal from the back of
+    // its queue--the end furthest from where its owner is working
+    for (uint32_t offset = 1; offset < _num_threads; offset++)
+    {
+        Task_queue& task_queue = *_task_queues[(i_worker + offset) % _num_threads];
+        std::lock_guard<std::mutex> lock(task_queue.mutex);
+        if (!task_queue.task_indices.empty())
+        {
+            *task_index = task_queue.task_indices.back();
+            task_queue.task_indices.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
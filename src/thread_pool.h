@@ -0,0 +1,85 @@
+/*
+Thread pool module: a small work-stealing thread pool for running many independent tasks, such as
+Monte Carlo replications, across all hardware threads.
+*/
+
+#pragma once
+
+// local includes
+// NA
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// A fixed-size pool of worker threads. Each worker owns a queue of task indices; when a worker
+/// runs out of its own work it steals from the other end of another worker's queue, so that tasks
+/// of very uneven duration still balance out across all threads.
+class Thread_pool
+{
+public:
+    /// Create a pool with `num_threads` threads, including the calling thread. 0 means one thread
+    /// per hardware thread.
+    explicit Thread_pool(uint32_t num_threads = 0);
+    ~Thread_pool();
+
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator=(const Thread_pool&) = delete;
+
+    /// Call `task(i)` for every `i` in the range [0, num_tasks), in parallel, and block until all
+    /// calls have returned. The calling thread participates as worker 0. Not reentrant: `task`
+    /// must not itself call `parallel_for()` on the same pool.
+    void parallel_for(uint64_t num_tasks, const std::function<void(uint64_t)>& task);
+
+    /// Same as above, but call `task(i, i_worker)`, where `i_worker`, in the range
+    /// [0, num_threads()), is the worker running the task, so that each worker can keep scratch
+    /// state of its own, and reuse it from task to task without any locking
+    void parallel_for_by_worker(uint64_t num_tasks,
+                                const std::function<void(uint64_t, uint32_t)>& task);
+
+    uint32_t num_threads() const
+    {
+        return _num_threads;
+    }
+
+private:
+    /// One task queue per worker
+    struct Task_queue
+    {
+        std::mutex mutex;
+        std::deque<uint64_t> task_indices;
+    };
+
+    const uint32_t _num_threads;
+    std::vector<std::thread> _threads;
+    std::vector<std::unique_ptr<Task_queue>> _task_queues;
+
+    /// Protects all members below
+    std::mutex _mutex;
+    std::condition_variable _start_cv;
+    std::condition_variable _done_cv;
+    const std::function<void(uint64_t, uint32_t)>* _task = nullptr;
+    /// Incremented every time `parallel_for()` hands out a new batch of work
+    uint64_t _generation = 0;
+    /// Number of spawned threads still working on the current batch
+    uint32_t _num_threads_busy = 0;
+    bool _stop = false;
+
+    void worker_loop(uint32_t i_worker);
+
+    /// Run tasks from worker `i_worker`'s own queue, then steal from the others, until no tasks
+    /// remain anywhere
+    void run_tasks(uint32_t i_worker);
+
+    bool pop_own_task(uint32_t i_worker, uint64_t* task_index);
+    bool steal_task(uint32_t i_worker, uint64_t* task_index);
+};
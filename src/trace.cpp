@@ -0,0 +1,336 @@
+#include "trace.h"
+
+// Linux includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// C++ includes
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+Trace_vehicle_type make_trace_vehicle_type(const Vehicle_type& vehicle_type)
+{
+    Trace_vehicle_type trace_vehicle_type{};
+    strncpy(trace_vehicle_type.name,
+            vehicle_type.name.c_str(),
+            sizeof(trace_vehicle_type.name) - 1);
+    trace_vehicle_type.cruise_speed_mph = vehicle_type.cruise_speed_mph;
+    trace_vehicle_type.battery_capacity_kwh = vehicle_type.battery_capacity_kwh;
+    trace_vehicle_type.time_to_charge_hrs = vehicle_type.time_to_charge_hrs;
+    trace_vehicle_type.energy_used_kwh_per_mile = vehicle_type.energy_used_kwh_per_mile;
+    trace_vehicle_type.prob_fault_per_hr = vehicle_type.prob_fault_per_hr;
+    trace_vehicle_type.passengers_per_vehicle = vehicle_type.passengers_per_vehicle;
+    return trace_vehicle_type;
+}
+
+const char* trace_event_name(Trace_event event)
+{
+    switch (event)
+    {
+    case Trace_event::INITIAL_STATE:
+        return "initial_state";
+    case Trace_event::STATE_CHANGE:
+        return "state_change";
+    case Trace_event::FAULT:
+        return "fault";
+    }
+
+    return "unknown";
+}
+
+Trace_channel::Trace_channel(Trace_writer* writer)
+    : _writer{writer},
+      _block{writer->exchange_block(nullptr)}
+{
+}
+
+void Trace_channel::flush()
+{
+    if (_block->num_records > 0)
+    {
+        _block = _writer->exchange_block(std::move(_block));
+    }
+}
+
+Trace_writer::~Trace_writer()
+{
+    close();
+}
+
+bool Trace_writer::open(const std::string& path,
+                        Trace_file_header header,
+                        const std::vector<Trace_vehicle_type>& vehicle_types)
+{
+    if (vehicle_types.size() > TRACE_MAX_NUM_VEHICLE_TYPES)
+    {
+        printf("Error: a trace can hold at most %lu vehicle types, but got %lu.\n",
+               TRACE_MAX_NUM_VEHICLE_TYPES,
+               vehicle_types.size());
+        return false;
+    }
+
+    _file = fopen(path.c_str(), "wb");
+    if (_file == nullptr)
+    {
+        printf("Error: failed to open trace file \"%s\": %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    _path = path;
+
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.record_size = sizeof(Trace_record);
+    header.num_vehicle_types = vehicle_types.size();
+
+    if (fwrite(&header, sizeof(header), 1, _file) != 1
+        || fwrite(vehicle_types.data(), sizeof(Trace_vehicle_type), vehicle_types.size(), _file)
+               != vehicle_types.size())
+    {
+        printf("Error: failed to write trace file \"%s\".\n", path.c_str());
+        fclose(_file);
+        _file = nullptr;
+        return false;
+    }
+
+    _closing = false;
+    _write_failed = false;
+    _io_thread = std::thread(&Trace_writer::io_loop, this);
+    return true;
+}
+
+Trace_channel* Trace_writer::add_channel()
+{
+    _channels.push_back(std::make_unique<Trace_channel>(this));
+    return _channels.back().get();
+}
+
+bool Trace_writer::close()
+{
+    if (_file == nullptr)
+    {
+        return true;
+    }
+
+    for (std::unique_ptr<Trace_channel>& channel : _channels)
+    {
+        channel->flush();
+    }
+    _channels.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closing = true;
+    }
+    _cv.notify_all();
+    _io_thread.join();
+
+    bool success = !_write_failed;
+    if (fclose(_file) != 0)
+    {
+        success = false;
+    }
+    _file = nullptr;
+    _free_blocks.clear();
+
+    if (!success)
+    {
+        printf("Error: failed to write trace file \"%s\".\n", _path.c_str());
+    }
+    return success;
+}
+
+std::unique_ptr<Trace_block> Trace_writer::exchange_block(std::unique_ptr<Trace_block> full_block)
+{
+    std::unique_ptr<Trace_block> empty_block;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (full_block)
+        {
+            _full_blocks.push_back(std::move(full_block));
+        }
+        if (!_free_blocks.empty())
+        {
+            empty_block = std::move(_free_blocks.back());
+            _free_blocks.pop_back();
+        }
+    }
+    _cv.notify_one();
+
+    // Never wait for the I/O thread to free up a block; allocate a new one instead
+    if (!empty_block)
+    {
+        empty_block = std::make_unique<Trace_block>();
+    }
+    empty_block->num_records = 0;
+    return empty_block;
+}
+
+void Trace_writer::io_loop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _cv.wait(lock, [this]() { return _closing || !_full_blocks.empty(); });
+        if (_full_blocks.empty())
+        {
+            // closing, and everything has been written
+            return;
+        }
+
+        std::unique_ptr<Trace_block> block = std::move(_full_blocks.front());
+        _full_blocks.pop_front();
+
+        // write without holding the lock, so producers can keep handing off blocks
+        lock.unlock();
+        bool write_failed = fwrite(block->records.data(),
+                                   sizeof(Trace_record),
+                                   block->num_records,
+                                   _file)
+                            != block->num_records;
+        lock.lock();
+
+        _write_failed = _write_failed || write_failed;
+        _free_blocks.push_back(std::move(block));
+    }
+}
+
+Trace_reader::~Trace_reader()
+{
+    if (_file != nullptr)
+    {
+        fclose(_file);
+    }
+}
+
+bool Trace_reader::open(const std::string& path)
+{
+    _file = fopen(path.c_str(), "rb");
+    if (_file == nullptr)
+    {
+        printf("Error: failed to open trace file \"%s\": %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    if (fread(&_header, sizeof(_header), 1, _file) != 1
+        || memcmp(_header.magic, TRACE_FILE_MAGIC, sizeof(_header.magic)) != 0)
+    {
+        printf("Error: \"%s\" is not a trace file.\n", path.c_str());
+        return false;
+    }
+    if (_header.version != TRACE_FILE_VERSION || _header.record_size != sizeof(Trace_record))
+    {
+        printf("Error: trace file \"%s\" is version %u with %u-byte records, but only version %u "
+               "with %lu-byte records is supported.\n",
+               path.c_str(),
+               _header.version,
+               _header.record_size,
+               TRACE_FILE_VERSION,
+               sizeof(Trace_record));
+        return false;
+    }
+
+    _vehicle_types.resize(_header.num_vehicle_types);
+    if (fread(_vehicle_types.data(), sizeof(Trace_vehicle_type), _vehicle_types.size(), _file)
+        != _vehicle_types.size())
+    {
+        printf("Error: trace file \"%s\" is truncated.\n", path.c_str());
+        return false;
+    }
+
+    _buffer.clear();
+    _i_buffer = 0;
+    return true;
+}
+
+bool Trace_reader::next(Trace_record* record)
+{
+    if (_i_buffer == _buffer.size())
+    {
+        _buffer.resize(TRACE_BLOCK_NUM_RECORDS);
+        size_t num_records = fread(_buffer.data(), sizeof(Trace_record), _buffer.size(), _file);
+        _buffer.resize(num_records);
+        _i_buffer = 0;
+        if (num_records == 0)
+        {
+            return false;
+        }
+    }
+
+    *record = _buffer[_i_buffer];
+    _i_buffer++;
+    return true;
+}
+
+Trace_mapped_file::~Trace_mapped_file()
+{
+    if (_data != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+}
+
+bool Trace_mapped_file::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Error: failed to open trace file \"%s\": %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(Trace_file_header))
+    {
+        printf("Error: \"%s\" is not a trace file.\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    _size = file_stat.st_size;
+
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the file is closed
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("Error: failed to map trace file \"%s\": %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    _data = static_cast<const uint8_t*>(data);
+    // records are scanned front to back, so read ahead aggressively
+    madvise(data, _size, MADV_SEQUENTIAL);
+
+    const Trace_file_header& header_ = header();
+    if (memcmp(header_.magic, TRACE_FILE_MAGIC, sizeof(header_.magic)) != 0)
+    {
+        printf("Error: \"%s\" is not a trace file.\n", path.c_str());
+        return false;
+    }
+    if (header_.version != TRACE_FILE_VERSION || header_.record_size != sizeof(Trace_record))
+    {
+        printf("Error: trace file \"%s\" is version %u with %u-byte records, but only version %u "
+               "with %lu-byte records is supported.\n",
+               path.c_str(),
+               header_.version,
+               header_.record_size,
+               TRACE_FILE_VERSION,
+               sizeof(Trace_record));
+        return false;
+    }
+
+    size_t records_offset =
+        sizeof(Trace_file_header) + header_.num_vehicle_types * sizeof(Trace_vehicle_type);
+    if (_size < records_offset)
+    {
+        printf("Error: trace file \"%s\" is truncated.\n", path.c_str());
+        return false;
+    }
+
+    _records = reinterpret_cast<const Trace_record*>(_data + records_offset);
+    // ignore any partially-written record at the end
+    _num_records = (_size - records_offset) / sizeof(Trace_record);
+    return true;
+}
@@ -0,0 +1,269 @@
+/*
+Trace module: an opt-in, compact binary trace of every vehicle state transition and fault in a
+simulation run, plus readers for it: a streaming reader, and a zero-copy memory-mapped view.
+
+File layout, in native byte order, with every section a multiple of 16 bytes so that records stay
+aligned:
+1. one `Trace_file_header`
+1. `Trace_file_header::num_vehicle_types` `Trace_vehicle_type`s
+1. `Trace_record`s until the end of the file
+
+Records are written in blocks, one block at a time per `Trace_channel`. Records from the same
+channel are in time order, but blocks from different channels may interleave, so sort by
+`Trace_record::time_hrs` if a global time order is needed.
+*/
+
+#pragma once
+
+// local includes
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr char TRACE_FILE_MAGIC[8] = {'E', 'V', 'T', 'O', 'L', 'T', 'R', 'C'};
+constexpr uint32_t TRACE_FILE_VERSION = 1;
+
+/// Number of records per block handed from a `Trace_channel` to the I/O thread: 64 KiB
+constexpr size_t TRACE_BLOCK_NUM_RECORDS = 4096;
+
+struct Trace_file_header
+{
+    char magic[8];
+    uint32_t version;
+    /// `sizeof(Trace_record)`, as written
+    uint32_t record_size;
+    uint32_t num_vehicle_types;
+    uint32_t num_vehicles;
+    uint32_t num_chargers;
+    uint32_t reserved;
+    double simulation_duration_hrs;
+    double simulation_step_size_hrs;
+};
+static_assert(sizeof(Trace_file_header) == 48, "Trace_file_header must be packed");
+
+/// The parameters of one vehicle type, as needed to interpret and analyze a trace without the
+/// scenario it came from
+struct Trace_vehicle_type
+{
+    /// Null-terminated, and truncated if need be
+    char name[32];
+    double cruise_speed_mph;
+    double battery_capacity_kwh;
+    double time_to_charge_hrs;
+    double energy_used_kwh_per_mile;
+    double prob_fault_per_hr;
+    uint32_t passengers_per_vehicle;
+    uint32_t reserved;
+};
+static_assert(sizeof(Trace_vehicle_type) == 80, "Trace_vehicle_type must be packed");
+
+Trace_vehicle_type make_trace_vehicle_type(const Vehicle_type& vehicle_type);
+
+enum class Trace_event : uint8_t
+{
+    /// The state each vehicle starts the simulation in, at time 0; `from_state == to_state`
+    INITIAL_STATE = 0,
+    /// A vehicle changed from `from_state` to `to_state`. Note that a vehicle being assigned a
+    /// charger is a change into `Vehicle_state::CHARGING`, since chargers are interchangeable.
+    STATE_CHANGE,
+    /// A fault, while flying; `from_state == to_state`
+    FAULT,
+};
+
+const char* trace_event_name(Trace_event event);
+
+/// One event in the trace
+struct Trace_record
+{
+    /// Simulation time of the event
+    double time_hrs;
+    uint32_t i_vehicle;
+    /// `Trace_event`
+    uint8_t event;
+    /// `Vehicle_state`
+    uint8_t from_state;
+    /// `Vehicle_state`
+    uint8_t to_state;
+    /// Index into the vehicle types which follow the header
+    uint8_t i_vehicle_type;
+};
+static_assert(sizeof(Trace_record) == 16, "Trace_record must be packed");
+
+/// The most vehicle types a trace can hold, since `Trace_record::i_vehicle_type` is 1 byte
+constexpr size_t TRACE_MAX_NUM_VEHICLE_TYPES = 256;
+
+class Trace_writer;
+
+/// A fixed-size block of records, filled by one channel and then written by the I/O thread
+struct Trace_block
+{
+    size_t num_records = 0;
+    std::array<Trace_record, TRACE_BLOCK_NUM_RECORDS> records;
+};
+
+/// One producer's stream of records into a `Trace_writer`. Appending is lock-free: records go
+/// into the channel's own block, which is handed off to the writer's I/O thread only once full.
+/// Each channel must only be appended to by one thread at a time.
+class Trace_channel
+{
+public:
+    explicit Trace_channel(Trace_writer* writer);
+
+    void append(const Trace_record& record)
+    {
+        if (_block->num_records == TRACE_BLOCK_NUM_RECORDS)
+        {
+            flush();
+        }
+        _block->records[_block->num_records] = record;
+        (_block->num_records)++;
+    }
+
+    /// Hand the current block, if not empty, off to be written, and start a new one
+    void flush();
+
+private:
+    Trace_writer* _writer;
+    std::unique_ptr<Trace_block> _block;
+};
+
+/// Writes a trace file from any number of `Trace_channel`s. Full blocks are written to disk by a
+/// background I/O thread, so producers never wait on disk I/O: if the disk falls behind, more
+/// blocks are allocated rather than stalling the simulation.
+class Trace_writer
+{
+public:
+    Trace_writer() = default;
+    ~Trace_writer();
+
+    Trace_writer(const Trace_writer&) = delete;
+    Trace_writer& operator=(const Trace_writer&) = delete;
+
+    /// Create the file at `path`, write its header and vehicle types, and start the I/O thread.
+    /// `header.magic`, `version`, `record_size`, and `num_vehicle_types` are filled in here.
+    /// Returns false, after printing why, on any error.
+    bool open(const std::string& path,
+              Trace_file_header header,
+              const std::vector<Trace_vehicle_type>& vehicle_types);
+
+    /// Add a new channel, owned by this writer. Not thread-safe: add all channels before
+    /// producing records from more than one thread.
+    Trace_channel* add_channel();
+
+    /// Flush every channel, wait for all blocks to be written, and close the file. Returns false,
+    /// after printing why, if any write failed.
+    bool close();
+
+private:
+    friend class Trace_channel;
+
+    /// Queue `full_block` to be written, if not null, and return an empty block to fill next
+    std::unique_ptr<Trace_block> exchange_block(std::unique_ptr<Trace_block> full_block);
+
+    void io_loop();
+
+    FILE* _file = nullptr;
+    std::string _path;
+    std::vector<std::unique_ptr<Trace_channel>> _channels;
+    std::thread _io_thread;
+
+    /// Protects all members below
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::unique_ptr<Trace_block>> _full_blocks;
+    std::vector<std::unique_ptr<Trace_block>> _free_blocks;
+    bool _closing = false;
+    bool _write_failed = false;
+};
+
+/// Reads a trace file written by `Trace_writer`, one record at a time
+class Trace_reader
+{
+public:
+    Trace_reader() = default;
+    ~Trace_reader();
+
+    Trace_reader(const Trace_reader&) = delete;
+    Trace_reader& operator=(const Trace_reader&) = delete;
+
+    /// Open the file at `path` and read and validate its header and vehicle types. Returns false,
+    /// after printing why, on any error.
+    bool open(const std::string& path);
+
+    /// Read the next record. Returns false at the end of the file.
+    bool next(Trace_record* record);
+
+    const Trace_file_header& header() const
+    {
+        return _header;
+    }
+
+    const std::vector<Trace_vehicle_type>& vehicle_types() const
+    {
+        return _vehicle_types;
+    }
+
+private:
+    FILE* _file = nullptr;
+    Trace_file_header _header{};
+    std::vector<Trace_vehicle_type> _vehicle_types;
+    std::vector<Trace_record> _buffer;
+    size_t _i_buffer = 0;
+};
+
+/// A read-only, zero-copy view of a whole trace file, memory-mapped into this process. Records are
+/// read straight out of the page cache, so a trace can be scanned from many threads at once
+/// without copying it, or even fitting it in memory.
+class Trace_mapped_file
+{
+public:
+    Trace_mapped_file() = default;
+    ~Trace_mapped_file();
+
+    Trace_mapped_file(const Trace_mapped_file&) = delete;
+    Trace_mapped_file& operator=(const Trace_mapped_file&) = delete;
+
+    /// Map the file at `path` and validate its header and vehicle types. Returns false, after
+    /// printing why, on any error.
+    bool open(const std::string& path);
+
+    const Trace_file_header& header() const
+    {
+        return *reinterpret_cast<const Trace_file_header*>(_data);
+    }
+
+    const Trace_vehicle_type* vehicle_types() const
+    {
+        return reinterpret_cast<const Trace_vehicle_type*>(_data + sizeof(Trace_file_header));
+    }
+
+    const Trace_record* records() const
+    {
+        return _records;
+    }
+
+    size_t num_records() const
+    {
+        return _num_records;
+    }
+
+private:
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+    const Trace_record* _records = nullptr;
+    size_t _num_records = 0;
+};
@@ -0,0 +1,411 @@
+#include "trace_analysis.h"
+
+// local includes
+#include "thread_pool.h"
+
+// C++ includes
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+constexpr size_t NUM_VEHICLE_STATES = (size_t)Vehicle_state::CHARGING + 1;
+
+/// Sums over the records of one chunk, in which every vehicle's state changes are accumulated
+/// as `exit time - entry time` for each state, split apart into a sum of exit times and a sum of
+/// negated entry times. That way, each record contributes on its own, without pairing it up with
+/// the same vehicle's previous record, which may be in another chunk entirely; and the sums of
+/// all chunks simply add up.
+struct Chunk_sums
+{
+    struct Type_sums
+    {
+        uint64_t num_vehicles = 0;
+        uint64_t num_faults = 0;
+        /// Entries into each `Vehicle_state`, including initial states
+        uint64_t num_entries[NUM_VEHICLE_STATES] = {};
+        uint64_t num_exits[NUM_VEHICLE_STATES] = {};
+        /// Sum of exit times minus sum of entry times, for each `Vehicle_state`
+        double time_hrs[NUM_VEHICLE_STATES] = {};
+    };
+
+    std::vector<Type_sums> by_type;
+
+    // Charger utilization: charger time in use within each bin, for each segment of use starting
+    // or ending in it, plus the net number of chargers in use for the whole of each bin onward
+
+    std::vector<double> partial_bin_busy_hrs;
+    std::vector<int64_t> num_busy_from_bin;
+
+    /// Net change in the number of vehicles waiting for a charger over the chunk
+    int64_t queue_length_delta = 0;
+    /// Time of the chunk's first state change (or initial state) record; -1 if it has none
+    double first_state_change_time_hrs = -1;
+
+    /// Set in the second pass: the time spent at each queue length during the chunk
+    std::vector<double> queue_length_time_hrs;
+
+    /// Index of the first invalid record in the chunk, if any
+    bool valid = true;
+    size_t i_invalid_record = 0;
+};
+
+/// The state changes, as `(from_state, to_state)`, recorded by `record`. Returns false for
+/// records which don't change any state (faults). An initial state is an entry only, so has no
+/// `from_state`, which is returned as `NUM_VEHICLE_STATES`.
+static bool get_state_change(const Trace_record& record, size_t* from_state, size_t* to_state)
+{
+    switch ((Trace_event)record.event)
+    {
+    case Trace_event::INITIAL_STATE:
+        *from_state = NUM_VEHICLE_STATES;
+        *to_state = record.to_state;
+        return true;
+    case Trace_event::STATE_CHANGE:
+        *from_state = record.from_state;
+        *to_state = record.to_state;
+        return true;
+    case Trace_event::FAULT:
+        break;
+    }
+    return false;
+}
+
+static bool is_valid(const Trace_record& record, size_t num_vehicle_types)
+{
+    return record.i_vehicle_type < num_vehicle_types
+           && record.event <= (uint8_t)Trace_event::FAULT
+           && record.from_state < NUM_VEHICLE_STATES && record.to_state < NUM_VEHICLE_STATES;
+}
+
+uint32_t Trace_analysis::queue_length_percentile(double fraction) const
+{
+    double total_time_hrs = 0;
+    for (double time_hrs : queue_length_time_hrs)
+    {
+        total_time_hrs += time_hrs;
+    }
+
+    double cumulative_time_hrs = 0;
+    for (size_t queue_length = 0; queue_length < queue_length_time_hrs.size(); queue_length++)
+    {
+        cumulative_time_hrs += queue_length_time_hrs[queue_length];
+        // allow for floating point error in the sum
+        if (cumulative_time_hrs >= fraction * total_time_hrs * (1 - 1e-12))
+        {
+            return queue_length;
+        }
+    }
+    return queue_length_time_hrs.empty() ? 0 : queue_length_time_hrs.size() - 1;
+}
+
+bool analyze_trace(const Trace_mapped_file& trace,
+                   const Trace_analysis_config& config,
+                   Trace_analysis* analysis)
+{
+    const Trace_file_header& header = trace.header();
+    const size_t num_vehicle_types = header.num_vehicle_types;
+    const size_t num_bins = std::max(1U, config.num_utilization_bins);
+
+    *analysis = Trace_analysis{};
+    for (size_t i_type = 0; i_type < num_vehicle_types; i_type++)
+    {
+        analysis->vehicle_type_names.push_back(trace.vehicle_types()[i_type].name);
+    }
+    analysis->num_records = trace.num_records();
+    analysis->num_chargers = header.num_chargers;
+    // the same number of whole time steps that the simulation ran for
+    analysis->end_time_hrs =
+        (uint64_t)(header.simulation_duration_hrs / header.simulation_step_size_hrs)
+        * header.simulation_step_size_hrs;
+    analysis->utilization_bin_width_hrs = analysis->end_time_hrs / num_bins;
+
+    const double end_time_hrs = analysis->end_time_hrs;
+    const double bin_width_hrs = analysis->utilization_bin_width_hrs;
+    const size_t chunk_size = std::max<size_t>(1, config.num_records_per_chunk);
+    const size_t num_chunks = (trace.num_records() + chunk_size - 1) / chunk_size;
+    std::vector<Chunk_sums> chunks(num_chunks);
+
+    auto chunk_records = [&](size_t i_chunk, const Trace_record** begin, const Trace_record** end) {
+        *begin = trace.records() + i_chunk * chunk_size;
+        *end = trace.records() + std::min(trace.num_records(), (i_chunk + 1) * chunk_size);
+    };
+
+    // Pass 1: sum up every chunk independently
+
+    auto sum_chunk = [&](uint64_t i_chunk) {
+        Chunk_sums& sums = chunks[i_chunk];
+        sums.by_type.resize(num_vehicle_types);
+        sums.partial_bin_busy_hrs.assign(num_bins, 0);
+        sums.num_busy_from_bin.assign(num_bins, 0);
+
+        // `sign` is +1 for a charger coming into use at `time_hrs`, and -1 for one freed up
+        auto add_busy = [&](int64_t sign, double time_hrs) {
+            if (time_hrs >= end_time_hrs)
+            {
+                return;
+            }
+            size_t i_bin = std::min((size_t)(time_hrs / bin_width_hrs), num_bins - 1);
+            sums.partial_bin_busy_hrs[i_bin] += sign * ((i_bin + 1) * bin_width_hrs - time_hrs);
+            if (i_bin + 1 < num_bins)
+            {
+                sums.num_busy_from_bin[i_bin + 1] += sign;
+            }
+        };
+
+        const Trace_record* begin;
+        const Trace_record* end;
+        chunk_records(i_chunk, &begin, &end);
+        for (const Trace_record* record = begin; record < end; record++)
+        {
+            if (!is_valid(*record, num_vehicle_types))
+            {
+                sums.valid = false;
+                sums.i_invalid_record = record - trace.records();
+                return;
+            }
+
+            Chunk_sums::Type_sums& type_sums = sums.by_type[record->i_vehicle_type];
+            double time_hrs = std::min(record->time_hrs, end_time_hrs);
+
+            if ((Trace_event)record->event == Trace_event::FAULT)
+            {
+                (type_sums.num_faults)++;
+                continue;
+            }
+            if ((Trace_event)record->event == Trace_event::INITIAL_STATE)
+            {
+                (type_sums.num_vehicles)++;
+            }
+            if (sums.first_state_change_time_hrs < 0)
+            {
+                sums.first_state_change_time_hrs = time_hrs;
+            }
+
+            size_t from_state;
+            size_t to_state;
+            get_state_change(*record, &from_state, &to_state);
+            if (from_state < NUM_VEHICLE_STATES)
+            {
+                (type_sums.num_exits[from_state])++;
+                type_sums.time_hrs[from_state] += time_hrs;
+            }
+            (type_sums.num_entries[to_state])++;
+            type_sums.time_hrs[to_state] -= time_hrs;
+
+            if (from_state == (size_t)Vehicle_state::CHARGING)
+            {
+                add_busy(-1, time_hrs);
+            }
+            if (to_state == (size_t)Vehicle_state::CHARGING)
+            {
+                add_busy(+1, time_hrs);
+            }
+            sums.queue_length_delta += (to_state == (size_t)Vehicle_state::WAITING_FOR_CHARGER)
+                                       - (from_state == (size_t)Vehicle_state::WAITING_FOR_CHARGER);
+        }
+    };
+
+    // Pass 2: now that each chunk's starting queue length is known, sweep each chunk's state
+    // changes in time order to find the time spent at each queue length. Note: all state changes
+    // are traced from one channel, so are in time order, even if faults are interleaved.
+
+    std::vector<int64_t> start_queue_lengths(num_chunks, 0);
+    std::vector<double> next_state_change_times_hrs(num_chunks, end_time_hrs);
+
+    auto sweep_chunk_queue = [&](uint64_t i_chunk) {
+        Chunk_sums& sums = chunks[i_chunk];
+
+        auto add_queue_time = [&](int64_t queue_length, double time_hrs) {
+            size_t i_length = std::max<int64_t>(queue_length, 0);
+            if (i_length >= sums.queue_length_time_hrs.size())
+            {
+                sums.queue_length_time_hrs.resize(i_length + 1, 0);
+            }
+            sums.queue_length_time_hrs[i_length] += time_hrs;
+        };
+
+        int64_t queue_length = start_queue_lengths[i_chunk];
+        double last_time_hrs = -1;
+
+        const Trace_record* begin;
+        const Trace_record* end;
+        chunk_records(i_chunk, &begin, &end);
+        for (const Trace_record* record = begin; record < end; record++)
+        {
+            size_t from_state;
+            size_t to_state;
+            if (!get_state_change(*record, &from_state, &to_state))
+            {
+                continue;
+            }
+
+            double time_hrs = std::min(record->time_hrs, end_time_hrs);
+            if (last_time_hrs >= 0)
+            {
+                add_queue_time(queue_length, time_hrs - last_time_hrs);
+            }
+            queue_length += (to_state == (size_t)Vehicle_state::WAITING_FOR_CHARGER)
+                            - (from_state == (size_t)Vehicle_state::WAITING_FOR_CHARGER);
+            last_time_hrs = time_hrs;
+        }
+
+        // the queue stays this long until the next chunk's first state change
+        if (last_time_hrs >= 0)
+        {
+            add_queue_time(queue_length, next_state_change_times_hrs[i_chunk] - last_time_hrs);
+        }
+    };
+
+    Thread_pool thread_pool{config.num_threads};
+    thread_pool.parallel_for(num_chunks, sum_chunk);
+
+    for (const Chunk_sums& sums : chunks)
+    {
+        if (!sums.valid)
+        {
+            printf("Error: trace record %lu is invalid.\n", sums.i_invalid_record);
+            return false;
+        }
+    }
+
+    for (size_t i_chunk = 1; i_chunk < num_chunks; i_chunk++)
+    {
+        start_queue_lengths[i_chunk] =
+            start_queue_lengths[i_chunk - 1] + chunks[i_chunk - 1].queue_length_delta;
+    }
+    for (size_t i_chunk = num_chunks; i_chunk-- > 1;)
+    {
+        double first_time_hrs = chunks[i_chunk].first_state_change_time_hrs;
+        next_state_change_times_hrs[i_chunk - 1] =
+            first_time_hrs >= 0 ? first_time_hrs : next_state_change_times_hrs[i_chunk];
+    }
+
+    thread_pool.parallel_for(num_chunks, sweep_chunk_queue);
+
+    // Merge all chunks, in chunk order
+
+    std::vector<Chunk_sums::Type_sums> type_sums(num_vehicle_types);
+    std::vector<double> bin_busy_hrs(num_bins, 0);
+    std::vector<int64_t> num_busy_from_bin(num_bins, 0);
+    for (const Chunk_sums& sums : chunks)
+    {
+        for (size_t i_type = 0; i_type < num_vehicle_types; i_type++)
+        {
+            const Chunk_sums::Type_sums& chunk_type_sums = sums.by_type[i_type];
+            type_sums[i_type].num_vehicles += chunk_type_sums.num_vehicles;
+            type_sums[i_type].num_faults += chunk_type_sums.num_faults;
+            for (size_t state = 0; state < NUM_VEHICLE_STATES; state++)
+            {
+                type_sums[i_type].num_entries[state] += chunk_type_sums.num_entries[state];
+                type_sums[i_type].num_exits[state] += chunk_type_sums.num_exits[state];
+                type_sums[i_type].time_hrs[state] += chunk_type_sums.time_hrs[state];
+            }
+        }
+
+        for (size_t i_bin = 0; i_bin < num_bins; i_bin++)
+        {
+            bin_busy_hrs[i_bin] += sums.partial_bin_busy_hrs[i_bin];
+            num_busy_from_bin[i_bin] += sums.num_busy_from_bin[i_bin];
+        }
+
+        if (sums.queue_length_time_hrs.size() > analysis->queue_length_time_hrs.size())
+        {
+            analysis->queue_length_time_hrs.resize(sums.queue_length_time_hrs.size(), 0);
+        }
+        for (size_t i_length = 0; i_length < sums.queue_length_time_hrs.size(); i_length++)
+        {
+            analysis->queue_length_time_hrs[i_length] += sums.queue_length_time_hrs[i_length];
+        }
+    }
+
+    for (size_t i_type = 0; i_type < num_vehicle_types; i_type++)
+    {
+        Chunk_sums::Type_sums& sums = type_sums[i_type];
+
+        // Every vehicle still in a state at the end of the run exits it then
+        for (size_t state = 0; state < NUM_VEHICLE_STATES; state++)
+        {
+            sums.time_hrs[state] +=
+                ((double)sums.num_entries[state] - (double)sums.num_exits[state]) * end_time_hrs;
+        }
+
+        const size_t flying = (size_t)Vehicle_state::FLYING;
+        const size_t waiting = (size_t)Vehicle_state::WAITING_FOR_CHARGER;
+        const size_t charging = (size_t)Vehicle_state::CHARGING;
+
+        Vehicle_type_stats stats;
+        stats.num_vehicles = sums.num_vehicles;
+        stats.total_num_faults = sums.num_faults;
+        stats.total_num_flights = sums.num_entries[flying];
+        stats.total_flight_time_hrs = sums.time_hrs[flying];
+        stats.total_distance_miles =
+            sums.time_hrs[flying] * trace.vehicle_types()[i_type].cruise_speed_mph;
+        stats.total_num_times_waiting = sums.num_entries[waiting];
+        stats.total_wait_time_hrs = sums.time_hrs[waiting];
+        stats.total_num_charges = sums.num_entries[charging];
+        stats.total_charge_time_hrs = sums.time_hrs[charging];
+        calculate_compound_stats(trace.vehicle_types()[i_type].passengers_per_vehicle, &stats);
+        analysis->stats_by_type.push_back(stats);
+    }
+
+    double total_busy_hrs = 0;
+    int64_t num_busy = 0;
+    for (size_t i_bin = 0; i_bin < num_bins; i_bin++)
+    {
+        num_busy += num_busy_from_bin[i_bin];
+        double busy_hrs = bin_busy_hrs[i_bin] + num_busy * bin_width_hrs;
+        total_busy_hrs += busy_hrs;
+        analysis->charger_utilization_by_bin.push_back(
+            header.num_chargers > 0 ? busy_hrs / (header.num_chargers * bin_width_hrs) : 0);
+    }
+    analysis->avg_charger_utilization =
+        header.num_chargers > 0 ? total_busy_hrs / (header.num_chargers * end_time_hrs) : 0;
+
+    double queue_length_sum = 0;
+    for (size_t i_length = 0; i_length < analysis->queue_length_time_hrs.size(); i_length++)
+    {
+        queue_length_sum += i_length * analysis->queue_length_time_hrs[i_length];
+    }
+    analysis->avg_queue_length = queue_length_sum / end_time_hrs;
+
+    return true;
+}
+
+void print_trace_analysis(const Trace_analysis& analysis)
+{
+    printf("\nTrace analysis: %lu records, %u chargers, %.3f hrs\n\n",
+           analysis.num_records,
+           analysis.num_chargers,
+           analysis.end_time_hrs);
+
+    for (size_t i_type = 0; i_type < analysis.stats_by_type.size(); i_type++)
+    {
+        printf("Vehicle type: %s\n", analysis.vehicle_type_names[i_type].c_str());
+        for (size_t i_metric = 0; i_metric < NUM_VEHICLE_TYPE_METRICS; i_metric++)
+        {
+            Vehicle_type_metric metric = (Vehicle_type_metric)i_metric;
+            printf("    %-32s = %f\n",
+                   metric_name(metric),
+                   metric_value(analysis.stats_by_type[i_type], metric));
+        }
+        printf("\n");
+    }
+
+    printf("Charger utilization (fraction of all chargers in use):\n");
+    for (size_t i_bin = 0; i_bin < analysis.charger_utilization_by_bin.size(); i_bin++)
+    {
+        printf("    %7.3f to %7.3f hrs: %.3f\n",
+               i_bin * analysis.utilization_bin_width_hrs,
+               (i_bin + 1) * analysis.utilization_bin_width_hrs,
+               analysis.charger_utilization_by_bin[i_bin]);
+    }
+    printf("    whole run:              %.3f\n\n", analysis.avg_charger_utilization);
+
+    printf("Number of vehicles waiting for a charger, weighted by time:\n"
+           "    mean = %.3f, p50 = %u, p90 = %u, p99 = %u, max = %u\n",
+           analysis.avg_queue_length,
+           analysis.queue_length_percentile(0.5),
+           analysis.queue_length_percentile(0.9),
+           analysis.queue_length_percentile(0.99),
+           analysis.queue_length_percentile(1));
+}
@@ -0,0 +1,70 @@
+/*
+Trace analysis module: recompute a past run's `Vehicle_type_stats`, plus metrics the simulation
+itself doesn't track--charger utilization over time and queue length percentiles--from its trace
+alone, without re-running it.
+*/
+
+#pragma once
+
+// local includes
+#include "trace.h"
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Default number of records each thread scans at a time: 16 MiB of records
+constexpr size_t TRACE_ANALYSIS_CHUNK_NUM_RECORDS = 1 << 20;
+
+struct Trace_analysis_config
+{
+    /// Independent of the number of threads, so that results are identical for any number of
+    /// threads
+    size_t num_records_per_chunk = TRACE_ANALYSIS_CHUNK_NUM_RECORDS;
+    /// 0 means one thread per hardware thread
+    uint32_t num_threads = 0;
+    /// Number of equal-width time bins to report charger utilization in
+    uint32_t num_utilization_bins = 12;
+};
+
+struct Trace_analysis
+{
+    std::vector<std::string> vehicle_type_names;
+    /// The same stats as the simulation calculated, but recomputed from the trace
+    std::vector<Vehicle_type_stats> stats_by_type;
+
+    uint64_t num_records = 0;
+    uint32_t num_chargers = 0;
+    /// The simulation time at which the run ended
+    double end_time_hrs = 0;
+
+    /// Fraction of all chargers in use, averaged over each equal-width time bin
+    std::vector<double> charger_utilization_by_bin;
+    double utilization_bin_width_hrs = 0;
+    /// Fraction of all chargers in use, averaged over the whole run
+    double avg_charger_utilization = 0;
+
+    /// `queue_length_time_hrs[n]` is the total time that exactly `n` vehicles were waiting for a
+    /// charger
+    std::vector<double> queue_length_time_hrs;
+    /// Time-weighted average number of vehicles waiting for a charger
+    double avg_queue_length = 0;
+
+    /// The smallest queue length which the queue was at or below for at least `fraction` (0 to 1)
+    /// of the run; ex: `queue_length_percentile(0.9)` is the 90th percentile
+    uint32_t queue_length_percentile(double fraction) const;
+};
+
+/// Scan every record in `trace` in parallel, and fill in `analysis`. Returns false, after printing
+/// why, if the trace is inconsistent.
+bool analyze_trace(const Trace_mapped_file& trace,
+                   const Trace_analysis_config& config,
+                   Trace_analysis* analysis);
+
+void print_trace_analysis(const Trace_analysis& analysis);
@@ -0,0 +1,94 @@
+/*
+Trace reader tool: analyze, and optionally print the records in, a binary trace file written by a
+simulation run with the `trace_path` setting. Recomputes the run's results by vehicle type, plus
+charger utilization over time and queue length percentiles, from the trace alone. The trace is
+memory-mapped and scanned in parallel, so even multi-gigabyte traces are analyzed without copying
+them into memory. See "trace.h" for the file format.
+
+Usage:
+    evtol_trace_reader <trace_file> [num_records_to_print]
+
+`num_records_to_print` defaults to 0; pass "all" to print every record.
+*/
+
+// local includes
+#include "trace.h"
+#include "trace_analysis.h"
+#include "vehicle.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        printf("Usage: %s <trace_file> [num_records_to_print | all]\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t num_records_to_print = 0;
+    if (argc == 3)
+    {
+        std::string arg = argv[2];
+        char* end = nullptr;
+        num_records_to_print = arg == "all" ? UINT64_MAX : strtoull(arg.c_str(), &end, 10);
+        if (arg != "all" && (end == arg.c_str() || *end != '\0'))
+        {
+            printf("Error: invalid number of records to print \"%s\".\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    Trace_mapped_file trace;
+    if (!trace.open(argv[1]))
+    {
+        return 1;
+    }
+
+    const Trace_file_header& header = trace.header();
+    printf("Trace of %u vehicles of %u types, with %u chargers, over %.3f hrs in %.6f hr "
+           "steps.\n\n",
+           header.num_vehicles,
+           header.num_vehicle_types,
+           header.num_chargers,
+           header.simulation_duration_hrs,
+           header.simulation_step_size_hrs);
+
+    Trace_analysis analysis;
+    if (!analyze_trace(trace, Trace_analysis_config{}, &analysis))
+    {
+        return 1;
+    }
+
+    if (num_records_to_print > 0)
+    {
+        printf("  time_hrs     i_vehicle  type        event          from_state           "
+               "to_state\n"
+               "-----------------------------------------------------------------------------"
+               "-------------------\n");
+    }
+    // records are known to be valid once analyzed
+    num_records_to_print = std::min(num_records_to_print, (uint64_t)trace.num_records());
+    for (uint64_t i_record = 0; i_record < num_records_to_print; i_record++)
+    {
+        const Trace_record& record = trace.records()[i_record];
+        printf("%12.6f %10u  %-10s  %-13s  %-19s  %s\n",
+               record.time_hrs,
+               record.i_vehicle,
+               trace.vehicle_types()[record.i_vehicle_type].name,
+               trace_event_name((Trace_event)record.event),
+               vehicle_state_name((Vehicle_state)record.from_state),
+               vehicle_state_name((Vehicle_state)record.to_state));
+    }
+
+    print_trace_analysis(analysis);
+    return 0;
+}
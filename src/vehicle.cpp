@@ -1,5 +1,22 @@
 #include "vehicle.h"
 
+// local includes
+#include "checkpoint.h"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <utility>
+
+uint64_t num_steps_to_complete(double duration_hrs, double step_size_hrs)
+{
+    // Subtract a tiny epsilon so that a duration which is an exact multiple of the step size
+    // doesn't get rounded up an extra step due to floating point error
+    return (uint64_t)std::ceil(duration_hrs / step_size_hrs - 1e-9);
+}
+
 Vehicle_type::Vehicle_type(
     std::string name_,
     double cruise_speed_mph_,
@@ -19,7 +36,8 @@ Vehicle_type::Vehicle_type(
       // derived values
       max_range_miles{battery_capacity_kwh / energy_used_kwh_per_mile},
       max_flight_time_hrs{max_range_miles / cruise_speed_mph},
-      cruise_power_kw{battery_capacity_kwh / max_flight_time_hrs}
+      cruise_power_kw{battery_capacity_kwh / max_flight_time_hrs},
+      charge_power_kw{battery_capacity_kwh / time_to_charge_hrs}
 {
 }
 
@@ -28,7 +46,7 @@ void Vehicle_type::print() const
     printf(
         "%-10s Primary values: %8.2f %8.2f %6.2f %6.8f %4u %6.2f\n"
         "           Derived values: max_range_miles=%.2f max_flight_time_hrs=%.2f "
-        "cruise_power_kw=%.2f\n\n",
+        "cruise_power_kw=%.2f charge_power_kw=%.2f\n\n",
         name.c_str(),
         // primary values
         cruise_speed_mph,
@@ -40,11 +58,403 @@ void Vehicle_type::print() const
         // derived values
         max_range_miles,
         max_flight_time_hrs,
-        cruise_power_kw);
+        cruise_power_kw,
+        charge_power_kw);
+}
+
+void Vehicle_type::bind_to_step_size(double step_size_hrs_)
+{
+    step_size_hrs = step_size_hrs_;
+    distance_per_step_miles = cruise_speed_mph * step_size_hrs;
+    prob_fault_per_step = prob_fault_per_hr * step_size_hrs;
+    // every flight and charge takes at least 1 time step
+    num_flight_steps =
+        std::max<uint64_t>(num_steps_to_complete(max_flight_time_hrs, step_size_hrs), 1);
+    num_charge_steps =
+        std::max<uint64_t>(num_steps_to_complete(time_to_charge_hrs, step_size_hrs), 1);
+}
+
+uint32_t Vehicle_type::num_steps_remaining(Vehicle_state state,
+                                           double battery_state_of_charge_kwh) const
+{
+    uint64_t num_steps = 0;
+    switch (state)
+    {
+    case Vehicle_state::FLYING:
+        num_steps = battery_state_of_charge_kwh >= battery_capacity_kwh
+                        ? num_flight_steps
+                        : num_steps_to_complete(battery_state_of_charge_kwh / cruise_power_kw,
+                                                step_size_hrs);
+        break;
+    case Vehicle_state::WAITING_FOR_CHARGER:
+        return 0;
+    case Vehicle_state::CHARGING:
+        num_steps = battery_state_of_charge_kwh <= 0
+                        ? num_charge_steps
+                        : num_steps_to_complete((battery_capacity_kwh - battery_state_of_charge_kwh)
+                                                    / battery_capacity_kwh * time_to_charge_hrs,
+                                                step_size_hrs);
+        break;
+    }
+
+    return std::max<uint64_t>(num_steps, 1);
+}
+
+double Vehicle_type::state_of_charge_kwh(Vehicle_state state, uint32_t num_steps_remaining) const
+{
+    // Note: calculated the same way as the `Engine::EVENT_DRIVEN` engine does, from the time
+    // since the flight or charge started
+    switch (state)
+    {
+    case Vehicle_state::FLYING:
+    {
+        double flight_time_hrs = (num_flight_steps - num_steps_remaining) * step_size_hrs;
+        return std::max(battery_capacity_kwh - flight_time_hrs * cruise_power_kw, 0.0);
+    }
+    case Vehicle_state::WAITING_FOR_CHARGER:
+        return 0;
+    case Vehicle_state::CHARGING:
+    {
+        double charge_time_hrs = (num_charge_steps - num_steps_remaining) * step_size_hrs;
+        return std::min(charge_time_hrs * battery_capacity_kwh / time_to_charge_hrs,
+                        battery_capacity_kwh);
+    }
+    }
+
+    return 0;
 }
 
-Vehicle::Vehicle(Vehicle_type* type_) : type{type_}
+Vehicle::Vehicle(uint16_t i_type_, const Vehicle_type& type) : i_type{i_type_}
 {
     // start the vehicle out with a fully-charged battery
-    stats.battery_state_of_charge_kwh = type->battery_capacity_kwh;
+    stats.battery_state_of_charge_kwh = type.battery_capacity_kwh;
+}
+
+bool Vehicle_type::is_valid() const
+{
+    bool valid = true;
+
+    auto check_positive = [&](double value, const char* value_name) {
+        // Note: written this way so that NaN fails too
+        if (!(value > 0 && std::isfinite(value)))
+        {
+            printf(
+                "Error: vehicle type \"%s\": %s must be > 0, but is %f.\n",
+                name.c_str(),
+                value_name,
+                value);
+            valid = false;
+        }
+    };
+
+    if (name.empty())
+    {
+        printf("Error: vehicle type name must not be empty.\n");
+        valid = false;
+    }
+    check_positive(cruise_speed_mph, "cruise_speed_mph");
+    check_positive(battery_capacity_kwh, "battery_capacity_kwh");
+    check_positive(time_to_charge_hrs, "time_to_charge_hrs");
+    check_positive(energy_used_kwh_per_mile, "energy_used_kwh_per_mile");
+    if (!(prob_fault_per_hr >= 0 && std::isfinite(prob_fault_per_hr)))
+    {
+        printf(
+            "Error: vehicle type \"%s\": prob_fault_per_hr must be >= 0, but is %f.\n",
+            name.c_str(),
+            prob_fault_per_hr);
+        valid = false;
+    }
+
+    return valid;
+}
+
+bool Vehicle_type::fits_step_size(double step_size_hrs) const
+{
+    bool fits = true;
+
+    auto check_num_steps = [&](double duration_hrs, const char* duration_name) {
+        // Note: compared before converting to an integer, which would wrap around
+        if (!(duration_hrs / step_size_hrs <= std::numeric_limits<uint32_t>::max()))
+        {
+            printf(
+                "Error: vehicle type \"%s\": %s takes more than %u time steps of %f hrs; "
+                "increase simulation_step_size_hrs.\n",
+                name.c_str(),
+                duration_name,
+                std::numeric_limits<uint32_t>::max(),
+                step_size_hrs);
+            fits = false;
+        }
+    };
+
+    check_num_steps(max_flight_time_hrs, "a full flight");
+    check_num_steps(time_to_charge_hrs, "a full charge");
+
+    return fits;
+}
+
+const char* metric_name(Vehicle_type_metric metric)
+{
+    switch (metric)
+    {
+    case Vehicle_type_metric::AVG_FLIGHT_TIME_PER_FLIGHT_HRS:
+        return "avg_flight_time_per_flight_hrs";
+    case Vehicle_type_metric::AVG_DISTANCE_PER_FLIGHT_MILES:
+        return "avg_distance_per_flight_miles";
+    case Vehicle_type_metric::AVG_CHARGE_TIME_PER_SESSION_HRS:
+        return "avg_charge_time_per_session_hrs";
+    case Vehicle_type_metric::TOTAL_NUM_FAULTS:
+        return "total_num_faults";
+    case Vehicle_type_metric::TOTAL_NUM_PASSENGER_MILES:
+        return "total_num_passenger_miles";
+    case Vehicle_type_metric::TOTAL_NUM_FLIGHTS:
+        return "total_num_flights";
+    case Vehicle_type_metric::TOTAL_FLIGHT_TIME_HRS:
+        return "total_flight_time_hrs";
+    case Vehicle_type_metric::TOTAL_DISTANCE_MILES:
+        return "total_distance_miles";
+    case Vehicle_type_metric::TOTAL_NUM_TIMES_WAITING:
+        return "total_num_times_waiting";
+    case Vehicle_type_metric::TOTAL_WAIT_TIME_HRS:
+        return "total_wait_time_hrs";
+    case Vehicle_type_metric::TOTAL_NUM_CHARGES:
+        return "total_num_charges";
+    case Vehicle_type_metric::TOTAL_CHARGE_TIME_HRS:
+        return "total_charge_time_hrs";
+    case Vehicle_type_metric::NUM_VEHICLES:
+        return "num_vehicles";
+    }
+
+    return "unknown";
+}
+
+double metric_value(const Vehicle_type_stats& stats, Vehicle_type_metric metric)
+{
+    switch (metric)
+    {
+    case Vehicle_type_metric::AVG_FLIGHT_TIME_PER_FLIGHT_HRS:
+        return stats.avg_flight_time_per_flight_hrs;
+    case Vehicle_type_metric::AVG_DISTANCE_PER_FLIGHT_MILES:
+        return stats.avg_distance_per_flight_miles;
+    case Vehicle_type_metric::AVG_CHARGE_TIME_PER_SESSION_HRS:
+        return stats.avg_charge_time_per_session_hrs;
+    case Vehicle_type_metric::TOTAL_NUM_FAULTS:
+        return stats.total_num_faults;
+    case Vehicle_type_metric::TOTAL_NUM_PASSENGER_MILES:
+        return stats.total_num_passenger_miles;
+    case Vehicle_type_metric::TOTAL_NUM_FLIGHTS:
+        return stats.total_num_flights;
+    case Vehicle_type_metric::TOTAL_FLIGHT_TIME_HRS:
+        return stats.total_flight_time_hrs;
+    case Vehicle_type_metric::TOTAL_DISTANCE_MILES:
+        return stats.total_distance_miles;
+    case Vehicle_type_metric::TOTAL_NUM_TIMES_WAITING:
+        return stats.total_num_times_waiting;
+    case Vehicle_type_metric::TOTAL_WAIT_TIME_HRS:
+        return stats.total_wait_time_hrs;
+    case Vehicle_type_metric::TOTAL_NUM_CHARGES:
+        return stats.total_num_charges;
+    case Vehicle_type_metric::TOTAL_CHARGE_TIME_HRS:
+        return stats.total_charge_time_hrs;
+    case Vehicle_type_metric::NUM_VEHICLES:
+        return stats.num_vehicles;
+    }
+
+    return 0;
+}
+
+void calculate_compound_stats(uint32_t passengers_per_vehicle, Vehicle_type_stats* stats)
+{
+    // passenger miles = num_passengers * num_miles, where `total_distance_miles` already sums the
+    // miles of every vehicle of the type
+    stats->total_num_passenger_miles = passengers_per_vehicle * stats->total_distance_miles;
+
+    stats->avg_flight_time_per_flight_hrs = stats->total_flight_time_hrs / stats->total_num_flights;
+    stats->avg_distance_per_flight_miles = stats->total_distance_miles / stats->total_num_flights;
+    stats->avg_charge_time_per_session_hrs =
+        stats->total_charge_time_hrs / stats->total_num_charges;
+}
+
+const char* vehicle_state_name(Vehicle_state state)
+{
+    switch (state)
+    {
+    case Vehicle_state::FLYING:
+        return "flying";
+    case Vehicle_state::WAITING_FOR_CHARGER:
+        return "waiting_for_charger";
+    case Vehicle_state::CHARGING:
+        return "charging";
+    }
+
+    return "unknown";
+}
+
+void Vehicle_type_distributions::add(Vehicle_state state, double duration_hrs)
+{
+    switch (state)
+    {
+    case Vehicle_state::FLYING:
+        flight_time_hrs.add(duration_hrs);
+        flight_time_histogram.add(duration_hrs);
+        break;
+    case Vehicle_state::WAITING_FOR_CHARGER:
+        wait_time_hrs.add(duration_hrs);
+        break;
+    case Vehicle_state::CHARGING:
+        charge_time_hrs.add(duration_hrs);
+        break;
+    }
+}
+
+void Vehicle_type_distributions::merge(const Vehicle_type_distributions& other)
+{
+    flight_time_hrs.merge(other.flight_time_hrs);
+    wait_time_hrs.merge(other.wait_time_hrs);
+    charge_time_hrs.merge(other.charge_time_hrs);
+    flight_time_histogram.merge(other.flight_time_histogram);
+}
+
+void Vehicle_type_distributions::clear()
+{
+    flight_time_hrs.clear();
+    wait_time_hrs.clear();
+    charge_time_hrs.clear();
+    flight_time_histogram.clear();
+}
+
+void Vehicle_type_stats::clear()
+{
+    // keep the distributions aside, rather than reassigning them, to keep their memory
+    Vehicle_type_distributions kept_distributions = std::move(distributions);
+    *this = Vehicle_type_stats();
+    distributions = std::move(kept_distributions);
+    distributions.clear();
+}
+
+void Vehicle_type_stats::merge(const Vehicle_type_stats& other)
+{
+    total_num_faults += other.total_num_faults;
+    total_num_flights += other.total_num_flights;
+    total_flight_time_hrs += other.total_flight_time_hrs;
+    total_distance_miles += other.total_distance_miles;
+    total_num_times_waiting += other.total_num_times_waiting;
+    total_wait_time_hrs += other.total_wait_time_hrs;
+    total_num_charges += other.total_num_charges;
+    total_charge_time_hrs += other.total_charge_time_hrs;
+    num_vehicles += other.num_vehicles;
+    distributions.merge(other.distributions);
+}
+
+void Fleet_results::reset(const Fleet_results& other)
+{
+    stats_by_type.resize(other.stats_by_type.size());
+    for (size_t i_type = 0; i_type < other.stats_by_type.size(); i_type++)
+    {
+        Vehicle_type_stats& stats = stats_by_type[i_type];
+        stats.clear();
+        stats.distributions.flight_time_histogram =
+            other.stats_by_type[i_type].distributions.flight_time_histogram;
+        stats.distributions.flight_time_histogram.clear();
+    }
+}
+
+void Fleet_results::add(uint16_t i_type, const Vehicle_stats& stats, double end_time_hrs)
+{
+    Vehicle_type_stats& type_stats = stats_by_type[i_type];
+    (type_stats.num_vehicles)++;
+    type_stats.total_num_flights += stats.num_flights;
+    type_stats.total_flight_time_hrs += stats.flight_time_hrs;
+    type_stats.total_distance_miles += stats.distance_miles;
+    type_stats.total_num_times_waiting += stats.num_times_waiting;
+    type_stats.total_wait_time_hrs += stats.wait_time_hrs;
+    type_stats.total_num_charges += stats.num_charges;
+    type_stats.total_charge_time_hrs += stats.charge_time_hrs;
+    type_stats.total_num_faults += stats.num_faults;
+
+    // the stint each vehicle was in the middle of ends with the simulation
+    type_stats.distributions.add(stats.state, end_time_hrs - stats.state_start_time_hrs);
+}
+
+void Fleet_results::merge(const Fleet_results& other)
+{
+    for (size_t i_type = 0; i_type < other.stats_by_type.size(); i_type++)
+    {
+        stats_by_type[i_type].merge(other.stats_by_type[i_type]);
+    }
+}
+
+void Vehicle_type_distributions::save(Checkpoint_writer* writer) const
+{
+    flight_time_hrs.save(writer);
+    wait_time_hrs.save(writer);
+    charge_time_hrs.save(writer);
+    flight_time_histogram.save(writer);
+}
+
+bool Vehicle_type_distributions::load(Checkpoint_reader* reader)
+{
+    return flight_time_hrs.load(reader) && wait_time_hrs.load(reader)
+           && charge_time_hrs.load(reader) && flight_time_histogram.load(reader);
+}
+
+void Vehicle_type_distributions::print(FILE* file) const
+{
+    auto print_distribution = [file](const char* name, const Sample_distribution& distribution) {
+        fprintf(file,
+                "    %-16s n = %lu, mean = %f, stddev = %f\n"
+                "    %-16s p50 = %f, p95 = %f, p99 = %f, max = %f\n",
+                name,
+                distribution.moments.count(),
+                distribution.moments.mean(),
+                distribution.moments.stddev(),
+                "",
+                distribution.quantiles.quantile(0.5),
+                distribution.quantiles.quantile(0.95),
+                distribution.quantiles.quantile(0.99),
+                distribution.moments.max());
+    };
+    print_distribution("flight_time_hrs", flight_time_hrs);
+    print_distribution("wait_time_hrs", wait_time_hrs);
+    print_distribution("charge_time_hrs", charge_time_hrs);
+
+    if (flight_time_histogram.count() == 0)
+    {
+        return;
+    }
+    // only print from the first to the last non-empty bin
+    size_t i_first_bin = flight_time_histogram.num_bins();
+    size_t i_end_bin = 0;
+    for (size_t i_bin = 0; i_bin < flight_time_histogram.num_bins(); i_bin++)
+    {
+        if (flight_time_histogram.bin_count(i_bin) > 0)
+        {
+            i_first_bin = std::min(i_first_bin, i_bin);
+            i_end_bin = i_bin + 1;
+        }
+    }
+
+    fprintf(file, "    flight_time_hrs histogram:\n");
+    if (flight_time_histogram.num_below() > 0)
+    {
+        fprintf(file,
+                "        below %7.4f:       %lu\n",
+                flight_time_histogram.bin_min(0),
+                flight_time_histogram.num_below());
+    }
+    for (size_t i_bin = i_first_bin; i_bin < i_end_bin; i_bin++)
+    {
+        fprintf(file,
+                "        %7.4f to %7.4f: %lu\n",
+                flight_time_histogram.bin_min(i_bin),
+                flight_time_histogram.bin_min(i_bin) + flight_time_histogram.bin_width(),
+                flight_time_histogram.bin_count(i_bin));
+    }
+    if (flight_time_histogram.num_above() > 0)
+    {
+        fprintf(file,
+                "        above %7.4f:       %lu\n",
+                flight_time_histogram.bin_min(flight_time_histogram.num_bins()),
+                flight_time_histogram.num_above());
+    }
 }
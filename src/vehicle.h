@@ -5,14 +5,59 @@ Vehicle class module for vehicle types and vehicles.
 #pragma once
 
 // local includes
+#include "rng.h"
+#include "statistics.h"
 #include "utils.h"
 
 // Linux includes
 // NA
 
 // C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
+
+/// State machine for each vehicle
+enum class Vehicle_state
+{
+    FLYING = 0,
+    WAITING_FOR_CHARGER,
+    CHARGING,
+};
+
+const char* vehicle_state_name(Vehicle_state state);
+
+/// Number of bins in each vehicle type's histogram of flight durations
+constexpr size_t FLIGHT_TIME_HISTOGRAM_NUM_BINS = 20;
+
+/// Distributions of the durations of individual flights, waits and charge sessions, accumulated
+/// online as each one ends, including those cut short by the end of the simulation
+struct Vehicle_type_distributions
+{
+    Sample_distribution flight_time_hrs;
+    Sample_distribution wait_time_hrs;
+    Sample_distribution charge_time_hrs;
+    /// Has no bins until the simulation sets them, from the vehicle type's longest flight
+    Histogram flight_time_histogram;
+
+    /// Add one stint of `duration_hrs` in `state`
+    void add(Vehicle_state state, double duration_hrs);
+
+    void merge(const Vehicle_type_distributions& other);
+
+    /// Remove all samples, keeping the memory allocated for them
+    void clear();
+
+    /// Print the mean, standard deviation and percentiles of each distribution, and the
+    /// histogram, to `file`
+    void print(FILE* file = stdout) const;
+
+    void save(Checkpoint_writer* writer) const;
+    bool load(Checkpoint_reader* reader);
+};
 
 struct Vehicle_type_stats
 {
@@ -33,8 +78,53 @@ struct Vehicle_type_stats
     uint32_t total_num_charges = 0;
     double total_charge_time_hrs = 0;
     uint32_t num_vehicles = 0;  /// the total number of vehicles of this type
+
+    Vehicle_type_distributions distributions;
+
+    /// Reset every stat to 0, keeping the memory allocated for the distributions
+    void clear();
+
+    /// Add in the totals and distributions of `other`, for more vehicles of the same type. The
+    /// compound stats must be calculated again afterwards.
+    void merge(const Vehicle_type_stats& other);
+};
+
+/// Identifies each output in `Vehicle_type_stats`, so that the outputs can be iterated over
+/// generically, such as to summarize them across many Monte Carlo replications
+enum class Vehicle_type_metric
+{
+    AVG_FLIGHT_TIME_PER_FLIGHT_HRS = 0,
+    AVG_DISTANCE_PER_FLIGHT_MILES,
+    AVG_CHARGE_TIME_PER_SESSION_HRS,
+    TOTAL_NUM_FAULTS,
+    TOTAL_NUM_PASSENGER_MILES,
+    TOTAL_NUM_FLIGHTS,
+    TOTAL_FLIGHT_TIME_HRS,
+    TOTAL_DISTANCE_MILES,
+    TOTAL_NUM_TIMES_WAITING,
+    TOTAL_WAIT_TIME_HRS,
+    TOTAL_NUM_CHARGES,
+    TOTAL_CHARGE_TIME_HRS,
+    NUM_VEHICLES,
 };
 
+constexpr size_t NUM_VEHICLE_TYPE_METRICS = (size_t)Vehicle_type_metric::NUM_VEHICLES + 1;
+
+/// The name of the `Vehicle_type_stats` member corresponding to `metric`
+const char* metric_name(Vehicle_type_metric metric);
+
+/// The value of `metric` in `stats`
+double metric_value(const Vehicle_type_stats& stats, Vehicle_type_metric metric);
+
+/// Calculate the compound stats in `stats`--the averages and passenger miles--from its totals.
+/// Every flight carries `passengers_per_vehicle` passengers for its whole distance, so passenger
+/// miles are the total distance flown times that, whatever the number of vehicles.
+void calculate_compound_stats(uint32_t passengers_per_vehicle, Vehicle_type_stats* stats);
+
+/// Return the number of whole time steps required to complete a segment (a full flight or a full
+/// charge, for instance) lasting `duration_hrs`.
+uint64_t num_steps_to_complete(double duration_hrs, double step_size_hrs);
+
 /// You need one of these objects per vehicle type
 struct Vehicle_type
 {
@@ -56,8 +146,18 @@ struct Vehicle_type
     const double max_range_miles;      // on a single charge
     const double max_flight_time_hrs;  // on a single charge
     const double cruise_power_kw;
+    const double charge_power_kw;      // charging at full speed
+
+    // values bound to the simulation's time step size by `bind_to_step_size()`, so that the
+    // stepped engines don't recompute them for every vehicle every time step
 
-    Vehicle_type_stats stats;
+    double step_size_hrs = 0;
+    double distance_per_step_miles = 0;
+    double prob_fault_per_step = 0;
+    /// Whole time steps a full flight takes, from a full battery to an empty one
+    uint32_t num_flight_steps = 0;
+    /// Whole time steps a full charge takes, from an empty battery to a full one
+    uint32_t num_charge_steps = 0;
 
     // constructor
     Vehicle_type(
@@ -70,14 +170,29 @@ struct Vehicle_type
         double prob_fault_per_hr_);
 
     void print() const;
-};
 
-/// State machine for each vehicle
-enum class Vehicle_state
-{
-    FLYING = 0,
-    WAITING_FOR_CHARGER,
-    CHARGING,
+    /// Compute the values above which depend on the time step size
+    void bind_to_step_size(double step_size_hrs_);
+
+    /// Whole time steps left in the current flight or charge of a vehicle of this type which is
+    /// in `state` with `battery_state_of_charge_kwh` left; always at least 1 while flying or
+    /// charging. Requires `bind_to_step_size()`.
+    uint32_t num_steps_remaining(Vehicle_state state, double battery_state_of_charge_kwh) const;
+
+    /// The inverse of the above: the state of charge of a vehicle of this type which is in
+    /// `state` with `num_steps_remaining` whole time steps left in its current flight or charge,
+    /// assuming the flight started with a full battery, or the charge with an empty one
+    double state_of_charge_kwh(Vehicle_state state, uint32_t num_steps_remaining) const;
+
+    /// Returns true if all primary values are physically meaningful, and otherwise prints why not
+    /// and returns false. (Ex: a zero `cruise_speed_mph` or `time_to_charge_hrs` would make the
+    /// derived values, and the simulation, infinite.)
+    bool is_valid() const;
+
+    /// Returns true if a full flight and a full charge each take few enough time steps of
+    /// `step_size_hrs` to count in `num_flight_steps` and `num_charge_steps`, and otherwise prints
+    /// why not and returns false. Requires `is_valid()`.
+    bool fits_step_size(double step_size_hrs) const;
 };
 
 struct Vehicle_stats
@@ -98,22 +213,67 @@ struct Vehicle_stats
 
     // other info
 
-    /// how full the battery currently is, this flight
+    /// Simulation time at which the vehicle entered its current `state`
+    double state_start_time_hrs = 0;
+
+    /// how full the battery currently is, this flight. The stepped engines don't track it every
+    /// time step, but derive it from `num_steps_remaining` at the end of the simulation.
     double battery_state_of_charge_kwh;
 
+    /// For the stepped engines: whole time steps left in the current flight or charge. The
+    /// flight or charge ends when this counts down to 0, so they always take exactly
+    /// `Vehicle_type::num_flight_steps` or `Vehicle_type::num_charge_steps` time steps, with no
+    /// floating point error accumulating in the state of charge.
+    uint32_t num_steps_remaining = 0;
+
+    /// For `Fault_model::POISSON`: the cumulative `flight_time_hrs` at which the next fault will
+    /// occur; negative until the first one has been sampled
+    double next_fault_flight_time_hrs = -1;
+
     Vehicle_state state = Vehicle_state::FLYING;
     Vehicle_state last_state = Vehicle_state::CHARGING;
 };
 
+/// The most vehicle types a simulation can have, since `Vehicle::i_type` is 2 bytes
+constexpr size_t MAX_NUM_VEHICLE_TYPES = (size_t)UINT16_MAX + 1;
+
 /// You need one of these objects per vehicle
 struct Vehicle
 {
     // constructor
-    Vehicle(Vehicle_type* type_);
+    Vehicle(uint16_t i_type_, const Vehicle_type& type);
 
-    // ptr to the vehicle type this vehicle is; don't copy the whole `Vehicle_type` struct into each
-    // vehicle; just point to the data; this way you don't unnecessarily duplicate `Vehicle_type`
-    // objects.
-    Vehicle_type* type;
     Vehicle_stats stats;
+    /// Simulation time of every fault, in order; only recorded if
+    /// `Simulation_options::record_fault_times` is set
+    std::vector<double> fault_times_hrs;
+    /// This vehicle's own random number stream, split off of the simulation's stream by
+    /// `Simulation::populate_vehicles()`, so that no two vehicles share random number state
+    Rng rng;
+    /// Index of the vehicle type this vehicle is, into the simulation's vehicle types; see
+    /// `Simulation::type_of()`. Don't copy the whole `Vehicle_type` struct into each vehicle, nor
+    /// point to it, which would dangle if more vehicle types were added: just index it, so that
+    /// `Vehicle_type` objects aren't duplicated, and each vehicle stays small.
+    uint16_t i_type;
+};
+
+/// The totals and distributions, by vehicle type, of any subset of a fleet's vehicles, kept apart
+/// from the vehicle types themselves, so that each chunk of a fleet can be summed up on its own,
+/// on any thread, and the chunks merged afterwards
+struct Fleet_results
+{
+    /// Indexed the same as the simulation's vehicle types
+    std::vector<Vehicle_type_stats> stats_by_type;
+
+    /// Get ready to sum up vehicles of the same types as `other`, with none so far, taking on the
+    /// bins of its flight time histograms. Keeps the memory already allocated, so it can be reused
+    /// for the next simulation.
+    void reset(const Fleet_results& other);
+
+    /// Add the totals of a vehicle of type `i_type` with stats `stats`, and the stint it's in the
+    /// middle of, which ends with the simulation at `end_time_hrs`
+    void add(uint16_t i_type, const Vehicle_stats& stats, double end_time_hrs);
+
+    /// Add in every vehicle summed up by `other`, which must be for the same vehicle types
+    void merge(const Fleet_results& other);
 };
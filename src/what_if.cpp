@@ -0,0 +1,41 @@
+#include "what_if.h"
+
+// local includes
+#include "checkpoint.h"
+#include "thread_pool.h"
+
+// C++ includes
+#include <cstdio>
+
+std::vector<std::unique_ptr<Simulation>> run_forks(const Simulation& simulation,
+                                                   const std::vector<Fork_changes>& changes,
+                                                   uint32_t num_threads)
+{
+    Checkpoint_writer writer;
+    if (!simulation.save_checkpoint(&writer))
+    {
+        return {};
+    }
+
+    std::vector<std::unique_ptr<Simulation>> forks(changes.size());
+    Thread_pool thread_pool{num_threads};
+    thread_pool.parallel_for(changes.size(), [&](uint64_t i_fork) {
+        Checkpoint_reader reader{writer.data()};
+        forks[i_fork] = Simulation::fork(&reader, changes[i_fork]);
+        if (forks[i_fork] != nullptr)
+        {
+            forks[i_fork]->run();
+        }
+    });
+
+    for (size_t i_fork = 0; i_fork < forks.size(); i_fork++)
+    {
+        if (forks[i_fork] == nullptr)
+        {
+            printf("Error: failed to fork the simulation for what-if %lu.\n", i_fork);
+            return {};
+        }
+    }
+
+    return forks;
+}
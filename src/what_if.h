@@ -0,0 +1,27 @@
+/*
+What-if module: fork one simulation, part way through, into many different futures--ex: with a
+charger taken offline, or a different fleet mix--and run them all in parallel, without re-running
+the shared warm-up before the fork for each one.
+*/
+
+#pragma once
+
+// local includes
+#include "simulation.h"
+
+// Linux includes
+// NA
+
+// C++ includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Fork `simulation`, which must not have finished running, once per element of `changes`, and
+/// run every fork to the end, in parallel on `num_threads` threads; 0 means one per hardware
+/// thread. The original's state is saved just once, and every fork is loaded from that one copy.
+/// The original itself isn't changed. Returns the finished forks, in the same order as
+/// `changes`, or an empty vector, after printing why, if any fork couldn't be made.
+std::vector<std::unique_ptr<Simulation>> run_forks(const Simulation& simulation,
+                                                   const std::vector<Fork_changes>& changes,
+                                                   uint32_t num_threads = 0);